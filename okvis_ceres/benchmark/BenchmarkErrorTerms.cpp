@@ -0,0 +1,364 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file BenchmarkErrorTerms.cpp
+ * @brief Microbenchmarks of the residual evaluation of all error terms.
+ *
+ * Every error term is timed in three modes (argument "mode"):
+ * 0: Evaluate() residuals only, 1: Evaluate() with Jacobians as requested by ceres,
+ * 2: EvaluateWithMinimalJacobians() with both the full and the minimal Jacobians.
+ * The factorisation of the marginalization prior is timed separately.
+ */
+
+#include <benchmark/benchmark.h>
+#include <okvis/Estimator.hpp>
+#include <okvis/SensorSimulator.hpp>
+#include <okvis/cameras/PinholeCamera.hpp>
+#include <okvis/cameras/EquidistantDistortion.hpp>
+#include <okvis/cameras/RadialTangentialDistortion.hpp>
+#include <okvis/cameras/RadialTangentialDistortion8.hpp>
+#include <okvis/ceres/ReprojectionError.hpp>
+#include <okvis/ceres/ImuError.hpp>
+#include <okvis/ceres/PoseError.hpp>
+#include <okvis/ceres/SpeedAndBiasError.hpp>
+#include <okvis/ceres/RelativePoseError.hpp>
+#include <okvis/ceres/HomogeneousPointError.hpp>
+#include <okvis/ceres/MarginalizationError.hpp>
+#include <okvis/ceres/PoseParameterBlock.hpp>
+#include <okvis/ceres/SpeedAndBiasParameterBlock.hpp>
+#include <okvis/ceres/HomogeneousPointParameterBlock.hpp>
+#include "benchmarkDataGenerators.hpp"
+
+namespace {
+
+/// \brief An error term together with the parameter blocks it is evaluated at.
+struct ErrorTermSetup
+{
+  std::shared_ptr<okvis::ceres::ErrorInterface> errorInterfacePtr;  ///< The error term.
+  std::vector<std::shared_ptr<okvis::ceres::ParameterBlock> > parameterBlockPtrs;  ///< Its parameter blocks.
+};
+
+typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrix;
+
+// Time the evaluation of an error term in the mode given by state.range(0).
+void evaluateErrorTerm(benchmark::State &state, ErrorTermSetup &setup) {
+  const okvis::ceres::ErrorInterface &error = *setup.errorInterfacePtr;
+  const ::ceres::CostFunction *costFunction =
+      dynamic_cast<const ::ceres::CostFunction *>(setup.errorInterfacePtr.get());
+  if (costFunction == NULL) {
+    state.SkipWithError("error term is not a ceres::CostFunction");
+    return;
+  }
+
+  const size_t numParameterBlocks = setup.parameterBlockPtrs.size();
+  std::vector<double *> parameters(numParameterBlocks);
+  std::vector<RowMajorMatrix> jacobians(numParameterBlocks);
+  std::vector<RowMajorMatrix> minimalJacobians(numParameterBlocks);
+  std::vector<double *> jacobianPtrs(numParameterBlocks);
+  std::vector<double *> minimalJacobianPtrs(numParameterBlocks);
+  for (size_t i = 0; i < numParameterBlocks; ++i) {
+    parameters[i] = setup.parameterBlockPtrs[i]->parameters();
+    jacobians[i].resize(error.residualDim(), error.parameterBlockDim(i));
+    minimalJacobians[i].resize(error.residualDim(),
+                               setup.parameterBlockPtrs[i]->minimalDimension());
+    jacobianPtrs[i] = jacobians[i].data();
+    minimalJacobianPtrs[i] = minimalJacobians[i].data();
+  }
+  Eigen::VectorXd residuals(error.residualDim());
+
+  const int mode = int(state.range(0));
+  for (auto _ : state) {
+    switch (mode) {
+      case 0:
+        costFunction->Evaluate(parameters.data(), residuals.data(), NULL);
+        break;
+      case 1:
+        costFunction->Evaluate(parameters.data(), residuals.data(), jacobianPtrs.data());
+        break;
+      default:
+        error.EvaluateWithMinimalJacobians(parameters.data(), residuals.data(),
+                                           jacobianPtrs.data(), minimalJacobianPtrs.data());
+        break;
+    }
+    benchmark::DoNotOptimize(residuals.data());
+    benchmark::ClobberMemory();
+  }
+  state.counters["residual_dim"] = double(error.residualDim());
+}
+
+// A pose parameter block at a random pose.
+std::shared_ptr<okvis::ceres::ParameterBlock> randomPose(uint64_t id) {
+  okvis::kinematics::Transformation T;
+  T.setRandom(1.0, 0.1);
+  return std::shared_ptr<okvis::ceres::ParameterBlock>(
+      new okvis::ceres::PoseParameterBlock(T, id, okvis::Time(0)));
+}
+
+// A speed and bias parameter block with small random entries.
+std::shared_ptr<okvis::ceres::ParameterBlock> randomSpeedAndBias(uint64_t id) {
+  okvis::SpeedAndBias speedAndBias = 0.01 * okvis::SpeedAndBias::Random();
+  return std::shared_ptr<okvis::ceres::ParameterBlock>(
+      new okvis::ceres::SpeedAndBiasParameterBlock(speedAndBias, id, okvis::Time(0)));
+}
+
+// Marginalization prior as it occurs in a sliding window with numKeyframes keyframes.
+// Returns false if there is none.
+bool simulatedMarginalizationError(size_t numKeyframes, ErrorTermSetup &setup) {
+  const size_t numImuFrames = 3;
+  const size_t numFrames = 2 * (numKeyframes + numImuFrames) + 4;
+  const okvis::ImuParameters imuParameters = okvis::BenchmarkDataGenerator::getImuParameters();
+  okvis::SimulationParameters simulationParameters;
+  simulationParameters.numLandmarks = 500;
+  simulationParameters.duration = double(numFrames + 3) / simulationParameters.cameraRate;
+  okvis::SensorSimulator simulator(okvis::BenchmarkDataGenerator::getCameraSystem(2),
+                                   imuParameters, simulationParameters);
+
+  // sliding window with online extrinsics calibration to get the full prior structure
+  std::shared_ptr<okvis::ceres::Map> mapPtr(new okvis::ceres::Map);
+  okvis::Estimator estimator(mapPtr);
+  for (size_t i = 0; i < 2; ++i) {
+    estimator.addCamera(okvis::ExtrinsicsEstimationParameters(1.0e-3, 1.0e-3, 1.0e-5, 1.0e-5));
+  }
+  estimator.addImu(imuParameters);
+  okvis::MapPointVector removedLandmarks;
+  for (size_t k = 0; k < numFrames; ++k) {
+    simulator.addToEstimator(estimator, k, k % 2 == 0);
+    estimator.optimize(5, 1, false);
+    estimator.applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks);
+  }
+
+  for (const auto &residual : mapPtr->residualBlockId2ResidualBlockSpecMap()) {
+    if (residual.second.errorInterfacePtr->typeInfo() == "MarginalizationError") {
+      setup.errorInterfacePtr = residual.second.errorInterfacePtr;
+      const okvis::ceres::Map::ParameterBlockCollection parameters =
+          mapPtr->parameters(residual.first);
+      for (size_t i = 0; i < parameters.size(); ++i) {
+        setup.parameterBlockPtrs.push_back(parameters[i].second);
+      }
+    }
+  }
+  return bool(setup.errorInterfacePtr);
+}
+
+}  // namespace
+
+
+// Reprojection error for a given camera geometry.
+template<class GEOMETRY_T>
+static void BM_ReprojectionError(benchmark::State &state) {
+  std::shared_ptr<const GEOMETRY_T> cameraGeometry =
+      std::static_pointer_cast<const GEOMETRY_T>(GEOMETRY_T::createTestObject());
+  ErrorTermSetup setup;
+  okvis::kinematics::Transformation T_WS, T_SC;
+  T_WS.setRandom(10.0, M_PI);
+  T_SC.setRandom(0.2, M_PI);
+  const Eigen::Vector4d point_C = cameraGeometry->createRandomVisibleHomogeneousPoint(5.0);
+  setup.parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+      new okvis::ceres::PoseParameterBlock(T_WS, 1, okvis::Time(0))));
+  setup.parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+      new okvis::ceres::HomogeneousPointParameterBlock(T_WS * T_SC * point_C, 2)));
+  setup.parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+      new okvis::ceres::PoseParameterBlock(T_SC, 3, okvis::Time(0))));
+  Eigen::Vector2d keypoint;
+  cameraGeometry->projectHomogeneous(point_C, &keypoint);
+  keypoint += Eigen::Vector2d::Random();
+  setup.errorInterfacePtr.reset(new okvis::ceres::ReprojectionError<GEOMETRY_T>(
+      cameraGeometry, 0, keypoint, Eigen::Matrix2d::Identity()));
+  evaluateErrorTerm(state, setup);
+}
+
+// IMU error between two consecutive frames at 20 Hz with 200 Hz IMU readings.
+// If state.range(1) is set, the gyro bias is toggled in every iteration, which
+// forces the re-integration of the IMU readings.
+static void BM_ImuError(benchmark::State &state) {
+  const okvis::ImuParameters imuParameters = okvis::BenchmarkDataGenerator::getImuParameters();
+  okvis::SimulationParameters simulationParameters;
+  simulationParameters.duration = 1.0;
+  simulationParameters.numLandmarks = 0;
+  okvis::SensorSimulator simulator(okvis::BenchmarkDataGenerator::getCameraSystem(1),
+                                   imuParameters, simulationParameters);
+  okvis::kinematics::Transformation T_WS_0, T_WS_1;
+  okvis::SpeedAndBias speedAndBias_0, speedAndBias_1;
+  simulator.groundTruth(simulator.frameTimestamp(0), T_WS_0, speedAndBias_0);
+  simulator.groundTruth(simulator.frameTimestamp(1), T_WS_1, speedAndBias_1);
+
+  ErrorTermSetup setup;
+  setup.parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+      new okvis::ceres::PoseParameterBlock(T_WS_0, 1, okvis::Time(0))));
+  std::shared_ptr<okvis::ceres::SpeedAndBiasParameterBlock> speedAndBiasParameterBlock(
+      new okvis::ceres::SpeedAndBiasParameterBlock(speedAndBias_0, 2, okvis::Time(0)));
+  setup.parameterBlockPtrs.push_back(speedAndBiasParameterBlock);
+  setup.parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+      new okvis::ceres::PoseParameterBlock(T_WS_1, 3, okvis::Time(0))));
+  setup.parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+      new okvis::ceres::SpeedAndBiasParameterBlock(speedAndBias_1, 4, okvis::Time(0))));
+  setup.errorInterfacePtr.reset(new okvis::ceres::ImuError(
+      simulator.imuMeasurements(), imuParameters, simulator.frameTimestamp(0),
+      simulator.frameTimestamp(1)));
+
+  if (state.range(1) == 0) {
+    evaluateErrorTerm(state, setup);
+    return;
+  }
+
+  // re-integration: alternate between two gyro biases (not timed)
+  const okvis::ceres::ImuError &imuError =
+      static_cast<const okvis::ceres::ImuError &>(*setup.errorInterfacePtr);
+  std::vector<double *> parameters;
+  for (size_t i = 0; i < setup.parameterBlockPtrs.size(); ++i) {
+    parameters.push_back(setup.parameterBlockPtrs[i]->parameters());
+  }
+  Eigen::Matrix<double, 15, 1> residuals;
+  okvis::SpeedAndBias speedAndBias = speedAndBias_0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    speedAndBias[3] = speedAndBias[3] > speedAndBias_0[3] ? speedAndBias_0[3] : speedAndBias_0[3] + 0.05;
+    speedAndBiasParameterBlock->setEstimate(speedAndBias);
+    state.ResumeTiming();
+    imuError.Evaluate(parameters.data(), residuals.data(), NULL);
+    benchmark::DoNotOptimize(residuals.data());
+  }
+}
+
+// Pose prior.
+static void BM_PoseError(benchmark::State &state) {
+  ErrorTermSetup setup;
+  okvis::kinematics::Transformation T;
+  T.setRandom(1.0, 0.1);
+  setup.parameterBlockPtrs.push_back(randomPose(1));
+  setup.errorInterfacePtr.reset(new okvis::ceres::PoseError(T, 1.0e-4, 1.0e-4));
+  evaluateErrorTerm(state, setup);
+}
+
+// Speed and bias prior.
+static void BM_SpeedAndBiasError(benchmark::State &state) {
+  ErrorTermSetup setup;
+  setup.parameterBlockPtrs.push_back(randomSpeedAndBias(1));
+  setup.errorInterfacePtr.reset(new okvis::ceres::SpeedAndBiasError(
+      okvis::SpeedAndBias::Zero(), 1.0, 1.0e-3, 1.0e-2));
+  evaluateErrorTerm(state, setup);
+}
+
+// Relative pose error as used between extrinsics of consecutive states.
+static void BM_RelativePoseError(benchmark::State &state) {
+  ErrorTermSetup setup;
+  setup.parameterBlockPtrs.push_back(randomPose(1));
+  setup.parameterBlockPtrs.push_back(randomPose(2));
+  setup.errorInterfacePtr.reset(new okvis::ceres::RelativePoseError(1.0e-4, 1.0e-4));
+  evaluateErrorTerm(state, setup);
+}
+
+// Homogeneous point prior.
+static void BM_HomogeneousPointError(benchmark::State &state) {
+  ErrorTermSetup setup;
+  const Eigen::Vector4d point(1.0, 2.0, 3.0, 1.0);
+  setup.parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+      new okvis::ceres::HomogeneousPointParameterBlock(
+          point + Eigen::Vector4d(0.05, -0.02, 0.1, 0.0), 1)));
+  setup.errorInterfacePtr.reset(new okvis::ceres::HomogeneousPointError(point, 0.01));
+  evaluateErrorTerm(state, setup);
+}
+
+// Marginalization prior with state.range(1) keyframes, factorised by LDLT (state.range(2) == 0)
+// or by the eigendecomposition (state.range(2) == 1).
+static void BM_MarginalizationError(benchmark::State &state) {
+  ErrorTermSetup setup;
+  if (!simulatedMarginalizationError(size_t(state.range(1)), setup)) {
+    state.SkipWithError("no marginalization error in the window");
+    return;
+  }
+  okvis::ceres::MarginalizationError &marginalizationError =
+      static_cast<okvis::ceres::MarginalizationError &>(*setup.errorInterfacePtr);
+  marginalizationError.setFactorization(
+      state.range(2) == 0 ? okvis::ceres::MarginalizationError::Factorization::Cholesky :
+          okvis::ceres::MarginalizationError::Factorization::Eigendecomposition);
+  marginalizationError.updateErrorComputation();
+  evaluateErrorTerm(state, setup);
+  state.counters["cholesky"] = double(
+      marginalizationError.lastFactorization()
+      == okvis::ceres::MarginalizationError::Factorization::Cholesky);
+}
+
+// Factorisation of the marginalization prior as done after every marginalization, with
+// state.range(0) keyframes, by LDLT (state.range(1) == 0) or the eigendecomposition.
+static void BM_MarginalizationFactorization(benchmark::State &state) {
+  ErrorTermSetup setup;
+  if (!simulatedMarginalizationError(size_t(state.range(0)), setup)) {
+    state.SkipWithError("no marginalization error in the window");
+    return;
+  }
+  okvis::ceres::MarginalizationError &marginalizationError =
+      static_cast<okvis::ceres::MarginalizationError &>(*setup.errorInterfacePtr);
+  const okvis::ceres::MarginalizationError::Factorization factorization =
+      state.range(1) == 0 ? okvis::ceres::MarginalizationError::Factorization::Cholesky :
+          okvis::ceres::MarginalizationError::Factorization::Eigendecomposition;
+  for (auto _ : state) {
+    marginalizationError.setFactorization(factorization);  // invalidates
+    marginalizationError.updateErrorComputation();
+    benchmark::ClobberMemory();
+  }
+  state.counters["residual_dim"] = double(marginalizationError.residualDim());
+  state.counters["cholesky"] = double(
+      marginalizationError.lastFactorization()
+      == okvis::ceres::MarginalizationError::Factorization::Cholesky);
+}
+
+// Evaluation modes, see the file description.
+static void ModeArguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgName("mode")->Arg(0)->Arg(1)->Arg(2);
+}
+
+BENCHMARK_TEMPLATE(BM_ReprojectionError,
+                   okvis::cameras::PinholeCamera<okvis::cameras::RadialTangentialDistortion>)
+    ->Apply(ModeArguments);
+BENCHMARK_TEMPLATE(BM_ReprojectionError,
+                   okvis::cameras::PinholeCamera<okvis::cameras::RadialTangentialDistortion8>)
+    ->Apply(ModeArguments);
+BENCHMARK_TEMPLATE(BM_ReprojectionError,
+                   okvis::cameras::PinholeCamera<okvis::cameras::EquidistantDistortion>)
+    ->Apply(ModeArguments);
+BENCHMARK(BM_ImuError)
+    ->ArgNames({"mode", "reintegrate"})
+    ->Args({0, 0})->Args({1, 0})->Args({2, 0})->Args({0, 1});
+BENCHMARK(BM_PoseError)->Apply(ModeArguments);
+BENCHMARK(BM_SpeedAndBiasError)->Apply(ModeArguments);
+BENCHMARK(BM_RelativePoseError)->Apply(ModeArguments);
+BENCHMARK(BM_HomogeneousPointError)->Apply(ModeArguments);
+BENCHMARK(BM_MarginalizationError)
+    ->ArgNames({"mode", "numKeyframes", "eigen"})
+    ->Args({0, 5, 0})->Args({1, 5, 0})->Args({2, 5, 0})
+    ->Args({0, 10, 0})->Args({1, 10, 0})->Args({2, 10, 0})
+    ->Args({0, 5, 1})->Args({1, 5, 1})->Args({2, 5, 1})
+    ->Args({0, 10, 1})->Args({1, 10, 1})->Args({2, 10, 1});
+BENCHMARK(BM_MarginalizationFactorization)
+    ->ArgNames({"numKeyframes", "eigen"})
+    ->Args({5, 0})->Args({5, 1})->Args({10, 0})->Args({10, 1});
@@ -0,0 +1,820 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file BenchmarkEstimator.cpp
+ * @brief Scalability benchmarks of Estimator::optimize() and
+ *        Estimator::applyMarginalizationStrategy() on simulated data.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <set>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+#include <okvis/Estimator.hpp>
+#include <okvis/SensorSimulator.hpp>
+#include <okvis/StructurelessEstimator.hpp>
+#include "benchmarkDataGenerators.hpp"
+
+namespace {
+
+const int kMeasuredFrames = 30;  ///< Frames added per benchmark run after warm-up.
+const int kMaxIterations = 10;  ///< Optimizer iterations per frame (as in the default config).
+const double kCameraRate = 20.0;  ///< [Hz]
+
+// Resident set size of this process in bytes.
+double residentSetSize() {
+  std::ifstream statm("/proc/self/statm");
+  long pages = 0, residentPages = 0;
+  statm >> pages >> residentPages;
+  return double(residentPages) * double(sysconf(_SC_PAGESIZE));
+}
+
+// Fraction of the pairs of non-landmark parameter blocks (incl. each block with itself)
+// that are coupled by at least one residual, i.e. the fill of the reduced camera system.
+double stateFillRatio(const okvis::ceres::Map &map) {
+  std::set<uint64_t> states;
+  std::set<std::pair<uint64_t, uint64_t> > coupled;
+  for (const auto &residual : map.residualBlockId2ResidualBlockSpecMap()) {
+    const okvis::ceres::Map::ParameterBlockCollection parameters =
+        map.parameters(residual.first);
+    for (size_t i = 0; i < parameters.size(); ++i) {
+      if (std::dynamic_pointer_cast<okvis::ceres::HomogeneousPointParameterBlock>(
+          parameters[i].second)) {
+        continue;
+      }
+      states.insert(parameters[i].first);
+      for (size_t j = 0; j <= i; ++j) {
+        if (std::dynamic_pointer_cast<okvis::ceres::HomogeneousPointParameterBlock>(
+            parameters[j].second)) {
+          continue;
+        }
+        coupled.insert(std::make_pair(std::min(parameters[i].first, parameters[j].first),
+                                      std::max(parameters[i].first, parameters[j].first)));
+      }
+    }
+  }
+  const double numPairs = 0.5 * double(states.size()) * double(states.size() + 1);
+  return numPairs > 0.0 ? double(coupled.size()) / numPairs : 0.0;
+}
+
+// Associate every stride-th keypoint of the newest frame with a wrong landmark, as a
+// frontend mismatch would. Returns the number of wrong associations.
+size_t addWrongAssociations(okvis::Estimator &estimator, size_t stride) {
+  typedef okvis::cameras::PinholeCamera<okvis::cameras::EquidistantDistortion> CameraGeometry;
+  okvis::MultiFramePtr multiFrame = estimator.multiFrame(estimator.currentFrameId());
+  size_t numWrong = 0;
+  for (size_t i = 0; i < multiFrame->numFrames(); ++i) {
+    const size_t numKeypoints = multiFrame->numKeypoints(i);
+    for (size_t j = 0; j < numKeypoints; j += stride) {
+      const uint64_t landmarkId = multiFrame->landmarkId(i, j);
+      const uint64_t wrongLandmarkId = multiFrame->landmarkId(i, (j + numKeypoints / 2)
+                                                              % numKeypoints);
+      if (landmarkId == wrongLandmarkId
+          || !estimator.removeObservation(landmarkId, multiFrame->id(), i, j)) {
+        continue;
+      }
+      multiFrame->setLandmarkId(i, j, wrongLandmarkId);
+      estimator.addObservation<CameraGeometry>(wrongLandmarkId, multiFrame->id(), i, j);
+      ++numWrong;
+    }
+  }
+  return numWrong;
+}
+
+// A simulated scene seen by numCameras cameras and an Estimator to feed it to, as used by
+// the benchmarks below. The scene lasts for the warm-up and the measured frames.
+// If structureless, the estimator is a StructurelessEstimator.
+struct SimulatedEstimator {
+  SimulatedEstimator(size_t numCameras, size_t numLandmarks, size_t numWarmUpFrames,
+                     const okvis::SimulationParameters &simulationParameters =
+                         okvis::SimulationParameters(),
+                     const okvis::ExtrinsicsEstimationParameters &extrinsicsEstimationParameters =
+                         okvis::ExtrinsicsEstimationParameters(),
+                     bool structureless = false)
+      : imuParameters(okvis::BenchmarkDataGenerator::getImuParameters()),
+        simulator(okvis::BenchmarkDataGenerator::getCameraSystem(numCameras), imuParameters,
+                  sceneParameters(simulationParameters, numLandmarks, numWarmUpFrames)),
+        mapPtr(new okvis::ceres::Map),
+        estimatorPtr(structureless ? new okvis::StructurelessEstimator(mapPtr)
+                                   : new okvis::Estimator(mapPtr)),
+        estimator(*estimatorPtr),
+        warmUpFrames(numWarmUpFrames),
+        frame(0) {
+    for (size_t i = 0; i < numCameras; ++i) {
+      estimator.addCamera(extrinsicsEstimationParameters);
+    }
+    estimator.addImu(imuParameters);
+  }
+
+  // The scene parameters with the number of landmarks and the duration of the run.
+  static okvis::SimulationParameters sceneParameters(
+      okvis::SimulationParameters simulationParameters, size_t numLandmarks,
+      size_t numWarmUpFrames) {
+    simulationParameters.numLandmarks = numLandmarks;
+    simulationParameters.cameraRate = kCameraRate;
+    simulationParameters.duration = double(numWarmUpFrames + kMeasuredFrames + 3) / kCameraRate;
+    return simulationParameters;
+  }
+
+  // Add the next frame, every keyframeInterval-th one as a keyframe.
+  // Returns the number of observations added.
+  size_t addFrame(size_t keyframeInterval = 2) {
+    const size_t numObservations = simulator.addToEstimator(estimator, frame,
+                                                            frame % keyframeInterval == 0);
+    ++frame;
+    return numObservations;
+  }
+
+  // Add, optimize and marginalize the warm-up frames, such that the window is full and
+  // marginalization happens in every step afterwards. If set, optimizeFrame() is called
+  // instead of optimize().
+  void warmUp(size_t numKeyframes, size_t numImuFrames, size_t keyframeInterval = 2,
+              const std::function<void()> &optimizeFrame = std::function<void()>()) {
+    okvis::MapPointVector removedLandmarks;
+    while (frame < warmUpFrames) {
+      addFrame(keyframeInterval);
+      if (optimizeFrame) {
+        optimizeFrame();
+      }
+      else {
+        estimator.optimize(kMaxIterations, 1, false);
+      }
+      estimator.applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks);
+    }
+  }
+
+  // Distance of the newest state from the ground truth. [m]
+  double positionError() {
+    okvis::kinematics::Transformation T_WS, T_WS_true;
+    okvis::SpeedAndBias speedAndBias;
+    estimator.get_T_WS(estimator.currentFrameId(), T_WS);
+    simulator.groundTruth(simulator.frameTimestamp(frame - 1), T_WS_true, speedAndBias);
+    return (T_WS.r() - T_WS_true.r()).norm();
+  }
+
+  const okvis::ImuParameters imuParameters;  ///< IMU of the simulated rig.
+  okvis::SensorSimulator simulator;  ///< The simulated scene and trajectory.
+  std::shared_ptr<okvis::ceres::Map> mapPtr;  ///< The estimator's map.
+  std::unique_ptr<okvis::Estimator> estimatorPtr;  ///< Owns the estimator.
+  okvis::Estimator &estimator;  ///< The estimator under test.
+  const size_t warmUpFrames;  ///< Frames added by warmUp().
+  size_t frame;  ///< Index of the next frame to add.
+};
+
+}  // namespace
+
+// Arguments: numKeyframes, numImuFrames, numCameras, numLandmarks.
+static void BM_EstimatorWindow(benchmark::State &state) {
+  const size_t numKeyframes = size_t(state.range(0));
+  const size_t numImuFrames = size_t(state.range(1));
+  const size_t numCameras = size_t(state.range(2));
+  const size_t warmUpFrames = 2 * (numKeyframes + numImuFrames) + 2;
+
+  SimulatedEstimator window(numCameras, size_t(state.range(3)), warmUpFrames);
+  okvis::Estimator &estimator = window.estimator;
+
+  // fill the window until marginalization happens in every step
+  window.warmUp(numKeyframes, numImuFrames);
+
+  const double rssBefore = residentSetSize();
+  double optimizeTime = 0.0;
+  double marginalizeTime = 0.0;
+  size_t numObservations = 0;
+  okvis::MapPointVector removedLandmarks;
+  for (auto _ : state) {
+    state.PauseTiming();
+    numObservations += window.addFrame();
+    state.ResumeTiming();
+
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+    estimator.optimize(kMaxIterations, 1, false);
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+    estimator.applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks);
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    optimizeTime += std::chrono::duration<double>(t1 - t0).count();
+    marginalizeTime += std::chrono::duration<double>(t2 - t1).count();
+  }
+
+  // problem size at the end of the run
+  size_t numResiduals = 0;
+  size_t priorDimension = 0;
+  for (const auto &residual : window.mapPtr->residualBlockId2ResidualBlockSpecMap()) {
+    const size_t dimension = residual.second.errorInterfacePtr->residualDim();
+    numResiduals += dimension;
+    if (residual.second.errorInterfacePtr->typeInfo() == "MarginalizationError") {
+      priorDimension = dimension;
+    }
+  }
+
+  state.counters["optimize_ms"] = benchmark::Counter(
+      1.0e3 * optimizeTime, benchmark::Counter::kAvgIterations);
+  state.counters["marginalize_ms"] = benchmark::Counter(
+      1.0e3 * marginalizeTime, benchmark::Counter::kAvgIterations);
+  state.counters["observations"] = benchmark::Counter(
+      double(numObservations), benchmark::Counter::kAvgIterations);
+  state.counters["frames"] = double(estimator.numFrames());
+  state.counters["landmarks"] = double(estimator.numLandmarks());
+  state.counters["parameter_blocks"] = double(window.mapPtr->id2parameterBlockMap().size());
+  state.counters["residuals"] = double(numResiduals);
+  state.counters["prior_dim"] = double(priorDimension);
+  state.counters["rss_MB"] = residentSetSize() / (1024.0 * 1024.0);
+  state.counters["rss_growth_MB"] = (residentSetSize() - rssBefore) / (1024.0 * 1024.0);
+}
+
+// Sweep window size, number of cameras and number of landmarks around the default configuration.
+static void EstimatorWindowArguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"numKeyframes", "numImuFrames", "numCameras", "numLandmarks"});
+  for (int numKeyframes : {3, 5, 7, 10}) {
+    for (int numImuFrames : {2, 3, 5}) {
+      benchmark->Args({numKeyframes, numImuFrames, 2, 1000});
+    }
+  }
+  for (int numCameras : {1, 3, 4}) {
+    benchmark->Args({5, 3, numCameras, 1000});
+  }
+  for (int numLandmarks : {250, 500, 2000, 4000}) {
+    benchmark->Args({5, 3, 2, numLandmarks});
+  }
+}
+
+BENCHMARK(BM_EstimatorWindow)
+    ->Apply(EstimatorWindowArguments)
+    ->Iterations(kMeasuredFrames)
+    ->Unit(benchmark::kMillisecond);
+
+// Runs the window with a marginalization policy and reports the fill of the reduced camera
+// system, the optimization and marginalization times and the accuracy.
+static void runMarginalizationPolicy(benchmark::State &state, size_t numKeyframes,
+                                     bool sparsify, size_t minObservations,
+                                     double minQuality) {
+  const size_t numImuFrames = 3;
+  const size_t numCameras = 2;
+  const size_t warmUpFrames = 2 * (numKeyframes + numImuFrames) + 2;
+
+  SimulatedEstimator window(numCameras, 1000, warmUpFrames);
+  okvis::Estimator &estimator = window.estimator;
+  estimator.setPriorSparsification(sparsify, 1.0);
+  estimator.setLandmarkMarginalizationPolicy(minObservations, minQuality);
+
+  window.warmUp(numKeyframes, numImuFrames);
+
+  double optimizeTime = 0.0;
+  double marginalizeTime = 0.0;
+  double fillRatio = 0.0;
+  double priorTerms = 0.0;
+  double positionError = 0.0;
+  okvis::MapPointVector removedLandmarks;
+  for (auto _ : state) {
+    state.PauseTiming();
+    window.addFrame();
+    fillRatio += stateFillRatio(*window.mapPtr);
+    priorTerms += double(estimator.numPriorErrorTerms());
+    state.ResumeTiming();
+
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+    estimator.optimize(kMaxIterations, 1, false);
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    state.PauseTiming();
+    positionError += window.positionError();
+    state.ResumeTiming();
+
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+    estimator.applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks);
+    std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+
+    optimizeTime += std::chrono::duration<double>(t1 - t0).count();
+    marginalizeTime += std::chrono::duration<double>(t3 - t2).count();
+  }
+
+  state.counters["optimize_ms"] = benchmark::Counter(
+      1.0e3 * optimizeTime, benchmark::Counter::kAvgIterations);
+  state.counters["marginalize_ms"] = benchmark::Counter(
+      1.0e3 * marginalizeTime, benchmark::Counter::kAvgIterations);
+  state.counters["fill_ratio"] = benchmark::Counter(
+      fillRatio, benchmark::Counter::kAvgIterations);
+  state.counters["prior_terms"] = benchmark::Counter(
+      priorTerms, benchmark::Counter::kAvgIterations);
+  state.counters["position_error_m"] = benchmark::Counter(
+      positionError, benchmark::Counter::kAvgIterations);
+  state.counters["landmarks"] = double(estimator.numLandmarks());
+}
+
+// Arguments: numKeyframes, sparsify (0/1).
+// Compares the dense with the sparsified marginalization prior.
+static void BM_PriorSparsification(benchmark::State &state) {
+  runMarginalizationPolicy(state, size_t(state.range(0)), state.range(1) != 0, 2, 0.0);
+}
+
+// Dense and sparsified prior for growing windows.
+static void PriorSparsificationArguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"numKeyframes", "sparsify"});
+  for (int numKeyframes : {5, 10, 20}) {
+    benchmark->Args({numKeyframes, 0});
+    benchmark->Args({numKeyframes, 1});
+  }
+}
+
+BENCHMARK(BM_PriorSparsification)
+    ->Apply(PriorSparsificationArguments)
+    ->Iterations(kMeasuredFrames)
+    ->Unit(benchmark::kMillisecond);
+
+// Arguments: minObservations, minQuality [1e-4].
+// Accuracy vs. latency of dropping weakly informative landmarks instead of marginalizing them.
+static void BM_ObservationDropping(benchmark::State &state) {
+  runMarginalizationPolicy(state, 5, false, size_t(state.range(0)), 1.0e-4 * state.range(1));
+}
+
+// Observation count and landmark quality thresholds, from marginalizing (almost) all landmarks
+// to dropping (almost) all of them.
+static void ObservationDroppingArguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"minObservations", "minQuality_1e4"});
+  for (int minObservations : {2, 3, 5, 1000}) {
+    benchmark->Args({minObservations, 0});
+  }
+  for (int minQuality : {10, 100, 1000}) {
+    benchmark->Args({2, minQuality});
+  }
+}
+
+BENCHMARK(BM_ObservationDropping)
+    ->Apply(ObservationDroppingArguments)
+    ->Iterations(kMeasuredFrames)
+    ->Unit(benchmark::kMillisecond);
+
+// Arguments: freeze (0/1).
+// Online calibration of the extrinsics, with and without freezing them once converged.
+static void BM_ExtrinsicsFreeze(benchmark::State &state) {
+  const size_t numKeyframes = 5;
+  const size_t numImuFrames = 3;
+  const size_t numCameras = 2;
+  const size_t warmUpFrames = 60;
+
+  SimulatedEstimator window(numCameras, 1000, warmUpFrames, okvis::SimulationParameters(),
+                            okvis::ExtrinsicsEstimationParameters(1.0e-3, 1.0e-3, 1.0e-5, 1.0e-5));
+  okvis::Estimator &estimator = window.estimator;
+  estimator.setExtrinsicsAutoFreeze(state.range(0) != 0, 1.0e-4, 1.0e-4, 20);
+
+  // convergence phase
+  window.warmUp(numKeyframes, numImuFrames);
+
+  double optimizeTime = 0.0;
+  double marginalizeTime = 0.0;
+  okvis::MapPointVector removedLandmarks;
+  for (auto _ : state) {
+    state.PauseTiming();
+    window.addFrame();
+    state.ResumeTiming();
+
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+    estimator.optimize(kMaxIterations, 1, false);
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+    estimator.applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks);
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    optimizeTime += std::chrono::duration<double>(t1 - t0).count();
+    marginalizeTime += std::chrono::duration<double>(t2 - t1).count();
+  }
+
+  size_t numFrozen = 0;
+  for (size_t i = 0; i < numCameras; ++i) {
+    numFrozen += estimator.extrinsicsFrozen(i) ? 1 : 0;
+  }
+  state.counters["optimize_ms"] = benchmark::Counter(
+      1.0e3 * optimizeTime, benchmark::Counter::kAvgIterations);
+  state.counters["marginalize_ms"] = benchmark::Counter(
+      1.0e3 * marginalizeTime, benchmark::Counter::kAvgIterations);
+  state.counters["frozen_cameras"] = double(numFrozen);
+  state.counters["parameter_blocks"] = double(window.mapPtr->id2parameterBlockMap().size());
+}
+
+BENCHMARK(BM_ExtrinsicsFreeze)
+    ->ArgName("freeze")
+    ->Arg(0)
+    ->Arg(1)
+    ->Iterations(kMeasuredFrames)
+    ->Unit(benchmark::kMillisecond);
+
+// Arguments: anchored (0/1), maxLandmarkDistance [m].
+// Solver iterations and time per optimize() of world-frame homogeneous vs. anchored
+// inverse depth landmarks, for near and far scenes.
+static void BM_LandmarkParameterization(benchmark::State &state) {
+  const size_t numKeyframes = 5;
+  const size_t numImuFrames = 3;
+  const size_t numCameras = 2;
+  const size_t warmUpFrames = 2 * (numKeyframes + numImuFrames) + 2;
+
+  okvis::SimulationParameters simulationParameters;
+  simulationParameters.maxLandmarkDistance = double(state.range(1));
+  simulationParameters.minLandmarkDistance = 0.5 * simulationParameters.maxLandmarkDistance;
+  SimulatedEstimator window(numCameras, 1000, warmUpFrames, simulationParameters);
+  okvis::Estimator &estimator = window.estimator;
+  estimator.setAnchoredLandmarks(state.range(0) != 0);
+
+  window.warmUp(numKeyframes, numImuFrames);
+
+  double optimizeTime = 0.0;
+  double iterations = 0.0;
+  double converged = 0.0;
+  double positionError = 0.0;
+  okvis::MapPointVector removedLandmarks;
+  for (auto _ : state) {
+    state.PauseTiming();
+    window.addFrame();
+    state.ResumeTiming();
+
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+    estimator.optimize(kMaxIterations, 1, false);
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    state.PauseTiming();
+    iterations += double(window.mapPtr->summary.num_successful_steps
+        + window.mapPtr->summary.num_unsuccessful_steps);
+    converged += window.mapPtr->summary.termination_type == ::ceres::CONVERGENCE ? 1.0 : 0.0;
+    positionError += window.positionError();
+    state.ResumeTiming();
+
+    estimator.applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks);
+    optimizeTime += std::chrono::duration<double>(t1 - t0).count();
+  }
+
+  state.counters["optimize_ms"] = benchmark::Counter(
+      1.0e3 * optimizeTime, benchmark::Counter::kAvgIterations);
+  state.counters["iterations"] = benchmark::Counter(
+      iterations, benchmark::Counter::kAvgIterations);
+  state.counters["converged"] = benchmark::Counter(
+      converged, benchmark::Counter::kAvgIterations);
+  state.counters["position_error_m"] = benchmark::Counter(
+      positionError, benchmark::Counter::kAvgIterations);
+  state.counters["landmarks"] = double(estimator.numLandmarks());
+}
+
+// Both parameterisations for the default scene and for far landmarks.
+static void LandmarkParameterizationArguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"anchored", "maxLandmarkDistance"});
+  for (int maxLandmarkDistance : {10, 100}) {
+    benchmark->Args({0, maxLandmarkDistance});
+    benchmark->Args({1, maxLandmarkDistance});
+  }
+}
+
+BENCHMARK(BM_LandmarkParameterization)
+    ->Apply(LandmarkParameterizationArguments)
+    ->Iterations(kMeasuredFrames)
+    ->Unit(benchmark::kMillisecond);
+
+// Iterations to convergence with and without warm starting the trust region.
+// Argument: warmStart (0/1).
+static void BM_TrustRegionWarmStart(benchmark::State &state) {
+  const size_t numKeyframes = 5;
+  const size_t numImuFrames = 3;
+  const size_t numCameras = 2;
+  const size_t warmUpFrames = 2 * (numKeyframes + numImuFrames) + 2;
+
+  SimulatedEstimator window(numCameras, 1000, warmUpFrames);
+  okvis::Estimator &estimator = window.estimator;
+  estimator.setTrustRegionWarmStart(state.range(0) != 0);
+
+  window.warmUp(numKeyframes, numImuFrames);
+
+  double optimizeTime = 0.0;
+  double iterations = 0.0;
+  double unsuccessfulSteps = 0.0;
+  double converged = 0.0;
+  okvis::MapPointVector removedLandmarks;
+  for (auto _ : state) {
+    state.PauseTiming();
+    window.addFrame();
+    state.ResumeTiming();
+
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+    estimator.optimize(kMaxIterations, 1, false);
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    state.PauseTiming();
+    iterations += double(window.mapPtr->summary.num_successful_steps
+        + window.mapPtr->summary.num_unsuccessful_steps);
+    unsuccessfulSteps += double(window.mapPtr->summary.num_unsuccessful_steps);
+    converged += window.mapPtr->summary.termination_type == ::ceres::CONVERGENCE ? 1.0 : 0.0;
+    state.ResumeTiming();
+
+    estimator.applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks);
+    optimizeTime += std::chrono::duration<double>(t1 - t0).count();
+  }
+
+  state.counters["optimize_ms"] = benchmark::Counter(
+      1.0e3 * optimizeTime, benchmark::Counter::kAvgIterations);
+  state.counters["iterations"] = benchmark::Counter(
+      iterations, benchmark::Counter::kAvgIterations);
+  state.counters["unsuccessful_steps"] = benchmark::Counter(
+      unsuccessfulSteps, benchmark::Counter::kAvgIterations);
+  state.counters["converged"] = benchmark::Counter(
+      converged, benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_TrustRegionWarmStart)
+    ->ArgName("warmStart")
+    ->Arg(0)
+    ->Arg(1)
+    ->Iterations(kMeasuredFrames)
+    ->Unit(benchmark::kMillisecond);
+
+// Optimization time and accuracy with the local optimization of non-keyframes, as in
+// ThreadedKFVio with localOptimization. Every third frame is a keyframe.
+// Argument: local (0/1).
+static void BM_LocalOptimization(benchmark::State &state) {
+  const size_t numKeyframes = 5;
+  const size_t numImuFrames = 3;
+  const size_t numCameras = 2;
+  const size_t warmUpFrames = 3 * (numKeyframes + numImuFrames) + 2;
+  const bool local = state.range(0) != 0;
+
+  SimulatedEstimator window(numCameras, 1000, warmUpFrames);
+  okvis::Estimator &estimator = window.estimator;
+
+  window.warmUp(numKeyframes, numImuFrames, 3);
+
+  double optimizeTime = 0.0;
+  double positionError = 0.0;
+  okvis::MapPointVector removedLandmarks;
+  for (auto _ : state) {
+    state.PauseTiming();
+    const bool asKeyframe = window.frame % 3 == 0;
+    window.addFrame(3);
+    state.ResumeTiming();
+
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+    if (local && !asKeyframe) {
+      estimator.optimizeLocal(numImuFrames, kMaxIterations, 1, false);
+    }
+    else {
+      estimator.optimize(kMaxIterations, 1, false);
+    }
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+
+    state.PauseTiming();
+    positionError += window.positionError();
+    state.ResumeTiming();
+
+    estimator.applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks);
+    optimizeTime += std::chrono::duration<double>(t1 - t0).count();
+  }
+
+  state.counters["optimize_ms"] = benchmark::Counter(
+      1.0e3 * optimizeTime, benchmark::Counter::kAvgIterations);
+  state.counters["position_error_m"] = benchmark::Counter(
+      positionError, benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_LocalOptimization)
+    ->ArgName("local")
+    ->Arg(0)
+    ->Arg(1)
+    ->Iterations(kMeasuredFrames)
+    ->Unit(benchmark::kMillisecond);
+
+// Optimization CPU time and accuracy of the Estimator against the StructurelessEstimator,
+// which projects the landmarks out of their reprojection errors instead of estimating them.
+// Arguments: structureless (0/1), numLandmarks.
+static void BM_StructurelessBackend(benchmark::State &state) {
+  const size_t numKeyframes = 5;
+  const size_t numImuFrames = 3;
+  const size_t numCameras = 2;
+  const size_t warmUpFrames = 2 * (numKeyframes + numImuFrames) + 2;
+
+  SimulatedEstimator window(numCameras, size_t(state.range(1)), warmUpFrames,
+                            okvis::SimulationParameters(),
+                            okvis::ExtrinsicsEstimationParameters(), state.range(0) != 0);
+  okvis::Estimator &estimator = window.estimator;
+
+  window.warmUp(numKeyframes, numImuFrames);
+
+  double optimizeCpuTime = 0.0;
+  double marginalizeCpuTime = 0.0;
+  double positionError = 0.0;
+  okvis::MapPointVector removedLandmarks;
+  for (auto _ : state) {
+    state.PauseTiming();
+    window.addFrame();
+    state.ResumeTiming();
+
+    const std::clock_t t0 = std::clock();
+    estimator.optimize(kMaxIterations, 1, false);
+    const std::clock_t t1 = std::clock();
+
+    state.PauseTiming();
+    positionError += window.positionError();
+    state.ResumeTiming();
+
+    const std::clock_t t2 = std::clock();
+    estimator.applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks);
+    const std::clock_t t3 = std::clock();
+
+    optimizeCpuTime += double(t1 - t0) / CLOCKS_PER_SEC;
+    marginalizeCpuTime += double(t3 - t2) / CLOCKS_PER_SEC;
+  }
+
+  state.counters["optimize_cpu_ms"] = benchmark::Counter(
+      1.0e3 * optimizeCpuTime, benchmark::Counter::kAvgIterations);
+  state.counters["marginalize_cpu_ms"] = benchmark::Counter(
+      1.0e3 * marginalizeCpuTime, benchmark::Counter::kAvgIterations);
+  state.counters["position_error_m"] = benchmark::Counter(
+      positionError, benchmark::Counter::kAvgIterations);
+  state.counters["landmarks"] = double(estimator.numLandmarks());
+  state.counters["parameter_blocks"] = double(window.mapPtr->id2parameterBlockMap().size());
+}
+
+static void StructurelessBackendArguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"structureless", "numLandmarks"});
+  for (int numLandmarks : {500, 1000, 2000}) {
+    benchmark->Args({0, numLandmarks});
+    benchmark->Args({1, numLandmarks});
+  }
+}
+
+BENCHMARK(BM_StructurelessBackend)
+    ->Apply(StructurelessBackendArguments)
+    ->Iterations(kMeasuredFrames)
+    ->Unit(benchmark::kMillisecond);
+
+// Optimization time and accuracy with 5% wrong associations, with and without removing
+// persistent outliers after each optimization. Argument: cull (0/1).
+static void BM_OutlierCulling(benchmark::State &state) {
+  const size_t numKeyframes = 5;
+  const size_t numImuFrames = 3;
+  const size_t numCameras = 2;
+  const size_t warmUpFrames = 2 * (numKeyframes + numImuFrames) + 2;
+  const size_t wrongAssociationStride = 20;
+  const bool cull = state.range(0) != 0;
+
+  SimulatedEstimator window(numCameras, 1000, warmUpFrames);
+  okvis::Estimator &estimator = window.estimator;
+
+  window.warmUp(numKeyframes, numImuFrames, 2, [&]() {
+    addWrongAssociations(estimator, wrongAssociationStride);
+    estimator.optimize(kMaxIterations, 1, false);
+    if (cull) {
+      okvis::MapPointVector culled;
+      estimator.cullOutliers(culled, 2);
+    }
+  });
+
+  double optimizeTime = 0.0;
+  double cullTime = 0.0;
+  double wrongAssociations = 0.0;
+  double culledObservations = 0.0;
+  double culledLandmarks = 0.0;
+  double positionError = 0.0;
+  okvis::MapPointVector removedLandmarks;
+  for (auto _ : state) {
+    state.PauseTiming();
+    window.addFrame();
+    wrongAssociations += double(addWrongAssociations(estimator, wrongAssociationStride));
+    state.ResumeTiming();
+
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+    estimator.optimize(kMaxIterations, 1, false);
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+    if (cull) {
+      okvis::MapPointVector culled;
+      culledObservations += double(estimator.cullOutliers(culled, 2));
+      culledLandmarks += double(culled.size());
+    }
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    state.PauseTiming();
+    positionError += window.positionError();
+    state.ResumeTiming();
+
+    estimator.applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks);
+    optimizeTime += std::chrono::duration<double>(t1 - t0).count();
+    cullTime += std::chrono::duration<double>(t2 - t1).count();
+  }
+
+  state.counters["optimize_ms"] = benchmark::Counter(
+      1.0e3 * optimizeTime, benchmark::Counter::kAvgIterations);
+  state.counters["cull_ms"] = benchmark::Counter(
+      1.0e3 * cullTime, benchmark::Counter::kAvgIterations);
+  state.counters["wrong_associations"] = benchmark::Counter(
+      wrongAssociations, benchmark::Counter::kAvgIterations);
+  state.counters["culled_observations"] = benchmark::Counter(
+      culledObservations, benchmark::Counter::kAvgIterations);
+  state.counters["culled_landmarks"] = benchmark::Counter(
+      culledLandmarks, benchmark::Counter::kAvgIterations);
+  state.counters["position_error_m"] = benchmark::Counter(
+      positionError, benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_OutlierCulling)
+    ->ArgName("cull")
+    ->Arg(0)
+    ->Arg(1)
+    ->Iterations(kMeasuredFrames)
+    ->Unit(benchmark::kMillisecond);
+
+// Optimization time with many features and 4 cameras, without and with a cap on the number
+// of landmarks. Argument: maxLandmarks (0: no limit).
+static void BM_LandmarkCap(benchmark::State &state) {
+  const size_t numKeyframes = 5;
+  const size_t numImuFrames = 3;
+  const size_t numCameras = 4;
+  const size_t warmUpFrames = 2 * (numKeyframes + numImuFrames) + 2;
+
+  SimulatedEstimator window(numCameras, 8000, warmUpFrames);
+  okvis::Estimator &estimator = window.estimator;
+  estimator.setMaxLandmarks(size_t(state.range(0)));
+
+  window.warmUp(numKeyframes, numImuFrames, 2, [&]() {
+    okvis::MapPointVector prunedLandmarks;
+    estimator.pruneLandmarks(prunedLandmarks);
+    estimator.optimize(kMaxIterations, 1, false);
+  });
+
+  double pruneTime = 0.0;
+  double optimizeTime = 0.0;
+  double maxOptimizeTime = 0.0;
+  double marginalizationTime = 0.0;
+  double landmarks = 0.0;
+  double positionError = 0.0;
+  okvis::MapPointVector removedLandmarks;
+  for (auto _ : state) {
+    state.PauseTiming();
+    window.addFrame();
+    state.ResumeTiming();
+
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+    estimator.pruneLandmarks(removedLandmarks);
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+    estimator.optimize(kMaxIterations, 1, false);
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+    state.PauseTiming();
+    landmarks += double(estimator.numLandmarks());
+    positionError += window.positionError();
+    state.ResumeTiming();
+
+    estimator.applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks);
+    std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+    pruneTime += std::chrono::duration<double>(t1 - t0).count();
+    optimizeTime += std::chrono::duration<double>(t2 - t1).count();
+    maxOptimizeTime = std::max(maxOptimizeTime, std::chrono::duration<double>(t2 - t1).count());
+    marginalizationTime += std::chrono::duration<double>(t3 - t2).count();
+  }
+
+  state.counters["prune_ms"] = benchmark::Counter(
+      1.0e3 * pruneTime, benchmark::Counter::kAvgIterations);
+  state.counters["optimize_ms"] = benchmark::Counter(
+      1.0e3 * optimizeTime, benchmark::Counter::kAvgIterations);
+  state.counters["optimize_max_ms"] = 1.0e3 * maxOptimizeTime;
+  state.counters["marginalization_ms"] = benchmark::Counter(
+      1.0e3 * marginalizationTime, benchmark::Counter::kAvgIterations);
+  state.counters["landmarks"] = benchmark::Counter(
+      landmarks, benchmark::Counter::kAvgIterations);
+  state.counters["position_error_m"] = benchmark::Counter(
+      positionError, benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_LandmarkCap)
+    ->ArgName("maxLandmarks")
+    ->Arg(0)
+    ->Arg(1000)
+    ->Arg(500)
+    ->Iterations(kMeasuredFrames)
+    ->Unit(benchmark::kMillisecond);
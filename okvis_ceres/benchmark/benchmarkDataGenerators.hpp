@@ -0,0 +1,51 @@
+#ifndef BENCHMARK_DATA_GENERATOR_HPP
+#define BENCHMARK_DATA_GENERATOR_HPP
+
+#include <okvis/Parameters.hpp>
+#include <okvis/cameras/NCameraSystem.hpp>
+#include <okvis/cameras/PinholeCamera.hpp>
+#include <okvis/cameras/EquidistantDistortion.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+class BenchmarkDataGenerator
+{
+public:
+  /// \brief A rig of num_cams cameras evenly rotated about the IMU x-axis.
+  static okvis::cameras::NCameraSystem getCameraSystem(size_t num_cams) {
+    okvis::cameras::NCameraSystem nCameraSystem;
+    for (size_t i = 0; i < num_cams; ++i) {
+      std::shared_ptr<const okvis::kinematics::Transformation> T_SC(
+          new okvis::kinematics::Transformation(
+              Eigen::Vector3d(0.0, 0.05 * double(i), 0.0),
+              Eigen::Quaterniond(Eigen::AngleAxisd(2.0 * M_PI * double(i) / double(num_cams),
+                                                   Eigen::Vector3d::UnitX()))));
+      nCameraSystem.addCamera(
+          T_SC,
+          okvis::cameras::PinholeCamera<okvis::cameras::EquidistantDistortion>::createTestObject(),
+          okvis::cameras::NCameraSystem::Equidistant, false);
+    }
+    return nCameraSystem;
+  }
+
+  /// \brief IMU parameters similar to the ones in the example configuration.
+  static okvis::ImuParameters getImuParameters() {
+    okvis::ImuParameters imuParameters;
+    imuParameters.a0.setZero();
+    imuParameters.g = 9.81;
+    imuParameters.a_max = 176.0;
+    imuParameters.g_max = 7.8;
+    imuParameters.rate = 200;
+    imuParameters.sigma_g_c = 12.0e-4;
+    imuParameters.sigma_a_c = 8.0e-3;
+    imuParameters.sigma_gw_c = 4.0e-6;
+    imuParameters.sigma_aw_c = 4.0e-5;
+    imuParameters.sigma_bg = 0.03;
+    imuParameters.sigma_ba = 0.1;
+    imuParameters.tau = 3600.0;
+    return imuParameters;
+  }
+};
+}
+
+#endif// BENCHMARK_DATA_GENERATOR_HPP
@@ -57,9 +57,11 @@
 #include <okvis/ceres/PoseParameterBlock.hpp>
 #include <okvis/ceres/SpeedAndBiasParameterBlock.hpp>
 #include <okvis/ceres/HomogeneousPointParameterBlock.hpp>
+#include <okvis/ceres/InverseDepthParameterBlock.hpp>
 #include <okvis/ceres/Map.hpp>
 #include <okvis/ceres/MarginalizationError.hpp>
 #include <okvis/ceres/ReprojectionError.hpp>
+#include <okvis/ceres/AnchoredReprojectionError.hpp>
 #include <okvis/ceres/CeresIterationCallback.hpp>
 
 /// \brief okvis Main namespace of this package.
@@ -144,6 +146,9 @@ public:
 
   /**
    * @brief Add a landmark.
+   *
+   * With setAnchoredLandmarks(true), the landmark is parameterised by inverse depth in the
+   * camera of its first observation (see ceres::InverseDepthParameterBlock).
    * @param landmarkId ID of the new landmark.
    * @param landmark Homogeneous coordinates of landmark in W-frame.
    * @return True if successful.
@@ -158,7 +163,8 @@ public:
    * @param poseId ID of pose where the landmark was observed.
    * @param camIdx ID of camera frame where the landmark was observed.
    * @param keypointIdx ID of keypoint corresponding to the landmark.
-   * @return Residual block ID for that observation.
+   * @return Residual block ID for that observation. NULL if the observation exists already
+   *         or the landmark has no parameter block.
    */
   template<class GEOMETRY_TYPE>
   ::ceres::ResidualBlockId addObservation(uint64_t landmarkId, uint64_t poseId,
@@ -180,10 +186,141 @@ public:
    * @param numKeyframes Number of keyframes.
    * @param numImuFrames Number of frames in IMU window.
    * @param removedLandmarks Get the landmarks that were removed by this operation.
+   * @param marginalizedStates Optionally get the final pose estimates of the frames whose
+   *                           poses were marginalized by this operation (oldest first).
    * @return True if successful.
    */
-  bool applyMarginalizationStrategy(size_t numKeyframes, size_t numImuFrames,
-                                    okvis::MapPointVector &removedLandmarks);
+  virtual bool applyMarginalizationStrategy(size_t numKeyframes, size_t numImuFrames,
+                                            okvis::MapPointVector &removedLandmarks,
+                                            okvis::FrameStateVector *marginalizedStates = NULL);
+
+  /**
+   * @brief Hold the camera extrinsics constant once their estimates have converged.
+   *
+   * After every optimize(), the change of the newest extrinsics estimate of each camera
+   * since the previous optimize() is monitored. Once it stayed below the thresholds for
+   * numStableOptimizations optimizations in a row, the newest extrinsics block is set
+   * constant and shared by all new frames, i.e. no new blocks and RelativePoseError terms
+   * are added, and the prior is conditioned on it. Disabling unfreezes all cameras.
+   * @param[in] enable Monitor and freeze, if true.
+   * @param[in] translationThreshold Maximum change of the translation. [m]
+   * @param[in] rotationThreshold Maximum change of the orientation. [rad]
+   * @param[in] numStableOptimizations Number of consecutive optimizations below the thresholds.
+   */
+  void setExtrinsicsAutoFreeze(bool enable, double translationThreshold,
+                               double rotationThreshold, size_t numStableOptimizations);
+
+  /// \brief Re-enable the estimation of the extrinsics of camera cameraIdx, if frozen.
+  void unfreezeExtrinsics(size_t cameraIdx);
+
+  /// \brief Whether the extrinsics of camera cameraIdx are currently held constant.
+  bool extrinsicsFrozen(size_t cameraIdx) const {
+    return cameraIdx < extrinsicsConvergence_.size()
+        && extrinsicsConvergence_[cameraIdx].frozen;
+  }
+
+  /**
+   * @brief Set which landmarks are marginalized and which are dropped when their last
+   *        observing frames leave the window.
+   *
+   * Landmarks still observed by newer frames are never marginalized, their observations in
+   * the leaving frames are dropped. The others are Schur-eliminated into the prior, which is
+   * the most expensive part of the marginalization and adds fill-in, unless they are weakly
+   * informative according to this policy, in which case all their observations are dropped.
+   * @param[in] minObservations Drop landmarks with fewer observations in the window.
+   *                            The default is 2.
+   * @param[in] minQuality Drop landmarks with a lower quality (see MapPoint::quality).
+   *                       The default 0.0 marginalizes all of them.
+   */
+  void setLandmarkMarginalizationPolicy(size_t minObservations, double minQuality) {
+    marginalizationMinObservations_ = minObservations;
+    marginalizationMinQuality_ = minQuality;
+  }
+
+  /**
+   * @brief Select the parameterisation of landmarks added from now on.
+   *
+   * Anchored landmarks are held as bearing and inverse depth in the camera frame of their
+   * first observation and observed through ceres::AnchoredReprojectionError, which keeps far
+   * points well conditioned. When the anchor frame is marginalized while the landmark stays,
+   * the landmark is re-anchored to its oldest remaining observation. Landmark coordinates
+   * passed to and returned by the Estimator are always in the world frame.
+   * @param[in] anchored Anchored inverse depth if true, world-frame homogeneous points
+   *                     otherwise (the default).
+   */
+  void setAnchoredLandmarks(bool anchored) {
+    anchoredLandmarks_ = anchored;
+  }
+
+  /**
+   * @brief Start each optimize() from the trust region radius the previous call ended with,
+   *        instead of the initial radius set in the map's solver options.
+   *
+   * Consecutive problems differ by about one state, so the previous radius predicts well how
+   * far the linearisation can be trusted, and fewer steps are rejected. For
+   * Levenberg-Marquardt, the radius is the inverse damping. After marginalization, the radius
+   * is moved halfway (geometrically) back to the configured one, since the cost has changed.
+   * The solver options themselves are left as they were after each optimize().
+   * @param[in] enable Warm start, if true.
+   */
+  void setTrustRegionWarmStart(bool enable) {
+    warmStartTrustRegion_ = enable;
+  }
+
+  /// \brief The trust region radius the last optimize() ended with (0 before the first).
+  double trustRegionRadius() const {
+    return trustRegionRadius_;
+  }
+
+  /**
+   * @brief Set when cullOutliers() removes observations and landmarks.
+   * @param[in] chi2Threshold Observations with a larger squared whitened reprojection error
+   *                          are outliers. The default 5.991 is the 95% quantile for 2 DOF.
+   * @param[in] numConsecutive Remove observations that were outliers in this many
+   *                           consecutive calls. The default is 3.
+   * @param[in] minObservations Remove landmarks left with fewer observations. The default is 2.
+   */
+  void setOutlierCulling(double chi2Threshold, size_t numConsecutive, size_t minObservations) {
+    outlierChi2Threshold_ = chi2Threshold;
+    outlierConsecutiveOptimizations_ = numConsecutive;
+    outlierMinObservations_ = minObservations;
+  }
+
+  /**
+   * @brief Limit the number of landmarks, see pruneLandmarks().
+   * @param[in] maxLandmarks The maximum number of landmarks. 0 (the default) sets no limit.
+   */
+  void setMaxLandmarks(size_t maxLandmarks) {
+    maxLandmarks_ = maxLandmarks;
+  }
+
+  /// \brief The maximum number of landmarks (0: no limit).
+  size_t maxLandmarks() const {
+    return maxLandmarks_;
+  }
+
+  /**
+   * @brief Enable sparsification of the marginalization prior after each marginalization.
+   *
+   * The dense prior is approximated by a chain of factors over pairs of consecutive frames
+   * (and the shared extrinsics), see ceres::MarginalizationError::sparsify(). This bounds
+   * the fill-in of the prior, which otherwise couples all frames it is connected to.
+   * @param[in] enable Sparsify, if true.
+   * @param[in] maxKullbackLeibler Keep the dense prior whenever the approximation would
+   *                               exceed this divergence. [nats]
+   */
+  void setPriorSparsification(bool enable, double maxKullbackLeibler) {
+    priorSparsification_ = enable;
+    priorSparsificationMaxKld_ = maxKullbackLeibler;
+  }
+
+  /// \brief Number of error terms representing the marginalization prior in the map.
+  size_t numPriorErrorTerms() const {
+    if (!sparsifiedPriorResidualIds_.empty()) {
+      return sparsifiedPriorResidualIds_.size();
+    }
+    return marginalizationResidualId_ ? 1 : 0;
+  }
 
   /**
    * @brief Initialise pose from IMU measurements. For convenience as static.
@@ -203,6 +340,52 @@ public:
    */
   void optimize(size_t numIter, size_t numThreads = 1, bool verbose = false);
 
+  /**
+   * @brief Start ceres optimization of the newest states only.
+   *
+   * The states of the numLocalFrames newest frames and the landmarks observed in them are
+   * optimized, everything else is held constant for this call (the map is not rebuilt).
+   * Meant for non-keyframes, where a full optimize() changes the old states only a little.
+   * @param[in] numLocalFrames Number of newest frames to optimize.
+   * @param[in] numIter Maximum number of iterations.
+   * @param[in] numThreads Number of threads.
+   * @param[in] verbose Print out optimization progress and result, if true.
+   */
+  virtual void optimizeLocal(size_t numLocalFrames, size_t numIter, size_t numThreads = 1,
+                             bool verbose = false);
+
+  /**
+   * @brief Remove persistent outliers. Call after every optimize().
+   *
+   * Under the Cauchy loss, bad observations stay in the problem until marginalization and
+   * are evaluated in every iteration. This evaluates all reprojection errors at the current
+   * estimate and removes the observations that exceeded the threshold in the last
+   * numConsecutive calls (see setOutlierCulling()), like the frontend removes RANSAC outliers:
+   * the landmark IDs of their keypoints are reset. Landmarks left with too few observations
+   * are removed. If the time runs out, the next call continues where this one stopped.
+   * @param[out] removedLandmarks Get the landmarks that were removed.
+   * @param[in]  numThreads Number of threads evaluating the error terms.
+   * @param[in]  timeLimit Time budget in seconds. If timeLimit < 0 there is no limit.
+   * @return The number of observations removed.
+   */
+  virtual size_t cullOutliers(okvis::MapPointVector &removedLandmarks, size_t numThreads = 1,
+                              double timeLimit = -1.0);
+
+  /**
+   * @brief Remove the least useful landmarks in excess of setMaxLandmarks(). Call before
+   *        optimize(), since the optimization and marginalization time grow with them.
+   *
+   * The utility of a landmark grows with its number of observations and its quality relative
+   * to the best landmark. It is divided by the number of landmarks last observed in the same
+   * cell of a coarse grid over the same image, i.e. landmarks in crowded image regions add
+   * less, and by one plus the number of frames since it was last observed. The landmarks
+   * with the lowest utility are selected with a bounded heap. Their keypoints' landmark IDs
+   * are reset.
+   * @param[out] removedLandmarks Get the landmarks that were removed.
+   * @return The number of landmarks removed.
+   */
+  size_t pruneLandmarks(okvis::MapPointVector &removedLandmarks);
+
   /**
    * @brief Set a time limit for the optimization process.
    * @param[in] timeLimit Time limit in seconds. If timeLimit < 0 the time limit is removed.
@@ -212,6 +395,38 @@ public:
    */
   bool setOptimizationTimeLimit(double timeLimit, int minIterations);
 
+  /**
+   * @brief Motion-only refinement of the pose and speed/bias of a state, e.g. the newest one
+   *        right after matching, as a cheap preview of optimize().
+   *
+   * Runs Gauss-Newton on the 15-dimensional system formed by the observations of the state
+   * (to initialised landmarks) and the error terms to the neighbouring states, holding
+   * everything else fixed. Iterations stop early once the cost increases.
+   * @param[in] poseId The pose ID, e.g. currentFrameId().
+   * @param[in] maxIterations Maximum number of Gauss-Newton iterations.
+   * @return True if the state was found and is not fixed.
+   */
+  bool refineState(uint64_t poseId, size_t maxIterations);
+
+  /**
+   * @brief Compute the marginal covariance of pose and speed/bias of a frame in the IMU window.
+   *
+   * Uses the linearisation at the current estimate (call after optimize()): landmarks are
+   * eliminated one at a time by the Schur complement, the remaining system over all frame
+   * and extrinsics states, including the marginalization prior, is factorised with LDLT
+   * and solved only for the 15 requested columns. Robustified residuals are weighted
+   * with the loss function derivative. The gauge is the one fixed by the estimator, i.e.
+   * the oldest pose's position and yaw.
+   * @param[in]  poseId The pose ID, e.g. currentFrameId().
+   * @param[out] covariance Covariance of [delta r_WS, delta alpha_WS, v_W, b_g, b_a]
+   *                        in the minimal coordinates of the pose and speed/bias blocks.
+   * @param[in]  timeLimit Time budget in seconds. If exceeded, the computation is aborted.
+   *                       If timeLimit < 0 there is no limit.
+   * @return True if successful.
+   */
+  bool computeCovariance(uint64_t poseId, Eigen::Matrix<double, 15, 15> &covariance,
+                         double timeLimit = -1.0) const;
+
   /**
    * @brief Checks whether the landmark is added to the estimator.
    * @param landmarkId The ID.
@@ -257,6 +472,18 @@ public:
    */
   size_t getLandmarks(okvis::MapPointVector &landmarks) const;
 
+  /**
+   * @brief Get the positions of several landmarks, locking only once and without
+   *        copying their observations.
+   * @param[in]  landmarkIds IDs of the desired landmarks.
+   * @param[out] points Homogeneous world positions in the order of landmarkIds. Set to
+   *                    zero for landmarks that do not exist.
+   * @return Number of landmarks found.
+   */
+  size_t getLandmarkPositions(
+      const std::vector<uint64_t> &landmarkIds,
+      std::vector<Eigen::Vector4d, Eigen::aligned_allocator<Eigen::Vector4d> > &points) const;
+
   /**
    * @brief Get a multiframe.
    * @param frameId ID of desired multiframe.
@@ -299,6 +526,20 @@ public:
   bool getCameraSensorStates(uint64_t poseId, size_t cameraIdx,
                              okvis::kinematics::Transformation &T_SCi) const;
 
+  /**
+   * @brief Get the current frame pose uncertainty. See computeCovariance().
+   * @param[out] P_T_WS Current pose uncertainty w.r.t. [r_WS,delta_alpha_WS].
+   * @return True on success.
+   */
+  bool getPoseUncertainty(Eigen::Matrix<double, 6, 6> &P_T_WS) const;
+
+  /**
+   * @brief Get the current frame state uncertainty. See computeCovariance().
+   * @param[out] P Current state uncertainty w.r.t. [r_WS,delta_alpha_WS,v_W,b_g,b_a].
+   * @return True on success.
+   */
+  bool getStateUncertainty(Eigen::Matrix<double, 15, 15> &P) const;
+
   /// @brief Get the number of states/frames in the estimator.
   /// \return The number of frames.
   size_t numFrames() const {
@@ -344,6 +585,24 @@ public:
    */
   bool isInImuWindow(uint64_t frameId) const;
 
+  /**
+   * @brief Get the number of landmarks observed in two frames (covisibility graph).
+   * @param[in] frameIdA ID of the first frame.
+   * @param[in] frameIdB ID of the second frame. Pass frameIdA to get the number of
+   *                     landmarks observed in frameIdA.
+   * @return The number of shared landmarks.
+   */
+  size_t numCovisibleLandmarks(uint64_t frameIdA, uint64_t frameIdB) const;
+
+  /**
+   * @brief Get the frames sharing landmarks with a frame (neighbours in the covisibility graph).
+   * @param[in]  frameId ID of the frame.
+   * @param[out] covisibleFrames Number of shared landmarks per frame ID, without frameId itself.
+   * @return The number of covisible frames.
+   */
+  size_t getCovisibleFrames(uint64_t frameId,
+                            std::map<uint64_t, size_t> &covisibleFrames) const;
+
   /// @name Getters
   /// @{
   /**
@@ -413,7 +672,21 @@ public:
   }
   ///@}
 
-private:
+protected:
+
+  /// \brief Monitor the convergence of the extrinsics after an optimization and freeze them.
+  void updateExtrinsicsConvergence();
+
+  /**
+   * @brief Get the frames applyMarginalizationStrategy() removes.
+   * @param[in]  numKeyframes Number of keyframes.
+   * @param[in]  numImuFrames Number of frames in IMU window.
+   * @param[out] removeFrames The frames whose poses are marginalized, newest first.
+   * @param[out] allLinearizedFrames All frames outside of the IMU window, newest first.
+   */
+  void getFramesToMarginalize(size_t numKeyframes, size_t numImuFrames,
+                              std::vector<uint64_t> &removeFrames,
+                              std::vector<uint64_t> &allLinearizedFrames) const;
 
   /**
    * @brief Remove an observation from a landmark.
@@ -422,6 +695,37 @@ private:
    */
   bool removeObservation(::ceres::ResidualBlockId residualBlockId);
 
+  /**
+   * @brief Get the parameter blocks of an observation of an anchored landmark,
+   *        anchoring the landmark to this observation if it is not anchored yet.
+   * @param[in]  landmarkId ID of the landmark (an InverseDepthParameterBlock).
+   * @param[in]  poseId ID of the observing frame.
+   * @param[in]  camIdx Index of the observing camera.
+   * @param[out] parameterBlocks The parameter blocks as ordered by AnchoredReprojectionError.
+   * @param[out] anchorPoseShared Is the anchor frame the observing frame?
+   * @param[out] anchorExtrinsicsShared Are the anchor extrinsics the observing ones?
+   */
+  void getAnchoredObservationParameterBlocks(
+      uint64_t landmarkId, uint64_t poseId, size_t camIdx,
+      std::vector<std::shared_ptr<ceres::ParameterBlock> > &parameterBlocks,
+      bool &anchorPoseShared, bool &anchorExtrinsicsShared);
+
+  /// \brief Remove a landmark with all its observations and reset the landmark IDs of
+  ///        the observed keypoints.
+  void removeLandmark(uint64_t landmarkId);
+
+  /// \brief The landmark estimate in the world frame, also for anchored landmarks.
+  Eigen::Vector4d landmarkEstimateInWorld(uint64_t landmarkId) const;
+
+  /**
+   * @brief Move the anchor of a landmark to its oldest observation outside of
+   *        excludedFrames, re-creating all of its observation error terms.
+   * @param[in] landmarkId ID of the landmark (an InverseDepthParameterBlock).
+   * @param[in] excludedFrames Frames that must not be the new anchor.
+   * @return False if the landmark has no observation in another frame.
+   */
+  bool reanchorLandmark(uint64_t landmarkId, const std::vector<uint64_t> &excludedFrames);
+
 
   /// \brief StateInfo This configures the state vector ordering
   struct StateInfo
@@ -537,6 +841,21 @@ private:
   bool setSensorStateEstimateAs(uint64_t poseId, int sensorIdx, int sensorType,
                                 int stateType, const typename PARAMETER_BLOCK_T::estimate_t &state);
 
+  /**
+   * @brief Update the covisibility graph for an observation of a landmark in a frame.
+   *        Call before adding the observation to the map point and after removing it.
+   * @param mapPoint The landmark.
+   * @param poseId The pose ID of the observing frame.
+   * @param added True if the observation is added, false if it was removed.
+   */
+  void updateCovisibilities(const MapPoint &mapPoint, uint64_t poseId, bool added);
+  /// \brief Decrement one entry of the covisibility graph.
+  void decrementCovisibility(uint64_t frameIdA, uint64_t frameIdB);
+  /// \brief Remove all observations of a landmark that is removed from the covisibility graph.
+  void removeCovisibilities(const MapPoint &mapPoint);
+  /// \brief Remove a frame that is removed from the covisibility graph.
+  void removeCovisibilities(uint64_t poseId);
+
   // the following are just fixed-size containers for related parameterBlockIds:
   typedef std::array<StateInfo, 6> GlobalStatesContainer; ///< Container for global states.
   typedef std::vector<StateInfo> SpecificSensorStatesContainer;  ///< Container for sensor states. The dimension can vary from sensor to sensor...
@@ -570,6 +889,7 @@ private:
 
   // the following are updated after the optimization
   okvis::PointMap landmarksMap_; ///< Contains all the current landmarks (synched after optimisation).
+  std::map<uint64_t, std::map<uint64_t, size_t> > covisibilities_; ///< Number of shared landmarks of pairs of frames (key=poseId). The diagonal holds the landmarks per frame.
   mutable std::mutex statesMutex_;  ///< Regulate access of landmarksMap_.
 
   // parameters
@@ -584,6 +904,37 @@ private:
   // the marginalized error term
   std::shared_ptr<ceres::MarginalizationError> marginalizationErrorPtr_; ///< The marginalisation class
   ::ceres::ResidualBlockId marginalizationResidualId_; ///< Remembers the marginalisation object's Id
+  std::vector<::ceres::ResidualBlockId> sparsifiedPriorResidualIds_; ///< The chain factors replacing the marginalisation object in the map, if sparsified.
+  /// \brief Convergence monitor of the extrinsics of one camera.
+  struct ExtrinsicsConvergence
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    okvis::kinematics::Transformation T_SC; ///< Newest estimate after the last optimization.
+    bool initialised = false; ///< Whether T_SC was set.
+    size_t numStable = 0; ///< Consecutive optimizations with a change below the thresholds.
+    bool frozen = false; ///< Whether the extrinsics are held constant.
+    uint64_t frozenId = 0; ///< The parameter block ID held constant.
+    bool conditioned = false; ///< Whether the prior was conditioned on the frozen block.
+  };
+  std::vector<ExtrinsicsConvergence, Eigen::aligned_allocator<ExtrinsicsConvergence> > extrinsicsConvergence_; ///< Per camera.
+  bool extrinsicsAutoFreeze_; ///< Freeze converged extrinsics.
+  double extrinsicsFreezeTranslation_; ///< Convergence threshold on the translation change. [m]
+  double extrinsicsFreezeRotation_; ///< Convergence threshold on the orientation change. [rad]
+  size_t extrinsicsFreezeCount_; ///< Consecutive optimizations below the thresholds to freeze.
+  size_t marginalizationMinObservations_; ///< Landmarks with fewer observations are dropped instead of marginalised.
+  double marginalizationMinQuality_; ///< Landmarks with a lower quality are dropped instead of marginalised.
+  bool priorSparsification_; ///< Sparsify the marginalisation prior.
+  double priorSparsificationMaxKld_; ///< Maximum divergence of the sparsified prior. [nats]
+  bool anchoredLandmarks_; ///< Add new landmarks as anchored inverse depth points.
+  bool warmStartTrustRegion_; ///< Start optimize() from the previous trust region radius.
+  double trustRegionRadius_; ///< Trust region radius the last optimize() ended with.
+  double outlierChi2Threshold_; ///< Squared whitened reprojection error above which an observation is an outlier.
+  size_t outlierConsecutiveOptimizations_; ///< Consecutive cullOutliers() calls as outlier to remove an observation.
+  size_t outlierMinObservations_; ///< Landmarks left with fewer observations by cullOutliers() are removed.
+  std::map<okvis::KeypointIdentifier, size_t> outlierCounts_; ///< Consecutive cullOutliers() calls in which an observation was an outlier.
+  size_t outlierCullingOffset_; ///< Where the evaluation of the observations in cullOutliers() continues.
+  size_t maxLandmarks_; ///< Maximum number of landmarks kept by pruneLandmarks(). 0: no limit.
+  ::ceres::LinearSolverType linearSolverType_; ///< The linear solver of optimize().
 
   // ceres iteration callback object
   std::unique_ptr<okvis::ceres::CeresIterationCallback> ceresCallback_; ///< Maybe there was a callback registered, store it here.
@@ -0,0 +1,226 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file okvis/SensorSimulator.hpp
+ * @brief Header file for the SensorSimulator class.
+ */
+
+#ifndef INCLUDE_OKVIS_SENSORSIMULATOR_HPP_
+#define INCLUDE_OKVIS_SENSORSIMULATOR_HPP_
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <okvis/assert_macros.hpp>
+#include <okvis/Measurements.hpp>
+#include <okvis/MultiFrame.hpp>
+#include <okvis/Parameters.hpp>
+#include <okvis/FrameTypedefs.hpp>
+#include <okvis/VioInterface.hpp>
+#include <okvis/cameras/NCameraSystem.hpp>
+#include <okvis/kinematics/Transformation.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+class Estimator;
+
+/// \brief Settings of the synthetic scene, trajectory and measurement noise.
+struct SimulationParameters
+{
+  double duration = 10.0; ///< Length of the simulated run. [s]
+  double cameraRate = 20.0; ///< Rate at which multiframes are generated. [Hz]
+  size_t numControlPoints = 10; ///< Number of control points of the closed trajectory spline.
+  double trajectoryRadius = 2.0; ///< Nominal radius of the (perturbed) horizontal loop. [m]
+  double trajectoryPerturbation = 0.3; ///< Random perturbation of the position control points. [m]
+  double maxRotation = 0.3; ///< Maximum rotation vector magnitude of the orientation control points. [rad]
+  size_t numLandmarks = 2000; ///< Number of landmarks.
+  double minLandmarkDistance = 5.0; ///< Landmarks are sampled in a spherical shell around the trajectory centre. [m]
+  double maxLandmarkDistance = 10.0; ///< Outer radius of the landmark shell. [m]
+  double keypointSigma = 0.5; ///< Standard deviation of the keypoint measurement noise. [pixels]
+  double keypointSize = 8.0; ///< Keypoint size assigned to every observation. [pixels]
+  int descriptorBitFlips = 10; ///< Number of random bit flips applied to the landmark descriptors per observation.
+  bool imuNoise = true; ///< Add white noise and bias random walk to the IMU readings.
+  unsigned int seed = 1; ///< Random seed. Identical seeds produce identical data.
+};
+
+/**
+ * @brief A synthetic visual-inertial sensor rig.
+ *
+ * The body moves along a closed, smooth trajectory (uniform cubic B-splines on position
+ * and on the rotation vector) through a cloud of random landmarks. IMU readings are sampled
+ * at ImuParameters::rate with white noise and bias random walk according to the
+ * ImuParameters. Frames are generated at SimulationParameters::cameraRate for all
+ * cameras of the NCameraSystem, either as keypoints with known landmark associations
+ * (to drive the Estimator directly) or as rendered images (to drive a VioInterface such
+ * as ThreadedKFVio). All data is generated in the constructor and deterministic in the seed.
+ */
+class SensorSimulator
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  OKVIS_DEFINE_EXCEPTION(Exception, std::runtime_error)
+
+  /// \brief Length of the synthetic BRISK-like descriptors in bytes.
+  static const int descriptorBytes = 48;
+
+  /**
+   * @brief Constructor. Generates landmarks, trajectory and IMU readings.
+   * @param nCameraSystem The camera rig.
+   * @param imuParameters IMU rate and noise characteristics.
+   * @param simulationParameters Scene, trajectory and noise settings.
+   */
+  SensorSimulator(const okvis::cameras::NCameraSystem &nCameraSystem,
+                  const okvis::ImuParameters &imuParameters,
+                  const okvis::SimulationParameters &simulationParameters);
+
+  /// @brief Trivial destructor.
+  virtual ~SensorSimulator() {
+  }
+
+  /// \brief Time of the first IMU reading and the first frame.
+  const okvis::Time &startTime() const {
+    return startTime_;
+  }
+
+  /// \brief Number of simulated multiframes.
+  size_t numFrames() const {
+    return frameTimestamps_.size();
+  }
+
+  /// \brief The timestamp of multiframe k.
+  const okvis::Time &frameTimestamp(size_t k) const {
+    return frameTimestamps_.at(k);
+  }
+
+  /// \brief All simulated IMU readings.
+  const okvis::ImuMeasurementDeque &imuMeasurements() const {
+    return imuMeasurements_;
+  }
+
+  /// \brief All landmarks (ground truth, homogeneous coordinates in the world frame).
+  const okvis::PointMap &landmarks() const {
+    return landmarks_;
+  }
+
+  /// \brief The camera rig.
+  const okvis::cameras::NCameraSystem &nCameraSystem() const {
+    return nCameraSystem_;
+  }
+
+  /**
+   * @brief Ground truth state.
+   * @param[in]  t Query time. Must be within the simulated time span.
+   * @param[out] T_WS Pose of the IMU in the world frame.
+   * @param[out] speedAndBias Speed in the world frame and the true gyro and accelerometer biases.
+   * @return False if t is outside of the simulated time span.
+   */
+  bool groundTruth(const okvis::Time &t, okvis::kinematics::Transformation &T_WS,
+                   okvis::SpeedAndBias &speedAndBias) const;
+
+  /**
+   * @brief Create multiframe k with noisy keypoints, descriptors and the true landmark IDs set.
+   * @param k Multiframe index.
+   * @param id Multiframe ID. Use 0 to draw a new one from the IdProvider.
+   * @return The multiframe.
+   */
+  okvis::MultiFramePtr simulateMultiFrame(size_t k, uint64_t id = 0) const;
+
+  /**
+   * @brief Render a grayscale image of camera cameraIdx at multiframe k.
+   *
+   * Every visible landmark is drawn as a small, landmark-specific checkerboard patch
+   * scaled with inverse depth, such that real detectors and descriptors find it.
+   * @param k Multiframe index.
+   * @param cameraIdx Camera index.
+   * @return The image (CV_8UC1).
+   */
+  cv::Mat renderImage(size_t k, size_t cameraIdx) const;
+
+  /**
+   * @brief Feed rendered images and IMU readings to a VioInterface, e.g. ThreadedKFVio,
+   *        in temporal order.
+   * @param vio The estimator interface to feed.
+   * @return The number of multiframes fed.
+   */
+  size_t feed(okvis::VioInterface &vio) const;
+
+  /**
+   * @brief Add multiframe k to an Estimator, bypassing the frontend.
+   *
+   * Calls addStates() with the simulated IMU readings, adds newly observed landmarks at
+   * their true position and adds all observations using the known associations.
+   * The first state is set to the ground truth, since initPoseFromImu() cannot observe yaw.
+   * @param estimator The estimator. Cameras and IMU must have been added already.
+   * @param k Multiframe index. Call with increasing k.
+   * @param asKeyframe Add the state as keyframe.
+   * @return The number of observations added.
+   */
+  size_t addToEstimator(okvis::Estimator &estimator, size_t k,
+                        bool asKeyframe) const;
+
+protected:
+  /// \brief Evaluate the closed uniform cubic B-spline on position with derivatives.
+  void evaluatePosition(double t, Eigen::Vector3d *r_W, Eigen::Vector3d *v_W,
+                        Eigen::Vector3d *a_W) const;
+  /// \brief Evaluate the closed uniform cubic B-spline on orientation.
+  Eigen::Quaterniond evaluateOrientation(double t) const;
+  /// \brief Angular rate in the sensor frame by central differences of the orientation.
+  Eigen::Vector3d evaluateAngularRate(double t) const;
+  /// \brief Interpolate the true biases at t (relative to the start time).
+  Eigen::Matrix<double, 6, 1> evaluateBiases(double t) const;
+  /// \brief Project all landmarks into camera cameraIdx at multiframe k.
+  ///        Keypoint noise is added if a generator is provided.
+  void project(size_t k, size_t cameraIdx, std::vector<cv::KeyPoint> &keypoints,
+               std::vector<uint64_t> &landmarkIds, std::vector<double> &depths,
+               std::mt19937 *generator) const;
+
+  okvis::cameras::NCameraSystem nCameraSystem_; ///< The camera rig.
+  okvis::ImuParameters imuParameters_; ///< IMU characteristics.
+  okvis::SimulationParameters parameters_; ///< Scene and noise settings.
+  okvis::Time startTime_; ///< Start of the simulated run.
+  double segmentDuration_; ///< Duration of one spline segment. [s]
+  std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>> positionControlPoints_; ///< Position spline.
+  std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>> rotationControlPoints_; ///< Rotation vector spline.
+  std::vector<Eigen::Matrix<double, 6, 1>, Eigen::aligned_allocator<Eigen::Matrix<double, 6, 1>>> biases_; ///< True [b_g, b_a] per IMU reading.
+  okvis::ImuMeasurementDeque imuMeasurements_; ///< Simulated IMU readings.
+  std::vector<okvis::Time> frameTimestamps_; ///< Multiframe timestamps.
+  okvis::PointMap landmarks_; ///< Ground truth landmarks.
+  std::map<uint64_t, cv::Mat> descriptors_; ///< Reference descriptor per landmark.
+  Eigen::Quaterniond q_WR_; ///< Yaw alignment of the raw spline frame R with the world frame.
+  Eigen::Vector3d r_WR_; ///< Translation of the raw spline frame R in the world frame.
+};
+
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_SENSORSIMULATOR_HPP_ */
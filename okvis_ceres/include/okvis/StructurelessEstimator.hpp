@@ -0,0 +1,209 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file StructurelessEstimator.hpp
+ * @brief Header file for the StructurelessEstimator class.
+ */
+
+#ifndef INCLUDE_OKVIS_STRUCTURELESSESTIMATOR_HPP_
+#define INCLUDE_OKVIS_STRUCTURELESSESTIMATOR_HPP_
+
+#include <map>
+#include <set>
+#include <memory>
+
+#include <okvis/Estimator.hpp>
+#include <okvis/ceres/StructurelessReprojectionError.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/**
+ * \brief A backend without landmark parameter blocks (MSCKF-style).
+ *
+ * States, IMU terms, the marginalization prior and all book-keeping are the Estimator's.
+ * Landmarks are kept as MapPoints only: every optimize() adds one
+ * StructurelessReprojectionError per initialised landmark track with at least two
+ * observations, which re-triangulates the landmark and projects it out of its
+ * reprojection errors. The problem then only holds the states, and is solved with a dense
+ * linear solver. Tracks that leave the window are absorbed into the prior together with
+ * the poses they were observed in, tracks that go on lose their oldest observations.
+ */
+class StructurelessEstimator : public Estimator
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /**
+   * @brief The default constructor.
+   */
+  StructurelessEstimator();
+
+  /**
+   * @brief Constructor if a ceres map is already available.
+   * @param mapPtr Shared pointer to ceres map.
+   */
+  StructurelessEstimator(std::shared_ptr<okvis::ceres::Map> mapPtr);
+  virtual ~StructurelessEstimator();
+
+  /**
+   * @brief Add a landmark. Only its estimate is remembered, it is no parameter.
+   * @param landmarkId ID of the new landmark.
+   * @param landmark Homogeneous coordinates of landmark in W-frame.
+   * @return True if successful.
+   */
+  virtual bool addLandmark(uint64_t landmarkId,
+                           const Eigen::Vector4d &landmark);
+
+  /**
+   * @brief Remove an observation from a landmark, if available. Drops the error term of
+   *        the track until the next optimize().
+   * @param landmarkId ID of landmark.
+   * @param poseId ID of pose where the landmark was observed.
+   * @param camIdx ID of camera frame where the landmark was observed.
+   * @param keypointIdx ID of keypoint corresponding to the landmark.
+   * @return True if observation was present and successfully removed.
+   */
+  virtual bool removeObservation(uint64_t landmarkId, uint64_t poseId, size_t camIdx,
+                                 size_t keypointIdx);
+
+  /**
+   * @brief Applies the marginalization strategy of the Estimator to the states.
+   *
+   * Of the landmarks observed in the frames that are removed, those also observed in the
+   * IMU window lose these observations. The error terms of the others are absorbed into the
+   * prior with the removed poses, unless they are weak as of
+   * setLandmarkMarginalizationPolicy() or have no error term yet, then they are dropped.
+   * @param numKeyframes Number of keyframes.
+   * @param numImuFrames Number of frames in IMU window.
+   * @param removedLandmarks Get the landmarks that were removed by this operation.
+   * @param marginalizedStates Optionally get the final pose estimates of the frames whose
+   *                           poses were marginalized by this operation (oldest first).
+   * @return True if successful.
+   */
+  virtual bool applyMarginalizationStrategy(size_t numKeyframes, size_t numImuFrames,
+                                            okvis::MapPointVector &removedLandmarks,
+                                            okvis::FrameStateVector *marginalizedStates = NULL);
+
+  /**
+   * @brief Start ceres optimization. Updates the error terms of the tracks first and
+   *        the landmarks from their triangulations afterwards.
+   * @param[in] numIter Maximum number of iterations.
+   * @param[in] numThreads Number of threads.
+   * @param[in] verbose Print out optimization progress and result, if true.
+   */
+  virtual void optimize(size_t numIter, size_t numThreads = 1, bool verbose = false);
+
+  /**
+   * @brief Without landmarks the problem is small: optimizes the full window.
+   * @param[in] numLocalFrames Ignored.
+   * @param[in] numIter Maximum number of iterations.
+   * @param[in] numThreads Number of threads.
+   * @param[in] verbose Print out optimization progress and result, if true.
+   */
+  virtual void optimizeLocal(size_t numLocalFrames, size_t numIter, size_t numThreads = 1,
+                             bool verbose = false);
+
+  /**
+   * @brief Remove outlier tracks. Call after every optimize().
+   *
+   * The projected error of a track cannot be attributed to single observations. Instead,
+   * whole tracks are removed whose squared error exceeds the threshold of
+   * setOutlierCulling() per two degrees of freedom.
+   * @param[out] removedLandmarks Get the landmarks that were removed.
+   * @param[in]  numThreads Ignored, the error terms are evaluated in this thread.
+   * @param[in]  timeLimit Time budget in seconds. If timeLimit < 0 there is no limit.
+   * @return The number of observations removed.
+   */
+  virtual size_t cullOutliers(okvis::MapPointVector &removedLandmarks, size_t numThreads = 1,
+                              double timeLimit = -1.0);
+
+  /**
+   * @brief Checks whether the landmark is added to the estimator.
+   * @param landmarkId The ID.
+   * @return True if added.
+   */
+  virtual bool isLandmarkAdded(uint64_t landmarkId) const {
+    return landmarksMap_.find(landmarkId) != landmarksMap_.end();
+  }
+
+  /**
+   * @brief Checks whether the landmark is initialized.
+   * @param landmarkId The ID.
+   * @return True if initialised.
+   */
+  virtual bool isLandmarkInitialized(uint64_t landmarkId) const;
+
+  /// @brief Set the homogeneous coordinates for a landmark.
+  /// @param[in] landmarkId The landmark ID.
+  /// @param[in] landmark Homogeneous coordinates of landmark in W-frame.
+  /// @return True if successful.
+  virtual bool setLandmark(uint64_t landmarkId, const Eigen::Vector4d &landmark);
+
+  /// @brief Set the landmark initialization state.
+  /// @param[in] landmarkId The landmark ID.
+  /// @param[in] initialized Whether or not initialised.
+  virtual void setLandmarkInitialized(uint64_t landmarkId, bool initialized);
+
+  /// \brief The number of tracks with an error term in the map.
+  size_t numTrackErrors() const {
+    return trackErrors_.size();
+  }
+
+private:
+
+  /// \brief An error term of a landmark track in the map.
+  struct TrackError
+  {
+    std::shared_ptr<ceres::StructurelessReprojectionError> errorPtr; ///< The error term.
+    std::shared_ptr<::ceres::LossFunction> lossFunctionPtr; ///< Its loss function.
+    ::ceres::ResidualBlockId residualBlockId; ///< Its ID in the map.
+  };
+
+  /// \brief Add the error term of a landmark track, replacing an outdated one.
+  /// \return False if the track is not initialised or observed less than twice.
+  bool addTrackError(const MapPoint &mapPoint);
+
+  /// \brief Remove the error term of a landmark track from the map, if any.
+  void removeTrackError(uint64_t landmarkId);
+
+  /// \brief Evaluate the error term of a track at the current estimates, which also
+  ///        re-triangulates the landmark.
+  void evaluateTrackError(const TrackError &trackError, Eigen::VectorXd &residuals) const;
+
+  std::map<uint64_t, TrackError> trackErrors_; ///< The error terms in the map (key=landmarkId).
+  std::set<uint64_t> initializedLandmarks_; ///< The landmarks set initialised.
+};
+
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_STRUCTURELESSESTIMATOR_HPP_ */
@@ -0,0 +1,125 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file InverseDepthParameterBlock.hpp
+ * @brief Header file for the InverseDepthParameterBlock class.
+ */
+
+#ifndef INCLUDE_OKVIS_CERES_INVERSEDEPTHPARAMETERBLOCK_HPP_
+#define INCLUDE_OKVIS_CERES_INVERSEDEPTHPARAMETERBLOCK_HPP_
+
+#include <okvis/ceres/HomogeneousPointParameterBlock.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+/// \brief ceres Namespace for ceres-related functionality implemented in okvis.
+namespace ceres {
+
+/**
+ * @brief Landmark anchored in the camera frame C_a of one of its observations.
+ *
+ * The estimate is the homogeneous point hp_Ca = [b_Ca; rho] with unit bearing b_Ca and
+ * inverse depth rho (along the bearing). The Euclidean-style perturbation of the first three
+ * coordinates (HomogeneousPointLocalParameterization) then changes the bearing and scales the
+ * depth, which stays well conditioned for far points (rho -> 0). Since it is a
+ * HomogeneousPointParameterBlock, marginalization treats it like any other landmark.
+ * It is used with AnchoredReprojectionError.
+ */
+class InverseDepthParameterBlock : public HomogeneousPointParameterBlock
+{
+public:
+
+  /// \brief Default constructor (assumes not fixed, not anchored).
+  InverseDepthParameterBlock();
+
+  /// \brief Constructor with estimate.
+  /// @param[in] point The homogeneous point estimate. In the world frame until anchored.
+  /// @param[in] id The (unique) ID of this block.
+  /// @param[in] initialized Whether or not the 3d position is considered initialised.
+  InverseDepthParameterBlock(const Eigen::Vector4d &point, uint64_t id,
+                             bool initialized = true);
+
+  /// \brief Trivial destructor.
+  virtual ~InverseDepthParameterBlock();
+
+  /// \brief Set the anchor.
+  /// @param[in] poseId ID of the pose parameter block of the anchor frame.
+  /// @param[in] cameraIdx Index of the anchor camera.
+  /// @param[in] extrinsicsId ID of the extrinsics parameter block of the anchor camera.
+  void setAnchor(uint64_t poseId, size_t cameraIdx, uint64_t extrinsicsId) {
+    anchorPoseId_ = poseId;
+    anchorCameraIdx_ = cameraIdx;
+    anchorExtrinsicsId_ = extrinsicsId;
+  }
+
+  /// \brief Has the anchor been set?
+  bool anchored() const {
+    return anchorPoseId_ != 0;
+  }
+
+  /// \brief ID of the pose parameter block of the anchor frame (0 if not anchored).
+  uint64_t anchorPoseId() const {
+    return anchorPoseId_;
+  }
+
+  /// \brief Index of the anchor camera.
+  size_t anchorCameraIdx() const {
+    return anchorCameraIdx_;
+  }
+
+  /// \brief ID of the extrinsics parameter block of the anchor camera.
+  uint64_t anchorExtrinsicsId() const {
+    return anchorExtrinsicsId_;
+  }
+
+  /// \brief Normalise a homogeneous point in the anchor camera frame to [b_Ca; rho],
+  ///        i.e. unit bearing and non-negative inverse depth.
+  /// @param[in] hp_Ca The homogeneous point.
+  /// \return The normalised point.
+  static Eigen::Vector4d normalize(const Eigen::Vector4d &hp_Ca);
+
+  /// @brief Return parameter block type as string
+  virtual std::string typeInfo() const {
+    return "InverseDepthParameterBlock";
+  }
+
+private:
+  uint64_t anchorPoseId_;  ///< ID of the pose of the anchor frame.
+  size_t anchorCameraIdx_;  ///< Index of the anchor camera.
+  uint64_t anchorExtrinsicsId_;  ///< ID of the extrinsics of the anchor camera.
+
+};
+
+}  // namespace ceres
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_CERES_INVERSEDEPTHPARAMETERBLOCK_HPP_ */
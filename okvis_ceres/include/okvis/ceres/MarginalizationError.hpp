@@ -75,6 +75,13 @@ public:
   /// \brief The base class type.
   typedef ::ceres::CostFunction base_t;
 
+  /// \brief Factorisation of the linearised system into the square root form J^T*J = H.
+  enum class Factorization
+  {
+    Cholesky,           ///< LDLT, falls back to the eigendecomposition if (close to) rank deficient.
+    Eigendecomposition  ///< Rank revealing eigendecomposition.
+  };
+
   /// \brief Trivial destructor.
   virtual ~MarginalizationError() {
   }
@@ -128,10 +135,50 @@ public:
                       const std::vector<bool> &keepParameterBlocks =
                       std::vector<bool>());
 
+  /// \brief Condition on a set of parameter blocks at their current estimates and remove them,
+  ///        e.g. once they are held constant for good. Unlike marginalizeOut(), the parameter
+  ///        blocks stay in the map.
+  /// \warning Call while this error term is not part of the map.
+  /// \return False if none of the parameter blocks are connected.
+  bool conditionOn(const std::vector<uint64_t> &parameterBlockIds);
+
   /// \brief This must be called before optimization after adding residual blocks and/or marginalizing,
   ///        since it performs all the lhs and rhs computations on from a given _H and _b.
   void updateErrorComputation();
 
+  /// \brief Select the factorisation used by updateErrorComputation(). Default: Cholesky.
+  /// \warning This invalidates the error computation.
+  /// @param[in] factorization The factorisation.
+  void setFactorization(Factorization factorization) {
+    factorization_ = factorization;
+    errorComputationValid_ = false;
+  }
+
+  /// \brief The factorisation actually used by the last updateErrorComputation().
+  Factorization lastFactorization() const {
+    return lastFactorization_;
+  }
+
+  /**
+   * @brief Sparsify the prior by nonlinear factor recovery on a chain of groups.
+   *
+   * The parameter blocks are partitioned into groups (e.g. the states of one frame) in chain
+   * order, and the blocks not in any group are shared by all cliques (e.g. extrinsics). The prior
+   * is replaced by the KL-divergence optimal approximation with the structure of a junction tree
+   * of the cliques {shared, group k, group k+1}: a product of conditionals that matches the
+   * marginals of every clique, with the mean unchanged. This error term is updated accordingly
+   * and stays the accumulator for future marginalizations.
+   * @param[in] groups Parameter block IDs per group in chain order. Unknown IDs are ignored.
+   * @param[in] maxKullbackLeibler Keep the dense prior if the divergence exceeds this. [nats]
+   * @param[out] factors One error term per clique. Use them instead of this in the optimization.
+   * @param[out] kullbackLeibler The divergence KL(dense||sparse), if of interest. [nats]
+   * @return False, if nothing was changed: fewer than three groups, a rank deficient
+   *         prior or a too large divergence.
+   */
+  bool sparsify(const std::vector<std::vector<uint64_t> > &groups, double maxKullbackLeibler,
+                std::vector<std::shared_ptr<MarginalizationError> > &factors,
+                double *kullbackLeibler = NULL);
+
   /// \brief Call this in order to (re-)add this error term after whenever it had been modified.
   /// @param[in] parameterBlockPtrs Parameter block pointers in question.
   void getParameterBlockPtrs(
@@ -297,16 +344,23 @@ protected:
   /// an identity information matrix, and an error
   /// _e = -pinv(J^T) * _b + J*Delta_Chi .
   /// _e = _e0 + J*Delta_Chi .
+  /// J is either obtained by LDLT (full rank) or by the eigendecomposition, in which case
+  /// only the rows of nonzero singular values are kept.
   /// @{
   Eigen::MatrixXd H_;  ///< lhs - Hessian
   Eigen::VectorXd b0_;  ///<  rhs constant part
   Eigen::VectorXd e0_;  ///<  _e0 := pinv(J^T) * _b0
   Eigen::MatrixXd J_;  ///<  Jacobian such that _J^T * J == _H
   Eigen::MatrixXd U_;  ///<  H_ = _U*_S*_U^T lhs Eigen decomposition
-  Eigen::VectorXd S_;  ///<  singular values
+  Eigen::VectorXd S_;  ///<  singular values (eigendecomposition only)
   Eigen::VectorXd S_sqrt_;  ///<  cwise sqrt of _S, i.e. _S_sqrt*_S_sqrt=_S; _J=_U^T*_S_sqrt
   Eigen::VectorXd S_pinv_;  ///<  pseudo inverse of _S
   Eigen::VectorXd S_pinv_sqrt_;  ///<  cwise sqrt of _S_pinv, i.e. pinv(J^T)=_U^T*_S_pinv_sqrt
+  /// Jacobians w.r.t. the non-minimal parameters per parameter block. They are constant,
+  /// since lifting happens at the linearisation point.
+  std::vector<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> > liftedJacobians_;
+  Factorization factorization_ = Factorization::Cholesky;  ///< Requested factorisation.
+  Factorization lastFactorization_ = Factorization::Cholesky;  ///< Factorisation actually used.
   Eigen::VectorXd p_;
   Eigen::VectorXd p_inv_;
   volatile bool errorComputationValid_;  ///<  adding residual blocks will invalidate this. before optimizing, call updateErrorComputation()
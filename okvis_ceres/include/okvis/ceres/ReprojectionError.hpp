@@ -67,7 +67,7 @@ public:
   typedef GEOMETRY_TYPE camera_geometry_t;
 
   /// \brief The base class type.
-  typedef ::ceres::SizedCostFunction<2, 7, 4, 7> base_t;
+  typedef ::ceres::CostFunction base_t;
 
   /// \brief Number of residuals (2)
   static const int kNumResiduals = 2;
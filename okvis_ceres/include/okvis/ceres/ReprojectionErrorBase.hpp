@@ -39,7 +39,9 @@
 #ifndef INCLUDE_OKVIS_CERES_REPROJECTIONERRORBASE_HPP_
 #define INCLUDE_OKVIS_CERES_REPROJECTIONERRORBASE_HPP_
 
+#include <memory>
 #include "ceres/ceres.h"
+#include <okvis/ceres/ErrorInterface.hpp>
 
 /// \brief okvis Main namespace of this package.
 namespace okvis {
@@ -47,13 +49,24 @@ namespace okvis {
 namespace ceres {
 
 /// \brief Reprojection error base class.
+///
+/// The first three parameter blocks are always the pose T_WS of the observing frame (7),
+/// the landmark (4) and the camera extrinsics T_SC (7). Derived classes may append
+/// further parameter blocks (e.g. the anchor frame of an anchored landmark).
 class ReprojectionErrorBase :
-    public ::ceres::SizedCostFunction<2 /* number of residuals */,
-        7 /* size of first parameter */, 4 /* size of second parameter */, 7 /* size of third parameter (camera extrinsics) */>,
+    public ::ceres::CostFunction,
     public ErrorInterface
 {
 public:
 
+  /// \brief Default constructor: 2 residuals, parameter blocks of size 7, 4 and 7.
+  ReprojectionErrorBase() {
+    set_num_residuals(2);
+    mutable_parameter_block_sizes()->push_back(7); // pose of the observing frame
+    mutable_parameter_block_sizes()->push_back(4); // landmark
+    mutable_parameter_block_sizes()->push_back(7); // camera extrinsics
+  }
+
   /// \brief Camera ID.
   uint64_t cameraId() const {
     return cameraId_;
@@ -103,6 +116,56 @@ public:
 
 };
 
+/// \brief 2D keypoint reprojection error base class for landmarks parameterised in an
+///        anchor camera frame (see InverseDepthParameterBlock).
+///
+/// Parameter blocks: T_WS of the observing frame, the landmark hp_Ca in the anchor camera
+/// frame, T_SC of the observing camera, then T_WS of the anchor frame (only if it is not the
+/// observing frame) and T_SC of the anchor camera (only if it is not the observing camera's
+/// extrinsics block). Ceres does not allow the same parameter block twice per residual.
+class AnchoredReprojectionError2dBase : public ReprojectionError2dBase
+{
+public:
+
+  /// \brief Constructor.
+  /// @param[in] anchorPoseShared Is the anchor frame the observing frame?
+  /// @param[in] anchorExtrinsicsShared Is the anchor camera extrinsics block the
+  ///                                   extrinsics block of the observing camera?
+  AnchoredReprojectionError2dBase(bool anchorPoseShared, bool anchorExtrinsicsShared)
+      : anchorPoseShared_(anchorPoseShared),
+        anchorExtrinsicsShared_(anchorExtrinsicsShared) {
+    if (!anchorPoseShared_) {
+      mutable_parameter_block_sizes()->push_back(7); // pose of the anchor frame
+    }
+    if (!anchorExtrinsicsShared_) {
+      mutable_parameter_block_sizes()->push_back(7); // extrinsics of the anchor camera
+    }
+  }
+
+  /// \brief Is the anchor frame the observing frame?
+  bool anchorPoseShared() const {
+    return anchorPoseShared_;
+  }
+
+  /// \brief Is the anchor extrinsics block the one of the observing camera?
+  bool anchorExtrinsicsShared() const {
+    return anchorExtrinsicsShared_;
+  }
+
+  /// \brief Create the same error term (measurement, information, camera) for a
+  ///        different anchor, i.e. with a different parameter block layout.
+  /// @param[in] anchorPoseShared Is the new anchor frame the observing frame?
+  /// @param[in] anchorExtrinsicsShared Is the new anchor extrinsics block the
+  ///                                   extrinsics block of the observing camera?
+  /// \return The new error term.
+  virtual std::shared_ptr<AnchoredReprojectionError2dBase> reanchored(
+      bool anchorPoseShared, bool anchorExtrinsicsShared) const = 0;
+
+protected:
+  bool anchorPoseShared_; ///< Is the anchor frame the observing frame?
+  bool anchorExtrinsicsShared_; ///< Is the anchor extrinsics block the observing one?
+};
+
 }
 
 }
@@ -0,0 +1,194 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file StructurelessReprojectionError.hpp
+ * @brief Header file for the StructurelessReprojectionError class.
+ */
+
+#ifndef INCLUDE_OKVIS_CERES_STRUCTURELESSREPROJECTIONERROR_HPP_
+#define INCLUDE_OKVIS_CERES_STRUCTURELESSREPROJECTIONERROR_HPP_
+
+#include <vector>
+#include <memory>
+#include "ceres/ceres.h"
+#include <okvis/assert_macros.hpp>
+#include <okvis/cameras/CameraBase.hpp>
+#include <okvis/ceres/ErrorInterface.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+/// \brief ceres Namespace for ceres-related functionality implemented in okvis.
+namespace ceres {
+
+/**
+ * \brief All reprojection errors of one landmark track, without the landmark as a parameter.
+ *
+ * The landmark is re-triangulated from the current poses at every evaluation (a few
+ * Gauss-Newton steps, warm-started from the previous result). The stacked whitened errors
+ * and their Jacobians are then projected onto the left nullspace of the Jacobian w.r.t. the
+ * landmark, which removes the landmark to first order (as in the MSCKF). For n observations
+ * the residual has 2n-3 dimensions.
+ *
+ * The parameter blocks are the poses T_WS and the extrinsics T_SC of the observations,
+ * each one only once.
+ */
+class StructurelessReprojectionError : public ::ceres::CostFunction, public ErrorInterface
+{
+public:
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+
+  OKVIS_DEFINE_EXCEPTION(Exception, std::runtime_error)
+
+
+  /// \brief The base class type.
+  typedef ::ceres::CostFunction base_t;
+
+  /// \brief One keypoint observation of the landmark.
+  struct Observation
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    std::shared_ptr<const cameras::CameraBase> cameraGeometry; ///< The camera model.
+    Eigen::Vector2d measurement; ///< The keypoint. [pixels]
+    double squareRootInformation; ///< Inverse of the keypoint standard deviation. [1/pixels]
+    size_t poseIdx; ///< Index of the parameter block of the pose T_WS.
+    size_t extrinsicsIdx; ///< Index of the parameter block of the extrinsics T_SC.
+  };
+
+  /// \brief The observation container type.
+  typedef std::vector<Observation, Eigen::aligned_allocator<Observation> > Observations;
+
+  /**
+   * @brief Construct with the observations and an initial landmark estimate.
+   * @param[in] observations The observations of the track, at least two.
+   * @param[in] numParameterBlocks Number of pose and extrinsics parameter blocks indexed
+   *                               by the observations.
+   * @param[in] hp_W Initial homogeneous landmark estimate in the world frame.
+   */
+  StructurelessReprojectionError(const Observations &observations,
+                                 size_t numParameterBlocks,
+                                 const Eigen::Vector4d &hp_W);
+
+  /// \brief Trivial destructor.
+  virtual ~StructurelessReprojectionError() {
+  }
+
+  /// \brief The number of observations.
+  size_t numObservations() const {
+    return observations_.size();
+  }
+
+  /// \brief The landmark as triangulated in the last evaluation (homogeneous, world frame).
+  const Eigen::Vector4d &point() const {
+    return hp_W_;
+  }
+
+  /// \brief sqrt(smallest/largest eigenvalue) of the landmark information in the last
+  ///        evaluation, as the landmark quality of the Estimator. 0 if not observable.
+  double quality() const {
+    return quality_;
+  }
+
+  // error term and Jacobian implementation
+  /**
+    * @brief This evaluates the error term and additionally computes the Jacobians.
+    * @param parameters Pointer to the parameters (see ceres)
+    * @param residuals Pointer to the residual vector (see ceres)
+    * @param jacobians Pointer to the Jacobians (see ceres)
+    * @return success of th evaluation.
+    */
+  virtual bool Evaluate(double const *const *parameters, double *residuals,
+                        double **jacobians) const;
+
+  /**
+   * @brief This evaluates the error term and additionally computes
+   *        the Jacobians in the minimal internal representation.
+   * @param parameters Pointer to the parameters (see ceres)
+   * @param residuals Pointer to the residual vector (see ceres)
+   * @param jacobians Pointer to the Jacobians (see ceres)
+   * @param jacobiansMinimal Pointer to the minimal Jacobians (equivalent to jacobians).
+   * @return Success of the evaluation.
+   */
+  bool EvaluateWithMinimalJacobians(double const *const *parameters,
+                                    double *residuals, double **jacobians,
+                                    double **jacobiansMinimal) const;
+
+  // sizes
+  /// \brief Residual dimension.
+  size_t residualDim() const {
+    return base_t::num_residuals();
+  }
+
+  /// \brief Number of parameter blocks.
+  size_t parameterBlocks() const {
+    return base_t::parameter_block_sizes().size();
+  }
+
+  /// \brief Dimension of an individual parameter block.
+  size_t parameterBlockDim(size_t parameterBlockId) const {
+    return base_t::parameter_block_sizes().at(parameterBlockId);
+  }
+
+  /// @brief Residual block type as string
+  virtual std::string typeInfo() const {
+    return "StructurelessReprojectionError";
+  }
+
+  /// \brief Gauss-Newton iterations of the re-triangulation per evaluation.
+  static const int kTriangulationIterations = 3;
+
+protected:
+
+  /**
+   * @brief Whitened errors and their Jacobians at the given landmark.
+   * @param[in]  parameters The pose and extrinsics parameters.
+   * @param[in]  hp_W The landmark (homogeneous, world frame).
+   * @param[out] errors The stacked whitened errors, 2 per observation.
+   * @param[out] J_point Jacobian of the errors w.r.t. the Euclidean part of hp_W.
+   * @param[out] J_states Minimal Jacobians w.r.t. all parameter blocks, 6 columns each.
+   *                      Not computed if NULL.
+   */
+  void linearize(double const *const *parameters, const Eigen::Vector4d &hp_W,
+                 Eigen::VectorXd &errors, Eigen::MatrixXd &J_point,
+                 Eigen::MatrixXd *J_states) const;
+
+  Observations observations_; ///< The observations of the track.
+  // ceres evaluates a residual block in one thread at a time
+  mutable Eigen::Vector4d hp_W_; ///< Landmark of the last evaluation, warm-starts the next.
+  mutable double quality_; ///< Landmark quality of the last evaluation.
+};
+
+}  // namespace ceres
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_CERES_STRUCTURELESSREPROJECTIONERROR_HPP_ */
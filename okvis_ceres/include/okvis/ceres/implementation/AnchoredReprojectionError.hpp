@@ -0,0 +1,284 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file implementation/AnchoredReprojectionError.hpp
+ * @brief Header implementation file for the AnchoredReprojectionError class.
+ */
+
+#include <okvis/kinematics/operators.hpp>
+#include <okvis/kinematics/Transformation.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+/// \brief ceres Namespace for ceres-related functionality implemented in okvis.
+namespace ceres {
+
+// Construct with measurement and information matrix.
+template<class GEOMETRY_T>
+AnchoredReprojectionError<GEOMETRY_T>::AnchoredReprojectionError(
+    std::shared_ptr<const camera_geometry_t> cameraGeometry, uint64_t cameraId,
+    const measurement_t &measurement, const covariance_t &information,
+    bool anchorPoseShared, bool anchorExtrinsicsShared)
+    : AnchoredReprojectionError2dBase(anchorPoseShared, anchorExtrinsicsShared) {
+  setCameraId(cameraId);
+  setMeasurement(measurement);
+  setInformation(information);
+  setCameraGeometry(cameraGeometry);
+}
+
+// Set the information.
+template<class GEOMETRY_T>
+void AnchoredReprojectionError<GEOMETRY_T>::setInformation(
+    const covariance_t &information) {
+  information_ = information;
+  covariance_ = information.inverse();
+  // perform the Cholesky decomposition on order to obtain the correct error weighting
+  Eigen::LLT<Eigen::Matrix2d> lltOfInformation(information_);
+  squareRootInformation_ = lltOfInformation.matrixL().transpose();
+}
+
+// This evaluates the error term and additionally computes the Jacobians.
+template<class GEOMETRY_T>
+bool AnchoredReprojectionError<GEOMETRY_T>::Evaluate(
+    double const *const *parameters, double *residuals, double **jacobians) const {
+  return EvaluateWithMinimalJacobians(parameters, residuals, jacobians, NULL);
+}
+
+// This evaluates the error term and additionally computes
+// the Jacobians in the minimal internal representation.
+template<class GEOMETRY_T>
+bool AnchoredReprojectionError<GEOMETRY_T>::EvaluateWithMinimalJacobians(
+    double const *const *parameters, double *residuals, double **jacobians,
+    double **jacobiansMinimal) const {
+
+  // As in ReprojectionError, we avoid okvis::kinematics::Transformation here.
+
+  // indices of the anchor parameter blocks (shared blocks are not repeated)
+  const size_t anchorPoseIdx = anchorPoseShared_ ? 0 : 3;
+  const size_t anchorExtrinsicsIdx =
+      anchorExtrinsicsShared_ ? 2 : (anchorPoseShared_ ? 3 : 4);
+
+  // pose of the observing frame: world to sensor transformation
+  Eigen::Map<const Eigen::Vector3d> t_WS_W(&parameters[0][0]);
+  const Eigen::Quaterniond q_WS(parameters[0][6], parameters[0][3],
+                                parameters[0][4], parameters[0][5]);
+
+  // the point in the anchor camera frame
+  Eigen::Map<const Eigen::Vector4d> hp_Ca(&parameters[1][0]);
+
+  // the sensor to camera transformation of the observing camera
+  Eigen::Map<const Eigen::Vector3d> t_SC_S(&parameters[2][0]);
+  const Eigen::Quaterniond q_SC(parameters[2][6], parameters[2][3],
+                                parameters[2][4], parameters[2][5]);
+
+  // pose of the anchor frame
+  Eigen::Map<const Eigen::Vector3d> t_WSa_W(&parameters[anchorPoseIdx][0]);
+  const Eigen::Quaterniond q_WSa(parameters[anchorPoseIdx][6],
+                                 parameters[anchorPoseIdx][3],
+                                 parameters[anchorPoseIdx][4],
+                                 parameters[anchorPoseIdx][5]);
+
+  // the sensor to camera transformation of the anchor camera
+  Eigen::Map<const Eigen::Vector3d> t_SCa_S(&parameters[anchorExtrinsicsIdx][0]);
+  const Eigen::Quaterniond q_SCa(parameters[anchorExtrinsicsIdx][6],
+                                 parameters[anchorExtrinsicsIdx][3],
+                                 parameters[anchorExtrinsicsIdx][4],
+                                 parameters[anchorExtrinsicsIdx][5]);
+
+  // transform the point into the observing camera:
+  Eigen::Matrix3d C_SC = q_SC.toRotationMatrix();
+  Eigen::Matrix3d C_CS = C_SC.transpose();
+  Eigen::Matrix4d T_CS = Eigen::Matrix4d::Identity();
+  T_CS.topLeftCorner<3, 3>() = C_CS;
+  T_CS.topRightCorner<3, 1>() = -C_CS * t_SC_S;
+  Eigen::Matrix3d C_WS = q_WS.toRotationMatrix();
+  Eigen::Matrix3d C_SW = C_WS.transpose();
+  Eigen::Matrix4d T_SW = Eigen::Matrix4d::Identity();
+  T_SW.topLeftCorner<3, 3>() = C_SW;
+  T_SW.topRightCorner<3, 1>() = -C_SW * t_WS_W;
+  Eigen::Matrix4d T_WSa = Eigen::Matrix4d::Identity();
+  T_WSa.topLeftCorner<3, 3>() = q_WSa.toRotationMatrix();
+  T_WSa.topRightCorner<3, 1>() = t_WSa_W;
+  Eigen::Matrix4d T_SCa = Eigen::Matrix4d::Identity();
+  T_SCa.topLeftCorner<3, 3>() = q_SCa.toRotationMatrix();
+  T_SCa.topRightCorner<3, 1>() = t_SCa_S;
+
+  // shared blocks cancel exactly: T_SW * T_WSa = I and T_CS * T_SCa = I
+  Eigen::Vector4d hp_Sa = T_SCa * hp_Ca;
+  Eigen::Vector4d hp_W = T_WSa * hp_Sa;
+  Eigen::Vector4d hp_S = anchorPoseShared_ ? hp_Sa : Eigen::Vector4d(T_SW * hp_W);
+  Eigen::Matrix4d T_CSa = anchorPoseShared_ ? T_CS : Eigen::Matrix4d(T_CS * T_SW * T_WSa);
+  Eigen::Matrix4d T_CCa = (anchorPoseShared_ && anchorExtrinsicsShared_) ?
+      Eigen::Matrix4d(Eigen::Matrix4d::Identity()) : Eigen::Matrix4d(T_CSa * T_SCa);
+  Eigen::Vector4d hp_C = T_CCa * hp_Ca;
+
+  // calculate the reprojection error
+  measurement_t kp;
+  Eigen::Matrix<double, 2, 4> Jh;
+  Eigen::Matrix<double, 2, 4> Jh_weighted;
+  if (jacobians != NULL) {
+    cameraGeometry_->projectHomogeneous(hp_C, &kp, &Jh);
+    Jh_weighted = squareRootInformation_ * Jh;
+  }
+  else {
+    cameraGeometry_->projectHomogeneous(hp_C, &kp);
+  }
+
+  measurement_t error = measurement_ - kp;
+
+  // weight:
+  measurement_t weighted_error = squareRootInformation_ * error;
+
+  // assign:
+  residuals[0] = weighted_error[0];
+  residuals[1] = weighted_error[1];
+
+  // check validity:
+  bool valid = true;
+  if (fabs(hp_C[3]) > 1.0e-8) {
+    Eigen::Vector3d p_C = hp_C.template head<3>() / hp_C[3];
+    if (p_C[2] < 0.2) {  // 20 cm - not very generic... but reasonable
+      valid = false;
+    }
+  }
+
+  // calculate jacobians, if required
+  if (jacobians != NULL) {
+    // minimal Jacobians w.r.t. the observing pose and extrinsics...
+    Eigen::Matrix<double, 2, 6> J_T_WS_minimal = Eigen::Matrix<double, 2, 6>::Zero();
+    Eigen::Matrix<double, 2, 6> J_T_SC_minimal;
+    // ...and w.r.t. the anchor pose and extrinsics
+    Eigen::Matrix<double, 2, 6> J_T_WSa_minimal = Eigen::Matrix<double, 2, 6>::Zero();
+    Eigen::Matrix<double, 2, 6> J_T_SCa_minimal;
+    if (!anchorPoseShared_) {
+      Eigen::Vector3d p = hp_W.head<3>() - t_WS_W * hp_W[3];
+      Eigen::Matrix<double, 4, 6> J;
+      J.setZero();
+      J.topLeftCorner<3, 3>() = C_SW * hp_W[3];
+      J.topRightCorner<3, 3>() = -C_SW * okvis::kinematics::crossMx(p);
+      J_T_WS_minimal = Jh_weighted * T_CS * J;
+
+      // the anchor pose perturbs hp_W the other way round
+      p = hp_W.head<3>() - t_WSa_W * hp_W[3];
+      J.setZero();
+      J.topLeftCorner<3, 3>() = Eigen::Matrix3d::Identity() * hp_W[3];
+      J.topRightCorner<3, 3>() = -okvis::kinematics::crossMx(p);
+      J_T_WSa_minimal = -Jh_weighted * T_CS * T_SW * J;
+    }
+    {
+      Eigen::Vector3d p = hp_S.head<3>() - t_SC_S * hp_S[3];
+      Eigen::Matrix<double, 4, 6> J;
+      J.setZero();
+      J.topLeftCorner<3, 3>() = C_CS * hp_S[3];
+      J.topRightCorner<3, 3>() = -C_CS * okvis::kinematics::crossMx(p);
+      J_T_SC_minimal = Jh_weighted * J;
+
+      p = hp_Sa.head<3>() - t_SCa_S * hp_Sa[3];
+      J.setZero();
+      J.topLeftCorner<3, 3>() = Eigen::Matrix3d::Identity() * hp_Sa[3];
+      J.topRightCorner<3, 3>() = -okvis::kinematics::crossMx(p);
+      J_T_SCa_minimal = -Jh_weighted * T_CSa * J;
+    }
+    if (anchorExtrinsicsShared_) {
+      if (anchorPoseShared_) {
+        J_T_SC_minimal.setZero(); // observed in the anchor camera itself
+      }
+      else {
+        J_T_SC_minimal += J_T_SCa_minimal;
+      }
+    }
+    if (!valid) {
+      J_T_WS_minimal.setZero();
+      J_T_SC_minimal.setZero();
+      J_T_WSa_minimal.setZero();
+      J_T_SCa_minimal.setZero();
+    }
+
+    // all pose-type parameter blocks in the order of the parameter blocks
+    std::vector<std::pair<size_t, const Eigen::Matrix<double, 2, 6>*> > poseBlocks;
+    poseBlocks.push_back(std::make_pair(size_t(0), &J_T_WS_minimal));
+    poseBlocks.push_back(std::make_pair(size_t(2), &J_T_SC_minimal));
+    if (!anchorPoseShared_) {
+      poseBlocks.push_back(std::make_pair(anchorPoseIdx, &J_T_WSa_minimal));
+    }
+    if (!anchorExtrinsicsShared_) {
+      poseBlocks.push_back(std::make_pair(anchorExtrinsicsIdx, &J_T_SCa_minimal));
+    }
+    for (size_t b = 0; b < poseBlocks.size(); ++b) {
+      const size_t i = poseBlocks[b].first;
+      if (jacobians[i] == NULL) {
+        continue;
+      }
+      // pseudo inverse of the local parametrization Jacobian:
+      Eigen::Matrix<double, 6, 7, Eigen::RowMajor> J_lift;
+      PoseLocalParameterization::liftJacobian(parameters[i], J_lift.data());
+
+      // hallucinate Jacobian w.r.t. state
+      Eigen::Map<Eigen::Matrix<double, 2, 7, Eigen::RowMajor> > J(jacobians[i]);
+      J = *poseBlocks[b].second * J_lift;
+
+      // if requested, provide minimal Jacobians
+      if (jacobiansMinimal != NULL) {
+        if (jacobiansMinimal[i] != NULL) {
+          Eigen::Map<Eigen::Matrix<double, 2, 6, Eigen::RowMajor> > J_minimal_mapped(
+              jacobiansMinimal[i]);
+          J_minimal_mapped = *poseBlocks[b].second;
+        }
+      }
+    }
+
+    if (jacobians[1] != NULL) {
+      Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor> > J1(
+          jacobians[1]);  // map the raw pointer to an Eigen matrix for convenience
+      J1 = -Jh_weighted * T_CCa;
+      if (!valid)
+        J1.setZero();
+
+      // if requested, provide minimal Jacobians
+      if (jacobiansMinimal != NULL) {
+        if (jacobiansMinimal[1] != NULL) {
+          Eigen::Map<Eigen::Matrix<double, 2, 3, Eigen::RowMajor> > J1_minimal_mapped(
+              jacobiansMinimal[1]);
+          Eigen::Matrix<double, 4, 3> S;
+          S.setZero();
+          S.topLeftCorner<3, 3>().setIdentity();
+          J1_minimal_mapped = J1 * S;  // this is for Euclidean-style perturbation only.
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+}  // namespace ceres
+}  // namespace okvis
@@ -55,6 +55,15 @@ template<class GEOMETRY_TYPE>
     return NULL;
   }
 
+  // without a landmark parameter block, e.g. in the StructurelessEstimator, there is no
+  // error term per observation: just remember it
+  if (!mapPtr_->parameterBlockExists(landmarkId)) {
+    updateCovisibilities(landmarksMap_.at(landmarkId), poseId, true);
+    landmarksMap_.at(landmarkId).observations.insert(
+        std::pair<okvis::KeypointIdentifier, uint64_t>(kid, 0));
+    return NULL;
+  }
+
   // get the keypoint measurement
   okvis::MultiFramePtr multiFramePtr = multiFramePtrMap_.at(poseId);
   Eigen::Vector2d measurement;
@@ -65,23 +74,46 @@ template<class GEOMETRY_TYPE>
   information *= 64.0 / (size * size);
 
   // create error term
-  std::shared_ptr<ceres::ReprojectionError
-      <GEOMETRY_TYPE
-      >> reprojectionError(
-      new ceres::ReprojectionError<GEOMETRY_TYPE>(
-          multiFramePtr->template geometryAs<GEOMETRY_TYPE>(camIdx),
-          camIdx, measurement, information));
+  ::ceres::ResidualBlockId retVal;
+  if (std::dynamic_pointer_cast<ceres::InverseDepthParameterBlock>(
+      mapPtr_->parameterBlockPtr(landmarkId))) {
+    std::vector<std::shared_ptr<ceres::ParameterBlock> > parameterBlocks;
+    bool anchorPoseShared = false;
+    bool anchorExtrinsicsShared = false;
+    getAnchoredObservationParameterBlocks(landmarkId, poseId, camIdx, parameterBlocks,
+                                          anchorPoseShared, anchorExtrinsicsShared);
+    std::shared_ptr<ceres::AnchoredReprojectionError
+        <GEOMETRY_TYPE
+        >> reprojectionError(
+        new ceres::AnchoredReprojectionError<GEOMETRY_TYPE>(
+            multiFramePtr->template geometryAs<GEOMETRY_TYPE>(camIdx),
+            camIdx, measurement, information, anchorPoseShared, anchorExtrinsicsShared));
 
-  ::ceres::ResidualBlockId retVal = mapPtr_->addResidualBlock(
-      reprojectionError,
-      cauchyLossFunctionPtr_ ? cauchyLossFunctionPtr_.get() : NULL,
-      mapPtr_->parameterBlockPtr(poseId),
-      mapPtr_->parameterBlockPtr(landmarkId),
-      mapPtr_->parameterBlockPtr(
-          statesMap_.at(poseId).sensors.at(SensorStates::Camera).at(camIdx).at(
-              CameraSensorStates::T_SCi).id));
+    retVal = mapPtr_->addResidualBlock(
+        reprojectionError,
+        cauchyLossFunctionPtr_ ? cauchyLossFunctionPtr_.get() : NULL,
+        parameterBlocks);
+  }
+  else {
+    std::shared_ptr<ceres::ReprojectionError
+        <GEOMETRY_TYPE
+        >> reprojectionError(
+        new ceres::ReprojectionError<GEOMETRY_TYPE>(
+            multiFramePtr->template geometryAs<GEOMETRY_TYPE>(camIdx),
+            camIdx, measurement, information));
+
+    retVal = mapPtr_->addResidualBlock(
+        reprojectionError,
+        cauchyLossFunctionPtr_ ? cauchyLossFunctionPtr_.get() : NULL,
+        mapPtr_->parameterBlockPtr(poseId),
+        mapPtr_->parameterBlockPtr(landmarkId),
+        mapPtr_->parameterBlockPtr(
+            statesMap_.at(poseId).sensors.at(SensorStates::Camera).at(camIdx).at(
+                CameraSensorStates::T_SCi).id));
+  }
 
   // remember
+  updateCovisibilities(landmarksMap_.at(landmarkId), poseId, true);
   landmarksMap_.at(landmarkId).observations.insert(
       std::pair<okvis::KeypointIdentifier, uint64_t>(
           kid, reinterpret_cast<uint64_t>(retVal)));
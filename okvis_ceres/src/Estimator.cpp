@@ -38,6 +38,13 @@
  * @author Andreas Forster
  */
 
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <set>
+#include <thread>
+#include <tuple>
+
 #include <glog/logging.h>
 #include <okvis/Estimator.hpp>
 #include <okvis/ceres/PoseParameterBlock.hpp>
@@ -59,7 +66,24 @@ Estimator::Estimator(
       referencePoseId_(0),
       cauchyLossFunctionPtr_(new ::ceres::CauchyLoss(1)),
       huberLossFunctionPtr_(new ::ceres::HuberLoss(1)),
-      marginalizationResidualId_(0) {
+      marginalizationResidualId_(0),
+      extrinsicsAutoFreeze_(false),
+      extrinsicsFreezeTranslation_(1.0e-4),
+      extrinsicsFreezeRotation_(1.0e-4),
+      extrinsicsFreezeCount_(20),
+      marginalizationMinObservations_(2),
+      marginalizationMinQuality_(0.0),
+      priorSparsification_(false),
+      priorSparsificationMaxKld_(1.0),
+      anchoredLandmarks_(false),
+      warmStartTrustRegion_(false),
+      trustRegionRadius_(0.0),
+      outlierChi2Threshold_(5.991),
+      outlierConsecutiveOptimizations_(3),
+      outlierMinObservations_(2),
+      outlierCullingOffset_(0),
+      maxLandmarks_(0),
+      linearSolverType_(::ceres::SPARSE_SCHUR) {
 }
 
 // The default constructor.
@@ -68,7 +92,24 @@ Estimator::Estimator()
       referencePoseId_(0),
       cauchyLossFunctionPtr_(new ::ceres::CauchyLoss(1)),
       huberLossFunctionPtr_(new ::ceres::HuberLoss(1)),
-      marginalizationResidualId_(0) {
+      marginalizationResidualId_(0),
+      extrinsicsAutoFreeze_(false),
+      extrinsicsFreezeTranslation_(1.0e-4),
+      extrinsicsFreezeRotation_(1.0e-4),
+      extrinsicsFreezeCount_(20),
+      marginalizationMinObservations_(2),
+      marginalizationMinQuality_(0.0),
+      priorSparsification_(false),
+      priorSparsificationMaxKld_(1.0),
+      anchoredLandmarks_(false),
+      warmStartTrustRegion_(false),
+      trustRegionRadius_(0.0),
+      outlierChi2Threshold_(5.991),
+      outlierConsecutiveOptimizations_(3),
+      outlierMinObservations_(2),
+      outlierCullingOffset_(0),
+      maxLandmarks_(0),
+      linearSolverType_(::ceres::SPARSE_SCHUR) {
 }
 
 Estimator::~Estimator() {
@@ -78,6 +119,7 @@ Estimator::~Estimator() {
 int Estimator::addCamera(
     const ExtrinsicsEstimationParameters &extrinsicsEstimationParameters) {
   extrinsicsEstimationParametersVec_.push_back(extrinsicsEstimationParameters);
+  extrinsicsConvergence_.push_back(ExtrinsicsConvergence());
   return extrinsicsEstimationParametersVec_.size() - 1;
 }
 
@@ -94,6 +136,7 @@ int Estimator::addImu(const ImuParameters &imuParameters) {
 // Remove all cameras from the configuration
 void Estimator::clearCameras() {
   extrinsicsEstimationParametersVec_.clear();
+  extrinsicsConvergence_.clear();
 }
 
 // Remove all IMUs from the configuration.
@@ -192,7 +235,8 @@ bool Estimator::addStates(
     cameraInfos.at(CameraSensorStates::T_SCi).exists = true;
     cameraInfos.at(CameraSensorStates::Intrinsics).exists = false;
     if (((extrinsicsEstimationParametersVec_.at(i).sigma_c_relative_translation < 1e-12) ||
-         (extrinsicsEstimationParametersVec_.at(i).sigma_c_relative_orientation < 1e-12)) &&
+         (extrinsicsEstimationParametersVec_.at(i).sigma_c_relative_orientation < 1e-12) ||
+         extrinsicsConvergence_.at(i).frozen) &&
         (statesMap_.size() > 1)) {
       // use the same block...
       cameraInfos.at(CameraSensorStates::T_SCi).id =
@@ -344,8 +388,11 @@ bool Estimator::addStates(
 // Add a landmark.
 bool Estimator::addLandmark(uint64_t landmarkId,
                             const Eigen::Vector4d &landmark) {
+  // anchored landmarks hold the world point until the first observation anchors them
   std::shared_ptr<okvis::ceres::HomogeneousPointParameterBlock> pointParameterBlock(
-      new okvis::ceres::HomogeneousPointParameterBlock(landmark, landmarkId));
+      anchoredLandmarks_ ?
+          new okvis::ceres::InverseDepthParameterBlock(landmark, landmarkId) :
+          new okvis::ceres::HomogeneousPointParameterBlock(landmark, landmarkId));
   if (!mapPtr_->addParameterBlock(pointParameterBlock,
                                   okvis::ceres::Map::HomogeneousPoint)) {
     return false;
@@ -363,6 +410,126 @@ bool Estimator::addLandmark(uint64_t landmarkId,
   return true;
 }
 
+// Get the parameter blocks of an observation of an anchored landmark.
+void Estimator::getAnchoredObservationParameterBlocks(
+    uint64_t landmarkId, uint64_t poseId, size_t camIdx,
+    std::vector<std::shared_ptr<ceres::ParameterBlock> > &parameterBlocks,
+    bool &anchorPoseShared, bool &anchorExtrinsicsShared) {
+  std::shared_ptr<ceres::InverseDepthParameterBlock> pointParameterBlock =
+      std::static_pointer_cast<ceres::InverseDepthParameterBlock>(
+          mapPtr_->parameterBlockPtr(landmarkId));
+  const uint64_t extrinsicsId = statesMap_.at(poseId).sensors.at(SensorStates::Camera).at(
+      camIdx).at(CameraSensorStates::T_SCi).id;
+
+  // the first observation becomes the anchor
+  if (!pointParameterBlock->anchored()) {
+    okvis::kinematics::Transformation T_WS = std::static_pointer_cast<
+        ceres::PoseParameterBlock>(mapPtr_->parameterBlockPtr(poseId))->estimate();
+    okvis::kinematics::Transformation T_SC = std::static_pointer_cast<
+        ceres::PoseParameterBlock>(mapPtr_->parameterBlockPtr(extrinsicsId))->estimate();
+    pointParameterBlock->setEstimate(ceres::InverseDepthParameterBlock::normalize(
+        (T_WS * T_SC).inverse().T() * landmarksMap_.at(landmarkId).point));
+    pointParameterBlock->setAnchor(poseId, camIdx, extrinsicsId);
+  }
+
+  anchorPoseShared = pointParameterBlock->anchorPoseId() == poseId;
+  anchorExtrinsicsShared = pointParameterBlock->anchorExtrinsicsId() == extrinsicsId;
+  parameterBlocks.clear();
+  parameterBlocks.push_back(mapPtr_->parameterBlockPtr(poseId));
+  parameterBlocks.push_back(pointParameterBlock);
+  parameterBlocks.push_back(mapPtr_->parameterBlockPtr(extrinsicsId));
+  if (!anchorPoseShared) {
+    parameterBlocks.push_back(
+        mapPtr_->parameterBlockPtr(pointParameterBlock->anchorPoseId()));
+  }
+  if (!anchorExtrinsicsShared) {
+    parameterBlocks.push_back(
+        mapPtr_->parameterBlockPtr(pointParameterBlock->anchorExtrinsicsId()));
+  }
+}
+
+// The landmark estimate in the world frame.
+Eigen::Vector4d Estimator::landmarkEstimateInWorld(uint64_t landmarkId) const {
+  std::shared_ptr<ceres::HomogeneousPointParameterBlock> pointParameterBlock =
+      std::static_pointer_cast<ceres::HomogeneousPointParameterBlock>(
+          mapPtr_->parameterBlockPtr(landmarkId));
+  std::shared_ptr<ceres::InverseDepthParameterBlock> inverseDepthParameterBlock =
+      std::dynamic_pointer_cast<ceres::InverseDepthParameterBlock>(pointParameterBlock);
+  if (!inverseDepthParameterBlock || !inverseDepthParameterBlock->anchored()) {
+    return pointParameterBlock->estimate();
+  }
+  okvis::kinematics::Transformation T_WSa = std::static_pointer_cast<
+      ceres::PoseParameterBlock>(mapPtr_->parameterBlockPtr(
+          inverseDepthParameterBlock->anchorPoseId()))->estimate();
+  okvis::kinematics::Transformation T_SCa = std::static_pointer_cast<
+      ceres::PoseParameterBlock>(mapPtr_->parameterBlockPtr(
+          inverseDepthParameterBlock->anchorExtrinsicsId()))->estimate();
+  return (T_WSa * T_SCa).T() * inverseDepthParameterBlock->estimate();
+}
+
+// Move the anchor of a landmark to its oldest observation outside of excludedFrames.
+bool Estimator::reanchorLandmark(uint64_t landmarkId,
+                                 const std::vector<uint64_t> &excludedFrames) {
+  MapPoint &mapPoint = landmarksMap_.at(landmarkId);
+  std::map<okvis::KeypointIdentifier, uint64_t>::const_iterator anchorIt =
+      mapPoint.observations.end();
+  for (std::map<okvis::KeypointIdentifier, uint64_t>::const_iterator it =
+      mapPoint.observations.begin(); it != mapPoint.observations.end(); ++it) {
+    if (std::find(excludedFrames.begin(), excludedFrames.end(), it->first.frameId)
+        != excludedFrames.end()) {
+      continue;
+    }
+    if (anchorIt == mapPoint.observations.end() || it->first.frameId < anchorIt->first.frameId) {
+      anchorIt = it;
+    }
+  }
+  if (anchorIt == mapPoint.observations.end()) {
+    return false;
+  }
+
+  // express the current estimate in the new anchor camera
+  std::shared_ptr<ceres::InverseDepthParameterBlock> pointParameterBlock =
+      std::static_pointer_cast<ceres::InverseDepthParameterBlock>(
+          mapPtr_->parameterBlockPtr(landmarkId));
+  const uint64_t poseId = anchorIt->first.frameId;
+  const size_t camIdx = anchorIt->first.cameraIndex;
+  const uint64_t extrinsicsId = statesMap_.at(poseId).sensors.at(SensorStates::Camera).at(
+      camIdx).at(CameraSensorStates::T_SCi).id;
+  const Eigen::Vector4d hp_W = landmarkEstimateInWorld(landmarkId);
+  okvis::kinematics::Transformation T_WS = std::static_pointer_cast<
+      ceres::PoseParameterBlock>(mapPtr_->parameterBlockPtr(poseId))->estimate();
+  okvis::kinematics::Transformation T_SC = std::static_pointer_cast<
+      ceres::PoseParameterBlock>(mapPtr_->parameterBlockPtr(extrinsicsId))->estimate();
+  pointParameterBlock->setEstimate(ceres::InverseDepthParameterBlock::normalize(
+      (T_WS * T_SC).inverse().T() * hp_W));
+  pointParameterBlock->setAnchor(poseId, camIdx, extrinsicsId);
+
+  // the parameter block layout of all observations changes
+  for (std::map<okvis::KeypointIdentifier, uint64_t>::iterator it =
+      mapPoint.observations.begin(); it != mapPoint.observations.end(); ++it) {
+    const ::ceres::ResidualBlockId residualBlockId =
+        reinterpret_cast< ::ceres::ResidualBlockId>(it->second);
+    const ceres::Map::ResidualBlockSpec spec =
+        mapPtr_->residualBlockId2ResidualBlockSpecMap().at(residualBlockId);
+    std::shared_ptr<ceres::AnchoredReprojectionError2dBase> reprojectionError =
+        std::dynamic_pointer_cast<ceres::AnchoredReprojectionError2dBase>(
+            spec.errorInterfacePtr);
+    OKVIS_ASSERT_TRUE_DBG(Exception, reprojectionError,
+                          "observation of anchored landmark without anchored error term");
+    std::vector<std::shared_ptr<ceres::ParameterBlock> > parameterBlocks;
+    bool anchorPoseShared = false;
+    bool anchorExtrinsicsShared = false;
+    getAnchoredObservationParameterBlocks(landmarkId, it->first.frameId,
+                                          it->first.cameraIndex, parameterBlocks,
+                                          anchorPoseShared, anchorExtrinsicsShared);
+    mapPtr_->removeResidualBlock(residualBlockId);
+    it->second = reinterpret_cast<uint64_t>(mapPtr_->addResidualBlock(
+        reprojectionError->reanchored(anchorPoseShared, anchorExtrinsicsShared),
+        spec.lossFunctionPtr, parameterBlocks));
+  }
+  return true;
+}
+
 // Remove an observation from a landmark.
 bool Estimator::removeObservation(::ceres::ResidualBlockId residualBlockId) {
   const ceres::Map::ParameterBlockCollection parameters = mapPtr_->parameters(residualBlockId);
@@ -372,8 +539,9 @@ bool Estimator::removeObservation(::ceres::ResidualBlockId residualBlockId) {
   for (std::map<okvis::KeypointIdentifier, uint64_t>::iterator it = mapPoint.observations.begin();
        it != mapPoint.observations.end();) {
     if (it->second == uint64_t(residualBlockId)) {
-
+      const uint64_t poseId = it->first.frameId;
       it = mapPoint.observations.erase(it);
+      updateCovisibilities(mapPoint, poseId, false);
     }
     else {
       it++;
@@ -408,6 +576,7 @@ bool Estimator::removeObservation(uint64_t landmarkId, uint64_t poseId,
 
   // remove also in local map
   mapPoint.observations.erase(it);
+  updateCovisibilities(mapPoint, poseId, false);
 
   return true;
 }
@@ -433,7 +602,8 @@ bool vectorContains(const std::vector<T> &vector, const T &query) {
 // The new number of frames in the window will be numKeyframes+numImuFrames.
 bool Estimator::applyMarginalizationStrategy(
     size_t numKeyframes, size_t numImuFrames,
-    okvis::MapPointVector &removedLandmarks) {
+    okvis::MapPointVector &removedLandmarks,
+    okvis::FrameStateVector *marginalizedStates) {
   // keep the newest numImuFrames
   std::map<uint64_t, States>::reverse_iterator rit = statesMap_.rbegin();
   for (size_t k = 0; k < numImuFrames; k++) {
@@ -453,6 +623,14 @@ bool Estimator::applyMarginalizationStrategy(
     if (!success)
       return false;
   }
+  for (size_t i = 0; i < sparsifiedPriorResidualIds_.size(); ++i) {
+    bool success = mapPtr_->removeResidualBlock(sparsifiedPriorResidualIds_[i]);
+    OKVIS_ASSERT_TRUE_DBG(Exception, success,
+                          "could not remove sparsified marginalization error");
+    if (!success)
+      return false;
+  }
+  sparsifiedPriorResidualIds_.clear();
 
   // these will keep track of what we want to marginalize out.
   std::vector<uint64_t> paremeterBlocksToBeMarginalized;
@@ -465,20 +643,9 @@ bool Estimator::applyMarginalizationStrategy(
 
   // distinguish if we marginalize everything or everything but pose
   std::vector<uint64_t> removeFrames;
-  std::vector<uint64_t> removeAllButPose;
   std::vector<uint64_t> allLinearizedFrames;
-  size_t countedKeyframes = 0;
-  while (rit != statesMap_.rend()) {
-    if (!rit->second.isKeyframe || countedKeyframes >= numKeyframes) {
-      removeFrames.push_back(rit->second.id);
-    }
-    else {
-      countedKeyframes++;
-    }
-    removeAllButPose.push_back(rit->second.id);
-    allLinearizedFrames.push_back(rit->second.id);
-    ++rit;// check the next frame
-  }
+  getFramesToMarginalize(numKeyframes, numImuFrames, removeFrames, allLinearizedFrames);
+  const std::vector<uint64_t> &removeAllButPose = allLinearizedFrames;
 
   // marginalize everything but pose:
   for (size_t k = 0; k < removeAllButPose.size(); ++k) {
@@ -552,6 +719,17 @@ bool Estimator::applyMarginalizationStrategy(
       }
     }
   }
+  // report the final estimates of the poses to be marginalized, oldest first
+  if (marginalizedStates) {
+    for (std::vector<uint64_t>::reverse_iterator fit = removeFrames.rbegin();
+         fit != removeFrames.rend(); ++fit) {
+      okvis::kinematics::Transformation T_WS;
+      get_T_WS(*fit, T_WS);
+      marginalizedStates->push_back(
+          okvis::FrameState(*fit, statesMap_.at(*fit).timestamp, T_WS));
+    }
+  }
+
   // marginalize ONLY pose now:
   bool reDoFixation = false;
   for (size_t k = 0; k < removeFrames.size(); ++k) {
@@ -625,6 +803,12 @@ bool Estimator::applyMarginalizationStrategy(
       for (PointMap::iterator pit = landmarksMap_.begin();
            pit != landmarksMap_.end();) {
 
+        // landmarks without a parameter block are up to the derived class
+        if (!mapPtr_->parameterBlockExists(pit->first)) {
+          pit++;
+          continue;
+        }
+
         ceres::Map::ResidualBlockCollection residuals = mapPtr_->residuals(pit->first);
 
         // first check if we can skip
@@ -667,11 +851,27 @@ bool Estimator::applyMarginalizationStrategy(
           continue;
         }
 
+        // a landmark that stays must not be anchored in a frame that leaves
+        if (skipLandmark || hasNewObservations) {
+          std::shared_ptr<ceres::InverseDepthParameterBlock> inverseDepthParameterBlock =
+              std::dynamic_pointer_cast<ceres::InverseDepthParameterBlock>(
+                  mapPtr_->parameterBlockPtr(pit->first));
+          if (inverseDepthParameterBlock
+              && vectorContains(removeFrames, inverseDepthParameterBlock->anchorPoseId())) {
+            reanchorLandmark(pit->first, removeFrames);
+            residuals = mapPtr_->residuals(pit->first);
+          }
+        }
+
         if (skipLandmark) {
           pit++;
           continue;
         }
 
+        // weakly informative landmarks are dropped rather than marginalized
+        const bool dropLandmark = obsCount < marginalizationMinObservations_
+            || pit->second.quality < marginalizationMinQuality_;
+
         // so, we need to consider it.
         for (size_t r = 0; r < residuals.size(); ++r) {
           std::shared_ptr<ceres::ReprojectionErrorBase> reprojectionError =
@@ -687,8 +887,7 @@ bool Estimator::applyMarginalizationStrategy(
               r--;
             }
             else if (marginalize && vectorContains(allLinearizedFrames, poseId)) {
-              // TODO: consider only the sensible ones for marginalization
-              if (obsCount < 2) { //visibleInFrame.size()
+              if (dropLandmark) {
                 removeObservation(residuals[r].residualBlockId);
                 residuals.erase(residuals.begin() + r);
                 r--;
@@ -718,6 +917,7 @@ bool Estimator::applyMarginalizationStrategy(
           paremeterBlocksToBeMarginalized.push_back(pit->first);
           keepParameterBlocks.push_back(false);
           removedLandmarks.push_back(pit->second);
+          removeCovisibilities(pit->second);
           pit = landmarksMap_.erase(pit);
           continue;
         }
@@ -729,6 +929,7 @@ bool Estimator::applyMarginalizationStrategy(
     // update book-keeping and go to the next frame
     //if(it != statesMap_.begin()){ // let's remember that we kept the very first pose
     if (true) { ///// DEBUG
+      removeCovisibilities(it->second.id);
       multiFramePtrMap_.erase(it->second.id);
       statesMap_.erase(it->second.id);
     }
@@ -740,8 +941,24 @@ bool Estimator::applyMarginalizationStrategy(
     marginalizationErrorPtr_->marginalizeOut(paremeterBlocksToBeMarginalized, keepParameterBlocks);
   }
 
+  // extrinsics frozen since the last marginalization are no longer estimated: condition the
+  // prior on them once. Terms added later treat the constant block as fixed.
+  std::vector<uint64_t> frozenIds;
+  for (size_t i = 0; i < extrinsicsConvergence_.size(); ++i) {
+    ExtrinsicsConvergence &convergence = extrinsicsConvergence_[i];
+    if (!convergence.frozen || convergence.conditioned) {
+      continue;
+    }
+    if (marginalizationErrorPtr_->isParameterBlockConnected(convergence.frozenId)) {
+      frozenIds.push_back(convergence.frozenId);
+    }
+    convergence.conditioned = true;
+  }
+  const bool conditioned = !frozenIds.empty()
+      && marginalizationErrorPtr_->conditionOn(frozenIds);
+
   // update error computation
-  if (paremeterBlocksToBeMarginalized.size() > 0) {
+  if (paremeterBlocksToBeMarginalized.size() > 0 || conditioned) {
     marginalizationErrorPtr_->updateErrorComputation();
   }
 
@@ -749,7 +966,53 @@ bool Estimator::applyMarginalizationStrategy(
   if (marginalizationErrorPtr_->num_residuals() == 0) {
     marginalizationErrorPtr_.reset();
   }
-  if (marginalizationErrorPtr_) {
+
+  std::vector<std::shared_ptr<ceres::MarginalizationError> > priorFactors;
+  if (marginalizationErrorPtr_ && priorSparsification_) {
+    // one group per frame: pose, speed/bias and extrinsics not shared with other frames
+    std::map<uint64_t, size_t> extrinsicsCount;
+    for (auto it = statesMap_.begin(); it != statesMap_.end(); ++it) {
+      for (size_t i = 0; i < it->second.sensors.at(SensorStates::Camera).size(); ++i) {
+        extrinsicsCount[it->second.sensors.at(SensorStates::Camera).at(i).at(
+            CameraSensorStates::T_SCi).id]++;
+      }
+    }
+    std::vector<std::vector<uint64_t> > groups;
+    for (auto it = statesMap_.begin(); it != statesMap_.end(); ++it) {
+      std::vector<uint64_t> group;
+      group.push_back(it->second.global.at(GlobalStates::T_WS).id);
+      for (size_t i = 0; i < it->second.sensors.at(SensorStates::Imu).size(); ++i) {
+        group.push_back(it->second.sensors.at(SensorStates::Imu).at(i).at(
+            ImuSensorStates::SpeedAndBias).id);
+      }
+      for (size_t i = 0; i < it->second.sensors.at(SensorStates::Camera).size(); ++i) {
+        const uint64_t extrinsicsId = it->second.sensors.at(SensorStates::Camera).at(i).at(
+            CameraSensorStates::T_SCi).id;
+        if (extrinsicsCount[extrinsicsId] == 1) {
+          group.push_back(extrinsicsId);
+        }
+      }
+      groups.push_back(group);
+    }
+    double kullbackLeibler = 0.0;
+    if (marginalizationErrorPtr_->sparsify(groups, priorSparsificationMaxKld_, priorFactors,
+                                           &kullbackLeibler)) {
+      VLOG(2) << "sparsified marginalization prior into " << priorFactors.size()
+              << " factors, KLD=" << kullbackLeibler;
+    }
+  }
+  for (size_t i = 0; i < priorFactors.size(); ++i) {
+    std::vector<std::shared_ptr<okvis::ceres::ParameterBlock> > parameterBlockPtrs;
+    priorFactors[i]->getParameterBlockPtrs(parameterBlockPtrs);
+    ::ceres::ResidualBlockId residualId = mapPtr_->addResidualBlock(
+        priorFactors[i], NULL, parameterBlockPtrs);
+    OKVIS_ASSERT_TRUE_DBG(Exception, residualId,
+                          "could not add sparsified marginalization error");
+    if (!residualId)
+      return false;
+    sparsifiedPriorResidualIds_.push_back(residualId);
+  }
+  if (marginalizationErrorPtr_ && priorFactors.empty()) {
     std::vector<std::shared_ptr<okvis::ceres::ParameterBlock> > parameterBlockPtrs;
     marginalizationErrorPtr_->getParameterBlockPtrs(parameterBlockPtrs);
     marginalizationResidualId_ = mapPtr_->addResidualBlock(
@@ -774,9 +1037,42 @@ bool Estimator::applyMarginalizationStrategy(
     mapPtr_->addResidualBlock(poseError, NULL, mapPtr_->parameterBlockPtr(statesMap_.begin()->first));
   }
 
+  // the cost changed (new prior, fewer states): trust the carried-over radius less
+  if (trustRegionRadius_ > 0.0) {
+    trustRegionRadius_ = sqrt(
+        trustRegionRadius_ * mapPtr_->options.initial_trust_region_radius);
+  }
+
   return true;
 }
 
+// Get the frames applyMarginalizationStrategy() removes.
+void Estimator::getFramesToMarginalize(size_t numKeyframes, size_t numImuFrames,
+                                       std::vector<uint64_t> &removeFrames,
+                                       std::vector<uint64_t> &allLinearizedFrames) const {
+  removeFrames.clear();
+  allLinearizedFrames.clear();
+
+  // keep the newest numImuFrames
+  std::map<uint64_t, States>::const_reverse_iterator rit = statesMap_.rbegin();
+  for (size_t k = 0; k < numImuFrames && rit != statesMap_.rend(); k++) {
+    rit++;
+  }
+
+  // and the newest numKeyframes keyframes outside of the IMU window
+  size_t countedKeyframes = 0;
+  while (rit != statesMap_.rend()) {
+    if (!rit->second.isKeyframe || countedKeyframes >= numKeyframes) {
+      removeFrames.push_back(rit->second.id);
+    }
+    else {
+      countedKeyframes++;
+    }
+    allLinearizedFrames.push_back(rit->second.id);
+    ++rit;// check the next frame
+  }
+}
+
 // Prints state information to buffer.
 void Estimator::printStates(uint64_t poseId, std::ostream &buffer) const {
   buffer << "GLOBAL: ";
@@ -856,7 +1152,7 @@ void Estimator::optimize(size_t numIter, size_t /*numThreads*/,
 
 {
   // assemble options
-  mapPtr_->options.linear_solver_type = ::ceres::SPARSE_SCHUR;
+  mapPtr_->options.linear_solver_type = linearSolverType_;
   //mapPtr_->options.initial_trust_region_radius = 1.0e4;
   //mapPtr_->options.initial_trust_region_radius = 2.0e6;
   //mapPtr_->options.preconditioner_type = ::ceres::IDENTITY;
@@ -879,12 +1175,27 @@ void Estimator::optimize(size_t numIter, size_t /*numThreads*/,
     mapPtr_->options.minimizer_progress_to_stdout = false;
   }
 
+  // start from the trust region of the previous call (also the inverse LM damping)
+  const double initialTrustRegionRadius = mapPtr_->options.initial_trust_region_radius;
+  if (warmStartTrustRegion_ && trustRegionRadius_ > 0.0) {
+    mapPtr_->options.initial_trust_region_radius = std::min(
+        std::max(trustRegionRadius_, 1.0e-4 * initialTrustRegionRadius),
+        mapPtr_->options.max_trust_region_radius);
+  }
+
   // call solver
   mapPtr_->solve();
+  mapPtr_->options.initial_trust_region_radius = initialTrustRegionRadius;
 
   // update landmarks
   {
     for (auto it = landmarksMap_.begin(); it != landmarksMap_.end(); ++it) {
+      if (!mapPtr_->parameterBlockExists(it->first)) {
+        continue;  // no landmark parameter block, e.g. in the StructurelessEstimator
+      }
+      if (mapPtr_->parameterBlockPtr(it->first)->fixed()) {
+        continue;  // not optimized, e.g. outside of optimizeLocal()
+      }
       Eigen::MatrixXd H(3, 3);
       mapPtr_->getLhs(it->first, H);
       Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> saes(H);
@@ -900,18 +1211,387 @@ void Estimator::optimize(size_t numIter, size_t /*numThreads*/,
         it->second.quality = sqrt(smallest) / sqrt(largest);
       }
 
-      // update coordinates
-      it->second.point = std::static_pointer_cast<okvis::ceres::HomogeneousPointParameterBlock>(
-          mapPtr_->parameterBlockPtr(it->first))->estimate();
+      // update coordinates (the quality is about invariant to anchoring, since both the
+      // lateral and the depth perturbations scale with the inverse depth)
+      it->second.point = landmarkEstimateInWorld(it->first);
     }
   }
 
+  // the radius after the last step
+  if (!mapPtr_->summary.iterations.empty()) {
+    trustRegionRadius_ = mapPtr_->summary.iterations.back().trust_region_radius;
+  }
+
+  updateExtrinsicsConvergence();
+
   // summary output
   if (verbose) {
     LOG(INFO) << mapPtr_->summary.FullReport();
   }
 }
 
+// Optimize the newest states and the landmarks they observe only.
+void Estimator::optimizeLocal(size_t numLocalFrames, size_t numIter, size_t numThreads,
+                              bool verbose) {
+  if (numLocalFrames == 0 || numLocalFrames >= statesMap_.size()) {
+    optimize(numIter, numThreads, verbose);
+    return;
+  }
+
+  // all state parameter blocks of the local frames
+  std::set<uint64_t> localFrames;
+  std::set<uint64_t> localStates;
+  auto collectStates = [](const States &states, std::set<uint64_t> &ids) {
+    for (size_t i = 0; i < states.global.size(); ++i) {
+      if (states.global[i].exists) {
+        ids.insert(states.global[i].id);
+      }
+    }
+    for (size_t s = 0; s < states.sensors.size(); ++s) {
+      for (size_t i = 0; i < states.sensors[s].size(); ++i) {
+        for (size_t j = 0; j < states.sensors[s][i].size(); ++j) {
+          if (states.sensors[s][i][j].exists) {
+            ids.insert(states.sensors[s][i][j].id);
+          }
+        }
+      }
+    }
+  };
+  for (auto it = statesMap_.rbegin(); it != statesMap_.rend()
+       && localFrames.size() < numLocalFrames; ++it) {
+    localFrames.insert(it->first);
+    collectStates(it->second, localStates);
+  }
+
+  // hold everything else constant, but only what is not constant anyway
+  std::vector<uint64_t> heldConstant;
+  auto holdConstant = [&](uint64_t id) {
+    if (!mapPtr_->parameterBlockPtr(id)->fixed()) {
+      mapPtr_->setParameterBlockConstant(id);
+      heldConstant.push_back(id);
+    }
+  };
+  for (auto it = statesMap_.begin(); it != statesMap_.end(); ++it) {
+    if (localFrames.count(it->first)) {
+      continue;
+    }
+    std::set<uint64_t> states;
+    collectStates(it->second, states);
+    for (auto id = states.begin(); id != states.end(); ++id) {
+      if (!localStates.count(*id)) {
+        holdConstant(*id);  // shared extrinsics stay free
+      }
+    }
+  }
+  for (auto it = landmarksMap_.begin(); it != landmarksMap_.end(); ++it) {
+    bool local = false;
+    for (auto obs = it->second.observations.begin(); obs != it->second.observations.end();
+         ++obs) {
+      if (localFrames.count(obs->first.frameId)) {
+        local = true;
+        break;
+      }
+    }
+    if (!local) {
+      holdConstant(it->first);
+    }
+  }
+
+  optimize(numIter, numThreads, verbose);
+
+  for (size_t i = 0; i < heldConstant.size(); ++i) {
+    mapPtr_->setParameterBlockVariable(heldConstant[i]);
+  }
+}
+
+// Remove observations that were outliers in consecutive optimizations.
+size_t Estimator::cullOutliers(okvis::MapPointVector &removedLandmarks, size_t numThreads,
+                               double timeLimit) {
+  const okvis::Time startTime = okvis::Time::now();
+
+  struct Observation {
+    uint64_t landmarkId;
+    okvis::KeypointIdentifier keypointId;
+    ::ceres::ResidualBlockId residualBlockId;
+    double chi2;
+    bool evaluated;
+  };
+  std::vector<Observation> observations;
+  for (PointMap::const_iterator pit = landmarksMap_.begin(); pit != landmarksMap_.end();
+       ++pit) {
+    for (std::map<okvis::KeypointIdentifier, uint64_t>::const_iterator it =
+        pit->second.observations.begin(); it != pit->second.observations.end(); ++it) {
+      Observation observation;
+      observation.landmarkId = pit->first;
+      observation.keypointId = it->first;
+      observation.residualBlockId = reinterpret_cast< ::ceres::ResidualBlockId>(it->second);
+      observation.chi2 = 0.0;
+      observation.evaluated = false;
+      observations.push_back(observation);
+    }
+  }
+  if (observations.empty()) {
+    outlierCounts_.clear();
+    return 0;
+  }
+
+  // evaluate the squared whitened errors, interleaved over the threads, such that
+  // approximately the first ones in the (rotated) order are done when the time runs out
+  const ceres::Map::ResidualBlockId2ResidualBlockSpec_Map &residualBlockSpecs =
+      mapPtr_->residualBlockId2ResidualBlockSpecMap();
+  const size_t offset = outlierCullingOffset_ % observations.size();
+  numThreads = std::max<size_t>(1, std::min(numThreads, observations.size()));
+  std::vector<size_t> numEvaluated(numThreads, 0);
+  auto evaluate = [&](size_t thread) {
+    std::vector<double *> parametersRaw;
+    Eigen::VectorXd residuals;
+    for (size_t j = thread; j < observations.size(); j += numThreads) {
+      if (timeLimit >= 0.0 && (okvis::Time::now() - startTime).toSec() > timeLimit) {
+        return;
+      }
+      Observation &observation = observations[(offset + j) % observations.size()];
+      const std::shared_ptr<ceres::ErrorInterface> &errorInterfacePtr =
+          residualBlockSpecs.at(observation.residualBlockId).errorInterfacePtr;
+      const ceres::Map::ParameterBlockCollection parameters =
+          mapPtr_->parameters(observation.residualBlockId);
+      parametersRaw.resize(parameters.size());
+      for (size_t i = 0; i < parameters.size(); ++i) {
+        parametersRaw[i] = parameters[i].second->parameters();
+      }
+      residuals.resize(errorInterfacePtr->residualDim());
+      errorInterfacePtr->EvaluateWithMinimalJacobians(parametersRaw.data(), residuals.data(),
+                                                      NULL, NULL);
+      observation.chi2 = residuals.squaredNorm();
+      observation.evaluated = true;
+      ++numEvaluated[thread];
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t t = 1; t < numThreads; ++t) {
+    workers.push_back(std::thread(evaluate, t));
+  }
+  evaluate(0);
+  for (size_t t = 0; t < workers.size(); ++t) {
+    workers[t].join();
+  }
+  size_t totalEvaluated = 0;
+  for (size_t t = 0; t < numThreads; ++t) {
+    totalEvaluated += numEvaluated[t];
+  }
+  outlierCullingOffset_ = offset + totalEvaluated;
+
+  // count consecutive outliers. The robust loss is monotonic, so comparing the chi2 is
+  // the same as comparing the robustified cost. Observations not evaluated keep their count.
+  std::map<okvis::KeypointIdentifier, size_t> outlierCounts;
+  std::vector<size_t> outliers;
+  for (size_t i = 0; i < observations.size(); ++i) {
+    std::map<okvis::KeypointIdentifier, size_t>::const_iterator previous =
+        outlierCounts_.find(observations[i].keypointId);
+    const size_t count = previous == outlierCounts_.end() ? 0 : previous->second;
+    if (!observations[i].evaluated) {
+      if (count > 0) {
+        outlierCounts[observations[i].keypointId] = count;
+      }
+      continue;
+    }
+    if (observations[i].chi2 <= outlierChi2Threshold_) {
+      continue;
+    }
+    if (count + 1 >= outlierConsecutiveOptimizations_) {
+      outliers.push_back(i);
+    }
+    else {
+      outlierCounts[observations[i].keypointId] = count + 1;
+    }
+  }
+  outlierCounts_.swap(outlierCounts);
+
+  // remove them, as the frontend does with RANSAC outliers
+  auto removeAssociation = [&](uint64_t landmarkId, okvis::KeypointIdentifier kid) {
+    multiFramePtrMap_.at(kid.frameId)->setLandmarkId(kid.cameraIndex, kid.keypointIndex, 0);
+    removeObservation(landmarkId, kid.frameId, kid.cameraIndex, kid.keypointIndex);
+  };
+  std::set<uint64_t> affectedLandmarks;
+  for (size_t i = 0; i < outliers.size(); ++i) {
+    const Observation &observation = observations[outliers[i]];
+    removeAssociation(observation.landmarkId, observation.keypointId);
+    affectedLandmarks.insert(observation.landmarkId);
+  }
+  size_t numRemovedLandmarks = 0;
+  for (std::set<uint64_t>::const_iterator lit = affectedLandmarks.begin();
+       lit != affectedLandmarks.end(); ++lit) {
+    PointMap::iterator pit = landmarksMap_.find(*lit);
+    if (pit->second.observations.size() >= outlierMinObservations_) {
+      continue;
+    }
+    removedLandmarks.push_back(pit->second);
+    removeLandmark(*lit);
+    ++numRemovedLandmarks;
+  }
+
+  VLOG(1) << "culled " << outliers.size() << " of " << totalEvaluated
+          << " evaluated observations and " << numRemovedLandmarks << " landmarks";
+  return outliers.size();
+}
+
+// Remove the least useful landmarks in excess of the maximum number.
+size_t Estimator::pruneLandmarks(okvis::MapPointVector &removedLandmarks) {
+  if (maxLandmarks_ == 0 || landmarksMap_.size() <= maxLandmarks_) {
+    return 0;
+  }
+  const size_t numExcess = landmarksMap_.size() - maxLandmarks_;
+  const int gridCells = 8;  // per image axis
+
+  // the newest frame has age 0
+  std::map<uint64_t, size_t> frameAges;
+  for (std::map<uint64_t, States>::const_reverse_iterator it = statesMap_.rbegin();
+       it != statesMap_.rend(); ++it) {
+    const size_t age = frameAges.size();
+    frameAges[it->first] = age;
+  }
+
+  // the grid cell of the newest observation of every landmark, and how crowded it is
+  typedef std::tuple<uint64_t, size_t, int, int> Cell;  // frame, camera, column, row
+  std::vector<Cell> landmarkCells;
+  landmarkCells.reserve(landmarksMap_.size());
+  std::map<Cell, size_t> cellCounts;
+  double maxQuality = 0.0;
+  for (PointMap::const_iterator pit = landmarksMap_.begin(); pit != landmarksMap_.end();
+       ++pit) {
+    maxQuality = std::max(maxQuality, pit->second.quality);
+    Cell cell(0, 0, 0, 0);
+    if (!pit->second.observations.empty()) {
+      const okvis::KeypointIdentifier &kid = pit->second.observations.rbegin()->first;
+      const okvis::MultiFramePtr &multiFrame = multiFramePtrMap_.at(kid.frameId);
+      Eigen::Vector2d keypoint;
+      multiFrame->getKeypoint(kid.cameraIndex, kid.keypointIndex, keypoint);
+      const std::shared_ptr<const cameras::CameraBase> geometry =
+          multiFrame->geometry(kid.cameraIndex);
+      const int column = std::min(gridCells - 1, std::max(0, int(
+          keypoint[0] * gridCells / double(geometry->imageWidth()))));
+      const int row = std::min(gridCells - 1, std::max(0, int(
+          keypoint[1] * gridCells / double(geometry->imageHeight()))));
+      cell = Cell(kid.frameId, kid.cameraIndex, column, row);
+      cellCounts[cell]++;
+    }
+    landmarkCells.push_back(cell);
+  }
+
+  // keep the numExcess lowest utilities in a max-heap
+  std::priority_queue<std::pair<double, uint64_t> > leastUseful;
+  size_t i = 0;
+  for (PointMap::const_iterator pit = landmarksMap_.begin(); pit != landmarksMap_.end();
+       ++pit, ++i) {
+    double utility = 0.0;
+    if (!pit->second.observations.empty()) {
+      const double quality = maxQuality > 0.0 ? pit->second.quality / maxQuality : 1.0;
+      const size_t age = frameAges.at(std::get<0>(landmarkCells[i]));
+      utility = std::log2(1.0 + double(pit->second.observations.size()))
+          * (0.1 + quality) / (double(cellCounts.at(landmarkCells[i])) * double(1 + age));
+    }
+    if (leastUseful.size() < numExcess) {
+      leastUseful.push(std::make_pair(utility, pit->first));
+    }
+    else if (utility < leastUseful.top().first) {
+      leastUseful.pop();
+      leastUseful.push(std::make_pair(utility, pit->first));
+    }
+  }
+
+  const size_t numRemoved = leastUseful.size();
+  while (!leastUseful.empty()) {
+    const uint64_t landmarkId = leastUseful.top().second;
+    leastUseful.pop();
+    removedLandmarks.push_back(landmarksMap_.at(landmarkId));
+    removeLandmark(landmarkId);
+  }
+  VLOG(1) << "pruned " << numRemoved << " landmarks";
+  return numRemoved;
+}
+
+// Remove a landmark with all its observations.
+void Estimator::removeLandmark(uint64_t landmarkId) {
+  PointMap::iterator pit = landmarksMap_.find(landmarkId);
+  if (pit == landmarksMap_.end()) {
+    return;
+  }
+  while (!pit->second.observations.empty()) {
+    const okvis::KeypointIdentifier kid = pit->second.observations.begin()->first;
+    multiFramePtrMap_.at(kid.frameId)->setLandmarkId(kid.cameraIndex, kid.keypointIndex, 0);
+    removeObservation(landmarkId, kid.frameId, kid.cameraIndex, kid.keypointIndex);
+  }
+  mapPtr_->removeParameterBlock(landmarkId);
+  landmarksMap_.erase(pit);
+}
+
+// Hold the camera extrinsics constant once their estimates have converged.
+void Estimator::setExtrinsicsAutoFreeze(bool enable, double translationThreshold,
+                                        double rotationThreshold,
+                                        size_t numStableOptimizations) {
+  extrinsicsAutoFreeze_ = enable;
+  extrinsicsFreezeTranslation_ = translationThreshold;
+  extrinsicsFreezeRotation_ = rotationThreshold;
+  extrinsicsFreezeCount_ = numStableOptimizations;
+  if (!enable) {
+    for (size_t i = 0; i < extrinsicsConvergence_.size(); ++i) {
+      unfreezeExtrinsics(i);
+    }
+  }
+}
+
+// Re-enable the estimation of the extrinsics of a camera.
+void Estimator::unfreezeExtrinsics(size_t cameraIdx) {
+  if (cameraIdx >= extrinsicsConvergence_.size()) {
+    return;
+  }
+  ExtrinsicsConvergence &convergence = extrinsicsConvergence_[cameraIdx];
+  if (convergence.frozen && mapPtr_->parameterBlockExists(convergence.frozenId)) {
+    mapPtr_->setParameterBlockVariable(convergence.frozenId);
+  }
+  convergence = ExtrinsicsConvergence();
+}
+
+// Monitor the convergence of the extrinsics after an optimization and freeze them.
+void Estimator::updateExtrinsicsConvergence() {
+  if (!extrinsicsAutoFreeze_ || statesMap_.empty()) {
+    return;
+  }
+  const States &newestStates = statesMap_.rbegin()->second;
+  for (size_t i = 0; i < extrinsicsConvergence_.size()
+       && i < newestStates.sensors.at(SensorStates::Camera).size(); ++i) {
+    ExtrinsicsConvergence &convergence = extrinsicsConvergence_[i];
+    const uint64_t id = newestStates.sensors.at(SensorStates::Camera).at(i).at(
+        CameraSensorStates::T_SCi).id;
+    if (convergence.frozen || mapPtr_->parameterBlockPtr(id)->fixed()) {
+      continue;  // not estimated
+    }
+    const okvis::kinematics::Transformation T_SC =
+        std::static_pointer_cast<ceres::PoseParameterBlock>(mapPtr_->parameterBlockPtr(id))
+            ->estimate();
+    if (convergence.initialised) {
+      const double translationChange = (T_SC.r() - convergence.T_SC.r()).norm();
+      const double rotationChange =
+          2.0 * (T_SC.q() * convergence.T_SC.q().inverse()).vec().norm();
+      if (translationChange < extrinsicsFreezeTranslation_
+          && rotationChange < extrinsicsFreezeRotation_) {
+        convergence.numStable++;
+      }
+      else {
+        convergence.numStable = 0;
+      }
+    }
+    convergence.T_SC = T_SC;
+    convergence.initialised = true;
+
+    if (convergence.numStable >= extrinsicsFreezeCount_) {
+      mapPtr_->setParameterBlockConstant(id);
+      convergence.frozen = true;
+      convergence.frozenId = id;
+      LOG(INFO) << "extrinsics of camera " << i << " converged, holding them constant";
+    }
+  }
+}
+
 // Set a time limit for the optimization process.
 bool Estimator::setOptimizationTimeLimit(double timeLimit, int minIterations) {
   if (ceresCallback_ != nullptr) {
@@ -935,6 +1615,322 @@ bool Estimator::setOptimizationTimeLimit(double timeLimit, int minIterations) {
   return true;
 }
 
+/**
+ * @brief Evaluate the minimal Jacobians of a residual block at the current estimate.
+ *        They are weighted with the square root of the loss function derivative, such that
+ *        J^T*J is the (Gauss-Newton) contribution to the Hessian.
+ * @param[in]  residualBlockSpec The residual block.
+ * @param[in]  parameters Its parameter blocks.
+ * @param[out] jacobiansMinimal The weighted minimal Jacobians, one per parameter block.
+ * @param[out] weightedResiduals If not NULL, the residuals weighted the same way.
+ * @return The robustified cost of the residual block, 0.5*rho(r^T*r).
+ */
+static double evaluateWeightedMinimalJacobians(
+    const ceres::Map::ResidualBlockSpec &residualBlockSpec,
+    const ceres::Map::ParameterBlockCollection &parameters,
+    std::vector<Eigen::MatrixXd> &jacobiansMinimal,
+    Eigen::VectorXd *weightedResiduals = NULL) {
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrix;
+  const size_t residualDim = residualBlockSpec.errorInterfacePtr->residualDim();
+  std::vector<double *> parametersRaw(parameters.size());
+  std::vector<RowMajorMatrix> jacobiansEigen(parameters.size());
+  std::vector<RowMajorMatrix> jacobiansMinimalEigen(parameters.size());
+  std::vector<double *> jacobiansRaw(parameters.size());
+  std::vector<double *> jacobiansMinimalRaw(parameters.size());
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    parametersRaw[i] = parameters[i].second->parameters();
+    jacobiansEigen[i].resize(residualDim, parameters[i].second->dimension());
+    jacobiansRaw[i] = jacobiansEigen[i].data();
+    jacobiansMinimalEigen[i].resize(residualDim, parameters[i].second->minimalDimension());
+    jacobiansMinimalRaw[i] = jacobiansMinimalEigen[i].data();
+  }
+  Eigen::VectorXd residuals(residualDim);
+  residualBlockSpec.errorInterfacePtr->EvaluateWithMinimalJacobians(
+      parametersRaw.data(), residuals.data(), jacobiansRaw.data(),
+      jacobiansMinimalRaw.data());
+
+  double weight = 1.0;
+  double cost = 0.5 * residuals.squaredNorm();
+  if (residualBlockSpec.lossFunctionPtr) {
+    double rho[3];
+    residualBlockSpec.lossFunctionPtr->Evaluate(residuals.squaredNorm(), rho);
+    weight = sqrt(rho[1]);
+    cost = 0.5 * rho[0];
+  }
+  jacobiansMinimal.resize(parameters.size());
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    jacobiansMinimal[i] = weight * jacobiansMinimalEigen[i];
+  }
+  if (weightedResiduals) {
+    *weightedResiduals = weight * residuals;
+  }
+  return cost;
+}
+
+// Motion-only Gauss-Newton refinement of pose and speed/bias of a state.
+bool Estimator::refineState(uint64_t poseId, size_t maxIterations) {
+  std::lock_guard<std::mutex> l(statesMutex_);
+
+  std::map<uint64_t, States>::const_iterator stateIt = statesMap_.find(poseId);
+  if (stateIt == statesMap_.end()
+      || !stateIt->second.global[GlobalStates::T_WS].exists
+      || stateIt->second.sensors.at(SensorStates::Imu).empty()
+      || !stateIt->second.sensors.at(SensorStates::Imu).at(0).at(
+          ImuSensorStates::SpeedAndBias).exists) {
+    return false;
+  }
+  const uint64_t speedAndBiasId = stateIt->second.sensors.at(SensorStates::Imu).at(0).at(
+      ImuSensorStates::SpeedAndBias).id;
+  std::shared_ptr<ceres::ParameterBlock> poseBlock = mapPtr_->parameterBlockPtr(poseId);
+  std::shared_ptr<ceres::ParameterBlock> speedAndBiasBlock =
+      mapPtr_->parameterBlockPtr(speedAndBiasId);
+  if (poseBlock->fixed() || speedAndBiasBlock->fixed()) {
+    return false;
+  }
+
+  // all error terms of the state, i.e. observations and IMU terms. Landmarks, extrinsics
+  // and the neighbouring states are held fixed. Uninitialised landmarks are left out.
+  struct Term {
+    ceres::Map::ResidualBlockSpec residualBlockSpec;
+    ceres::Map::ParameterBlockCollection parameters;
+    int poseIdx;
+    int speedAndBiasIdx;
+  };
+  std::vector<Term> terms;
+  std::set<::ceres::ResidualBlockId> visited;
+  const uint64_t stateIds[2] = {poseId, speedAndBiasId};
+  for (size_t n = 0; n < 2; ++n) {
+    const ceres::Map::ResidualBlockCollection residuals = mapPtr_->residuals(stateIds[n]);
+    for (size_t r = 0; r < residuals.size(); ++r) {
+      if (!visited.insert(residuals[r].residualBlockId).second) {
+        continue;
+      }
+      Term term;
+      term.residualBlockSpec = residuals[r];
+      term.parameters = mapPtr_->parameters(residuals[r].residualBlockId);
+      term.poseIdx = -1;
+      term.speedAndBiasIdx = -1;
+      bool use = true;
+      for (size_t i = 0; i < term.parameters.size(); ++i) {
+        if (term.parameters[i].first == poseId) {
+          term.poseIdx = i;
+        } else if (term.parameters[i].first == speedAndBiasId) {
+          term.speedAndBiasIdx = i;
+        } else if (landmarksMap_.find(term.parameters[i].first) != landmarksMap_.end()) {
+          use = use && std::static_pointer_cast<okvis::ceres::HomogeneousPointParameterBlock>(
+              term.parameters[i].second)->initialized();
+        }
+      }
+      if (use) {
+        terms.push_back(term);
+      }
+    }
+  }
+
+  // Gauss-Newton system in [delta r_WS, delta alpha_WS, v_W, b_g, b_a]
+  typedef Eigen::Matrix<double, 15, 15> Hessian;
+  typedef Eigen::Matrix<double, 15, 1> Gradient;
+  std::vector<Eigen::MatrixXd> jacobians;
+  Eigen::VectorXd residuals;
+  auto linearize = [&](Hessian &H, Gradient &b) -> double {
+    H.setZero();
+    b.setZero();
+    double cost = 0.0;
+    for (size_t t = 0; t < terms.size(); ++t) {
+      cost += evaluateWeightedMinimalJacobians(terms[t].residualBlockSpec, terms[t].parameters,
+                                               jacobians, &residuals);
+      Eigen::Matrix<double, Eigen::Dynamic, 15> J =
+          Eigen::Matrix<double, Eigen::Dynamic, 15>::Zero(residuals.size(), 15);
+      if (terms[t].poseIdx >= 0) {
+        J.leftCols<6>() = jacobians[terms[t].poseIdx];
+      }
+      if (terms[t].speedAndBiasIdx >= 0) {
+        J.rightCols<9>() = jacobians[terms[t].speedAndBiasIdx];
+      }
+      H += J.transpose() * J;
+      b += J.transpose() * residuals;
+    }
+    return cost;
+  };
+
+  Hessian H;
+  Gradient b;
+  double cost = linearize(H, b);
+  for (size_t iteration = 0; iteration < maxIterations; ++iteration) {
+    const Gradient delta = H.ldlt().solve(-b);
+    if (!delta.allFinite()) {
+      break;
+    }
+    const Eigen::Matrix<double, 7, 1> pose0 = Eigen::Map<const Eigen::Matrix<double, 7, 1> >(
+        poseBlock->parameters());
+    const Eigen::Matrix<double, 9, 1> speedAndBias0 = Eigen::Map<const Eigen::Matrix<double, 9, 1> >(
+        speedAndBiasBlock->parameters());
+    Eigen::Matrix<double, 7, 1> pose;
+    Eigen::Matrix<double, 9, 1> speedAndBias;
+    poseBlock->plus(pose0.data(), delta.data(), pose.data());
+    speedAndBiasBlock->plus(speedAndBias0.data(), delta.data() + 6, speedAndBias.data());
+    poseBlock->setParameters(pose.data());
+    speedAndBiasBlock->setParameters(speedAndBias.data());
+
+    Hessian H_new;
+    Gradient b_new;
+    const double newCost = linearize(H_new, b_new);
+    if (newCost > cost) {
+      // no trust region here: just keep the last estimate
+      poseBlock->setParameters(pose0.data());
+      speedAndBiasBlock->setParameters(speedAndBias0.data());
+      break;
+    }
+    cost = newCost;
+    H = H_new;
+    b = b_new;
+    if (delta.norm() < 1.0e-9) {
+      break;
+    }
+  }
+  return true;
+}
+
+// Compute the marginal covariance of pose and speed/bias of a frame in the IMU window.
+bool Estimator::computeCovariance(uint64_t poseId,
+                                  Eigen::Matrix<double, 15, 15> &covariance,
+                                  double timeLimit) const {
+  std::lock_guard<std::mutex> l(statesMutex_);
+  const okvis::Time startTime = okvis::Time::now();
+
+  std::map<uint64_t, States>::const_iterator stateIt = statesMap_.find(poseId);
+  if (stateIt == statesMap_.end()
+      || !stateIt->second.global[GlobalStates::T_WS].exists
+      || stateIt->second.sensors.at(SensorStates::Imu).empty()
+      || !stateIt->second.sensors.at(SensorStates::Imu).at(0).at(
+          ImuSensorStates::SpeedAndBias).exists) {
+    return false;
+  }
+  const uint64_t speedAndBiasId = stateIt->second.sensors.at(SensorStates::Imu).at(0).at(
+      ImuSensorStates::SpeedAndBias).id;
+
+  // order all estimated parameter blocks except for landmarks
+  std::map<uint64_t, size_t> orderingIdx;
+  size_t dimension = 0;
+  for (auto it = mapPtr_->id2parameterBlockMap().begin();
+       it != mapPtr_->id2parameterBlockMap().end(); ++it) {
+    if (it->second->fixed() || landmarksMap_.find(it->first) != landmarksMap_.end()) {
+      continue;
+    }
+    orderingIdx[it->first] = dimension;
+    dimension += it->second->minimalDimension();
+  }
+  if (orderingIdx.find(poseId) == orderingIdx.end()
+      || orderingIdx.find(speedAndBiasId) == orderingIdx.end()) {
+    return false;
+  }
+
+  Eigen::MatrixXd H = Eigen::MatrixXd::Zero(dimension, dimension);
+  std::vector<Eigen::MatrixXd> jacobians;
+
+  // eliminate the landmarks one at a time: H -= W * U^-1 * W^T
+  for (PointMap::const_iterator pit = landmarksMap_.begin(); pit != landmarksMap_.end();
+       ++pit) {
+    if (timeLimit >= 0.0 && (okvis::Time::now() - startTime).toSec() > timeLimit) {
+      return false;
+    }
+    if (!mapPtr_->parameterBlockExists(pit->first)
+        || mapPtr_->parameterBlockPtr(pit->first)->fixed()) {
+      continue;
+    }
+    Eigen::Matrix3d U = Eigen::Matrix3d::Zero();
+    std::map<size_t, Eigen::MatrixXd> W;  // indexed by ordering index
+    const ceres::Map::ResidualBlockCollection residuals = mapPtr_->residuals(pit->first);
+    for (size_t r = 0; r < residuals.size(); ++r) {
+      const ceres::Map::ParameterBlockCollection parameters = mapPtr_->parameters(
+          residuals[r].residualBlockId);
+      evaluateWeightedMinimalJacobians(residuals[r], parameters, jacobians);
+      size_t landmarkIdx = 0;
+      for (size_t i = 0; i < parameters.size(); ++i) {
+        if (parameters[i].first == pit->first) {
+          landmarkIdx = i;
+        }
+      }
+      U += jacobians[landmarkIdx].transpose() * jacobians[landmarkIdx];
+      for (size_t i = 0; i < parameters.size(); ++i) {
+        std::map<uint64_t, size_t>::const_iterator it_i = orderingIdx.find(parameters[i].first);
+        if (i == landmarkIdx || it_i == orderingIdx.end()) {
+          continue;
+        }
+        const Eigen::MatrixXd W_i = jacobians[i].transpose() * jacobians[landmarkIdx];
+        if (W.find(it_i->second) == W.end()) {
+          W[it_i->second] = W_i;
+        } else {
+          W[it_i->second] += W_i;
+        }
+        for (size_t j = 0; j < parameters.size(); ++j) {
+          std::map<uint64_t, size_t>::const_iterator it_j = orderingIdx.find(parameters[j].first);
+          if (j == landmarkIdx || it_j == orderingIdx.end()) {
+            continue;
+          }
+          H.block(it_i->second, it_j->second, jacobians[i].cols(), jacobians[j].cols()) +=
+              jacobians[i].transpose() * jacobians[j];
+        }
+      }
+    }
+    Eigen::Matrix3d U_inv;
+    ceres::MarginalizationError::pseudoInverseSymm(U, U_inv);
+    for (auto it_a = W.begin(); it_a != W.end(); ++it_a) {
+      const Eigen::MatrixXd W_a_U_inv = it_a->second * U_inv;
+      for (auto it_b = W.begin(); it_b != W.end(); ++it_b) {
+        H.block(it_a->first, it_b->first, it_a->second.rows(), it_b->second.rows()) -=
+            W_a_U_inv * it_b->second.transpose();
+      }
+    }
+  }
+
+  // all remaining error terms, including the marginalization prior
+  for (auto rit = mapPtr_->residualBlockId2ResidualBlockSpecMap().begin();
+       rit != mapPtr_->residualBlockId2ResidualBlockSpecMap().end(); ++rit) {
+    const ceres::Map::ParameterBlockCollection parameters = mapPtr_->parameters(rit->first);
+    bool observesLandmark = false;
+    for (size_t i = 0; i < parameters.size(); ++i) {
+      if (landmarksMap_.find(parameters[i].first) != landmarksMap_.end()) {
+        observesLandmark = true;
+      }
+    }
+    if (observesLandmark) {
+      continue;  // already considered above
+    }
+    evaluateWeightedMinimalJacobians(rit->second, parameters, jacobians);
+    for (size_t i = 0; i < parameters.size(); ++i) {
+      std::map<uint64_t, size_t>::const_iterator it_i = orderingIdx.find(parameters[i].first);
+      if (it_i == orderingIdx.end()) {
+        continue;
+      }
+      for (size_t j = 0; j < parameters.size(); ++j) {
+        std::map<uint64_t, size_t>::const_iterator it_j = orderingIdx.find(parameters[j].first);
+        if (it_j == orderingIdx.end()) {
+          continue;
+        }
+        H.block(it_i->second, it_j->second, jacobians[i].cols(), jacobians[j].cols()) +=
+            jacobians[i].transpose() * jacobians[j];
+      }
+    }
+  }
+
+  // solve for the requested columns of the inverse only
+  const size_t poseIdx = orderingIdx.at(poseId);
+  const size_t speedAndBiasIdx = orderingIdx.at(speedAndBiasId);
+  Eigen::MatrixXd rhs = Eigen::MatrixXd::Zero(dimension, 15);
+  rhs.block<6, 6>(poseIdx, 0).setIdentity();
+  rhs.block<9, 9>(speedAndBiasIdx, 6).setIdentity();
+  Eigen::LDLT<Eigen::MatrixXd> ldlt(H);
+  if (ldlt.info() != Eigen::Success) {
+    return false;
+  }
+  const Eigen::MatrixXd columns = ldlt.solve(rhs);
+  covariance.topRows<6>() = columns.block<6, 15>(poseIdx, 0);
+  covariance.bottomRows<9>() = columns.block<9, 15>(speedAndBiasIdx, 0);
+  covariance = (0.5 * (covariance + covariance.transpose())).eval();
+  return covariance.allFinite();
+}
+
 // getters
 // Get a specific landmark.
 bool Estimator::getLandmark(uint64_t landmarkId,
@@ -975,6 +1971,24 @@ size_t Estimator::getLandmarks(MapPointVector &landmarks) const {
   return landmarksMap_.size();
 }
 
+// Get the positions of several landmarks, locking only once and without copying their
+// observations.
+size_t Estimator::getLandmarkPositions(
+    const std::vector<uint64_t> &landmarkIds,
+    std::vector<Eigen::Vector4d, Eigen::aligned_allocator<Eigen::Vector4d> > &points) const {
+  std::lock_guard<std::mutex> l(statesMutex_);
+  points.assign(landmarkIds.size(), Eigen::Vector4d::Zero());
+  size_t numFound = 0;
+  for (size_t i = 0; i < landmarkIds.size(); ++i) {
+    PointMap::const_iterator it = landmarksMap_.find(landmarkIds[i]);
+    if (it == landmarksMap_.end())
+      continue;
+    points[i] = it->second.point;
+    ++numFound;
+  }
+  return numFound;
+}
+
 // Get pose for a given pose ID.
 bool Estimator::get_T_WS(uint64_t poseId,
                          okvis::kinematics::Transformation &T_WS) const {
@@ -1007,6 +2021,21 @@ bool Estimator::getCameraSensorStates(
       poseId, cameraIdx, SensorStates::Camera, CameraSensorStates::T_SCi, T_SCi);
 }
 
+// Get the current frame pose uncertainty.
+bool Estimator::getPoseUncertainty(Eigen::Matrix<double, 6, 6> &P_T_WS) const {
+  Eigen::Matrix<double, 15, 15> P;
+  if (!computeCovariance(currentFrameId(), P)) {
+    return false;
+  }
+  P_T_WS = P.topLeftCorner<6, 6>();
+  return true;
+}
+
+// Get the current frame state uncertainty.
+bool Estimator::getStateUncertainty(Eigen::Matrix<double, 15, 15> &P) const {
+  return computeCovariance(currentFrameId(), P);
+}
+
 // Get the ID of the current keyframe.
 uint64_t Estimator::currentKeyframeId() const {
   for (std::map<uint64_t, States>::const_reverse_iterator rit = statesMap_.rbegin();
@@ -1044,6 +2073,109 @@ bool Estimator::isInImuWindow(uint64_t frameId) const {
   return statesMap_.at(frameId).sensors.at(SensorStates::Imu).at(0).at(ImuSensorStates::SpeedAndBias).exists;
 }
 
+// Get the number of landmarks observed in two frames.
+size_t Estimator::numCovisibleLandmarks(uint64_t frameIdA, uint64_t frameIdB) const {
+  std::map<uint64_t, std::map<uint64_t, size_t> >::const_iterator it = covisibilities_.find(
+      frameIdA);
+  if (it == covisibilities_.end()) {
+    return 0;
+  }
+  std::map<uint64_t, size_t>::const_iterator jt = it->second.find(frameIdB);
+  return jt == it->second.end() ? 0 : jt->second;
+}
+
+// Get the frames sharing landmarks with a frame.
+size_t Estimator::getCovisibleFrames(uint64_t frameId,
+                                     std::map<uint64_t, size_t> &covisibleFrames) const {
+  covisibleFrames.clear();
+  std::map<uint64_t, std::map<uint64_t, size_t> >::const_iterator it = covisibilities_.find(
+      frameId);
+  if (it != covisibilities_.end()) {
+    covisibleFrames = it->second;
+    covisibleFrames.erase(frameId);
+  }
+  return covisibleFrames.size();
+}
+
+// Update the covisibility graph for an observation of a landmark in a frame.
+void Estimator::updateCovisibilities(const MapPoint &mapPoint, uint64_t poseId, bool added) {
+  // only the first observation (e.g. in one of several cameras) of a frame counts
+  std::map<okvis::KeypointIdentifier, uint64_t>::const_iterator it = mapPoint.observations
+      .lower_bound(okvis::KeypointIdentifier(poseId, 0, 0));
+  if (it != mapPoint.observations.end() && it->first.frameId == poseId) {
+    return;
+  }
+  // observations are sorted by frame ID
+  uint64_t lastFrameId = 0;
+  for (it = mapPoint.observations.begin(); it != mapPoint.observations.end(); ++it) {
+    const uint64_t frameId = it->first.frameId;
+    if (frameId == lastFrameId) {
+      continue;
+    }
+    lastFrameId = frameId;
+    if (added) {
+      covisibilities_[poseId][frameId]++;
+      covisibilities_[frameId][poseId]++;
+    } else {
+      decrementCovisibility(poseId, frameId);
+      decrementCovisibility(frameId, poseId);
+    }
+  }
+  // diagonal
+  if (added) {
+    covisibilities_[poseId][poseId]++;
+  } else {
+    decrementCovisibility(poseId, poseId);
+  }
+}
+
+// Decrement one entry of the covisibility graph, dropping zero entries.
+void Estimator::decrementCovisibility(uint64_t frameIdA, uint64_t frameIdB) {
+  std::map<uint64_t, std::map<uint64_t, size_t> >::iterator it = covisibilities_.find(frameIdA);
+  if (it == covisibilities_.end()) {
+    return;  // e.g. frameIdA was removed already
+  }
+  std::map<uint64_t, size_t>::iterator jt = it->second.find(frameIdB);
+  if (jt != it->second.end() && --jt->second == 0) {
+    it->second.erase(jt);
+  }
+  if (it->second.empty()) {
+    covisibilities_.erase(it);
+  }
+}
+
+// Remove all observations of a landmark from the covisibility graph.
+void Estimator::removeCovisibilities(const MapPoint &mapPoint) {
+  MapPoint remaining = mapPoint;
+  while (!remaining.observations.empty()) {
+    const uint64_t poseId = remaining.observations.begin()->first.frameId;
+    remaining.observations.erase(
+        remaining.observations.begin(),
+        remaining.observations.lower_bound(okvis::KeypointIdentifier(poseId + 1, 0, 0)));
+    updateCovisibilities(remaining, poseId, false);
+  }
+}
+
+// Remove a frame from the covisibility graph.
+void Estimator::removeCovisibilities(uint64_t poseId) {
+  std::map<uint64_t, std::map<uint64_t, size_t> >::iterator it = covisibilities_.find(poseId);
+  if (it == covisibilities_.end()) {
+    return;
+  }
+  const std::map<uint64_t, size_t> row = it->second;
+  covisibilities_.erase(it);
+  for (std::map<uint64_t, size_t>::const_iterator jt = row.begin(); jt != row.end(); ++jt) {
+    std::map<uint64_t, std::map<uint64_t, size_t> >::iterator kt = covisibilities_.find(
+        jt->first);
+    if (kt != covisibilities_.end()) {
+      kt->second.erase(poseId);
+      if (kt->second.empty()) {
+        covisibilities_.erase(kt);
+      }
+    }
+  }
+}
+
 // Set pose for a given pose ID.
 bool Estimator::set_T_WS(uint64_t poseId,
                          const okvis::kinematics::Transformation &T_WS) {
@@ -1082,11 +2214,24 @@ bool Estimator::setLandmark(
     OKVIS_THROW_DBG(Exception, "wrong pointer type requested.")
     return false;
   }
-  derivedParameterBlockPtr->setEstimate(landmark);;
-#else
-  std::static_pointer_cast<ceres::HomogeneousPointParameterBlock>(
-      parameterBlockPtr)->setEstimate(landmark);
 #endif
+  std::shared_ptr<ceres::InverseDepthParameterBlock> inverseDepthParameterBlockPtr =
+      std::dynamic_pointer_cast<ceres::InverseDepthParameterBlock>(parameterBlockPtr);
+  if (inverseDepthParameterBlockPtr && inverseDepthParameterBlockPtr->anchored()) {
+    // express in the anchor camera
+    okvis::kinematics::Transformation T_WSa = std::static_pointer_cast<
+        ceres::PoseParameterBlock>(mapPtr_->parameterBlockPtr(
+            inverseDepthParameterBlockPtr->anchorPoseId()))->estimate();
+    okvis::kinematics::Transformation T_SCa = std::static_pointer_cast<
+        ceres::PoseParameterBlock>(mapPtr_->parameterBlockPtr(
+            inverseDepthParameterBlockPtr->anchorExtrinsicsId()))->estimate();
+    inverseDepthParameterBlockPtr->setEstimate(ceres::InverseDepthParameterBlock::normalize(
+        (T_WSa * T_SCa).inverse().T() * landmark));
+  }
+  else {
+    std::static_pointer_cast<ceres::HomogeneousPointParameterBlock>(
+        parameterBlockPtr)->setEstimate(landmark);
+  }
 
   // also update in map
   landmarksMap_.at(landmarkId).point = landmark;
@@ -0,0 +1,75 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file InverseDepthParameterBlock.cpp
+ * @brief Source file for the InverseDepthParameterBlock class.
+ */
+
+#include <okvis/ceres/InverseDepthParameterBlock.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+/// \brief ceres Namespace for ceres-related functionality implemented in okvis.
+namespace ceres {
+
+// Default constructor (assumes not fixed, not anchored).
+InverseDepthParameterBlock::InverseDepthParameterBlock()
+    : HomogeneousPointParameterBlock(),
+      anchorPoseId_(0),
+      anchorCameraIdx_(0),
+      anchorExtrinsicsId_(0) {
+}
+
+// Constructor with estimate.
+InverseDepthParameterBlock::InverseDepthParameterBlock(
+    const Eigen::Vector4d &point, uint64_t id, bool initialized)
+    : HomogeneousPointParameterBlock(point, id, initialized),
+      anchorPoseId_(0),
+      anchorCameraIdx_(0),
+      anchorExtrinsicsId_(0) {
+}
+
+// Trivial destructor.
+InverseDepthParameterBlock::~InverseDepthParameterBlock() {
+}
+
+// Normalise to unit bearing and non-negative inverse depth.
+Eigen::Vector4d InverseDepthParameterBlock::normalize(const Eigen::Vector4d &hp_Ca) {
+  const double norm = hp_Ca.head<3>().norm();
+  if (norm < 1.0e-12) {
+    return hp_Ca;
+  }
+  return (hp_Ca[3] < 0.0 ? -1.0 : 1.0) * hp_Ca / norm;
+}
+
+}  // namespace ceres
+}  // namespace okvis
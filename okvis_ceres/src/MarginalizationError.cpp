@@ -36,8 +36,12 @@
  * @author Stefan Leutenegger
  */
 
+#include <cmath>
 #include <functional>
 
+#include <Eigen/Cholesky>
+#include <Eigen/Eigenvalues>
+
 #include <okvis/ceres/MarginalizationError.hpp>
 #include <okvis/ceres/LocalParamizationAdditionalInterfaces.hpp>
 #include <okvis/assert_macros.hpp>
@@ -757,10 +761,9 @@ bool MarginalizationError::marginalizeOut(
     b0_ = p_a.asDiagonal() * b0_;
   }
 
-  // also adapt the ceres-internal size information
-  base_t::set_num_residuals(
-      base_t::num_residuals() - marginalizationParametersDense
-      - marginalizationParametersLandmarks);
+  // also adapt the ceres-internal size information. Not relative to the current one, which is
+  // the rank after an eigendecomposition: updateErrorComputation() sets the final size
+  base_t::set_num_residuals(H_.cols());
 
   /* delete all the book-keeping */
   for (size_t i = 0; i < parameterBlockIdsCopy.size(); ++i) {
@@ -819,43 +822,170 @@ bool MarginalizationError::marginalizeOut(
   return true;
 }
 
+// Condition on a set of parameter blocks at their current estimates and remove them.
+bool MarginalizationError::conditionOn(const std::vector<uint64_t> &parameterBlockIds) {
+  // split into kept (a) and conditioned (c) columns
+  std::vector<bool> conditioned(parameterBlockInfos_.size(), false);
+  bool connected = false;
+  for (size_t i = 0; i < parameterBlockIds.size(); ++i) {
+    std::map<uint64_t, size_t>::const_iterator it =
+        parameterBlockId2parameterBlockInfoIdx_.find(parameterBlockIds[i]);
+    if (it != parameterBlockId2parameterBlockInfoIdx_.end()) {
+      conditioned[it->second] = true;
+      connected = true;
+    }
+  }
+  if (!connected) {
+    return false;
+  }
+  std::vector<int> keptColumns;
+  std::vector<int> conditionedColumns;
+  Eigen::VectorXd Delta_Chi_c;
+  for (size_t i = 0; i < parameterBlockInfos_.size(); ++i) {
+    const ParameterBlockInfo &info = parameterBlockInfos_[i];
+    for (size_t d = 0; d < info.minimalDimension; ++d) {
+      (conditioned[i] ? conditionedColumns : keptColumns).push_back(int(info.orderingIdx + d));
+    }
+    if (conditioned[i] && info.minimalDimension > 0) {
+      // deviation of the current estimate from the linearization point, also if held constant
+      Eigen::VectorXd Delta_Chi_i(info.minimalDimension);
+      info.parameterBlockPtr->minus(info.linearizationPoint.get(),
+                                    info.parameterBlockPtr->parameters(), Delta_Chi_i.data());
+      Delta_Chi_c.conservativeResize(Delta_Chi_c.rows() + Delta_Chi_i.rows());
+      Delta_Chi_c.tail(Delta_Chi_i.rows()) = Delta_Chi_i;
+    }
+  }
+
+  // b_a := b_a - H_ac * Delta_Chi_c, H := H_aa
+  Eigen::MatrixXd H_aa(keptColumns.size(), keptColumns.size());
+  Eigen::MatrixXd H_ac(keptColumns.size(), conditionedColumns.size());
+  Eigen::VectorXd b_a(keptColumns.size());
+  for (size_t r = 0; r < keptColumns.size(); ++r) {
+    for (size_t c = 0; c < keptColumns.size(); ++c) {
+      H_aa(r, c) = H_(keptColumns[r], keptColumns[c]);
+    }
+    for (size_t c = 0; c < conditionedColumns.size(); ++c) {
+      H_ac(r, c) = H_(keptColumns[r], conditionedColumns[c]);
+    }
+    b_a[r] = b0_[keptColumns[r]];
+  }
+  if (conditionedColumns.size() > 0) {
+    b_a -= H_ac * Delta_Chi_c;
+  }
+  H_ = H_aa;
+  b0_ = b_a;
+  errorComputationValid_ = false;
+
+  // also adapt the ceres-internal size information
+  base_t::set_num_residuals(H_.cols());
+
+  // delete the book-keeping
+  std::vector<ParameterBlockInfo> parameterBlockInfos;
+  parameterBlockId2parameterBlockInfoIdx_.clear();
+  base_t::mutable_parameter_block_sizes()->clear();
+  size_t orderingIdx = 0;
+  for (size_t i = 0; i < parameterBlockInfos_.size(); ++i) {
+    if (conditioned[i]) {
+      continue;
+    }
+    ParameterBlockInfo info = parameterBlockInfos_[i];
+    info.orderingIdx = orderingIdx;
+    orderingIdx += info.minimalDimension;
+    parameterBlockId2parameterBlockInfoIdx_[info.parameterBlockId] = parameterBlockInfos.size();
+    parameterBlockInfos.push_back(info);
+    base_t::mutable_parameter_block_sizes()->push_back(info.dimension);
+  }
+  parameterBlockInfos_ = parameterBlockInfos;
+  denseIndices_ = parameterBlockInfos_.size();
+  for (size_t i = 0; i < parameterBlockInfos_.size(); ++i) {
+    parameterBlockInfos_[i].isLandmark = false;
+  }
+
+  check();
+
+  return true;
+}
+
 // This must be called before optimization after adding residual blocks and/or marginalizing,
 // since it performs all the lhs and rhs computations on from a given _H and _b.
 void MarginalizationError::updateErrorComputation() {
   if (errorComputationValid_)
     return;  // already done.
 
-  // now we also know the error dimension:
-  base_t::set_num_residuals(H_.cols());
-
   // preconditioner
   Eigen::VectorXd p = (H_.diagonal().array() > 1.0e-9).select(H_.diagonal().cwiseSqrt(), 1.0e-3);
   Eigen::VectorXd p_inv = p.cwiseInverse();
-
-  // lhs SVD: _H = J^T*J = _U*S*_U^T
-  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> saes(
-      0.5 * p_inv.asDiagonal() * (H_ + H_.transpose()) * p_inv.asDiagonal());
+  const Eigen::MatrixXd H_p =
+      0.5 * p_inv.asDiagonal() * (H_ + H_.transpose()) * p_inv.asDiagonal();
 
   static const double epsilon = std::numeric_limits<double>::epsilon();
-  double tolerance = epsilon * H_.cols()
-                     * saes.eigenvalues().array().maxCoeff();
-  S_ = Eigen::VectorXd(
-      (saes.eigenvalues().array() > tolerance).select(
-          saes.eigenvalues().array(), 0));
-  S_pinv_ = Eigen::VectorXd(
-      (saes.eigenvalues().array() > tolerance).select(
-          saes.eigenvalues().array().inverse(), 0));
-
-  S_sqrt_ = S_.cwiseSqrt();
-  S_pinv_sqrt_ = S_pinv_.cwiseSqrt();
-
-  // assign Jacobian
-  J_ = (p.asDiagonal() * saes.eigenvectors() * (S_sqrt_.asDiagonal())).transpose();
-
-  // constant error (residual) _e0 := (-pinv(J^T) * _b):
-  Eigen::MatrixXd J_pinv_T = (S_pinv_sqrt_.asDiagonal())
-                             * saes.eigenvectors().transpose() * p_inv.asDiagonal();
-  e0_ = (-J_pinv_T * b0_);
+  bool factorized = false;
+  if (factorization_ == Factorization::Cholesky && H_.cols() > 0) {
+    // lhs LDLT: H_p = P^T*L*D*L^T*P, accepted if well conditioned
+    Eigen::LDLT<Eigen::MatrixXd> ldlt(H_p);
+    const Eigen::VectorXd D = ldlt.vectorD();
+    if (ldlt.info() == Eigen::Success
+        && D.minCoeff() > std::sqrt(epsilon) * D.maxCoeff()) {
+      const Eigen::VectorXd D_sqrt = D.cwiseSqrt();
+
+      // assign Jacobian: J = sqrt(D)*L^T*P*diag(p)
+      const Eigen::PermutationMatrix<Eigen::Dynamic> P(ldlt.transpositionsP());
+      J_ = D_sqrt.asDiagonal() * Eigen::MatrixXd(ldlt.matrixU()) * P * p.asDiagonal();
+
+      // constant error (residual) _e0 := (-inv(J^T) * _b) by forward substitution
+      const Eigen::VectorXd Pb = ldlt.transpositionsP() * p_inv.cwiseProduct(b0_);
+      const Eigen::VectorXd LinvPb = ldlt.matrixL().solve(Pb);
+      e0_ = -LinvPb.cwiseQuotient(D_sqrt);
+      lastFactorization_ = Factorization::Cholesky;
+      factorized = true;
+    }
+  }
+
+  if (!factorized) {
+    // lhs SVD: _H = J^T*J = _U*S*_U^T
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> saes(H_p);
+
+    double tolerance = epsilon * H_.cols()
+                       * saes.eigenvalues().array().maxCoeff();
+    S_ = Eigen::VectorXd(
+        (saes.eigenvalues().array() > tolerance).select(
+            saes.eigenvalues().array(), 0));
+    S_pinv_ = Eigen::VectorXd(
+        (saes.eigenvalues().array() > tolerance).select(
+            saes.eigenvalues().array().inverse(), 0));
+
+    S_sqrt_ = S_.cwiseSqrt();
+    S_pinv_sqrt_ = S_pinv_.cwiseSqrt();
+
+    // assign Jacobian. The eigenvalues are sorted increasingly, so only the last rank rows are nonzero.
+    const int rank = int((saes.eigenvalues().array() > tolerance).count());
+    const Eigen::MatrixXd J = (p.asDiagonal() * saes.eigenvectors() * (S_sqrt_.asDiagonal())).transpose();
+    J_ = J.bottomRows(rank);
+
+    // constant error (residual) _e0 := (-pinv(J^T) * _b):
+    Eigen::MatrixXd J_pinv_T = (S_pinv_sqrt_.asDiagonal())
+                               * saes.eigenvectors().transpose() * p_inv.asDiagonal();
+    const Eigen::VectorXd e0 = -J_pinv_T * b0_;
+    e0_ = e0.bottomRows(rank);
+    lastFactorization_ = Factorization::Eigendecomposition;
+  }
+
+  // now we also know the error dimension:
+  base_t::set_num_residuals(J_.rows());
+
+  // the lifting happens at the linearization point, hence once here
+  liftedJacobians_.resize(parameterBlockInfos_.size());
+  for (size_t i = 0; i < parameterBlockInfos_.size(); ++i) {
+    const ParameterBlockInfo &info = parameterBlockInfos_[i];
+    if (info.minimalDimension == 0) {
+      liftedJacobians_[i].setZero(J_.rows(), info.dimension);  // fixed
+      continue;
+    }
+    Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> J_lift(
+        info.minimalDimension, info.dimension);
+    info.parameterBlockPtr->liftJacobian(info.linearizationPoint.get(), J_lift.data());
+    liftedJacobians_[i] = J_.middleCols(info.orderingIdx, info.minimalDimension) * J_lift;
+  }
 
   // reconstruct. TODO: check if this really improves quality --- doesn't seem so...
   //H_ = J_.transpose() * J_;
@@ -863,12 +993,161 @@ void MarginalizationError::updateErrorComputation() {
   errorComputationValid_ = true;
 }
 
+// Sparsify the prior by nonlinear factor recovery on a chain of groups.
+bool MarginalizationError::sparsify(
+    const std::vector<std::vector<uint64_t> > &groups, double maxKullbackLeibler,
+    std::vector<std::shared_ptr<MarginalizationError> > &factors, double *kullbackLeibler) {
+  factors.clear();
+
+  // book-keeping indices of the groups, the remaining blocks are shared
+  std::vector<bool> grouped(parameterBlockInfos_.size(), false);
+  std::vector<std::vector<size_t> > chain;
+  for (size_t g = 0; g < groups.size(); ++g) {
+    std::vector<size_t> group;
+    for (size_t j = 0; j < groups[g].size(); ++j) {
+      std::map<uint64_t, size_t>::const_iterator it =
+          parameterBlockId2parameterBlockInfoIdx_.find(groups[g][j]);
+      if (it == parameterBlockId2parameterBlockInfoIdx_.end() || grouped[it->second]
+          || parameterBlockInfos_[it->second].minimalDimension == 0) {
+        continue;
+      }
+      grouped[it->second] = true;
+      group.push_back(it->second);
+    }
+    if (!group.empty()) {
+      chain.push_back(group);
+    }
+  }
+  if (chain.size() < 3) {
+    return false;  // already as sparse as the chain
+  }
+  std::vector<size_t> shared;
+  for (size_t i = 0; i < parameterBlockInfos_.size(); ++i) {
+    if (!grouped[i] && parameterBlockInfos_[i].minimalDimension > 0) {
+      shared.push_back(i);
+    }
+  }
+
+  // covariance and mean (w.r.t. the linearization point) of the prior
+  static const double epsilon = std::numeric_limits<double>::epsilon();
+  const Eigen::VectorXd p =
+      (H_.diagonal().array() > 1.0e-9).select(H_.diagonal().cwiseSqrt(), 1.0e-3);
+  const Eigen::VectorXd p_inv = p.cwiseInverse();
+  const Eigen::MatrixXd H_p =
+      0.5 * p_inv.asDiagonal() * (H_ + H_.transpose()) * p_inv.asDiagonal();
+  Eigen::LDLT<Eigen::MatrixXd> ldlt(H_p);
+  const Eigen::VectorXd D = ldlt.vectorD();
+  if (ldlt.info() != Eigen::Success || D.minCoeff() <= std::sqrt(epsilon) * D.maxCoeff()) {
+    return false;  // no covariance
+  }
+  const Eigen::MatrixXd Sigma = p_inv.asDiagonal()
+      * ldlt.solve(Eigen::MatrixXd::Identity(H_.rows(), H_.cols())) * p_inv.asDiagonal();
+  const Eigen::VectorXd mu = p_inv.cwiseProduct(ldlt.solve(p_inv.cwiseProduct(b0_)));
+
+  // columns of a set of parameter blocks
+  auto columnsOf = [this](const std::vector<size_t> &infoIndices) -> std::vector<int> {
+    std::vector<int> columns;
+    for (size_t j = 0; j < infoIndices.size(); ++j) {
+      const ParameterBlockInfo &info = parameterBlockInfos_[infoIndices[j]];
+      for (size_t d = 0; d < info.minimalDimension; ++d) {
+        columns.push_back(int(info.orderingIdx + d));
+      }
+    }
+    return columns;
+  };
+  // information of the marginal over some columns
+  auto marginalInformation = [&Sigma](const std::vector<int> &columns) -> Eigen::MatrixXd {
+    Eigen::MatrixXd Sigma_m(columns.size(), columns.size());
+    for (size_t r = 0; r < columns.size(); ++r) {
+      for (size_t c = 0; c < columns.size(); ++c) {
+        Sigma_m(r, c) = Sigma(columns[r], columns[c]);
+      }
+    }
+    return Sigma_m.ldlt().solve(Eigen::MatrixXd::Identity(columns.size(), columns.size()));
+  };
+
+  // clique k = {shared, group k, group k+1} contributes p(clique k) / p(shared, group k),
+  // i.e. the conditional of group k+1, except for the first one
+  Eigen::MatrixXd H_sparse = Eigen::MatrixXd::Zero(H_.rows(), H_.cols());
+  std::vector<std::vector<size_t> > cliques;
+  std::vector<Eigen::MatrixXd> cliqueInformations;
+  for (size_t k = 0; k + 1 < chain.size(); ++k) {
+    std::vector<size_t> separator = shared;
+    separator.insert(separator.end(), chain[k].begin(), chain[k].end());
+    std::vector<size_t> clique = separator;
+    clique.insert(clique.end(), chain[k + 1].begin(), chain[k + 1].end());
+    const std::vector<int> columns = columnsOf(clique);
+    Eigen::MatrixXd information = marginalInformation(columns);
+    if (k > 0) {
+      const std::vector<int> separatorColumns = columnsOf(separator);
+      information.topLeftCorner(separatorColumns.size(), separatorColumns.size()) -=
+          marginalInformation(separatorColumns);
+    }
+    for (size_t r = 0; r < columns.size(); ++r) {
+      for (size_t c = 0; c < columns.size(); ++c) {
+        H_sparse(columns[r], columns[c]) += information(r, c);
+      }
+    }
+    cliques.push_back(clique);
+    cliqueInformations.push_back(information);
+  }
+
+  // KL(dense||sparse) = 0.5*(log det H - log det H_sparse), since the clique marginals match
+  Eigen::LDLT<Eigen::MatrixXd> ldltSparse(
+      p_inv.asDiagonal() * H_sparse * p_inv.asDiagonal());
+  const Eigen::VectorXd D_sparse = ldltSparse.vectorD();
+  if (ldltSparse.info() != Eigen::Success || D_sparse.minCoeff() <= 0.0) {
+    return false;
+  }
+  const double divergence =
+      0.5 * (D.array().log().sum() - D_sparse.array().log().sum());
+  if (kullbackLeibler) {
+    *kullbackLeibler = divergence;
+  }
+  if (divergence > maxKullbackLeibler) {
+    return false;
+  }
+
+  // one error term per clique, sharing the linearization points
+  for (size_t k = 0; k < cliques.size(); ++k) {
+    std::shared_ptr<MarginalizationError> factor(new MarginalizationError(*mapPtr_));
+    const std::vector<int> columns = columnsOf(cliques[k]);
+    size_t orderingIdx = 0;
+    for (size_t j = 0; j < cliques[k].size(); ++j) {
+      ParameterBlockInfo info = parameterBlockInfos_[cliques[k][j]];
+      info.orderingIdx = orderingIdx;
+      orderingIdx += info.minimalDimension;
+      factor->parameterBlockId2parameterBlockInfoIdx_[info.parameterBlockId] =
+          factor->parameterBlockInfos_.size();
+      factor->parameterBlockInfos_.push_back(info);
+      factor->mutable_parameter_block_sizes()->push_back(info.dimension);
+    }
+    factor->denseIndices_ = factor->parameterBlockInfos_.size();
+    factor->H_ = cliqueInformations[k];
+    Eigen::VectorXd mu_k(columns.size());
+    for (size_t r = 0; r < columns.size(); ++r) {
+      mu_k[r] = mu[columns[r]];
+    }
+    factor->b0_ = factor->H_ * mu_k;
+    factor->factorization_ = factorization_;
+    factor->updateErrorComputation();
+    factors.push_back(factor);
+  }
+
+  // this keeps accumulating on the sparsified prior
+  H_ = H_sparse;
+  b0_ = H_sparse * mu;
+  errorComputationValid_ = false;
+  updateErrorComputation();
+  return true;
+}
+
 // Computes the linearized deviation from the references (linearization points)
 bool MarginalizationError::computeDeltaChi(Eigen::VectorXd &DeltaChi) const {
-  DeltaChi.resize(H_.rows());
+  DeltaChi.setZero(H_.rows());
   for (size_t i = 0; i < parameterBlockInfos_.size(); ++i) {
-    // stack Delta_Chi vector
-    if (!parameterBlockInfos_[i].parameterBlockPtr->fixed()) {
+    // stack Delta_Chi vector, also of blocks held constant since the marginalization
+    if (parameterBlockInfos_[i].minimalDimension > 0) {
       Eigen::VectorXd Delta_Chi_i(parameterBlockInfos_[i].minimalDimension);
       parameterBlockInfos_[i].parameterBlockPtr->minus(
           parameterBlockInfos_[i].linearizationPoint.get(),
@@ -884,10 +1163,10 @@ bool MarginalizationError::computeDeltaChi(Eigen::VectorXd &DeltaChi) const {
 // Computes the linearized deviation from the references (linearization points)
 bool MarginalizationError::computeDeltaChi(double const *const *parameters,
                                            Eigen::VectorXd &DeltaChi) const {
-  DeltaChi.resize(H_.rows());
+  DeltaChi.setZero(H_.rows());
   for (size_t i = 0; i < parameterBlockInfos_.size(); ++i) {
-    // stack Delta_Chi vector
-    if (!parameterBlockInfos_[i].parameterBlockPtr->fixed()) {
+    // stack Delta_Chi vector, also of blocks held constant since the marginalization
+    if (parameterBlockInfos_[i].minimalDimension > 0) {
       Eigen::VectorXd Delta_Chi_i(parameterBlockInfos_[i].minimalDimension);
       parameterBlockInfos_[i].parameterBlockPtr->minus(
           parameterBlockInfos_[i].linearizationPoint.get(), parameters[i],
@@ -916,10 +1195,24 @@ bool MarginalizationError::EvaluateWithMinimalJacobians(
       errorComputationValid_,
       "trying to opmimize, but updateErrorComputation() was not called after adding residual blocks/marginalizing");
 
-  Eigen::VectorXd Delta_Chi;
-  computeDeltaChi(parameters, Delta_Chi);
+  // the error (residual) e = (-pinv(J^T) * _b + _J*Delta_Chi), accumulated per moved block
+  Eigen::Map<Eigen::VectorXd> e(residuals, e0_.rows());
+  e = e0_;
 
   for (size_t i = 0; i < parameterBlockInfos_.size(); ++i) {
+    const ParameterBlockInfo &info = parameterBlockInfos_[i];
+    if (info.minimalDimension == 0) {
+      continue;  // fixed when marginalized: not part of the prior
+    }
+
+    // a block held constant now (e.g. by optimizeLocal) may still have moved since the
+    // marginalization, so its deviation counts all the same
+    Eigen::VectorXd Delta_Chi_i(info.minimalDimension);
+    info.parameterBlockPtr->minus(info.linearizationPoint.get(), parameters[i],
+                                  Delta_Chi_i.data());
+    if (!Delta_Chi_i.isZero(0.0)) {
+      e.noalias() += J_.middleCols(info.orderingIdx, info.minimalDimension) * Delta_Chi_i;
+    }
 
     // decompose the jacobians: minimal ones are easy
     if (jacobiansMinimal != NULL) {
@@ -927,39 +1220,22 @@ bool MarginalizationError::EvaluateWithMinimalJacobians(
         Eigen::Map<
             Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
                 Eigen::RowMajor> > Jmin_i(
-            jacobiansMinimal[i], e0_.rows(),
-            parameterBlockInfos_[i].minimalDimension);
-        Jmin_i = J_.block(0, parameterBlockInfos_[i].orderingIdx, e0_.rows(),
-                          parameterBlockInfos_[i].minimalDimension);
+            jacobiansMinimal[i], e0_.rows(), info.minimalDimension);
+        Jmin_i = J_.middleCols(info.orderingIdx, info.minimalDimension);
       }
     }
 
-    // hallucinate the non-minimal Jacobians
+    // the non-minimal Jacobians were lifted in updateErrorComputation()
     if (jacobians != NULL) {
       if (jacobians[i] != NULL) {
         Eigen::Map<
             Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
-                Eigen::RowMajor> > J_i(jacobians[i], e0_.rows(),
-                                       parameterBlockInfos_[i].dimension);
-        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Jmin_i =
-            J_.block(0, parameterBlockInfos_[i].orderingIdx, e0_.rows(),
-                     parameterBlockInfos_[i].minimalDimension);
-
-        Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> J_lift(
-            parameterBlockInfos_[i].parameterBlockPtr->minimalDimension(),
-            parameterBlockInfos_[i].parameterBlockPtr->dimension());
-        parameterBlockInfos_[i].parameterBlockPtr->liftJacobian(
-            parameterBlockInfos_[i].linearizationPoint.get(), J_lift.data());
-
-        J_i = Jmin_i * J_lift;
+                Eigen::RowMajor> > J_i(jacobians[i], e0_.rows(), info.dimension);
+        J_i = liftedJacobians_[i];
       }
     }
   }
 
-  // finally the error (residual) e = (-pinv(J^T) * _b + _J*Delta_Chi):
-  Eigen::Map<Eigen::VectorXd> e(residuals, e0_.rows());
-  e = e0_ + J_ * Delta_Chi;
-
   return true;
 }
 
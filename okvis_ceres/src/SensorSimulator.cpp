@@ -0,0 +1,484 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file SensorSimulator.cpp
+ * @brief Source file for the SensorSimulator class.
+ */
+
+#include <algorithm>
+#include <numeric>
+
+#include <glog/logging.h>
+
+#include <okvis/SensorSimulator.hpp>
+#include <okvis/Estimator.hpp>
+#include <okvis/IdProvider.hpp>
+#include <okvis/cameras/PinholeCamera.hpp>
+#include <okvis/cameras/EquidistantDistortion.hpp>
+#include <okvis/cameras/RadialTangentialDistortion.hpp>
+#include <okvis/cameras/RadialTangentialDistortion8.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+// Draw a 3d vector with independent standard normal entries.
+static Eigen::Vector3d randn3(std::mt19937 &generator) {
+  std::normal_distribution<double> normal(0.0, 1.0);
+  const double x = normal(generator);
+  const double y = normal(generator);
+  const double z = normal(generator);
+  return Eigen::Vector3d(x, y, z);
+}
+
+// Rotation vector to quaternion.
+static Eigen::Quaterniond rotationVectorToQuaternion(const Eigen::Vector3d &phi) {
+  const double angle = phi.norm();
+  if (angle < 1.0e-12) {
+    return Eigen::Quaterniond::Identity();
+  }
+  return Eigen::Quaterniond(Eigen::AngleAxisd(angle, phi / angle));
+}
+
+// Constructor. Generates landmarks, trajectory and IMU readings.
+SensorSimulator::SensorSimulator(
+    const okvis::cameras::NCameraSystem &nCameraSystem,
+    const okvis::ImuParameters &imuParameters,
+    const okvis::SimulationParameters &simulationParameters)
+    : nCameraSystem_(nCameraSystem),
+      imuParameters_(imuParameters),
+      parameters_(simulationParameters),
+      startTime_(1.0),
+      q_WR_(Eigen::Quaterniond::Identity()),
+      r_WR_(Eigen::Vector3d::Zero()) {
+  OKVIS_ASSERT_TRUE(Exception, nCameraSystem_.numCameras() > 0,
+                    "the camera system must contain at least one camera");
+  OKVIS_ASSERT_TRUE(Exception, parameters_.numControlPoints >= 4,
+                    "at least 4 control points are required for a cubic spline");
+  OKVIS_ASSERT_TRUE(Exception, imuParameters_.rate > 0 && parameters_.cameraRate > 0.0,
+                    "IMU and camera rates must be positive");
+
+  std::mt19937 generator(parameters_.seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+  // closed spline: one loop over the whole duration
+  const size_t n = parameters_.numControlPoints;
+  segmentDuration_ = parameters_.duration / double(n);
+  positionControlPoints_.resize(n);
+  rotationControlPoints_.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    const double angle = 2.0 * M_PI * double(i) / double(n);
+    positionControlPoints_[i] = parameters_.trajectoryRadius
+        * Eigen::Vector3d(cos(angle), sin(angle), 0.0)
+        + parameters_.trajectoryPerturbation * randn3(generator);
+    Eigen::Vector3d phi = randn3(generator);
+    phi *= parameters_.maxRotation * uniform(generator) / std::max(phi.norm(), 1.0e-12);
+    rotationControlPoints_[i] = phi;
+  }
+
+  // multiframe timestamps: leave some IMU readings before the first and after the last frame
+  const double imuDt = 1.0 / double(imuParameters_.rate);
+  const double cameraDt = 1.0 / parameters_.cameraRate;
+  for (double t = cameraDt; t <= parameters_.duration - cameraDt; t += cameraDt) {
+    frameTimestamps_.push_back(startTime_ + okvis::Duration(t));
+  }
+  OKVIS_ASSERT_TRUE(Exception, !frameTimestamps_.empty(),
+                    "duration too short for the requested camera rate");
+
+  // align the raw spline frame R with the world frame W such that the first state
+  // is at the origin and has the yaw that Estimator::initPoseFromImu() would assign
+  const double t0 = (frameTimestamps_.front() - startTime_).toSec();
+  Eigen::Vector3d r_R0;
+  evaluatePosition(t0, &r_R0, NULL, NULL);
+  const Eigen::Quaterniond q_RS0 = evaluateOrientation(t0);
+  const Eigen::Vector3d e_acc = (q_RS0.inverse() * Eigen::Vector3d::UnitZ()).normalized();
+  const Eigen::Quaterniond q_WS0 = Eigen::Quaterniond::FromTwoVectors(
+      e_acc, Eigen::Vector3d::UnitZ());
+  q_WR_ = (q_WS0 * q_RS0.inverse()).normalized();
+  r_WR_ = -(q_WR_ * r_R0);
+
+  // IMU readings
+  Eigen::Vector3d b_g = Eigen::Vector3d::Zero();
+  Eigen::Vector3d b_a = imuParameters_.a0;
+  if (parameters_.imuNoise) {
+    b_g += imuParameters_.sigma_bg * randn3(generator);
+    b_a += imuParameters_.sigma_ba * randn3(generator);
+  }
+  const size_t numImuMeasurements = size_t(parameters_.duration * imuParameters_.rate) + 1;
+  for (size_t i = 0; i < numImuMeasurements; ++i) {
+    const double t = double(i) * imuDt;
+    Eigen::Vector3d a_R;
+    evaluatePosition(t, NULL, NULL, &a_R);
+    const Eigen::Quaterniond q_RS = evaluateOrientation(t);
+    // accelerometers measure specific force; gravity is along -z in both R and W
+    Eigen::Vector3d acc = q_RS.inverse()
+        * (a_R + Eigen::Vector3d(0.0, 0.0, imuParameters_.g));
+    Eigen::Vector3d gyr = evaluateAngularRate(t);
+    if (parameters_.imuNoise) {
+      gyr += b_g + imuParameters_.sigma_g_c / sqrt(imuDt) * randn3(generator);
+      acc += b_a + imuParameters_.sigma_a_c / sqrt(imuDt) * randn3(generator);
+    }
+    Eigen::Matrix<double, 6, 1> biases;
+    biases << b_g, b_a;
+    biases_.push_back(biases);
+    imuMeasurements_.push_back(
+        okvis::ImuMeasurement(startTime_ + okvis::Duration(t),
+                              okvis::ImuSensorReadings(gyr, acc)));
+    if (parameters_.imuNoise) {
+      // bias random walk, accelerometer bias reverting with time constant tau
+      b_g += imuParameters_.sigma_gw_c * sqrt(imuDt) * randn3(generator);
+      b_a += -b_a * imuDt / imuParameters_.tau
+          + imuParameters_.sigma_aw_c * sqrt(imuDt) * randn3(generator);
+    }
+  }
+
+  // landmarks in a spherical shell around the trajectory centre
+  for (size_t i = 0; i < parameters_.numLandmarks; ++i) {
+    Eigen::Vector3d direction = randn3(generator);
+    direction /= std::max(direction.norm(), 1.0e-12);
+    const double distance = parameters_.minLandmarkDistance
+        + (parameters_.maxLandmarkDistance - parameters_.minLandmarkDistance)
+            * uniform(generator);
+    Eigen::Vector4d point;
+    point << r_WR_ + distance * direction, 1.0;
+    const uint64_t id = okvis::IdProvider::instance().newId();
+    landmarks_.insert(std::make_pair(id, okvis::MapPoint(id, point, 1.0, distance)));
+    cv::Mat descriptor(1, descriptorBytes, CV_8UC1);
+    for (int b = 0; b < descriptorBytes; ++b) {
+      descriptor.at<uchar>(0, b) = uchar(generator() & 0xFF);
+    }
+    descriptors_.insert(std::make_pair(id, descriptor));
+  }
+}
+
+// Ground truth state.
+bool SensorSimulator::groundTruth(const okvis::Time &t,
+                                  okvis::kinematics::Transformation &T_WS,
+                                  okvis::SpeedAndBias &speedAndBias) const {
+  if (t < startTime_ || t > imuMeasurements_.back().timeStamp) {
+    return false;
+  }
+  const double dt = (t - startTime_).toSec();
+  Eigen::Vector3d r_R, v_R;
+  evaluatePosition(dt, &r_R, &v_R, NULL);
+  T_WS = okvis::kinematics::Transformation(q_WR_ * r_R + r_WR_,
+                                           q_WR_ * evaluateOrientation(dt));
+  speedAndBias.head<3>() = q_WR_ * v_R;
+  speedAndBias.tail<6>() = evaluateBiases(dt);
+  return true;
+}
+
+// Create multiframe k with noisy keypoints, descriptors and the true landmark IDs set.
+okvis::MultiFramePtr SensorSimulator::simulateMultiFrame(size_t k, uint64_t id) const {
+  okvis::MultiFramePtr multiFrame(
+      new okvis::MultiFrame(nCameraSystem_, frameTimestamp(k),
+                            id == 0 ? okvis::IdProvider::instance().newId() : id));
+  for (size_t i = 0; i < nCameraSystem_.numCameras(); ++i) {
+    // seeded per image, such that the result does not depend on the call order
+    std::seed_seq seed{parameters_.seed, (unsigned int) k, (unsigned int) i};
+    std::mt19937 generator(seed);
+    std::vector<cv::KeyPoint> keypoints;
+    std::vector<uint64_t> landmarkIds;
+    std::vector<double> depths;
+    project(k, i, keypoints, landmarkIds, depths, &generator);
+
+    std::uniform_int_distribution<int> bit(0, 8 * descriptorBytes - 1);
+    cv::Mat descriptors(int(keypoints.size()), descriptorBytes, CV_8UC1);
+    for (size_t j = 0; j < landmarkIds.size(); ++j) {
+      descriptors_.at(landmarkIds[j]).copyTo(descriptors.row(int(j)));
+      for (int f = 0; f < parameters_.descriptorBitFlips; ++f) {
+        const int b = bit(generator);
+        descriptors.at<uchar>(int(j), b / 8) ^= uchar(1 << (b % 8));
+      }
+    }
+
+    multiFrame->resetKeypoints(i, keypoints);
+    multiFrame->resetDescriptors(i, descriptors);
+    for (size_t j = 0; j < landmarkIds.size(); ++j) {
+      multiFrame->setLandmarkId(i, j, landmarkIds[j]);
+    }
+  }
+  return multiFrame;
+}
+
+// Render a grayscale image of camera cameraIdx at multiframe k.
+cv::Mat SensorSimulator::renderImage(size_t k, size_t cameraIdx) const {
+  std::shared_ptr<const okvis::cameras::CameraBase> camera =
+      nCameraSystem_.cameraGeometry(cameraIdx);
+  cv::Mat image(int(camera->imageHeight()), int(camera->imageWidth()), CV_8UC1,
+                cv::Scalar(128));
+
+  std::vector<cv::KeyPoint> keypoints;
+  std::vector<uint64_t> landmarkIds;
+  std::vector<double> depths;
+  project(k, cameraIdx, keypoints, landmarkIds, depths, NULL);
+
+  // painter's algorithm: far to near
+  std::vector<size_t> order(keypoints.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&depths](size_t a, size_t b) {return depths[a] > depths[b];});
+  for (size_t j : order) {
+    const int halfSize = std::max(
+        3, std::min(12, int(parameters_.keypointSize * 4.0 / depths[j])));
+    const int u = int(keypoints[j].pt.x + 0.5);
+    const int v = int(keypoints[j].pt.y + 0.5);
+    // landmark-specific checkerboard corner
+    const uchar dark = uchar(20 + (landmarkIds[j] * 37) % 60);
+    const uchar bright = uchar(180 + (landmarkIds[j] * 53) % 60);
+    cv::rectangle(image, cv::Point(u - halfSize, v - halfSize), cv::Point(u - 1, v - 1),
+                  cv::Scalar(dark), CV_FILLED);
+    cv::rectangle(image, cv::Point(u, v), cv::Point(u + halfSize - 1, v + halfSize - 1),
+                  cv::Scalar(dark), CV_FILLED);
+    cv::rectangle(image, cv::Point(u, v - halfSize), cv::Point(u + halfSize - 1, v - 1),
+                  cv::Scalar(bright), CV_FILLED);
+    cv::rectangle(image, cv::Point(u - halfSize, v), cv::Point(u - 1, v + halfSize - 1),
+                  cv::Scalar(bright), CV_FILLED);
+  }
+
+  // a bit of sensor noise
+  cv::Mat noise(image.size(), CV_8SC1);
+  cv::RNG rng(uint64(parameters_.seed) * 1000003u + k * 131u + cameraIdx);
+  rng.fill(noise, cv::RNG::NORMAL, 0, 2);
+  cv::add(image, noise, image, cv::noArray(), CV_8UC1);
+  return image;
+}
+
+// Feed rendered images and IMU readings to a VioInterface in temporal order.
+size_t SensorSimulator::feed(okvis::VioInterface &vio) const {
+  size_t k = 0;
+  for (okvis::ImuMeasurementDeque::const_iterator it = imuMeasurements_.begin();
+      it != imuMeasurements_.end(); ++it) {
+    while (k < frameTimestamps_.size() && frameTimestamps_[k] <= it->timeStamp) {
+      for (size_t i = 0; i < nCameraSystem_.numCameras(); ++i) {
+        vio.addImage(frameTimestamps_[k], i, renderImage(k, i));
+      }
+      ++k;
+    }
+    vio.addImuMeasurement(it->timeStamp, it->measurement.accelerometers,
+                          it->measurement.gyroscopes);
+  }
+  return k;
+}
+
+// Add multiframe k to an Estimator, bypassing the frontend.
+size_t SensorSimulator::addToEstimator(okvis::Estimator &estimator, size_t k,
+                                       bool asKeyframe) const {
+  okvis::MultiFramePtr multiFrame = simulateMultiFrame(k);
+  okvis::kinematics::Transformation T_WS;
+  okvis::SpeedAndBias speedAndBias;
+  groundTruth(frameTimestamp(k), T_WS, speedAndBias);
+
+  if (estimator.numFrames() == 0) {
+    // initialise from the noise-free gravity direction, consistent with the world frame
+    okvis::ImuMeasurementDeque gravity;
+    gravity.push_back(okvis::ImuMeasurement(
+        frameTimestamp(k),
+        okvis::ImuSensorReadings(Eigen::Vector3d::Zero(),
+                                 T_WS.C().transpose() * Eigen::Vector3d::UnitZ())));
+    if (!estimator.addStates(multiFrame, gravity, asKeyframe)) {
+      return 0;
+    }
+    okvis::SpeedAndBias speedAndBias_est;
+    estimator.getSpeedAndBias(multiFrame->id(), 0, speedAndBias_est);
+    speedAndBias_est.head<3>() = speedAndBias.head<3>();
+    estimator.setSpeedAndBias(multiFrame->id(), 0, speedAndBias_est);
+  } else {
+    // only hand over the readings spanning the gap to the previous state
+    const okvis::Duration margin(2.0 / double(imuParameters_.rate));
+    const okvis::Time start = estimator.timestamp(estimator.currentFrameId()) - margin;
+    const okvis::Time end = frameTimestamp(k) + margin;
+    okvis::ImuMeasurementDeque imuMeasurements;
+    for (okvis::ImuMeasurementDeque::const_iterator it = imuMeasurements_.begin();
+        it != imuMeasurements_.end() && it->timeStamp <= end; ++it) {
+      if (it->timeStamp >= start) {
+        imuMeasurements.push_back(*it);
+      }
+    }
+    if (!estimator.addStates(multiFrame, imuMeasurements, asKeyframe)) {
+      return 0;
+    }
+  }
+
+  size_t numObservations = 0;
+  for (size_t i = 0; i < multiFrame->numFrames(); ++i) {
+    for (size_t j = 0; j < multiFrame->numKeypoints(i); ++j) {
+      const uint64_t landmarkId = multiFrame->landmarkId(i, j);
+      if (!estimator.isLandmarkAdded(landmarkId)) {
+        estimator.addLandmark(landmarkId, landmarks_.at(landmarkId).point);
+        estimator.setLandmarkInitialized(landmarkId, true);
+      }
+      // count the observations rather than the error terms, which not every backend adds
+      okvis::MapPoint mapPoint;
+      estimator.getLandmark(landmarkId, mapPoint);
+      const size_t numLandmarkObservations = mapPoint.observations.size();
+      switch (nCameraSystem_.distortionType(i)) {
+        case okvis::cameras::NCameraSystem::RadialTangential: {
+          estimator.addObservation<
+              okvis::cameras::PinholeCamera<
+                  okvis::cameras::RadialTangentialDistortion> >(
+              landmarkId, multiFrame->id(), i, j);
+          break;
+        }
+        case okvis::cameras::NCameraSystem::Equidistant: {
+          estimator.addObservation<
+              okvis::cameras::PinholeCamera<
+                  okvis::cameras::EquidistantDistortion> >(
+              landmarkId, multiFrame->id(), i, j);
+          break;
+        }
+        case okvis::cameras::NCameraSystem::RadialTangential8: {
+          estimator.addObservation<
+              okvis::cameras::PinholeCamera<
+                  okvis::cameras::RadialTangentialDistortion8> >(
+              landmarkId, multiFrame->id(), i, j);
+          break;
+        }
+        default:
+          OKVIS_THROW(Exception, "Unsupported distortion type.")
+          break;
+      }
+      estimator.getLandmark(landmarkId, mapPoint);
+      numObservations += mapPoint.observations.size() - numLandmarkObservations;
+    }
+  }
+  return numObservations;
+}
+
+// Evaluate the closed uniform cubic B-spline on position with derivatives.
+void SensorSimulator::evaluatePosition(double t, Eigen::Vector3d *r_W,
+                                       Eigen::Vector3d *v_W,
+                                       Eigen::Vector3d *a_W) const {
+  const size_t n = positionControlPoints_.size();
+  const double u = t / segmentDuration_;
+  const double segment = std::floor(u);
+  const double s = u - segment;
+  const size_t i = size_t(int64_t(segment) % int64_t(n) + int64_t(n)) % n;
+  const Eigen::Vector3d &c0 = positionControlPoints_[i];
+  const Eigen::Vector3d &c1 = positionControlPoints_[(i + 1) % n];
+  const Eigen::Vector3d &c2 = positionControlPoints_[(i + 2) % n];
+  const Eigen::Vector3d &c3 = positionControlPoints_[(i + 3) % n];
+  if (r_W) {
+    *r_W = ((1.0 - s) * (1.0 - s) * (1.0 - s) * c0
+        + (3.0 * s * s * s - 6.0 * s * s + 4.0) * c1
+        + (-3.0 * s * s * s + 3.0 * s * s + 3.0 * s + 1.0) * c2
+        + s * s * s * c3) / 6.0;
+  }
+  if (v_W) {
+    *v_W = (-(1.0 - s) * (1.0 - s) * c0 + (3.0 * s * s - 4.0 * s) * c1
+        + (-3.0 * s * s + 2.0 * s + 1.0) * c2 + s * s * c3)
+        / (2.0 * segmentDuration_);
+  }
+  if (a_W) {
+    *a_W = ((1.0 - s) * c0 + (3.0 * s - 2.0) * c1 + (-3.0 * s + 1.0) * c2 + s * c3)
+        / (segmentDuration_ * segmentDuration_);
+  }
+}
+
+// Evaluate the closed uniform cubic B-spline on orientation.
+Eigen::Quaterniond SensorSimulator::evaluateOrientation(double t) const {
+  const size_t n = rotationControlPoints_.size();
+  const double u = t / segmentDuration_;
+  const double segment = std::floor(u);
+  const double s = u - segment;
+  const size_t i = size_t(int64_t(segment) % int64_t(n) + int64_t(n)) % n;
+  const Eigen::Vector3d phi = ((1.0 - s) * (1.0 - s) * (1.0 - s)
+      * rotationControlPoints_[i]
+      + (3.0 * s * s * s - 6.0 * s * s + 4.0) * rotationControlPoints_[(i + 1) % n]
+      + (-3.0 * s * s * s + 3.0 * s * s + 3.0 * s + 1.0)
+          * rotationControlPoints_[(i + 2) % n]
+      + s * s * s * rotationControlPoints_[(i + 3) % n]) / 6.0;
+  return rotationVectorToQuaternion(phi);
+}
+
+// Angular rate in the sensor frame by central differences of the orientation.
+Eigen::Vector3d SensorSimulator::evaluateAngularRate(double t) const {
+  const double h = 1.0e-5;
+  const Eigen::Quaterniond dq = evaluateOrientation(t - h).inverse()
+      * evaluateOrientation(t + h);
+  const double sign = dq.w() < 0.0 ? -1.0 : 1.0;
+  return sign * 2.0 * dq.vec() / (2.0 * h);
+}
+
+// Interpolate the true biases at t (relative to the start time).
+Eigen::Matrix<double, 6, 1> SensorSimulator::evaluateBiases(double t) const {
+  const double index = t * double(imuParameters_.rate);
+  const size_t i = std::min(size_t(std::max(index, 0.0)), biases_.size() - 1);
+  if (i + 1 >= biases_.size()) {
+    return biases_[i];
+  }
+  const double s = index - double(i);
+  return (1.0 - s) * biases_[i] + s * biases_[i + 1];
+}
+
+// Project all landmarks into camera cameraIdx at multiframe k.
+void SensorSimulator::project(size_t k, size_t cameraIdx,
+                              std::vector<cv::KeyPoint> &keypoints,
+                              std::vector<uint64_t> &landmarkIds,
+                              std::vector<double> &depths,
+                              std::mt19937 *generator) const {
+  keypoints.clear();
+  landmarkIds.clear();
+  depths.clear();
+  okvis::kinematics::Transformation T_WS;
+  okvis::SpeedAndBias speedAndBias;
+  groundTruth(frameTimestamp(k), T_WS, speedAndBias);
+  const okvis::kinematics::Transformation T_CW =
+      (T_WS * (*nCameraSystem_.T_SC(cameraIdx))).inverse();
+  std::shared_ptr<const okvis::cameras::CameraBase> camera =
+      nCameraSystem_.cameraGeometry(cameraIdx);
+  std::normal_distribution<double> normal(0.0, parameters_.keypointSigma);
+  for (okvis::PointMap::const_iterator it = landmarks_.begin(); it != landmarks_.end();
+      ++it) {
+    const Eigen::Vector4d hp_C = T_CW * it->second.point;
+    Eigen::Vector2d projection;
+    if (camera->projectHomogeneous(hp_C, &projection)
+        != okvis::cameras::CameraBase::ProjectionStatus::Successful) {
+      continue;
+    }
+    if (generator) {
+      projection[0] += normal(*generator);
+      projection[1] += normal(*generator);
+      // keep noisy keypoints inside the image
+      if (projection[0] < 0.0 || projection[1] < 0.0
+          || projection[0] > double(camera->imageWidth()) - 1.0
+          || projection[1] > double(camera->imageHeight()) - 1.0) {
+        continue;
+      }
+    }
+    keypoints.push_back(cv::KeyPoint(float(projection[0]), float(projection[1]),
+                                     float(parameters_.keypointSize)));
+    landmarkIds.push_back(it->first);
+    depths.push_back(hp_C[2] / hp_C[3]);
+  }
+}
+
+}  // namespace okvis
@@ -0,0 +1,334 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file StructurelessEstimator.cpp
+ * @brief Source file for the StructurelessEstimator class.
+ */
+
+#include <cmath>
+#include <limits>
+
+#include <glog/logging.h>
+#include <okvis/StructurelessEstimator.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+// Constructor if a ceres map is already available.
+StructurelessEstimator::StructurelessEstimator(std::shared_ptr<okvis::ceres::Map> mapPtr)
+    : Estimator(mapPtr) {
+  // only the states are left: a small, dense problem
+  linearSolverType_ = ::ceres::DENSE_NORMAL_CHOLESKY;
+}
+
+// The default constructor.
+StructurelessEstimator::StructurelessEstimator()
+    : Estimator() {
+  linearSolverType_ = ::ceres::DENSE_NORMAL_CHOLESKY;
+}
+
+StructurelessEstimator::~StructurelessEstimator() {
+}
+
+// Add a landmark.
+bool StructurelessEstimator::addLandmark(uint64_t landmarkId,
+                                         const Eigen::Vector4d &landmark) {
+  double dist = std::numeric_limits<double>::max();
+  if (fabs(landmark[3]) > 1.0e-8) {
+    dist = (landmark / landmark[3]).head<3>().norm(); // euclidean distance
+  }
+  return landmarksMap_.insert(
+      std::pair<uint64_t, MapPoint>(
+          landmarkId, MapPoint(landmarkId, landmark, 0.0, dist))).second;
+}
+
+// Remove an observation from a landmark, if available.
+bool StructurelessEstimator::removeObservation(uint64_t landmarkId, uint64_t poseId,
+                                               size_t camIdx, size_t keypointIdx) {
+  PointMap::iterator pit = landmarksMap_.find(landmarkId);
+  if (pit == landmarksMap_.end()) {
+    return false;
+  }
+  std::map<okvis::KeypointIdentifier, uint64_t>::iterator it = pit->second.observations.find(
+      okvis::KeypointIdentifier(poseId, camIdx, keypointIdx));
+  if (it == pit->second.observations.end()) {
+    return false; // observation not present
+  }
+
+  // the error term is rebuilt with the remaining observations by the next optimize()
+  removeTrackError(landmarkId);
+  pit->second.observations.erase(it);
+  updateCovisibilities(pit->second, poseId, false);
+  return true;
+}
+
+// Applies the marginalization strategy of the Estimator to the states.
+bool StructurelessEstimator::applyMarginalizationStrategy(
+    size_t numKeyframes, size_t numImuFrames,
+    okvis::MapPointVector &removedLandmarks,
+    okvis::FrameStateVector *marginalizedStates) {
+  std::vector<uint64_t> removeFrames;
+  std::vector<uint64_t> allLinearizedFrames;
+  getFramesToMarginalize(numKeyframes, numImuFrames, removeFrames, allLinearizedFrames);
+  const std::set<uint64_t> removedFrames(removeFrames.begin(), removeFrames.end());
+  const std::set<uint64_t> linearizedFrames(allLinearizedFrames.begin(),
+                                            allLinearizedFrames.end());
+  std::vector<TrackError> absorbedTrackErrors;  // keeps their loss functions alive
+
+  for (PointMap::iterator pit = landmarksMap_.begin();
+       pit != landmarksMap_.end() && !removedFrames.empty();) {
+    std::vector<okvis::KeypointIdentifier> removedObservations;
+    bool hasNewObservations = false;
+    size_t obsCount = 0;
+    for (std::map<okvis::KeypointIdentifier, uint64_t>::const_iterator it =
+        pit->second.observations.begin(); it != pit->second.observations.end(); ++it) {
+      if (removedFrames.count(it->first.frameId)) {
+        removedObservations.push_back(it->first);
+      }
+      if (it->first.frameId >= allLinearizedFrames.at(0)) {
+        hasNewObservations = true;
+      }
+      if (linearizedFrames.count(it->first.frameId)) {
+        obsCount++;
+      }
+    }
+    if (removedObservations.empty()) {
+      pit++;
+      continue;
+    }
+
+    // the track goes on without the frames that leave
+    if (hasNewObservations) {
+      for (size_t i = 0; i < removedObservations.size(); ++i) {
+        removeObservation(pit->first, removedObservations[i].frameId,
+                          removedObservations[i].cameraIndex,
+                          removedObservations[i].keypointIndex);
+      }
+      pit++;
+      continue;
+    }
+
+    // the track ended: weakly informative ones are dropped rather than marginalized
+    removedLandmarks.push_back(pit->second);
+    std::map<uint64_t, TrackError>::iterator tit = trackErrors_.find(pit->first);
+    if (tit == trackErrors_.end()
+        || tit->second.errorPtr->numObservations() != pit->second.observations.size()
+        || obsCount < marginalizationMinObservations_
+        || pit->second.quality < marginalizationMinQuality_) {
+      const uint64_t landmarkId = pit->first;
+      pit++;
+      initializedLandmarks_.erase(landmarkId);
+      removeLandmark(landmarkId);
+      continue;
+    }
+
+    // the error term stays in the map and goes into the prior with the removed poses
+    absorbedTrackErrors.push_back(tit->second);
+    trackErrors_.erase(tit);
+    initializedLandmarks_.erase(pit->first);
+    removeCovisibilities(pit->second);
+    pit = landmarksMap_.erase(pit);
+  }
+
+  return Estimator::applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks,
+                                                 marginalizedStates);
+}
+
+// Start ceres optimization.
+void StructurelessEstimator::optimize(size_t numIter, size_t numThreads, bool verbose) {
+  // (re-)build the error terms of the tracks observed since the last call
+  for (PointMap::const_iterator pit = landmarksMap_.begin(); pit != landmarksMap_.end();
+       ++pit) {
+    std::map<uint64_t, TrackError>::const_iterator tit = trackErrors_.find(pit->first);
+    if (tit == trackErrors_.end()
+        || tit->second.errorPtr->numObservations() != pit->second.observations.size()) {
+      addTrackError(pit->second);
+    }
+  }
+
+  Estimator::optimize(numIter, numThreads, verbose);
+
+  // the last evaluation may have been a rejected step: triangulate at the solution
+  Eigen::VectorXd residuals;
+  for (std::map<uint64_t, TrackError>::const_iterator tit = trackErrors_.begin();
+       tit != trackErrors_.end(); ++tit) {
+    evaluateTrackError(tit->second, residuals);
+    MapPoint &mapPoint = landmarksMap_.at(tit->first);
+    mapPoint.point = tit->second.errorPtr->point();
+    mapPoint.quality = tit->second.errorPtr->quality();
+  }
+}
+
+// Without landmarks the problem is small: optimizes the full window.
+void StructurelessEstimator::optimizeLocal(size_t /*numLocalFrames*/, size_t numIter,
+                                           size_t numThreads, bool verbose) {
+  optimize(numIter, numThreads, verbose);
+}
+
+// Remove outlier tracks.
+size_t StructurelessEstimator::cullOutliers(okvis::MapPointVector &removedLandmarks,
+                                            size_t /*numThreads*/, double timeLimit) {
+  const okvis::Time startTime = okvis::Time::now();
+  std::vector<uint64_t> outliers;
+  Eigen::VectorXd residuals;
+  for (std::map<uint64_t, TrackError>::const_iterator tit = trackErrors_.begin();
+       tit != trackErrors_.end(); ++tit) {
+    if (timeLimit >= 0.0 && (okvis::Time::now() - startTime).toSec() > timeLimit) {
+      break;
+    }
+    evaluateTrackError(tit->second, residuals);
+    if (residuals.squaredNorm() > 0.5 * outlierChi2Threshold_ * residuals.size()) {
+      outliers.push_back(tit->first);
+    }
+  }
+
+  size_t numObservations = 0;
+  for (size_t i = 0; i < outliers.size(); ++i) {
+    const MapPoint &mapPoint = landmarksMap_.at(outliers[i]);
+    numObservations += mapPoint.observations.size();
+    removedLandmarks.push_back(mapPoint);
+    initializedLandmarks_.erase(outliers[i]);
+    removeLandmark(outliers[i]);
+  }
+  VLOG(1) << "culled " << outliers.size() << " tracks with " << numObservations
+          << " observations";
+  return numObservations;
+}
+
+// Checks whether the landmark is initialized.
+bool StructurelessEstimator::isLandmarkInitialized(uint64_t landmarkId) const {
+  OKVIS_ASSERT_TRUE_DBG(Exception, isLandmarkAdded(landmarkId),
+                        "landmark not added");
+  return initializedLandmarks_.count(landmarkId) > 0;
+}
+
+// Set the homogeneous coordinates for a landmark.
+bool StructurelessEstimator::setLandmark(uint64_t landmarkId,
+                                         const Eigen::Vector4d &landmark) {
+  PointMap::iterator pit = landmarksMap_.find(landmarkId);
+  if (pit == landmarksMap_.end()) {
+    return false;
+  }
+  pit->second.point = landmark;
+  return true;
+}
+
+// Set the landmark initialization state.
+void StructurelessEstimator::setLandmarkInitialized(uint64_t landmarkId,
+                                                    bool initialized) {
+  OKVIS_ASSERT_TRUE_DBG(Exception, isLandmarkAdded(landmarkId),
+                        "landmark not added");
+  if (initialized) {
+    initializedLandmarks_.insert(landmarkId);
+  }
+  else {
+    initializedLandmarks_.erase(landmarkId);
+    removeTrackError(landmarkId);
+  }
+}
+
+// Add the error term of a landmark track, replacing an outdated one.
+bool StructurelessEstimator::addTrackError(const MapPoint &mapPoint) {
+  removeTrackError(mapPoint.id);
+  if (!initializedLandmarks_.count(mapPoint.id) || mapPoint.observations.size() < 2) {
+    return false;
+  }
+
+  // every pose and extrinsics block once
+  std::vector<std::shared_ptr<ceres::ParameterBlock> > parameterBlocks;
+  std::map<uint64_t, size_t> parameterBlockIdx;
+  auto index = [&](uint64_t id) -> size_t {
+    std::map<uint64_t, size_t>::const_iterator it = parameterBlockIdx.find(id);
+    if (it != parameterBlockIdx.end()) {
+      return it->second;
+    }
+    parameterBlockIdx[id] = parameterBlocks.size();
+    parameterBlocks.push_back(mapPtr_->parameterBlockPtr(id));
+    return parameterBlocks.size() - 1;
+  };
+  ceres::StructurelessReprojectionError::Observations observations;
+  for (std::map<okvis::KeypointIdentifier, uint64_t>::const_iterator it =
+      mapPoint.observations.begin(); it != mapPoint.observations.end(); ++it) {
+    const okvis::KeypointIdentifier &kid = it->first;
+    const okvis::MultiFramePtr &multiFrame = multiFramePtrMap_.at(kid.frameId);
+    ceres::StructurelessReprojectionError::Observation observation;
+    observation.cameraGeometry = multiFrame->geometry(kid.cameraIndex);
+    multiFrame->getKeypoint(kid.cameraIndex, kid.keypointIndex, observation.measurement);
+    double size = 1.0;
+    multiFrame->getKeypointSize(kid.cameraIndex, kid.keypointIndex, size);
+    observation.squareRootInformation = 8.0 / size;  // the information of addObservation()
+    observation.poseIdx = index(kid.frameId);
+    observation.extrinsicsIdx = index(statesMap_.at(kid.frameId).sensors.at(
+        SensorStates::Camera).at(kid.cameraIndex).at(CameraSensorStates::T_SCi).id);
+    observations.push_back(observation);
+  }
+
+  // a Huber loss at the cullOutliers() threshold keeps the full information of inlier tracks
+  TrackError trackError;
+  trackError.errorPtr.reset(new ceres::StructurelessReprojectionError(
+      observations, parameterBlocks.size(), mapPoint.point));
+  trackError.lossFunctionPtr.reset(new ::ceres::HuberLoss(
+      sqrt(0.5 * outlierChi2Threshold_ * trackError.errorPtr->residualDim())));
+  trackError.residualBlockId = mapPtr_->addResidualBlock(
+      trackError.errorPtr, trackError.lossFunctionPtr.get(), parameterBlocks);
+  if (!trackError.residualBlockId) {
+    return false;
+  }
+  trackErrors_[mapPoint.id] = trackError;
+  return true;
+}
+
+// Remove the error term of a landmark track from the map, if any.
+void StructurelessEstimator::removeTrackError(uint64_t landmarkId) {
+  std::map<uint64_t, TrackError>::iterator tit = trackErrors_.find(landmarkId);
+  if (tit == trackErrors_.end()) {
+    return;
+  }
+  mapPtr_->removeResidualBlock(tit->second.residualBlockId);
+  trackErrors_.erase(tit);
+}
+
+// Evaluate the error term of a track at the current estimates.
+void StructurelessEstimator::evaluateTrackError(const TrackError &trackError,
+                                                Eigen::VectorXd &residuals) const {
+  const ceres::Map::ParameterBlockCollection parameters =
+      mapPtr_->parameters(trackError.residualBlockId);
+  std::vector<double *> parametersRaw(parameters.size());
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    parametersRaw[i] = parameters[i].second->parameters();
+  }
+  residuals.resize(trackError.errorPtr->residualDim());
+  trackError.errorPtr->EvaluateWithMinimalJacobians(parametersRaw.data(), residuals.data(),
+                                                    NULL, NULL);
+}
+
+}  // namespace okvis
@@ -0,0 +1,221 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file StructurelessReprojectionError.cpp
+ * @brief Source file for the StructurelessReprojectionError class.
+ */
+
+#include <Eigen/Dense>
+#include <okvis/ceres/StructurelessReprojectionError.hpp>
+#include <okvis/ceres/PoseLocalParameterization.hpp>
+#include <okvis/kinematics/operators.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+/// \brief ceres Namespace for ceres-related functionality implemented in okvis.
+namespace ceres {
+
+// Construct with the observations and an initial landmark estimate.
+StructurelessReprojectionError::StructurelessReprojectionError(
+    const Observations &observations, size_t numParameterBlocks,
+    const Eigen::Vector4d &hp_W)
+    : observations_(observations),
+      hp_W_(hp_W),
+      quality_(0.0) {
+  OKVIS_ASSERT_TRUE(Exception, observations_.size() >= 2,
+                    "a track needs at least two observations");
+  base_t::set_num_residuals(2 * observations_.size() - 3);
+  base_t::mutable_parameter_block_sizes()->assign(numParameterBlocks, 7);
+}
+
+// This evaluates the error term and additionally computes the Jacobians.
+bool StructurelessReprojectionError::Evaluate(double const *const *parameters,
+                                              double *residuals,
+                                              double **jacobians) const {
+  return EvaluateWithMinimalJacobians(parameters, residuals, jacobians, NULL);
+}
+
+// This evaluates the error term and additionally computes
+// the Jacobians in the minimal internal representation.
+bool StructurelessReprojectionError::EvaluateWithMinimalJacobians(
+    double const *const *parameters, double *residuals, double **jacobians,
+    double **jacobiansMinimal) const {
+
+  // re-triangulate with the current poses, starting from the last landmark
+  Eigen::Vector4d hp_W = hp_W_;
+  Eigen::VectorXd errors;
+  Eigen::MatrixXd J_point;
+  linearize(parameters, hp_W, errors, J_point, NULL);
+  double cost = errors.squaredNorm();
+  for (int i = 0; i < kTriangulationIterations; ++i) {
+    const Eigen::Matrix3d H = J_point.transpose() * J_point;
+    const Eigen::Vector3d delta = -H.ldlt().solve(J_point.transpose() * errors);
+    if (!delta.allFinite()) {
+      break;
+    }
+    Eigen::Vector4d hp_W_new = hp_W;
+    hp_W_new.head<3>() += delta;
+    Eigen::VectorXd errorsNew;
+    Eigen::MatrixXd J_pointNew;
+    linearize(parameters, hp_W_new, errorsNew, J_pointNew, NULL);
+    const double costNew = errorsNew.squaredNorm();
+    if (costNew >= cost) {
+      break;
+    }
+    hp_W = hp_W_new;
+    errors = errorsNew;
+    J_point = J_pointNew;
+    cost = costNew;
+  }
+  hp_W_ = hp_W;
+
+  // the same quality measure as for landmark parameter blocks
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> saes(J_point.transpose() * J_point);
+  const Eigen::Vector3d eigenvalues = saes.eigenvalues();
+  quality_ = eigenvalues[0] < 1.0e-12 ? 0.0 : sqrt(eigenvalues[0]) / sqrt(eigenvalues[2]);
+
+  // the left nullspace of J_point: the last 2n-3 columns of Q in J_point = QR
+  Eigen::MatrixXd J_states;
+  if (jacobians != NULL) {
+    linearize(parameters, hp_W, errors, J_point, &J_states);
+  }
+  const Eigen::HouseholderQR<Eigen::MatrixXd> qr(J_point);
+  const int dim = base_t::num_residuals();
+  const Eigen::VectorXd projectedErrors = (qr.householderQ().transpose() * errors).tail(dim);
+  Eigen::Map<Eigen::VectorXd>(residuals, dim) = projectedErrors;
+  if (jacobians == NULL) {
+    return true;
+  }
+  const Eigen::MatrixXd projectedJacobian =
+      (qr.householderQ().transpose() * J_states).bottomRows(dim);
+
+  for (size_t k = 0; k < parameterBlocks(); ++k) {
+    if (jacobians[k] == NULL) {
+      continue;
+    }
+    const Eigen::MatrixXd J_minimal = projectedJacobian.middleCols(6 * k, 6);
+
+    // pseudo inverse of the local parametrization Jacobian:
+    Eigen::Matrix<double, 6, 7, Eigen::RowMajor> J_lift;
+    PoseLocalParameterization::liftJacobian(parameters[k], J_lift.data());
+
+    // hallucinate Jacobian w.r.t. state
+    Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, 7, Eigen::RowMajor> > J(
+        jacobians[k], dim, 7);
+    J = J_minimal * J_lift;
+
+    // if requested, provide minimal Jacobians
+    if (jacobiansMinimal != NULL && jacobiansMinimal[k] != NULL) {
+      Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, 6, Eigen::RowMajor> > J_minimal_mapped(
+          jacobiansMinimal[k], dim, 6);
+      J_minimal_mapped = J_minimal;
+    }
+  }
+  return true;
+}
+
+// Whitened errors and their Jacobians at the given landmark.
+void StructurelessReprojectionError::linearize(double const *const *parameters,
+                                               const Eigen::Vector4d &hp_W,
+                                               Eigen::VectorXd &errors,
+                                               Eigen::MatrixXd &J_point,
+                                               Eigen::MatrixXd *J_states) const {
+  const size_t n = observations_.size();
+  errors.resize(2 * n);
+  J_point.resize(2 * n, 3);
+  if (J_states) {
+    J_states->setZero(2 * n, 6 * parameterBlocks());
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    const Observation &observation = observations_[i];
+    const double *pose = parameters[observation.poseIdx];
+    const double *extrinsics = parameters[observation.extrinsicsIdx];
+
+    // as in ReprojectionError: avoid okvis::kinematics::Transformation
+    Eigen::Map<const Eigen::Vector3d> t_WS_W(pose);
+    const Eigen::Quaterniond q_WS(pose[6], pose[3], pose[4], pose[5]);
+    Eigen::Map<const Eigen::Vector3d> t_SC_S(extrinsics);
+    const Eigen::Quaterniond q_SC(extrinsics[6], extrinsics[3], extrinsics[4],
+                                  extrinsics[5]);
+
+    // transform the point into the camera:
+    const Eigen::Matrix3d C_CS = q_SC.toRotationMatrix().transpose();
+    Eigen::Matrix4d T_CS = Eigen::Matrix4d::Identity();
+    T_CS.topLeftCorner<3, 3>() = C_CS;
+    T_CS.topRightCorner<3, 1>() = -C_CS * t_SC_S;
+    const Eigen::Matrix3d C_SW = q_WS.toRotationMatrix().transpose();
+    Eigen::Matrix4d T_SW = Eigen::Matrix4d::Identity();
+    T_SW.topLeftCorner<3, 3>() = C_SW;
+    T_SW.topRightCorner<3, 1>() = -C_SW * t_WS_W;
+    const Eigen::Vector4d hp_S = T_SW * hp_W;
+    const Eigen::Vector4d hp_C = T_CS * hp_S;
+
+    // the whitened reprojection error
+    Eigen::Vector2d kp;
+    Eigen::Matrix<double, 2, 4> Jh;
+    observation.cameraGeometry->projectHomogeneous(hp_C, &kp, &Jh);
+    errors.segment<2>(2 * i) = observation.squareRootInformation * (observation.measurement - kp);
+    const Eigen::Matrix<double, 2, 4> Jh_weighted = observation.squareRootInformation * Jh;
+
+    // points behind the camera do not contribute to the Jacobians
+    bool valid = true;
+    if (fabs(hp_C[3]) > 1.0e-8 && hp_C[2] / hp_C[3] < 0.2) {
+      valid = false;
+    }
+    if (!valid) {
+      J_point.middleRows<2>(2 * i).setZero();
+      continue;
+    }
+    J_point.middleRows<2>(2 * i) = -(Jh_weighted * T_CS * T_SW).leftCols<3>();
+    if (!J_states) {
+      continue;
+    }
+
+    // pose, see ReprojectionError
+    Eigen::Vector3d p = hp_W.head<3>() - t_WS_W * hp_W[3];
+    Eigen::Matrix<double, 4, 6> J = Eigen::Matrix<double, 4, 6>::Zero();
+    J.topLeftCorner<3, 3>() = C_SW * hp_W[3];
+    J.topRightCorner<3, 3>() = -C_SW * okvis::kinematics::crossMx(p);
+    J_states->block<2, 6>(2 * i, 6 * observation.poseIdx) = Jh_weighted * T_CS * J;
+
+    // extrinsics
+    p = hp_S.head<3>() - t_SC_S * hp_S[3];
+    J.setZero();
+    J.topLeftCorner<3, 3>() = C_CS * hp_S[3];
+    J.topRightCorner<3, 3>() = -C_CS * okvis::kinematics::crossMx(p);
+    J_states->block<2, 6>(2 * i, 6 * observation.extrinsicsIdx) = Jh_weighted * J;
+  }
+}
+
+}  // namespace ceres
+}  // namespace okvis
@@ -0,0 +1,154 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file SimulatedEstimatorTest.hpp
+ * @brief Test fixture feeding an Estimator from the SensorSimulator.
+ */
+
+#ifndef SIMULATED_ESTIMATOR_TEST_HPP
+#define SIMULATED_ESTIMATOR_TEST_HPP
+
+#include <memory>
+
+#include <gtest/gtest.h>
+#include <okvis/SensorSimulator.hpp>
+#include <okvis/Estimator.hpp>
+#include <okvis/cameras/PinholeCamera.hpp>
+#include <okvis/cameras/EquidistantDistortion.hpp>
+
+// Set up a two-camera rig and IMU parameters for the simulator tests.
+inline void createTestSetup(okvis::cameras::NCameraSystem &cameraSystem,
+                            okvis::ImuParameters &imuParameters) {
+  std::shared_ptr<const okvis::kinematics::Transformation> T_SC_0(
+      new okvis::kinematics::Transformation());
+  std::shared_ptr<const okvis::kinematics::Transformation> T_SC_1(
+      new okvis::kinematics::Transformation(Eigen::Vector3d(0, 0.1, 0),
+                                            Eigen::Quaterniond(1, 0, 0, 0)));
+  cameraSystem.addCamera(
+      T_SC_0,
+      okvis::cameras::PinholeCamera<okvis::cameras::EquidistantDistortion>::createTestObject(),
+      okvis::cameras::NCameraSystem::DistortionType::Equidistant, false);
+  cameraSystem.addCamera(
+      T_SC_1,
+      okvis::cameras::PinholeCamera<okvis::cameras::EquidistantDistortion>::createTestObject(),
+      okvis::cameras::NCameraSystem::DistortionType::Equidistant, false);
+
+  imuParameters.a0.setZero();
+  imuParameters.g = 9.81;
+  imuParameters.a_max = 1000.0;
+  imuParameters.g_max = 1000.0;
+  imuParameters.rate = 1000;
+  imuParameters.sigma_g_c = 6.0e-4;
+  imuParameters.sigma_a_c = 2.0e-3;
+  imuParameters.sigma_gw_c = 3.0e-6;
+  imuParameters.sigma_aw_c = 2.0e-5;
+  imuParameters.sigma_bg = 0.01;
+  imuParameters.sigma_ba = 0.1;
+  imuParameters.tau = 3600.0;
+}
+
+// A simulated two-camera rig feeding an Estimator, shared by the estimator tests.
+class SimulatedEstimatorTest : public ::testing::Test {
+ public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+ protected:
+  SimulatedEstimatorTest()
+      : mapPtr_(new okvis::ceres::Map),
+        estimator_(mapPtr_) {
+    createTestSetup(cameraSystem_, imuParameters_);
+  }
+
+  // Simulate a scene with numLandmarks landmarks and add the rig to the estimator.
+  void setUpEstimator(size_t numLandmarks,
+                      const okvis::ExtrinsicsEstimationParameters &extrinsicsEstimationParameters =
+                          okvis::ExtrinsicsEstimationParameters()) {
+    okvis::SimulationParameters simulationParameters;
+    simulationParameters.numLandmarks = numLandmarks;
+    simulator_.reset(new okvis::SensorSimulator(cameraSystem_, imuParameters_,
+                                                simulationParameters));
+    addSensors(estimator_, extrinsicsEstimationParameters);
+  }
+
+  // Add the rig to a further estimator, e.g. to compare two configurations.
+  void addSensors(okvis::Estimator &estimator,
+                  const okvis::ExtrinsicsEstimationParameters &extrinsicsEstimationParameters =
+                      okvis::ExtrinsicsEstimationParameters()) const {
+    for (size_t i = 0; i < cameraSystem_.numCameras(); ++i) {
+      estimator.addCamera(extrinsicsEstimationParameters);
+    }
+    estimator.addImu(imuParameters_);
+  }
+
+  // Add frame k, every third one as a keyframe. Returns the number of observations added.
+  size_t addFrame(size_t k) {
+    return simulator_->addToEstimator(estimator_, k, k % 3 == 0);
+  }
+
+  // Marginalize down to the given window. Returns the number of landmarks removed.
+  size_t marginalize(size_t numKeyframes = 3, size_t numImuFrames = 2) {
+    okvis::MapPointVector removedLandmarks;
+    EXPECT_TRUE(estimator_.applyMarginalizationStrategy(numKeyframes, numImuFrames,
+                                                        removedLandmarks));
+    return removedLandmarks.size();
+  }
+
+  // Add, optimize and marginalize the frames [0, numFrames). Returns the landmarks removed.
+  size_t run(size_t numFrames) {
+    size_t numRemovedLandmarks = 0;
+    for (size_t k = 0; k < numFrames; ++k) {
+      addFrame(k);
+      estimator_.optimize(10, 1, false);
+      numRemovedLandmarks += marginalize();
+    }
+    return numRemovedLandmarks;
+  }
+
+  // Compare the newest state, i.e. frame k, with the ground truth.
+  void expectNewestStateNear(size_t k, double positionTolerance, double rotationTolerance) {
+    okvis::kinematics::Transformation T_WS_est, T_WS_true;
+    okvis::SpeedAndBias speedAndBias_true;
+    ASSERT_TRUE(estimator_.get_T_WS(estimator_.currentFrameId(), T_WS_est));
+    ASSERT_TRUE(simulator_->groundTruth(simulator_->frameTimestamp(k), T_WS_true,
+                                        speedAndBias_true));
+    EXPECT_LT((T_WS_est.r() - T_WS_true.r()).norm(), positionTolerance);
+    EXPECT_LT(2 * (T_WS_est.q() * T_WS_true.q().inverse()).vec().norm(), rotationTolerance);
+  }
+
+  okvis::cameras::NCameraSystem cameraSystem_;
+  okvis::ImuParameters imuParameters_;
+  std::unique_ptr<okvis::SensorSimulator> simulator_;
+  std::shared_ptr<okvis::ceres::Map> mapPtr_;
+  okvis::Estimator estimator_;
+};
+
+#endif // SIMULATED_ESTIMATOR_TEST_HPP
@@ -0,0 +1,134 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+#include "SimulatedEstimatorTest.hpp"
+
+namespace {
+// Prune the landmarks down to maxLandmarks and check that the pruned ones are gone
+// together with their parameter blocks and observations. Returns the number pruned.
+size_t pruneLandmarks(okvis::Estimator &estimator, const okvis::ceres::Map &map,
+                      size_t maxLandmarks) {
+  const size_t numLandmarks = estimator.numLandmarks();
+  okvis::MapPointVector prunedLandmarks;
+  const size_t numRemoved = estimator.pruneLandmarks(prunedLandmarks);
+  EXPECT_EQ(numRemoved, prunedLandmarks.size());
+  EXPECT_EQ(estimator.numLandmarks(), std::min(numLandmarks, maxLandmarks));
+  for (size_t i = 0; i < prunedLandmarks.size(); ++i) {
+    EXPECT_FALSE(estimator.isLandmarkAdded(prunedLandmarks[i].id));
+    EXPECT_FALSE(map.parameterBlockExists(prunedLandmarks[i].id));
+  }
+  okvis::MultiFramePtr multiFrame = estimator.multiFrame(estimator.currentFrameId());
+  for (size_t i = 0; i < multiFrame->numFrames(); ++i) {
+    for (size_t j = 0; j < multiFrame->numKeypoints(i); ++j) {
+      const uint64_t landmarkId = multiFrame->landmarkId(i, j);
+      EXPECT_TRUE(landmarkId == 0 || estimator.isLandmarkAdded(landmarkId));
+    }
+  }
+  return numRemoved;
+}
+}  // namespace
+
+TEST_F(SimulatedEstimatorTest, LandmarkPruning) {
+  setUpEstimator(2000);
+  const size_t maxLandmarks = 100;
+  estimator_.setMaxLandmarks(maxLandmarks);
+
+  const size_t K = 20;
+  size_t numPruned = 0;
+  for (size_t k = 0; k < K; ++k) {
+    addFrame(k);
+    numPruned += pruneLandmarks(estimator_, *mapPtr_, maxLandmarks);
+    estimator_.optimize(10, 1, false);
+    marginalize();
+  }
+  EXPECT_GT(numPruned, 0u);
+  expectNewestStateNear(K - 1, 0.1, 2.0e-2);
+}
+
+TEST_F(SimulatedEstimatorTest, LandmarkPruningLocalOptimization) {
+  setUpEstimator(2000);
+  const size_t maxLandmarks = 100;
+  estimator_.setMaxLandmarks(maxLandmarks);
+
+  // pruned before every optimisation, most of which hold the old part of the window constant
+  const size_t K = 20;
+  size_t numPruned = 0;
+  for (size_t k = 0; k < K; ++k) {
+    addFrame(k);
+    numPruned += pruneLandmarks(estimator_, *mapPtr_, maxLandmarks);
+    if (k % 3 == 0) {
+      estimator_.optimize(10, 1, false);
+    }
+    else {
+      estimator_.optimizeLocal(2, 10, 1, false);
+    }
+    // all remaining landmarks are released again
+    okvis::PointMap landmarks;
+    estimator_.getLandmarks(landmarks);
+    for (okvis::PointMap::const_iterator it = landmarks.begin(); it != landmarks.end(); ++it) {
+      EXPECT_FALSE(mapPtr_->parameterBlockPtr(it->first)->fixed());
+    }
+    marginalize();
+  }
+  EXPECT_GT(numPruned, 0u);
+  expectNewestStateNear(K - 1, 0.1, 2.0e-2);
+}
+
+TEST_F(SimulatedEstimatorTest, LandmarkPruningAnchored) {
+  setUpEstimator(2000);
+  const size_t maxLandmarks = 100;
+  estimator_.setMaxLandmarks(maxLandmarks);
+  estimator_.setAnchoredLandmarks(true);
+
+  // the anchored blocks go with the landmarks, the anchors of the others stay valid
+  const size_t K = 20;
+  size_t numPruned = 0;
+  for (size_t k = 0; k < K; ++k) {
+    addFrame(k);
+    numPruned += pruneLandmarks(estimator_, *mapPtr_, maxLandmarks);
+    estimator_.optimize(10, 1, false);
+    marginalize();
+    okvis::PointMap landmarks;
+    estimator_.getLandmarks(landmarks);
+    for (okvis::PointMap::const_iterator it = landmarks.begin(); it != landmarks.end(); ++it) {
+      std::shared_ptr<okvis::ceres::InverseDepthParameterBlock> pointParameterBlock =
+          std::dynamic_pointer_cast<okvis::ceres::InverseDepthParameterBlock>(
+              mapPtr_->parameterBlockPtr(it->first));
+      ASSERT_TRUE(pointParameterBlock && pointParameterBlock->anchored());
+      EXPECT_TRUE(mapPtr_->parameterBlockExists(pointParameterBlock->anchorPoseId()));
+    }
+  }
+  EXPECT_GT(numPruned, 0u);
+  expectNewestStateNear(K - 1, 0.1, 2.0e-2);
+}
@@ -0,0 +1,129 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <okvis/ceres/MarginalizationError.hpp>
+#include "SimulatedEstimatorTest.hpp"
+
+namespace {
+// The cost of the marginalization prior at the current estimates, 0 if there is none.
+double priorCost(const okvis::ceres::Map &map) {
+  const okvis::ceres::Map::ResidualBlockId2ResidualBlockSpec_Map &residualBlocks =
+      map.residualBlockId2ResidualBlockSpecMap();
+  for (auto it = residualBlocks.begin(); it != residualBlocks.end(); ++it) {
+    if (!std::dynamic_pointer_cast<okvis::ceres::MarginalizationError>(
+        it->second.errorInterfacePtr)) {
+      continue;
+    }
+    const okvis::ceres::Map::ParameterBlockCollection parameterBlocks =
+        map.parameters(it->first);
+    std::vector<double *> parameters;
+    for (size_t i = 0; i < parameterBlocks.size(); ++i) {
+      parameters.push_back(parameterBlocks[i].second->parameters());
+    }
+    Eigen::VectorXd residuals(it->second.errorInterfacePtr->residualDim());
+    it->second.errorInterfacePtr->EvaluateWithMinimalJacobians(parameters.data(),
+                                                               residuals.data(), NULL, NULL);
+    return 0.5 * residuals.squaredNorm();
+  }
+  return 0.0;
+}
+}  // namespace
+
+TEST_F(SimulatedEstimatorTest, LocalOptimization) {
+  setUpEstimator(500);
+
+  // full optimisation on keyframes, only the two newest frames otherwise
+  const size_t K = 20;
+  const size_t numLocalFrames = 2;
+  for (size_t k = 0; k < K; ++k) {
+    addFrame(k);
+    if (k % 3 == 0) {
+      estimator_.optimize(10, 1, false);
+    }
+    else {
+      std::vector<uint64_t> oldFrames;
+      std::vector<okvis::kinematics::Transformation> oldPoses;
+      for (size_t n = numLocalFrames; n < estimator_.numFrames(); ++n) {
+        oldFrames.push_back(estimator_.frameIdByAge(n));
+        oldPoses.push_back(okvis::kinematics::Transformation());
+        estimator_.get_T_WS(oldFrames.back(), oldPoses.back());
+      }
+      estimator_.optimizeLocal(numLocalFrames, 10, 1, false);
+      for (size_t i = 0; i < oldFrames.size(); ++i) {
+        okvis::kinematics::Transformation T_WS;
+        estimator_.get_T_WS(oldFrames[i], T_WS);
+        EXPECT_TRUE(T_WS.T() == oldPoses[i].T());
+        // the old states are released again
+        EXPECT_FALSE(mapPtr_->parameterBlockPtr(oldFrames[i])->fixed());
+      }
+    }
+    marginalize();
+  }
+  expectNewestStateNear(K - 1, 0.1, 2.0e-2);
+}
+
+TEST_F(SimulatedEstimatorTest, LocalOptimizationPrior) {
+  setUpEstimator(500);
+  run(10);
+
+  // the full optimisation moves the old states away from the prior's linearization point
+  addFrame(10);
+  estimator_.optimize(10, 1, false);
+  const size_t numLocalFrames = 2;
+  std::vector<uint64_t> oldFrames;
+  for (size_t n = numLocalFrames; n < estimator_.numFrames(); ++n) {
+    oldFrames.push_back(estimator_.frameIdByAge(n));
+  }
+
+  // the prior's cost as seen by optimizeLocal(), i.e. with the old states held constant
+  auto priorCostOldStatesConstant = [&]() -> double {
+    for (size_t i = 0; i < oldFrames.size(); ++i) {
+      mapPtr_->setParameterBlockConstant(oldFrames[i]);
+    }
+    const double cost = priorCost(*mapPtr_);
+    for (size_t i = 0; i < oldFrames.size(); ++i) {
+      mapPtr_->setParameterBlockVariable(oldFrames[i]);
+    }
+    return cost;
+  };
+
+  const double priorCostBefore = priorCost(*mapPtr_);
+  ASSERT_GT(priorCostBefore, 0.0);
+  EXPECT_NEAR(priorCostOldStatesConstant(), priorCostBefore, 1.0e-9 * priorCostBefore);
+
+  estimator_.optimizeLocal(numLocalFrames, 10, 1, false);
+  const double priorCostAfter = priorCost(*mapPtr_);
+  ASSERT_GT(priorCostAfter, 0.0);
+  EXPECT_NEAR(priorCostOldStatesConstant(), priorCostAfter, 1.0e-9 * priorCostAfter);
+}
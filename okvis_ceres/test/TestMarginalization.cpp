@@ -43,6 +43,7 @@
 #include <okvis/ceres/ReprojectionError.hpp>
 #include <okvis/ceres/MarginalizationError.hpp>
 #include <okvis/ceres/PoseError.hpp>
+#include <okvis/ceres/RelativePoseError.hpp>
 #include <okvis/ceres/SpeedAndBiasError.hpp>
 #include <okvis/ceres/PoseParameterBlock.hpp>
 #include <okvis/ceres/SpeedAndBiasParameterBlock.hpp>
@@ -236,3 +237,286 @@ TEST(okvisTestSuite, Marginalization) {
       (T_WS2.r() - poseParameterBlock2_ptr->estimate().r()).norm() < 1e-1, "translation not close enough");
 }
 
+
+// Evaluate a marginalization error: residual and minimal Jacobians.
+static void evaluateMarginalizationError(
+    const okvis::ceres::MarginalizationError &marginalizationError,
+    const std::vector<std::shared_ptr<okvis::ceres::ParameterBlock> > &parameterBlockPtrs,
+    Eigen::VectorXd &residual, Eigen::MatrixXd &jacobian) {
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrix;
+  const size_t numResiduals = marginalizationError.residualDim();
+  std::vector<double *> parameters;
+  std::vector<RowMajorMatrix> minimalJacobians;
+  std::vector<double *> minimalJacobianPtrs;
+  size_t dimension = 0;
+  for (size_t i = 0; i < parameterBlockPtrs.size(); ++i) {
+    parameters.push_back(parameterBlockPtrs[i]->parameters());
+    minimalJacobians.push_back(
+        RowMajorMatrix(numResiduals, parameterBlockPtrs[i]->minimalDimension()));
+    dimension += parameterBlockPtrs[i]->minimalDimension();
+  }
+  for (size_t i = 0; i < parameterBlockPtrs.size(); ++i) {
+    minimalJacobianPtrs.push_back(minimalJacobians[i].data());
+  }
+  residual.resize(numResiduals);
+  marginalizationError.EvaluateWithMinimalJacobians(parameters.data(), residual.data(),
+                                                    NULL, minimalJacobianPtrs.data());
+  jacobian.resize(numResiduals, dimension);
+  size_t column = 0;
+  for (size_t i = 0; i < parameterBlockPtrs.size(); ++i) {
+    jacobian.middleCols(column, minimalJacobians[i].cols()) = minimalJacobians[i];
+    column += minimalJacobians[i].cols();
+  }
+}
+
+TEST(okvisTestSuite, MarginalizationFactorization) {
+  for (size_t withPrior = 0; withPrior < 2; ++withPrior) {
+    okvis::kinematics::Transformation T_WS0, T_WS1;
+    T_WS0.setRandom(10.0, M_PI);
+    T_WS1.setRandom(10.0, M_PI);
+    std::vector<std::shared_ptr<okvis::ceres::ParameterBlock> > parameterBlockPtrs;
+    parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+        new okvis::ceres::PoseParameterBlock(T_WS0, 1, okvis::Time(0))));
+    parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+        new okvis::ceres::PoseParameterBlock(T_WS1, 2, okvis::Time(0))));
+    parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+        new okvis::ceres::SpeedAndBiasParameterBlock(okvis::SpeedAndBias::Zero(), 3,
+                                                     okvis::Time(0))));
+
+    okvis::ceres::Map map;
+    map.addParameterBlock(parameterBlockPtrs[0], okvis::ceres::Map::Pose6d);
+    map.addParameterBlock(parameterBlockPtrs[1], okvis::ceres::Map::Pose6d);
+    map.addParameterBlock(parameterBlockPtrs[2]);
+
+    // without the pose prior, the absolute pose is unobservable
+    std::vector<::ceres::ResidualBlockId> residualBlockIds;
+    if (withPrior) {
+      okvis::kinematics::Transformation T_disturb;
+      T_disturb.setRandom(0.1, 0.01);
+      residualBlockIds.push_back(map.addResidualBlock(
+          std::shared_ptr<::ceres::CostFunction>(
+              new okvis::ceres::PoseError(T_WS0 * T_disturb, 1.0e-2, 1.0e-3)),
+          NULL, parameterBlockPtrs[0]));
+    }
+    residualBlockIds.push_back(map.addResidualBlock(
+        std::shared_ptr<::ceres::CostFunction>(
+            new okvis::ceres::RelativePoseError(1.0e-2, 1.0e-3)),
+        NULL, parameterBlockPtrs[0], parameterBlockPtrs[1]));
+    residualBlockIds.push_back(map.addResidualBlock(
+        std::shared_ptr<::ceres::CostFunction>(
+            new okvis::ceres::SpeedAndBiasError(0.1 * okvis::SpeedAndBias::Random(),
+                                                1.0, 1.0e-3, 1.0e-2)),
+        NULL, parameterBlockPtrs[2]));
+
+    okvis::ceres::MarginalizationError marginalizationError(map, residualBlockIds);
+
+    // move away from the linearization point
+    okvis::kinematics::Transformation T_delta;
+    T_delta.setRandom(0.1, 0.01);
+    std::static_pointer_cast<okvis::ceres::PoseParameterBlock>(parameterBlockPtrs[1])
+        ->setEstimate(T_WS1 * T_delta);
+
+    Eigen::VectorXd residualCholesky, residualEigen;
+    Eigen::MatrixXd jacobianCholesky, jacobianEigen;
+    marginalizationError.updateErrorComputation();
+    evaluateMarginalizationError(marginalizationError, parameterBlockPtrs,
+                                 residualCholesky, jacobianCholesky);
+    const okvis::ceres::MarginalizationError::Factorization factorization =
+        marginalizationError.lastFactorization();
+    marginalizationError.setFactorization(
+        okvis::ceres::MarginalizationError::Factorization::Eigendecomposition);
+    marginalizationError.updateErrorComputation();
+    evaluateMarginalizationError(marginalizationError, parameterBlockPtrs,
+                                 residualEigen, jacobianEigen);
+
+    if (withPrior) {
+      // full rank: the cheap LDLT is used
+      EXPECT_TRUE(factorization == okvis::ceres::MarginalizationError::Factorization::Cholesky);
+      EXPECT_EQ(21u, marginalizationError.residualDim());
+    } else {
+      // rank deficient: falls back, and only the nonzero rows are kept
+      EXPECT_TRUE(factorization
+                  == okvis::ceres::MarginalizationError::Factorization::Eigendecomposition);
+      EXPECT_EQ(15u, marginalizationError.residualDim());
+    }
+
+    // both factorizations describe the same cost, gradient and Hessian
+    const Eigen::MatrixXd H_cholesky = jacobianCholesky.transpose() * jacobianCholesky;
+    const Eigen::MatrixXd H_eigen = jacobianEigen.transpose() * jacobianEigen;
+    EXPECT_NEAR(residualCholesky.squaredNorm(), residualEigen.squaredNorm(),
+                1.0e-6 * residualEigen.squaredNorm());
+    EXPECT_LT((jacobianCholesky.transpose() * residualCholesky
+               - jacobianEigen.transpose() * residualEigen).norm(),
+              1.0e-6 * (jacobianEigen.transpose() * residualEigen).norm());
+    EXPECT_LT((H_cholesky - H_eigen).norm(), 1.0e-8 * H_eigen.norm());
+
+    // marginalizing the speed and biases: the size follows the factorization of the reduced H
+    marginalizationError.setFactorization(
+        okvis::ceres::MarginalizationError::Factorization::Cholesky);
+    ASSERT_TRUE(marginalizationError.marginalizeOut(std::vector<uint64_t>(1, 3),
+                                                    std::vector<bool>(1, true)));
+    EXPECT_EQ(12u, marginalizationError.residualDim());
+    marginalizationError.updateErrorComputation();
+    EXPECT_EQ(withPrior ? 12u : 6u, marginalizationError.residualDim());
+  }
+}
+
+TEST(okvisTestSuite, MarginalizationSparsification) {
+  // a chain of four poses with a pose prior and loop closures 0-2 and 0-3
+  const size_t numPoses = 4;
+  okvis::ceres::Map map;
+  std::vector<std::shared_ptr<okvis::ceres::ParameterBlock> > parameterBlockPtrs;
+  std::vector<okvis::kinematics::Transformation> T_WS(numPoses);
+  for (size_t i = 0; i < numPoses; ++i) {
+    T_WS[i].setRandom(10.0, M_PI);
+    parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+        new okvis::ceres::PoseParameterBlock(T_WS[i], i + 1, okvis::Time(0))));
+    map.addParameterBlock(parameterBlockPtrs[i], okvis::ceres::Map::Pose6d);
+  }
+  std::vector<::ceres::ResidualBlockId> residualBlockIds;
+  residualBlockIds.push_back(map.addResidualBlock(
+      std::shared_ptr<::ceres::CostFunction>(
+          new okvis::ceres::PoseError(T_WS[0], 1.0e-2, 1.0e-3)),
+      NULL, parameterBlockPtrs[0]));
+  const size_t edges[5][2] = { { 0, 1 }, { 1, 2 }, { 2, 3 }, { 0, 2 }, { 0, 3 } };
+  for (size_t e = 0; e < 5; ++e) {
+    residualBlockIds.push_back(map.addResidualBlock(
+        std::shared_ptr<::ceres::CostFunction>(
+            new okvis::ceres::RelativePoseError(1.0e-2 * (e + 1), 1.0e-3 * (e + 1))),
+        NULL, parameterBlockPtrs[edges[e][0]], parameterBlockPtrs[edges[e][1]]));
+  }
+  okvis::ceres::MarginalizationError marginalizationError(map, residualBlockIds);
+  std::vector<std::vector<uint64_t> > groups(numPoses);
+  for (size_t i = 0; i < numPoses; ++i) {
+    groups[i].push_back(parameterBlockPtrs[i]->id());
+  }
+
+  // loop closures cannot be represented by the chain: rejected if no divergence is allowed
+  std::vector<std::shared_ptr<okvis::ceres::MarginalizationError> > factors;
+  double kullbackLeibler = -1.0;
+  EXPECT_FALSE(marginalizationError.sparsify(groups, 0.0, factors, &kullbackLeibler));
+  EXPECT_GT(kullbackLeibler, 0.0);
+  EXPECT_TRUE(factors.empty());
+  EXPECT_EQ(24u, marginalizationError.residualDim());
+
+  // move away from the linearization point
+  for (size_t i = 0; i < numPoses; ++i) {
+    okvis::kinematics::Transformation T_delta;
+    T_delta.setRandom(0.1, 0.01);
+    std::static_pointer_cast<okvis::ceres::PoseParameterBlock>(parameterBlockPtrs[i])
+        ->setEstimate(T_WS[i] * T_delta);
+  }
+  Eigen::VectorXd residualDense;
+  Eigen::MatrixXd jacobianDense;
+  marginalizationError.updateErrorComputation();
+  evaluateMarginalizationError(marginalizationError, parameterBlockPtrs,
+                               residualDense, jacobianDense);
+  const Eigen::MatrixXd H_dense = jacobianDense.transpose() * jacobianDense;
+
+  ASSERT_TRUE(marginalizationError.sparsify(groups, 10.0, factors));
+  ASSERT_EQ(numPoses - 1, factors.size());
+
+  // the sparsified prior no longer couples poses that are not adjacent
+  Eigen::VectorXd residualSparse;
+  Eigen::MatrixXd jacobianSparse;
+  evaluateMarginalizationError(marginalizationError, parameterBlockPtrs,
+                               residualSparse, jacobianSparse);
+  const Eigen::MatrixXd H_sparse = jacobianSparse.transpose() * jacobianSparse;
+  EXPECT_LT(H_sparse.block<6, 6>(0, 12).norm(), 1.0e-8 * H_sparse.norm());
+  EXPECT_LT(H_sparse.block<6, 6>(0, 18).norm(), 1.0e-8 * H_sparse.norm());
+  EXPECT_LT(H_sparse.block<6, 6>(6, 18).norm(), 1.0e-8 * H_sparse.norm());
+  EXPECT_GT(H_dense.block<6, 6>(0, 18).norm(), 1.0e-3 * H_dense.norm());
+
+  // the factors sum up to the sparsified prior
+  Eigen::MatrixXd H_factors = Eigen::MatrixXd::Zero(24, 24);
+  Eigen::VectorXd gradientFactors = Eigen::VectorXd::Zero(24);
+  for (size_t k = 0; k < factors.size(); ++k) {
+    std::vector<std::shared_ptr<okvis::ceres::ParameterBlock> > factorParameterBlockPtrs;
+    factors[k]->getParameterBlockPtrs(factorParameterBlockPtrs);
+    ASSERT_EQ(2u, factorParameterBlockPtrs.size());
+    Eigen::VectorXd residual;
+    Eigen::MatrixXd jacobian;
+    evaluateMarginalizationError(*factors[k], factorParameterBlockPtrs, residual, jacobian);
+    Eigen::MatrixXd jacobianEmbedded = Eigen::MatrixXd::Zero(jacobian.rows(), 24);
+    for (size_t j = 0; j < factorParameterBlockPtrs.size(); ++j) {
+      jacobianEmbedded.middleCols(6 * (factorParameterBlockPtrs[j]->id() - 1), 6) =
+          jacobian.middleCols(6 * j, 6);
+    }
+    H_factors += jacobianEmbedded.transpose() * jacobianEmbedded;
+    gradientFactors += jacobianEmbedded.transpose() * residual;
+  }
+  EXPECT_LT((H_factors - H_sparse).norm(), 1.0e-8 * H_sparse.norm());
+  const Eigen::VectorXd gradientSparse = jacobianSparse.transpose() * residualSparse;
+  EXPECT_LT((gradientFactors - gradientSparse).norm(), 1.0e-6 * gradientSparse.norm());
+
+  // the marginals of adjacent poses are unchanged
+  const Eigen::MatrixXd covarianceDense = H_dense.inverse();
+  const Eigen::MatrixXd covarianceSparse = H_sparse.inverse();
+  for (size_t k = 0; k + 1 < numPoses; ++k) {
+    EXPECT_LT((covarianceDense.block<12, 12>(6 * k, 6 * k)
+               - covarianceSparse.block<12, 12>(6 * k, 6 * k)).norm(),
+              1.0e-6 * covarianceDense.block<12, 12>(6 * k, 6 * k).norm());
+  }
+}
+
+TEST(okvisTestSuite, MarginalizationConditioning) {
+  okvis::kinematics::Transformation T_WS0, T_WS1;
+  T_WS0.setRandom(10.0, M_PI);
+  T_WS1.setRandom(10.0, M_PI);
+  std::vector<std::shared_ptr<okvis::ceres::ParameterBlock> > parameterBlockPtrs;
+  parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+      new okvis::ceres::PoseParameterBlock(T_WS0, 1, okvis::Time(0))));
+  parameterBlockPtrs.push_back(std::shared_ptr<okvis::ceres::ParameterBlock>(
+      new okvis::ceres::PoseParameterBlock(T_WS1, 2, okvis::Time(0))));
+  okvis::ceres::Map map;
+  map.addParameterBlock(parameterBlockPtrs[0], okvis::ceres::Map::Pose6d);
+  map.addParameterBlock(parameterBlockPtrs[1], okvis::ceres::Map::Pose6d);
+  std::vector<::ceres::ResidualBlockId> residualBlockIds;
+  residualBlockIds.push_back(map.addResidualBlock(
+      std::shared_ptr<::ceres::CostFunction>(
+          new okvis::ceres::PoseError(T_WS0, 1.0e-2, 1.0e-3)),
+      NULL, parameterBlockPtrs[0]));
+  residualBlockIds.push_back(map.addResidualBlock(
+      std::shared_ptr<::ceres::CostFunction>(
+          new okvis::ceres::RelativePoseError(1.0e-2, 1.0e-3)),
+      NULL, parameterBlockPtrs[0], parameterBlockPtrs[1]));
+  okvis::ceres::MarginalizationError marginalizationError(map, residualBlockIds);
+
+  // move away from the linearization point
+  for (size_t i = 0; i < 2; ++i) {
+    okvis::kinematics::Transformation T_delta;
+    T_delta.setRandom(0.1, 0.01);
+    std::shared_ptr<okvis::ceres::PoseParameterBlock> poseParameterBlock =
+        std::static_pointer_cast<okvis::ceres::PoseParameterBlock>(parameterBlockPtrs[i]);
+    poseParameterBlock->setEstimate(poseParameterBlock->estimate() * T_delta);
+  }
+  Eigen::VectorXd residualFull;
+  Eigen::MatrixXd jacobianFull;
+  marginalizationError.updateErrorComputation();
+  evaluateMarginalizationError(marginalizationError, parameterBlockPtrs,
+                               residualFull, jacobianFull);
+
+  // hold the second pose at its current estimate
+  EXPECT_FALSE(marginalizationError.conditionOn(std::vector<uint64_t>(1, 3)));
+  ASSERT_TRUE(marginalizationError.conditionOn(std::vector<uint64_t>(1, 2)));
+  marginalizationError.updateErrorComputation();
+  EXPECT_EQ(1u, marginalizationError.parameterBlocks());
+  EXPECT_EQ(6u, marginalizationError.residualDim());
+  EXPECT_TRUE(marginalizationError.isParameterBlockConnected(1));
+  EXPECT_FALSE(marginalizationError.isParameterBlockConnected(2));
+  EXPECT_TRUE(map.parameterBlockExists(2));
+
+  // same gradient and Hessian w.r.t. the first pose
+  Eigen::VectorXd residualConditioned;
+  Eigen::MatrixXd jacobianConditioned;
+  evaluateMarginalizationError(
+      marginalizationError,
+      std::vector<std::shared_ptr<okvis::ceres::ParameterBlock> >(1, parameterBlockPtrs[0]),
+      residualConditioned, jacobianConditioned);
+  const Eigen::VectorXd gradientFull = (jacobianFull.transpose() * residualFull).head<6>();
+  const Eigen::MatrixXd H_full = (jacobianFull.transpose() * jacobianFull).topLeftCorner<6, 6>();
+  EXPECT_LT((jacobianConditioned.transpose() * residualConditioned - gradientFull).norm(),
+            1.0e-6 * gradientFull.norm());
+  EXPECT_LT((jacobianConditioned.transpose() * jacobianConditioned - H_full).norm(),
+            1.0e-8 * H_full.norm());
+}
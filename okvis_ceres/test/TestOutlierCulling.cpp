@@ -0,0 +1,137 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+#include <set>
+
+#include <gtest/gtest.h>
+#include "SimulatedEstimatorTest.hpp"
+
+namespace {
+// Associate every 20th keypoint of camera 0 in the newest frame with a wrong landmark.
+void corruptAssociations(okvis::Estimator &estimator,
+                         std::set<okvis::KeypointIdentifier> &corrupted) {
+  typedef okvis::cameras::PinholeCamera<okvis::cameras::EquidistantDistortion> CameraGeometry;
+  okvis::MultiFramePtr multiFrame = estimator.multiFrame(estimator.currentFrameId());
+  const size_t numKeypoints = multiFrame->numKeypoints(0);
+  for (size_t j = 0; j < numKeypoints; j += 20) {
+    const uint64_t landmarkId = multiFrame->landmarkId(0, j);
+    const uint64_t wrongLandmarkId = multiFrame->landmarkId(0, (j + numKeypoints / 2)
+                                                            % numKeypoints);
+    if (landmarkId == wrongLandmarkId) {
+      continue;
+    }
+    ASSERT_TRUE(estimator.removeObservation(landmarkId, multiFrame->id(), 0, j));
+    multiFrame->setLandmarkId(0, j, wrongLandmarkId);
+    estimator.addObservation<CameraGeometry>(wrongLandmarkId, multiFrame->id(), 0, j);
+    corrupted.insert(okvis::KeypointIdentifier(multiFrame->id(), 0, j));
+  }
+}
+}  // namespace
+
+TEST_F(SimulatedEstimatorTest, OutlierCulling) {
+  setUpEstimator(500);
+  estimator_.setOutlierCulling(5.991, 2, 2);
+
+  // associate every 20th keypoint of camera 0 in the early keyframes with a wrong landmark
+  const size_t K = 20;
+  std::set<okvis::KeypointIdentifier> corrupted;
+  size_t numCulled = 0;
+  for (size_t k = 0; k < K; ++k) {
+    addFrame(k);
+    if (k % 3 == 0 && k + 6 <= K) {
+      corruptAssociations(estimator_, corrupted);
+    }
+    estimator_.optimize(10, 1, false);
+    okvis::MapPointVector removedLandmarks(1);  // cullOutliers() appends
+    numCulled += estimator_.cullOutliers(removedLandmarks, 2);
+    for (size_t i = 1; i < removedLandmarks.size(); ++i) {
+      EXPECT_FALSE(estimator_.isLandmarkAdded(removedLandmarks[i].id));
+    }
+    marginalize();
+  }
+  ASSERT_FALSE(corrupted.empty());
+  EXPECT_GE(numCulled, corrupted.size() / 2);
+
+  // the wrong associations still in the window are gone
+  std::set<uint64_t> frames;
+  for (size_t n = 0; n < estimator_.numFrames(); ++n) {
+    frames.insert(estimator_.frameIdByAge(n));
+  }
+  size_t numChecked = 0;
+  for (std::set<okvis::KeypointIdentifier>::const_iterator it = corrupted.begin();
+       it != corrupted.end(); ++it) {
+    if (!frames.count(it->frameId)) {
+      continue;
+    }
+    ++numChecked;
+    EXPECT_EQ(estimator_.multiFrame(it->frameId)->landmarkId(it->cameraIndex, it->keypointIndex),
+              0u);
+  }
+  EXPECT_GT(numChecked, 0u);
+  expectNewestStateNear(K - 1, 0.1, 2.0e-2);
+}
+
+TEST_F(SimulatedEstimatorTest, OutlierCullingThreads) {
+  setUpEstimator(500);
+  estimator_.setOutlierCulling(5.991, 2, 2);
+  std::shared_ptr<okvis::ceres::Map> mapPtr(new okvis::ceres::Map);
+  okvis::Estimator estimator(mapPtr);
+  addSensors(estimator);
+  estimator.setOutlierCulling(5.991, 2, 2);
+
+  // identical problems, culled with one and with several threads
+  okvis::Estimator *estimators[2] = {&estimator_, &estimator};
+  const size_t numThreads[2] = {1, 4};
+  const size_t K = 20;
+  size_t numCulled = 0;
+  for (size_t k = 0; k < K; ++k) {
+    size_t numCulledObservations[2];
+    std::set<uint64_t> culledLandmarkIds[2];
+    for (size_t e = 0; e < 2; ++e) {
+      simulator_->addToEstimator(*estimators[e], k, k % 3 == 0);
+      if (k % 3 == 0 && k + 6 <= K) {
+        std::set<okvis::KeypointIdentifier> corrupted;
+        corruptAssociations(*estimators[e], corrupted);
+      }
+      estimators[e]->optimize(10, 1, false);
+      okvis::MapPointVector removedLandmarks;
+      numCulledObservations[e] = estimators[e]->cullOutliers(removedLandmarks, numThreads[e]);
+      for (size_t i = 0; i < removedLandmarks.size(); ++i) {
+        culledLandmarkIds[e].insert(removedLandmarks[i].id);
+      }
+      ASSERT_TRUE(estimators[e]->applyMarginalizationStrategy(3, 2, removedLandmarks));
+    }
+    EXPECT_EQ(numCulledObservations[0], numCulledObservations[1]);
+    EXPECT_TRUE(culledLandmarkIds[0] == culledLandmarkIds[1]);
+    numCulled += numCulledObservations[0];
+  }
+  EXPECT_GT(numCulled, 0u);
+}
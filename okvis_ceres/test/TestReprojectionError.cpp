@@ -37,6 +37,8 @@
 #include <okvis/cameras/EquidistantDistortion.hpp>
 #include <okvis/ceres/HomogeneousPointError.hpp>
 #include <okvis/ceres/ReprojectionError.hpp>
+#include <okvis/ceres/AnchoredReprojectionError.hpp>
+#include <okvis/ceres/StructurelessReprojectionError.hpp>
 #include <okvis/ceres/PoseParameterBlock.hpp>
 #include <okvis/ceres/PoseLocalParameterization.hpp>
 #include <okvis/ceres/HomogeneousPointLocalParameterization.hpp>
@@ -142,3 +144,199 @@ TEST(okvisTestSuite, ReprojectionError) {
   OKVIS_ASSERT_TRUE(Exception, 2 * (T_WS.q() * poseParameterBlock.estimate().q().inverse()).vec().norm() < 1e-2, "quaternions not close enough");
   OKVIS_ASSERT_TRUE(Exception, (T_WS.r() - poseParameterBlock.estimate().r()).norm() < 1e-1, "translation not close enough");
 }
+
+TEST(okvisTestSuite, AnchoredReprojectionError) {
+  OKVIS_DEFINE_EXCEPTION(Exception, std::runtime_error);
+  typedef okvis::cameras::PinholeCamera<okvis::cameras::EquidistantDistortion> DistortedPinholeCameraGeometry;
+  std::shared_ptr<const DistortedPinholeCameraGeometry> cameraGeometry =
+      std::static_pointer_cast<const DistortedPinholeCameraGeometry>(DistortedPinholeCameraGeometry::createTestObject());
+
+  // all parameter block layouts: anchor pose and/or anchor extrinsics shared with the observation
+  for (int layout = 0; layout < 4; ++layout) {
+    const bool anchorPoseShared = layout & 1;
+    const bool anchorExtrinsicsShared = layout & 2;
+    okvis::kinematics::Transformation T_WS, T_SC, T_disturb;
+    T_WS.setRandom(10.0, M_PI);
+    T_SC.setRandom(0.2, M_PI);
+    T_disturb.setRandom(0.5, 0.1);
+    const okvis::kinematics::Transformation T_WSa = anchorPoseShared ? T_WS : T_WS * T_disturb;
+    T_disturb.setRandom(0.1, 0.1);
+    const okvis::kinematics::Transformation T_SCa = anchorExtrinsicsShared ? T_SC : T_SC * T_disturb;
+
+    // a point visible in the observing camera, expressed in the anchor camera
+    const Eigen::Vector4d hp_C = cameraGeometry->createRandomVisibleHomogeneousPoint(10.0);
+    const Eigen::Vector4d hp_W = T_WS.T() * T_SC.T() * hp_C;
+    Eigen::Vector4d hp_Ca = (T_WSa * T_SCa).inverse().T() * hp_W;
+    hp_Ca /= hp_Ca.head<3>().norm();
+
+    Eigen::Vector2d kp;
+    cameraGeometry->projectHomogeneous(hp_C, &kp);
+    kp += Eigen::Vector2d::Random();
+    const Eigen::Matrix2d information = Eigen::Matrix2d::Identity();
+    okvis::ceres::AnchoredReprojectionError<DistortedPinholeCameraGeometry> anchoredError(
+        cameraGeometry, 1, kp, information, anchorPoseShared, anchorExtrinsicsShared);
+    okvis::ceres::ReprojectionError<DistortedPinholeCameraGeometry> error(
+        cameraGeometry, 1, kp, information);
+
+    std::vector<Eigen::Matrix<double, 7, 1> > poses;
+    poses.push_back(T_WS.parameters());
+    poses.push_back(T_SC.parameters());
+    if (!anchorPoseShared) {
+      poses.push_back(T_WSa.parameters());
+    }
+    if (!anchorExtrinsicsShared) {
+      poses.push_back(T_SCa.parameters());
+    }
+    std::vector<double *> parameters;
+    parameters.push_back(poses[0].data());
+    parameters.push_back(hp_Ca.data());
+    for (size_t i = 1; i < poses.size(); ++i) {
+      parameters.push_back(poses[i].data());
+    }
+    OKVIS_ASSERT_TRUE(Exception, anchoredError.parameterBlocks() == parameters.size(),
+                      "wrong number of parameter blocks");
+
+    // same residual as the world-frame error term
+    Eigen::Vector2d residual, worldResidual;
+    std::vector<Eigen::Matrix<double, 2, 7, Eigen::RowMajor> > jacobians(parameters.size());
+    std::vector<double *> jacobianPtrs;
+    for (size_t i = 0; i < parameters.size(); ++i) {
+      jacobianPtrs.push_back(jacobians[i].data());
+    }
+    anchoredError.Evaluate(&parameters[0], residual.data(), &jacobianPtrs[0]);
+    const double *worldParameters[3] = {poses[0].data(), hp_W.data(), poses[1].data()};
+    error.Evaluate(worldParameters, worldResidual.data(), NULL);
+    OKVIS_ASSERT_TRUE(Exception, (residual - worldResidual).norm() < 1e-6,
+                      "residual differs from ReprojectionError");
+
+    // Jacobians against central differences in the minimal coordinates
+    const double delta = 1e-6;
+    for (size_t i = 0; i < parameters.size(); ++i) {
+      const size_t dimension = (i == 1) ? 3 : 6;
+      const size_t size = (i == 1) ? 4 : 7;
+      Eigen::Matrix<double, 2, 6> numDiff = Eigen::Matrix<double, 2, 6>::Zero();
+      Eigen::Matrix<double, 2, 6> minimal = Eigen::Matrix<double, 2, 6>::Zero();
+      std::vector<double> x(parameters[i], parameters[i] + size);
+      for (size_t d = 0; d < dimension; ++d) {
+        Eigen::Vector2d residualP, residualM;
+        Eigen::Matrix<double, 6, 1> dx = Eigen::Matrix<double, 6, 1>::Zero();
+        dx[d] = delta;
+        if (i == 1) {
+          okvis::ceres::HomogeneousPointLocalParameterization::plus(&x[0], dx.data(), parameters[i]);
+        }
+        else {
+          okvis::ceres::PoseLocalParameterization::plus(&x[0], dx.data(), parameters[i]);
+        }
+        anchoredError.Evaluate(&parameters[0], residualP.data(), NULL);
+        dx[d] = -delta;
+        if (i == 1) {
+          okvis::ceres::HomogeneousPointLocalParameterization::plus(&x[0], dx.data(), parameters[i]);
+        }
+        else {
+          okvis::ceres::PoseLocalParameterization::plus(&x[0], dx.data(), parameters[i]);
+        }
+        anchoredError.Evaluate(&parameters[0], residualM.data(), NULL);
+        std::copy(x.begin(), x.end(), parameters[i]);
+        numDiff.col(d) = (residualP - residualM) / (2.0 * delta);
+      }
+      if (i == 1) {
+        Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor> > J(jacobians[i].data());
+        minimal.leftCols<3>() = J.leftCols<3>();
+      }
+      else {
+        Eigen::Matrix<double, 7, 6, Eigen::RowMajor> J_plus;
+        okvis::ceres::PoseLocalParameterization::plusJacobian(parameters[i], J_plus.data());
+        minimal = jacobians[i] * J_plus;
+      }
+      OKVIS_ASSERT_TRUE(Exception, (minimal - numDiff).norm() < 1e-4 * std::max(1.0, numDiff.norm()),
+                        "Jacobian " << i << " of layout " << layout << " wrong:\n"
+                        << minimal << "\nvs.\n" << numDiff);
+    }
+  }
+}
+
+TEST(okvisTestSuite, StructurelessReprojectionError) {
+  OKVIS_DEFINE_EXCEPTION(Exception, std::runtime_error);
+  typedef okvis::cameras::PinholeCamera<okvis::cameras::EquidistantDistortion> DistortedPinholeCameraGeometry;
+  std::shared_ptr<const DistortedPinholeCameraGeometry> cameraGeometry =
+      std::static_pointer_cast<const DistortedPinholeCameraGeometry>(DistortedPinholeCameraGeometry::createTestObject());
+
+  // a landmark observed from four poses through the same camera, without noise
+  okvis::kinematics::Transformation T_WC0, T_SC;
+  T_WC0.setRandom(10.0, M_PI);
+  T_SC.setRandom(0.2, M_PI);
+  const Eigen::Vector4d hp_W = T_WC0.T() * cameraGeometry->createRandomVisibleHomogeneousPoint(10.0);
+  const size_t numPoses = 4;
+  std::vector<Eigen::Matrix<double, 7, 1> > states;
+  okvis::ceres::StructurelessReprojectionError::Observations observations;
+  for (size_t i = 0; i < numPoses; ++i) {
+    okvis::kinematics::Transformation T_disturb;
+    T_disturb.setRandom(0.5, 0.05);
+    const okvis::kinematics::Transformation T_WS = T_WC0 * T_disturb * T_SC.inverse();
+    states.push_back(T_WS.parameters());
+    okvis::ceres::StructurelessReprojectionError::Observation observation;
+    observation.cameraGeometry = cameraGeometry;
+    cameraGeometry->projectHomogeneous((T_WS * T_SC).inverse().T() * hp_W,
+                                       &observation.measurement);
+    observation.squareRootInformation = 1.0;
+    observation.poseIdx = i;
+    observation.extrinsicsIdx = numPoses;
+    observations.push_back(observation);
+  }
+  states.push_back(T_SC.parameters());
+  std::vector<double *> parameters;
+  for (size_t i = 0; i < states.size(); ++i) {
+    parameters.push_back(states[i].data());
+  }
+
+  // start from a wrong landmark: the re-triangulation converges over a few evaluations
+  Eigen::Vector4d hp_W_init = hp_W;
+  hp_W_init.head<3>() += 0.05 * hp_W[3] * Eigen::Vector3d::Random();
+  okvis::ceres::StructurelessReprojectionError error(observations, states.size(), hp_W_init);
+  OKVIS_ASSERT_TRUE(Exception, error.residualDim() == 2 * numPoses - 3, "wrong residual dimension");
+  Eigen::VectorXd residual(error.residualDim());
+  for (size_t i = 0; i < 5; ++i) {
+    error.Evaluate(&parameters[0], residual.data(), NULL);
+  }
+  OKVIS_ASSERT_TRUE(Exception, residual.norm() < 1e-6, "non-zero residual: " << residual.transpose());
+  OKVIS_ASSERT_TRUE(Exception, (error.point().head<3>() / error.point()[3]
+                    - hp_W.head<3>() / hp_W[3]).norm() < 1e-6, "landmark not triangulated");
+  OKVIS_ASSERT_TRUE(Exception, error.quality() > 0.0, "landmark not observable");
+
+  // Jacobians against central differences in the minimal coordinates
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrix;
+  std::vector<RowMajorMatrix> jacobians(parameters.size(), RowMajorMatrix(error.residualDim(), 7));
+  std::vector<RowMajorMatrix> jacobiansMinimal(parameters.size(),
+                                               RowMajorMatrix(error.residualDim(), 6));
+  std::vector<double *> jacobianPtrs, jacobianMinimalPtrs;
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    jacobianPtrs.push_back(jacobians[i].data());
+    jacobianMinimalPtrs.push_back(jacobiansMinimal[i].data());
+  }
+  error.EvaluateWithMinimalJacobians(&parameters[0], residual.data(), &jacobianPtrs[0],
+                                     &jacobianMinimalPtrs[0]);
+  const double delta = 1e-6;
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    Eigen::MatrixXd numDiff(error.residualDim(), 6);
+    std::vector<double> x(parameters[i], parameters[i] + 7);
+    for (size_t d = 0; d < 6; ++d) {
+      Eigen::VectorXd residualP(error.residualDim()), residualM(error.residualDim());
+      Eigen::Matrix<double, 6, 1> dx = Eigen::Matrix<double, 6, 1>::Zero();
+      dx[d] = delta;
+      okvis::ceres::PoseLocalParameterization::plus(&x[0], dx.data(), parameters[i]);
+      error.Evaluate(&parameters[0], residualP.data(), NULL);
+      dx[d] = -delta;
+      okvis::ceres::PoseLocalParameterization::plus(&x[0], dx.data(), parameters[i]);
+      error.Evaluate(&parameters[0], residualM.data(), NULL);
+      std::copy(x.begin(), x.end(), parameters[i]);
+      numDiff.col(d) = (residualP - residualM) / (2.0 * delta);
+    }
+    Eigen::Matrix<double, 7, 6, Eigen::RowMajor> J_plus;
+    okvis::ceres::PoseLocalParameterization::plusJacobian(parameters[i], J_plus.data());
+    const Eigen::MatrixXd minimal = jacobians[i] * J_plus;
+    OKVIS_ASSERT_TRUE(Exception, (minimal - numDiff).norm() < 1e-4 * std::max(1.0, numDiff.norm()),
+                      "Jacobian " << i << " wrong:\n" << minimal << "\nvs.\n" << numDiff);
+    OKVIS_ASSERT_TRUE(Exception, (Eigen::MatrixXd(jacobiansMinimal[i]) - minimal).norm() < 1e-8,
+                      "minimal Jacobian " << i << " inconsistent");
+  }
+}
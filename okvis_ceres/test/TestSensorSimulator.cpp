@@ -0,0 +1,105 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+#include <gtest/gtest.h>
+#include <okvis/ceres/ImuError.hpp>
+#include "SimulatedEstimatorTest.hpp"
+
+TEST(okvisTestSuite, SensorSimulatorImuConsistency) {
+  okvis::cameras::NCameraSystem cameraSystem;
+  okvis::ImuParameters imuParameters;
+  createTestSetup(cameraSystem, imuParameters);
+  okvis::SimulationParameters simulationParameters;
+  simulationParameters.imuNoise = false;
+  okvis::SensorSimulator simulator(cameraSystem, imuParameters, simulationParameters);
+
+  // noise-free IMU integration must follow the ground truth trajectory
+  for (size_t k = 0; k + 10 < simulator.numFrames(); k += 10) {
+    okvis::kinematics::Transformation T_WS, T_WS_true;
+    okvis::SpeedAndBias speedAndBias, speedAndBias_true;
+    ASSERT_TRUE(simulator.groundTruth(simulator.frameTimestamp(k), T_WS, speedAndBias));
+    okvis::ceres::ImuError::propagation(simulator.imuMeasurements(), imuParameters,
+                                        T_WS, speedAndBias, simulator.frameTimestamp(k),
+                                        simulator.frameTimestamp(k + 10));
+    ASSERT_TRUE(simulator.groundTruth(simulator.frameTimestamp(k + 10), T_WS_true,
+                                      speedAndBias_true));
+    EXPECT_LT((T_WS.r() - T_WS_true.r()).norm(), 1.0e-2);
+    EXPECT_LT(2 * (T_WS.q() * T_WS_true.q().inverse()).vec().norm(), 1.0e-3);
+    EXPECT_LT((speedAndBias.head<3>() - speedAndBias_true.head<3>()).norm(), 1.0e-2);
+  }
+
+  // the first state is gravity aligned at the origin
+  okvis::kinematics::Transformation T_WS0;
+  okvis::SpeedAndBias speedAndBias0;
+  ASSERT_TRUE(simulator.groundTruth(simulator.frameTimestamp(0), T_WS0, speedAndBias0));
+  EXPECT_LT(T_WS0.r().norm(), 1.0e-9);
+}
+
+TEST(okvisTestSuite, SensorSimulatorDeterminism) {
+  okvis::cameras::NCameraSystem cameraSystem;
+  okvis::ImuParameters imuParameters;
+  createTestSetup(cameraSystem, imuParameters);
+  okvis::SimulationParameters simulationParameters;
+  okvis::SensorSimulator simulator0(cameraSystem, imuParameters, simulationParameters);
+  okvis::SensorSimulator simulator1(cameraSystem, imuParameters, simulationParameters);
+
+  ASSERT_EQ(simulator0.imuMeasurements().size(), simulator1.imuMeasurements().size());
+  EXPECT_EQ(simulator0.imuMeasurements().back().measurement.accelerometers,
+            simulator1.imuMeasurements().back().measurement.accelerometers);
+
+  okvis::MultiFramePtr mf0 = simulator0.simulateMultiFrame(3);
+  okvis::MultiFramePtr mf1 = simulator1.simulateMultiFrame(3);
+  for (size_t i = 0; i < cameraSystem.numCameras(); ++i) {
+    ASSERT_GT(mf0->numKeypoints(i), 50u);
+    ASSERT_EQ(mf0->numKeypoints(i), mf1->numKeypoints(i));
+    for (size_t j = 0; j < mf0->numKeypoints(i); ++j) {
+      Eigen::Vector2d kp0, kp1;
+      mf0->getKeypoint(i, j, kp0);
+      mf1->getKeypoint(i, j, kp1);
+      EXPECT_EQ(kp0, kp1);
+    }
+  }
+
+  cv::Mat image = simulator0.renderImage(3, 0);
+  EXPECT_EQ(image.cols, int(cameraSystem.cameraGeometry(0)->imageWidth()));
+  EXPECT_EQ(image.rows, int(cameraSystem.cameraGeometry(0)->imageHeight()));
+}
+
+TEST_F(SimulatedEstimatorTest, SensorSimulatorEstimator) {
+  setUpEstimator(500);
+
+  const size_t K = 8;
+  for (size_t k = 0; k < K; ++k) {
+    EXPECT_GT(addFrame(k), 0u);
+    estimator_.optimize(10, 1, false);
+  }
+  expectNewestStateNear(K - 1, 0.05, 1.0e-2);
+}
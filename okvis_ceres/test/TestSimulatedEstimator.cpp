@@ -0,0 +1,378 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include <gtest/gtest.h>
+#include "SimulatedEstimatorTest.hpp"
+
+TEST_F(SimulatedEstimatorTest, MarginalizedStates) {
+  setUpEstimator(500);
+
+  // every frame must be reported exactly once, in order, when its pose is marginalized
+  const size_t K = 30;
+  const size_t numKeyframes = 3;
+  const size_t numImuFrames = 2;
+  std::vector<uint64_t> frameIds;
+  okvis::FrameStateVector marginalizedStates;
+  for (size_t k = 0; k < K; ++k) {
+    addFrame(k);
+    frameIds.push_back(estimator_.currentFrameId());
+    estimator_.optimize(10, 1, false);
+    okvis::MapPointVector removedLandmarks;
+    estimator_.applyMarginalizationStrategy(numKeyframes, numImuFrames, removedLandmarks,
+                                            &marginalizedStates);
+    EXPECT_LE(estimator_.numFrames(), numKeyframes + numImuFrames);
+  }
+  ASSERT_GT(marginalizedStates.size(), K - 2 * (numKeyframes + numImuFrames));
+  std::set<uint64_t> reported;
+  for (size_t i = 0; i < marginalizedStates.size(); ++i) {
+    const okvis::FrameState &state = marginalizedStates[i];
+    EXPECT_TRUE(reported.insert(state.frameId).second);
+    if (i > 0) {
+      EXPECT_GT(state.timestamp, marginalizedStates[i - 1].timestamp);
+    }
+    const size_t k = std::find(frameIds.begin(), frameIds.end(), state.frameId)
+        - frameIds.begin();
+    ASSERT_LT(k, K);
+    EXPECT_EQ(state.timestamp, simulator_->frameTimestamp(k));
+    okvis::kinematics::Transformation T_WS_true;
+    okvis::SpeedAndBias speedAndBias_true;
+    simulator_->groundTruth(state.timestamp, T_WS_true, speedAndBias_true);
+    EXPECT_LT((state.T_WS.r() - T_WS_true.r()).norm(), 0.1);
+  }
+}
+
+TEST_F(SimulatedEstimatorTest, ObservationMarginalization) {
+  setUpEstimator(500);
+  estimator_.setLandmarkMarginalizationPolicy(2, 0.0);
+
+  // all landmarks with two observations are marginalized
+  const size_t K = 30;
+  EXPECT_GT(run(K), 0u);
+  expectNewestStateNear(K - 1, 0.1, 2.0e-2);
+}
+
+TEST_F(SimulatedEstimatorTest, ObservationDropping) {
+  setUpEstimator(500);
+  estimator_.setLandmarkMarginalizationPolicy(1000, 0.0);
+
+  // dropping all landmarks loses information, but the window still constrains the state
+  const size_t K = 30;
+  EXPECT_GT(run(K), 0u);
+  expectNewestStateNear(K - 1, 0.1, 2.0e-2);
+}
+
+TEST_F(SimulatedEstimatorTest, AnchoredLandmarks) {
+  setUpEstimator(500);
+  estimator_.setAnchoredLandmarks(true);
+
+  // anchor frames leave the window while their landmarks are still observed
+  auto anchorPoseId = [this](uint64_t landmarkId) -> uint64_t {
+    return std::static_pointer_cast<okvis::ceres::InverseDepthParameterBlock>(
+        mapPtr_->parameterBlockPtr(landmarkId))->anchorPoseId();
+  };
+  std::map<uint64_t, uint64_t> initialAnchors;
+  const size_t K = 30;
+  for (size_t k = 0; k < K; ++k) {
+    addFrame(k);
+    estimator_.optimize(10, 1, false);
+    marginalize();
+    if (k == 5) {
+      okvis::PointMap landmarks;
+      estimator_.getLandmarks(landmarks);
+      for (okvis::PointMap::const_iterator it = landmarks.begin(); it != landmarks.end(); ++it) {
+        initialAnchors[it->first] = anchorPoseId(it->first);
+      }
+    }
+  }
+
+  // all landmarks are anchored in a frame of the window and close to the truth
+  okvis::PointMap landmarks;
+  ASSERT_GT(estimator_.getLandmarks(landmarks), 0u);
+  size_t numReanchored = 0;
+  for (okvis::PointMap::const_iterator it = landmarks.begin(); it != landmarks.end(); ++it) {
+    std::shared_ptr<okvis::ceres::InverseDepthParameterBlock> pointParameterBlock =
+        std::dynamic_pointer_cast<okvis::ceres::InverseDepthParameterBlock>(
+            mapPtr_->parameterBlockPtr(it->first));
+    ASSERT_TRUE(pointParameterBlock && pointParameterBlock->anchored());
+    ASSERT_TRUE(mapPtr_->parameterBlockExists(pointParameterBlock->anchorPoseId()));
+    if (initialAnchors.count(it->first)
+        && initialAnchors.at(it->first) != pointParameterBlock->anchorPoseId()) {
+      ++numReanchored;
+    }
+    const Eigen::Vector4d &hp_W = simulator_->landmarks().at(it->first).point;
+    EXPECT_LT((it->second.point.head<3>() / it->second.point[3]
+        - hp_W.head<3>() / hp_W[3]).norm(), 0.5);
+  }
+  EXPECT_GT(numReanchored, 0u);
+  expectNewestStateNear(K - 1, 0.1, 2.0e-2);
+}
+
+TEST_F(SimulatedEstimatorTest, TrustRegionWarmStart) {
+  setUpEstimator(500);
+  estimator_.setTrustRegionWarmStart(true);
+  EXPECT_EQ(estimator_.trustRegionRadius(), 0.0);
+  const double initialTrustRegionRadius = 1.0e3;
+  mapPtr_->options.initial_trust_region_radius = initialTrustRegionRadius;
+
+  // each optimisation starts where the previous one ended, the options stay untouched
+  const size_t K = 20;
+  for (size_t k = 0; k < K; ++k) {
+    addFrame(k);
+    const double trustRegionRadius = estimator_.trustRegionRadius();
+    estimator_.optimize(10, 1, false);
+    EXPECT_EQ(mapPtr_->options.initial_trust_region_radius, initialTrustRegionRadius);
+    ASSERT_FALSE(mapPtr_->summary.iterations.empty());
+    EXPECT_DOUBLE_EQ(mapPtr_->summary.iterations.front().trust_region_radius,
+                     trustRegionRadius > 0.0 ?
+                         std::min(std::max(trustRegionRadius, 1.0e-4 * initialTrustRegionRadius),
+                                  mapPtr_->options.max_trust_region_radius) :
+                         initialTrustRegionRadius);
+    EXPECT_GT(estimator_.trustRegionRadius(), 0.0);
+    marginalize();
+  }
+  expectNewestStateNear(K - 1, 0.1, 2.0e-2);
+}
+
+TEST_F(SimulatedEstimatorTest, ExtrinsicsFreeze) {
+  // online calibration, frozen once converged
+  setUpEstimator(500, okvis::ExtrinsicsEstimationParameters(1.0e-3, 1.0e-3, 1.0e-5, 1.0e-5));
+  estimator_.setExtrinsicsAutoFreeze(true, 1.0e-2, 1.0e-2, 3);
+
+  // pose blocks are the frame poses and the distinct extrinsics
+  auto numExtrinsicsBlocks = [this]() -> size_t {
+    size_t numPoseBlocks = 0;
+    for (auto it = mapPtr_->id2parameterBlockMap().begin();
+         it != mapPtr_->id2parameterBlockMap().end(); ++it) {
+      if (it->second->typeInfo() == "PoseParameterBlock") {
+        ++numPoseBlocks;
+      }
+    }
+    return numPoseBlocks - estimator_.numFrames();
+  };
+
+  const size_t K = 30;
+  run(K);
+  ASSERT_TRUE(estimator_.extrinsicsFrozen(0));
+  ASSERT_TRUE(estimator_.extrinsicsFrozen(1));
+
+  // by now, all frames share the frozen blocks
+  EXPECT_EQ(2u, numExtrinsicsBlocks());
+  okvis::kinematics::Transformation T_SC;
+  ASSERT_TRUE(estimator_.getCameraSensorStates(estimator_.currentFrameId(), 0, T_SC));
+  EXPECT_LT((T_SC.r() - cameraSystem_.T_SC(0)->r()).norm(), 1.0e-2);
+  expectNewestStateNear(K - 1, 0.1, 2.0e-2);
+
+  // re-enabled: new frames get their own extrinsics again
+  estimator_.setExtrinsicsAutoFreeze(false, 1.0e-2, 1.0e-2, 3);
+  EXPECT_FALSE(estimator_.extrinsicsFrozen(0));
+  for (size_t k = K; k < K + 3; ++k) {
+    addFrame(k);
+    estimator_.optimize(10, 1, false);
+    marginalize();
+  }
+  EXPECT_GT(numExtrinsicsBlocks(), 2u);
+}
+
+TEST_F(SimulatedEstimatorTest, Covariance) {
+  setUpEstimator(300);
+  for (size_t k = 0; k < 12; ++k) {
+    addFrame(k);
+    estimator_.optimize(10, 1, false);
+    marginalize(2, 2);
+  }
+
+  Eigen::Matrix<double, 15, 15> covariance;
+  ASSERT_TRUE(estimator_.computeCovariance(estimator_.currentFrameId(), covariance));
+  EXPECT_LT((covariance - covariance.transpose()).norm(), 1.0e-9 * covariance.norm());
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 15, 15> > saes(covariance);
+  EXPECT_GT(saes.eigenvalues().minCoeff(), 0.0);
+
+  // compare with the inverse of the full Hessian including landmarks
+  std::map<uint64_t, size_t> orderingIdx;
+  size_t dimension = 0;
+  for (auto it = mapPtr_->id2parameterBlockMap().begin();
+       it != mapPtr_->id2parameterBlockMap().end(); ++it) {
+    if (!it->second->fixed()) {
+      orderingIdx[it->first] = dimension;
+      dimension += it->second->minimalDimension();
+    }
+  }
+  Eigen::MatrixXd H = Eigen::MatrixXd::Zero(dimension, dimension);
+  for (auto rit = mapPtr_->residualBlockId2ResidualBlockSpecMap().begin();
+       rit != mapPtr_->residualBlockId2ResidualBlockSpecMap().end(); ++rit) {
+    const okvis::ceres::Map::ParameterBlockCollection parameters =
+        mapPtr_->parameters(rit->first);
+    const size_t residualDim = rit->second.errorInterfacePtr->residualDim();
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrix;
+    std::vector<RowMajorMatrix> J(parameters.size()), J_min(parameters.size());
+    std::vector<double *> parametersRaw, jacobiansRaw, jacobiansMinimalRaw;
+    for (size_t i = 0; i < parameters.size(); ++i) {
+      J[i].resize(residualDim, parameters[i].second->dimension());
+      J_min[i].resize(residualDim, parameters[i].second->minimalDimension());
+      parametersRaw.push_back(parameters[i].second->parameters());
+      jacobiansRaw.push_back(J[i].data());
+      jacobiansMinimalRaw.push_back(J_min[i].data());
+    }
+    Eigen::VectorXd residuals(residualDim);
+    rit->second.errorInterfacePtr->EvaluateWithMinimalJacobians(
+        parametersRaw.data(), residuals.data(), jacobiansRaw.data(), jacobiansMinimalRaw.data());
+    double weight = 1.0;
+    if (rit->second.lossFunctionPtr) {
+      double rho[3];
+      rit->second.lossFunctionPtr->Evaluate(residuals.squaredNorm(), rho);
+      weight = rho[1];
+    }
+    for (size_t i = 0; i < parameters.size(); ++i) {
+      for (size_t j = 0; j < parameters.size(); ++j) {
+        if (orderingIdx.count(parameters[i].first) && orderingIdx.count(parameters[j].first)) {
+          H.block(orderingIdx.at(parameters[i].first), orderingIdx.at(parameters[j].first),
+                  J_min[i].cols(), J_min[j].cols()) +=
+              weight * J_min[i].transpose() * J_min[j];
+        }
+      }
+    }
+  }
+  // landmarks with unobservable depth are treated by pseudo inversion; regularise them here
+  for (auto it = orderingIdx.begin(); it != orderingIdx.end(); ++it) {
+    if (estimator_.isLandmarkAdded(it->first)) {
+      H.block<3, 3>(it->second, it->second) += 1.0e-8 * Eigen::Matrix3d::Identity();
+    }
+  }
+  okvis::SpeedAndBias speedAndBias;
+  ASSERT_TRUE(estimator_.getSpeedAndBias(estimator_.currentFrameId(), 0, speedAndBias));
+  uint64_t speedAndBiasId = 0;
+  for (auto it = orderingIdx.begin(); it != orderingIdx.end(); ++it) {
+    std::shared_ptr<okvis::ceres::SpeedAndBiasParameterBlock> block =
+        std::dynamic_pointer_cast<okvis::ceres::SpeedAndBiasParameterBlock>(
+            mapPtr_->parameterBlockPtr(it->first));
+    if (block && block->estimate() == speedAndBias) {
+      speedAndBiasId = it->first;
+    }
+  }
+  ASSERT_NE(speedAndBiasId, 0u);
+  const Eigen::MatrixXd P = H.ldlt().solve(Eigen::MatrixXd::Identity(dimension, dimension));
+  const size_t poseIdx = orderingIdx.at(estimator_.currentFrameId());
+  const size_t speedAndBiasIdx = orderingIdx.at(speedAndBiasId);
+  EXPECT_LT((covariance.topLeftCorner<6, 6>() - P.block(poseIdx, poseIdx, 6, 6)).norm(),
+            1.0e-4 * P.block(poseIdx, poseIdx, 6, 6).norm());
+  EXPECT_LT((covariance.bottomRightCorner<9, 9>()
+      - P.block(speedAndBiasIdx, speedAndBiasIdx, 9, 9)).norm(),
+            1.0e-4 * P.block(speedAndBiasIdx, speedAndBiasIdx, 9, 9).norm());
+
+  Eigen::Matrix<double, 15, 15> stateUncertainty;
+  ASSERT_TRUE(estimator_.getStateUncertainty(stateUncertainty));
+  EXPECT_EQ(stateUncertainty, covariance);
+
+  // a zero time budget is exceeded immediately
+  EXPECT_FALSE(estimator_.computeCovariance(estimator_.currentFrameId(), covariance, 0.0));
+}
+
+TEST_F(SimulatedEstimatorTest, RefineState) {
+  setUpEstimator(500);
+  const size_t K = 8;
+  for (size_t k = 0; k < K - 1; ++k) {
+    addFrame(k);
+    estimator_.optimize(10, 1, false);
+  }
+  simulator_->addToEstimator(estimator_, K - 1, false);
+  const uint64_t poseId = estimator_.currentFrameId();
+
+  // perturb the new state, then refine it alone
+  okvis::kinematics::Transformation T_WS_true;
+  okvis::SpeedAndBias speedAndBias_true;
+  simulator_->groundTruth(simulator_->frameTimestamp(K - 1), T_WS_true, speedAndBias_true);
+  okvis::kinematics::Transformation T_WS;
+  okvis::SpeedAndBias speedAndBias;
+  ASSERT_TRUE(estimator_.get_T_WS(poseId, T_WS));
+  ASSERT_TRUE(estimator_.getSpeedAndBias(poseId, 0, speedAndBias));
+  Eigen::Matrix<double, 6, 1> delta;
+  delta << 0.05, -0.04, 0.03, 0.01, -0.02, 0.01;
+  T_WS.oplus(delta);
+  speedAndBias.head<3>() += Eigen::Vector3d(0.1, -0.1, 0.05);
+  ASSERT_TRUE(estimator_.set_T_WS(poseId, T_WS));
+  ASSERT_TRUE(estimator_.setSpeedAndBias(poseId, 0, speedAndBias));
+  const double positionError = (T_WS.r() - T_WS_true.r()).norm();
+  const double rotationError = 2 * (T_WS.q() * T_WS_true.q().inverse()).vec().norm();
+
+  EXPECT_TRUE(estimator_.refineState(poseId, 5));
+  okvis::kinematics::Transformation T_WS_refined;
+  ASSERT_TRUE(estimator_.get_T_WS(poseId, T_WS_refined));
+  EXPECT_LT((T_WS_refined.r() - T_WS_true.r()).norm(), 0.5 * positionError);
+  EXPECT_LT(2 * (T_WS_refined.q() * T_WS_true.q().inverse()).vec().norm(),
+            0.5 * rotationError);
+
+  // only states in the window can be refined
+  EXPECT_FALSE(estimator_.refineState(poseId + 1000000, 5));
+}
+
+TEST_F(SimulatedEstimatorTest, Covisibility) {
+  setUpEstimator(300);
+  std::vector<uint64_t> frameIds;
+  for (size_t k = 0; k < 15; ++k) {
+    addFrame(k);
+    frameIds.push_back(estimator_.currentFrameId());
+    estimator_.optimize(5, 1, false);
+    marginalize(2, 2);
+
+    // the graph must match the observations of the remaining landmarks
+    std::map<uint64_t, std::map<uint64_t, size_t> > expected;
+    okvis::PointMap landmarks;
+    estimator_.getLandmarks(landmarks);
+    for (auto it = landmarks.begin(); it != landmarks.end(); ++it) {
+      std::set<uint64_t> observingFrames;
+      for (auto ot = it->second.observations.begin(); ot != it->second.observations.end();
+          ++ot) {
+        observingFrames.insert(ot->first.frameId);
+      }
+      for (uint64_t a : observingFrames) {
+        for (uint64_t b : observingFrames) {
+          expected[a][b]++;
+        }
+      }
+    }
+    for (uint64_t a : frameIds) {
+      for (uint64_t b : frameIds) {
+        const size_t numExpected = expected.count(a) && expected[a].count(b) ? expected[a][b] : 0;
+        EXPECT_EQ(estimator_.numCovisibleLandmarks(a, b), numExpected);
+      }
+    }
+  }
+
+  // the newest frame shares landmarks with the previous one
+  std::map<uint64_t, size_t> covisibleFrames;
+  EXPECT_GT(estimator_.getCovisibleFrames(estimator_.currentFrameId(), covisibleFrames), 0u);
+  EXPECT_EQ(covisibleFrames.count(estimator_.currentFrameId()), 0u);
+  EXPECT_GT(covisibleFrames[estimator_.frameIdByAge(1)], 0u);
+}
@@ -0,0 +1,78 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+#include <gtest/gtest.h>
+#include <okvis/StructurelessEstimator.hpp>
+#include "SimulatedEstimatorTest.hpp"
+
+TEST_F(SimulatedEstimatorTest, StructurelessEstimator) {
+  setUpEstimator(500);
+  std::shared_ptr<okvis::ceres::Map> mapPtr(new okvis::ceres::Map);
+  okvis::StructurelessEstimator estimator(mapPtr);
+  addSensors(estimator);
+
+  // the same sequence as the SensorSimulatorEstimator test, but through a marginalization window
+  const size_t K = 30;
+  size_t numRemovedLandmarks = 0;
+  for (size_t k = 0; k < K; ++k) {
+    EXPECT_GT(simulator_->addToEstimator(estimator, k, k % 3 == 0), 0u);
+    estimator.optimize(10, 1, false);
+    okvis::MapPointVector removedLandmarks;
+    ASSERT_TRUE(estimator.applyMarginalizationStrategy(3, 2, removedLandmarks));
+    numRemovedLandmarks += removedLandmarks.size();
+  }
+  EXPECT_GT(numRemovedLandmarks, 0u);
+  EXPECT_GT(estimator.numTrackErrors(), 0u);
+
+  // no landmark is a parameter block, but the re-triangulated points follow the ground truth
+  okvis::PointMap landmarks;
+  ASSERT_GT(estimator.getLandmarks(landmarks), 0u);
+  size_t numTriangulated = 0;
+  for (okvis::PointMap::const_iterator it = landmarks.begin(); it != landmarks.end(); ++it) {
+    EXPECT_FALSE(mapPtr->parameterBlockExists(it->first));
+    if (!estimator.isLandmarkInitialized(it->first)) {
+      continue;
+    }
+    const Eigen::Vector4d &hp_W_true = simulator_->landmarks().at(it->first).point;
+    const Eigen::Vector3d p_W = it->second.point.head<3>() / it->second.point[3];
+    EXPECT_LT((p_W - hp_W_true.head<3>() / hp_W_true[3]).norm(), 0.5);
+    ++numTriangulated;
+  }
+  EXPECT_GT(numTriangulated, 0u);
+
+  okvis::kinematics::Transformation T_WS_est, T_WS_true;
+  okvis::SpeedAndBias speedAndBias_true;
+  ASSERT_TRUE(estimator.get_T_WS(estimator.currentFrameId(), T_WS_est));
+  ASSERT_TRUE(simulator_->groundTruth(simulator_->frameTimestamp(K - 1), T_WS_true,
+                                      speedAndBias_true));
+  EXPECT_LT((T_WS_est.r() - T_WS_true.r()).norm(), 0.1);
+  EXPECT_LT(2 * (T_WS_est.q() * T_WS_true.q().inverse()).vec().norm(), 2.0e-2);
+}
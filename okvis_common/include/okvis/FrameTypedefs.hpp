@@ -44,6 +44,7 @@
 #include <map>
 
 #include <Eigen/Core>
+#include <okvis/Time.hpp>
 #include <okvis/kinematics/Transformation.hpp>
 
 /// \brief okvis Main namespace of this package.
@@ -236,6 +237,36 @@ struct Observation
 
 typedef std::vector<Observation, Eigen::aligned_allocator<Observation> > ObservationVector;
 
+/// \brief The pose estimate of a frame, e.g. its final one when it is marginalized.
+struct FrameState
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /// \brief Default constructor.
+  FrameState()
+      : frameId(0) {
+  }
+
+  /**
+   * @brief Constructor.
+   * @param frameId   Multiframe ID.
+   * @param timestamp Multiframe timestamp.
+   * @param T_WS      Pose of the IMU in the world frame.
+   */
+  FrameState(uint64_t frameId, const okvis::Time &timestamp,
+             const okvis::kinematics::Transformation &T_WS)
+      : frameId(frameId),
+        timestamp(timestamp),
+        T_WS(T_WS) {
+  }
+
+  uint64_t frameId;  ///< Multiframe ID.
+  okvis::Time timestamp;  ///< Multiframe timestamp.
+  okvis::kinematics::Transformation T_WS;  ///< Pose of the IMU in the world frame.
+};
+
+typedef std::vector<FrameState, Eigen::aligned_allocator<FrameState> > FrameStateVector;
+
 // todo: find a better place for this
 typedef Eigen::Matrix<double, 9, 1> SpeedAndBiases;
 typedef Eigen::Matrix<double, 9, 1> SpeedAndBias;
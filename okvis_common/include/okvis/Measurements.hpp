@@ -188,6 +188,10 @@ typedef std::deque<ImuMeasurement, Eigen::aligned_allocator<ImuMeasurement> > Im
 /// \brief Camera measurement.
 struct CameraData
 {
+  /// \brief Set if image points to a caller-owned buffer. The buffer is released
+  ///        (and the caller notified) when the last copy of this is destroyed.
+  ///        Declared first, such that it is destroyed after the image.
+  std::shared_ptr<void> imageLease;
   cv::Mat image;  ///< Image.
   std::vector<cv::KeyPoint> keypoints; ///< Keypoints if available.
   bool deliversKeypoints; ///< Are the keypoints delivered too?
@@ -261,8 +261,27 @@ struct Optimization
   bool useMedianFilter;     ///< Use a Median filter over captured image?
   int detectionOctaves;     ///< Number of keypoint detection octaves.
   int maxNoKeypoints;       ///< Restrict to a maximum of this many keypoints per image (strongest ones).
+  int detectionGridColumns = 0; ///< Spread the keypoints over a grid of this many columns. 0 disables bucketing.
+  int detectionGridRows = 0; ///< Spread the keypoints over a grid of this many rows. 0 disables bucketing.
+  int detectionCellQuota = 0; ///< Strongest keypoints retained per grid cell first. 0: maxNoKeypoints / number of cells.
   int numKeyframes; ///< Number of keyframes.
   int numImuFrames; ///< Number of IMU frames.
+  int numMatchingKeyframes3d2d = 3; ///< New frames are matched 3D-2D to this many keyframes with the largest predicted overlap.
+  int numMatchingKeyframes2d2d = 2; ///< New frames are matched 2D-2D to this many keyframes with the largest predicted overlap.
+  bool mapToFrameMatching = false; ///< Match all initialised landmarks 3D-2D in one pass instead of keyframe by keyframe.
+  int marginalizationMinObservations = 2; ///< Landmarks leaving the window with fewer observations are dropped instead of marginalized.
+  double marginalizationMinQuality = 0.0; ///< Landmarks leaving the window with a lower quality are dropped instead of marginalized.
+  int maxLandmarks = 0; ///< Prune the least useful landmarks in excess of this number before each optimization. 0: no limit.
+  bool priorSparsification = false; ///< Approximate the marginalization prior by a chain of factors over consecutive frames.
+  double priorSparsificationMaxKld = 1.0; ///< Keep the dense prior if the sparsified one diverges more than this. [nats]
+  bool anchoredLandmarks = false; ///< Parameterise landmarks by inverse depth in the camera of their first observation.
+  bool warmStartTrustRegion = false; ///< Start each optimization from the previous trust region radius.
+  /// Gauss-Newton iterations of the motion-only refinement of the newest state right after matching,
+  /// which is published ahead of the full optimization. 0 disables it.
+  int poseRefinementIterations = 0;
+  bool localOptimization = false; ///< On non-keyframes, optimize only the IMU frames and the landmarks they observe.
+  int fullOptimizationInterval = 0; ///< With localOptimization, optimize the full window at least every this many frames. 0: on keyframes only.
+  bool structurelessBackend = false; ///< Use the StructurelessEstimator, which projects the landmarks out instead of estimating them.
 };
 
 /**
@@ -276,6 +295,53 @@ struct SensorsInformation
   double frameTimestampTolerance; ///< Time tolerance between frames to accept them as stereo frames. [s]
 };
 
+/// @brief What to do with a frame whose multiframe has already been dispatched.
+enum class LateFramePolicy
+{
+  Discard, ///< Drop the frame.
+  Append   ///< Add the detected keypoints to the multiframe for matching against later frames.
+};
+
+/// @brief Grouping of the camera frames into multiframes.
+struct FrameSynchronizationParameters
+{
+  /// Dispatch multiframes before all cameras completed detection. Otherwise wait for all.
+  bool asynchronous = false;
+  size_t minCameras = 1; ///< Asynchronous: dispatch once this many cameras completed detection.
+  std::vector<size_t> requiredCameras; ///< Asynchronous: multiframes lacking any of these cameras are dropped.
+  double deadline = 0.02; ///< Asynchronous: dispatch at the latest this long after the first camera completed detection. [s]
+  LateFramePolicy lateFrames = LateFramePolicy::Discard; ///< Asynchronous: handling of late frames.
+};
+
+/// @brief Skipping of frames before detection when the pipeline falls behind the camera.
+struct LoadSheddingParameters
+{
+  bool enabled = false; ///< Skip frames while the pipeline latency is too high.
+  double maxLatency = 2.0; ///< Skip non-keyframe candidates above this smoothed latency. [camera periods]
+  size_t maxConsecutiveSkips = 2; ///< Never skip more frames in a row, to limit the IMU-only gaps.
+  double keyframeTranslation = 0.1; ///< Motion since the last keyframe that makes a keyframe candidate. [m]
+  double keyframeRotation = 0.1; ///< Rotation since the last keyframe that makes a keyframe candidate. [rad]
+};
+
+/// @brief Holding converged camera extrinsics constant, see Estimator::setExtrinsicsAutoFreeze().
+struct ExtrinsicsFreezeParameters
+{
+  bool enabled = false; ///< Freeze the extrinsics once converged.
+  double translationThreshold = 1.0e-4; ///< Maximum translation change between optimizations. [m]
+  double rotationThreshold = 1.0e-4; ///< Maximum orientation change between optimizations. [rad]
+  size_t numStableOptimizations = 20; ///< Consecutive optimizations below the thresholds.
+};
+
+/// @brief Removal of persistent outliers after the optimization, see Estimator::cullOutliers().
+struct OutlierCullingParameters
+{
+  bool enabled = false; ///< Remove persistent outliers.
+  double chi2Threshold = 5.991; ///< Squared whitened reprojection error above which an observation is an outlier.
+  size_t numConsecutive = 3; ///< Remove observations that were outliers after this many consecutive optimizations.
+  size_t minObservations = 2; ///< Remove landmarks left with fewer observations.
+  double timeLimit = 0.002; ///< Time budget per optimization. Negative values set no limit. [s]
+};
+
 /// @brief Some visualization settings.
 struct Visualization
 {
@@ -287,6 +353,28 @@ enum class FrameName
   B, S, W, Wc
 };
 
+/// @brief How a user callback is invoked by the publisher thread.
+enum class CallbackDispatchPolicy
+{
+  Synchronous, ///< Called directly from the publisher thread.
+  LatestOnly,  ///< Called from an own thread. Only the newest pending invocation is kept.
+  Bounded,     ///< Called from an own thread. If queueSize invocations are pending, the oldest is dropped.
+  Blocking     ///< Called from an own thread. If queueSize invocations are pending, the publisher waits.
+};
+
+/// @brief Dispatch settings of a user callback.
+struct CallbackDispatchParameters
+{
+  /// \brief Constructor.
+  CallbackDispatchParameters(CallbackDispatchPolicy policy = CallbackDispatchPolicy::Bounded,
+                             size_t queueSize = 100)
+      : policy(policy),
+        queueSize(queueSize) {
+  }
+  CallbackDispatchPolicy policy; ///< The dispatch policy.
+  size_t queueSize; ///< Maximum number of pending invocations. Used by Bounded and Blocking.
+};
+
 
 /// @brief Some publishing parameters.
 struct PublishingParameters
@@ -298,9 +386,24 @@ struct PublishingParameters
   float maxLandmarkQuality = 0.05; ///< Quality above which landmarks are assumed to be of the best quality. Between 0 and 1.
   size_t maxPathLength = 100; ///< Maximum length of ros::nav_mgsgs::Path to be published.
   bool publishImuPropagatedState = true; ///< Should the state that is propagated with IMU messages be published? Or just the optimized ones?
+  double covarianceTimeLimit = 0.005; ///< Time budget for the state covariance computation. If exceeded, it is not published. [s]
   okvis::kinematics::Transformation T_Wc_W = okvis::kinematics::Transformation::Identity(); ///< Provide custom World frame Wc
   FrameName trackedBodyFrame = FrameName::B; ///< B or S, the frame of reference that will be expressed relative to the selected worldFrame Wc
   FrameName velocitiesFrame = FrameName::B; ///< B or S,  the frames in which the velocities of the selected trackedBodyFrame will be expressed in
+  /// \name Dispatch of the user callbacks. Each one not Synchronous runs on its own thread.
+  /// \{
+  CallbackDispatchParameters stateCallbackDispatch; ///< VioInterface::StateCallback.
+  CallbackDispatchParameters fullStateCallbackDispatch; ///< VioInterface::FullStateCallback.
+  CallbackDispatchParameters fullStateWithExtrinsicsCallbackDispatch; ///< VioInterface::FullStateCallbackWithExtrinsics.
+  /// \brief VioInterface::LandmarksCallback. Each invocation is the only one carrying its
+  ///        transferred (marginalized) landmarks, so none are replaced by newer ones, and
+  ///        the drops of a full queue are counted.
+  CallbackDispatchParameters landmarksCallbackDispatch;
+  CallbackDispatchParameters stateCovarianceCallbackDispatch = CallbackDispatchParameters(
+      CallbackDispatchPolicy::LatestOnly, 1); ///< VioInterface::StateCovarianceCallback.
+  CallbackDispatchParameters smoothedStateCallbackDispatch = CallbackDispatchParameters(
+      CallbackDispatchPolicy::Bounded, 1000); ///< VioInterface::SmoothedStateCallback.
+  /// \}
 };
 
 
@@ -311,7 +414,11 @@ struct VioParameters
   Optimization optimization;    ///< Optimization parameters.
   Visualization visualization;  ///< Visualization parameters.
   SensorsInformation sensors_information; ///< Information on camera and IMU setup.
+  FrameSynchronizationParameters frameSynchronization; ///< Grouping of the camera frames into multiframes.
+  LoadSheddingParameters loadShedding; ///< Skipping of frames when the pipeline falls behind.
   ExtrinsicsEstimationParameters camera_extrinsics; ///< Camera extrinsic estimation parameters.
+  ExtrinsicsFreezeParameters extrinsicsFreeze; ///< Holding converged camera extrinsics constant.
+  OutlierCullingParameters outlierCulling; ///< Removal of persistent outliers.
   okvis::cameras::NCameraSystem nCameraSystem;  ///< Camera configuration.
   ImuParameters imu;  ///< IMU parameters
   MagnetometerParameters magnetometer;  ///< Magnetometer parameters.
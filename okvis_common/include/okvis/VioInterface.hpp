@@ -87,9 +87,16 @@ public:
           const std::vector<okvis::kinematics::Transformation,
               Eigen::aligned_allocator<okvis::kinematics::Transformation> > &)> FullStateCallbackWithExtrinsics;
   typedef Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> EigenImage;
+  typedef std::function<void()> ImageReleaseCallback;
   typedef std::function<
       void(const okvis::Time &, const okvis::MapPointVector &,
            const okvis::MapPointVector &)> LandmarksCallback;
+  typedef std::function<
+      void(const okvis::Time &, uint64_t,
+           const okvis::kinematics::Transformation &)> SmoothedStateCallback;
+  typedef std::function<
+      void(const okvis::Time &, uint64_t,
+           const Eigen::Matrix<double, 15, 15> &)> StateCovarianceCallback;
 
   VioInterface();
   virtual ~VioInterface();
@@ -146,6 +153,23 @@ public:
                         const std::vector<cv::KeyPoint> *keypoints = 0,
                         bool *asKeyframe = 0) = 0;
 
+  /**
+   * \brief                 Add a new image in a caller-owned buffer without copying it.
+   *
+   * The buffer must stay valid and unchanged until releaseCallback is called. This happens
+   * from an internal thread as soon as the image is no longer accessed, i.e. after
+   * keypoint detection, or when the image is dropped. If images are visualized, a copy
+   * is kept for that purpose. The default implementation copies the image right away.
+   * \param stamp           The image timestamp.
+   * \param cameraIndex     The index of the camera that the image originates from.
+   * \param image           The image, pointing to the caller-owned buffer.
+   * \param releaseCallback Called exactly once when the buffer can be reused.
+   * \return                Returns true normally. False, if the previous one has not been processed yet.
+   */
+  virtual bool addImageBuffer(const okvis::Time &stamp, size_t cameraIndex,
+                              const cv::Mat &image,
+                              const ImageReleaseCallback &releaseCallback);
+
   /**
    * \brief             Add an abstracted image observation.
    * \param stamp       The timestamp for the start of integration time for the image.
@@ -294,12 +318,33 @@ public:
   virtual void setLandmarksCallback(
       const LandmarksCallback &landmarksCallback);
 
+  /// \brief Set the smoothedStateCallback to be called once per frame when its pose is
+  ///        marginalized, i.e. with the final estimate of the fixed-lag smoother:
+  ///        smoothedStateCallback_( stamp, frameId, T_WS );
+  ///        where stamp and frameId identify the frame. The poses arrive delayed by the
+  ///        window length. Nothing is extracted if this is not set.
+  virtual void setSmoothedStateCallback(
+      const SmoothedStateCallback &smoothedStateCallback);
+
+  /// \brief Set the stateCovarianceCallback to be called after every optimization with the
+  ///        marginal covariance of the newest optimized state:
+  ///        stateCovarianceCallback_( stamp, frameId, covariance );
+  ///        where covariance is the 15x15 covariance of [delta r_WS, delta alpha_WS, v_W, b_g, b_a].
+  ///        It is only computed if this is set, and skipped if it exceeds its time budget.
+  virtual void setStateCovarianceCallback(
+      const StateCovarianceCallback &stateCovarianceCallback);
+
   /**
    * \brief Set the blocking variable that indicates whether the addMeasurement() functions
    *        should return immediately (blocking=false), or only when the processing is complete.
    */
   virtual void setBlocking(bool blocking);
 
+  /// \brief Whether the addMeasurement() functions wait until the processing is complete.
+  bool blocking() const {
+    return blocking_;
+  }
+
   /// \}
 
 protected:
@@ -317,6 +362,8 @@ protected:
   FullStateCallback fullStateCallback_; ///< Full state callback function.
   FullStateCallbackWithExtrinsics fullStateCallbackWithExtrinsics_; ///< Full state and extrinsics callback function.
   LandmarksCallback landmarksCallback_; ///< Landmarks callback function.
+  SmoothedStateCallback smoothedStateCallback_; ///< Smoothed (marginalized) state callback function.
+  StateCovarianceCallback stateCovarianceCallback_; ///< State covariance callback function.
   std::shared_ptr<std::fstream> csvImuFile_;  ///< IMU CSV file.
   std::shared_ptr<std::fstream> csvPosFile_;  ///< Position CSV File.
   std::shared_ptr<std::fstream> csvMagFile_;  ///< Magnetometer CSV File
@@ -117,6 +117,7 @@ protected:
     Eigen::Vector2d focalLength;              ///< Focal length.
     Eigen::Vector2d principalPoint;           ///< Principal point.
     std::string distortionType;               ///< Distortion type. ('radialtangential' 'plumb_bob' 'equdistant')
+    std::string maskFile;                     ///< Optional detection mask image (0 == masked).
   };
 
 
@@ -134,6 +135,15 @@ protected:
    */
   bool parseBoolean(cv::FileNode node, bool &val) const;
 
+  /**
+   * @brief Parses the dispatch settings of a user callback, e.g. {policy: bounded, queueSize: 100}.
+   *        Policies are synchronous, latest, bounded and blocking.
+   * @param[in] node The file node.
+   * @param[in,out] parameters The parsed settings. Unchanged where not specified.
+   */
+  void parseCallbackDispatch(cv::FileNode node,
+                             okvis::CallbackDispatchParameters &parameters) const;
+
   /**
    * @brief Get the camera calibration. This looks for the calibration in the
    *        configuration file first. If this fails it will directly get the calibration
@@ -50,7 +50,8 @@
 
 /// \brief okvis Main namespace of this package.
 namespace okvis {
-VioInterface::VioInterface() {
+VioInterface::VioInterface()
+    : blocking_(false) {
 }
 
 VioInterface::~VioInterface() {
@@ -77,6 +78,17 @@ bool VioInterface::addEigenImage(const okvis::Time &stamp, size_t cameraIndex,
 
 }
 
+// Add a new image in a caller-owned buffer. Copies the image by default.
+bool VioInterface::addImageBuffer(const okvis::Time &stamp, size_t cameraIndex,
+                                  const cv::Mat &image,
+                                  const ImageReleaseCallback &releaseCallback) {
+  const bool success = addImage(stamp, cameraIndex, image.clone());
+  if (releaseCallback) {
+    releaseCallback();
+  }
+  return success;
+}
+
 // Set the callback to be called every time a new state is estimated.
 void VioInterface::setStateCallback(const StateCallback &stateCallback) {
   stateCallback_ = stateCallback;
@@ -100,6 +112,18 @@ void VioInterface::setLandmarksCallback(
   landmarksCallback_ = landmarksCallback;
 }
 
+// Set the smoothedStateCallback to be called for every frame whose pose is marginalized.
+void VioInterface::setSmoothedStateCallback(
+    const SmoothedStateCallback &smoothedStateCallback) {
+  smoothedStateCallback_ = smoothedStateCallback;
+}
+
+// Set the stateCovarianceCallback to be called with the covariance of the newest optimized state.
+void VioInterface::setStateCovarianceCallback(
+    const StateCovarianceCallback &stateCovarianceCallback) {
+  stateCovarianceCallback_ = stateCovarianceCallback;
+}
+
 // Set the blocking variable that indicates whether the addMeasurement() functions
 // should return immediately (blocking=false), or only when the processing is complete.
 void VioInterface::setBlocking(bool blocking) {
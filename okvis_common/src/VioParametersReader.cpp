@@ -49,6 +49,7 @@
 #include <okvis/cameras/RadialTangentialDistortion8.hpp>
 
 #include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
 
 #include <okvis/VioParametersReader.hpp>
 
@@ -102,6 +103,42 @@ void VioParametersReader::readConfigFile(const std::string &filename) {
         << "numImuFrames parameter not provided. Setting to default numImuFrames=2.";
     vioParameters_.optimization.numImuFrames = 2;
   }
+  // number of keyframes matched to a new frame
+  if (file["numMatchingKeyframes3d2d"].isInt()) {
+    file["numMatchingKeyframes3d2d"] >> vioParameters_.optimization.numMatchingKeyframes3d2d;
+  }
+  if (file["numMatchingKeyframes2d2d"].isInt()) {
+    file["numMatchingKeyframes2d2d"] >> vioParameters_.optimization.numMatchingKeyframes2d2d;
+  }
+  // 3D-2D matching against all landmarks at once
+  parseBoolean(file["mapToFrameMatching"], vioParameters_.optimization.mapToFrameMatching);
+  // which landmarks are dropped instead of marginalized
+  if (file["marginalizationMinObservations"].isInt()) {
+    file["marginalizationMinObservations"]
+        >> vioParameters_.optimization.marginalizationMinObservations;
+    OKVIS_ASSERT_TRUE(Exception,
+                      vioParameters_.optimization.marginalizationMinObservations >= 0,
+                      "Invalid parameter value.");
+  }
+  if (file["marginalizationMinQuality"].isReal()) {
+    file["marginalizationMinQuality"] >> vioParameters_.optimization.marginalizationMinQuality;
+  }
+  // limit on the number of landmarks
+  if (file["maxLandmarks"].isInt()) {
+    file["maxLandmarks"] >> vioParameters_.optimization.maxLandmarks;
+    OKVIS_ASSERT_TRUE(Exception, vioParameters_.optimization.maxLandmarks >= 0,
+                      "Invalid parameter value.");
+  }
+  // sparsification of the marginalization prior
+  parseBoolean(file["priorSparsification"], vioParameters_.optimization.priorSparsification);
+  if (file["priorSparsificationMaxKld"].isReal()) {
+    file["priorSparsificationMaxKld"] >> vioParameters_.optimization.priorSparsificationMaxKld;
+    OKVIS_ASSERT_TRUE(Exception,
+                      vioParameters_.optimization.priorSparsificationMaxKld >= 0.0,
+                      "Invalid parameter value.");
+  }
+  // landmark parameterisation
+  parseBoolean(file["anchoredLandmarks"], vioParameters_.optimization.anchoredLandmarks);
   // minimum ceres iterations
   if (file["ceres_options"]["minIterations"].isInt()) {
     file["ceres_options"]["minIterations"]
@@ -132,6 +169,28 @@ void VioParametersReader::readConfigFile(const std::string &filename) {
     vioParameters_.optimization.timeLimitForMatchingAndOptimization = -1.0;
   }
 
+  // motion-only refinement of the newest state ahead of the full optimization
+  if (file["ceres_options"]["poseRefinementIterations"].isInt()) {
+    file["ceres_options"]["poseRefinementIterations"]
+        >> vioParameters_.optimization.poseRefinementIterations;
+  }
+
+  // start the optimization from the trust region of the previous one
+  parseBoolean(file["ceres_options"]["warmStartTrustRegion"],
+               vioParameters_.optimization.warmStartTrustRegion);
+
+  // optimize only the newest frames on non-keyframes
+  parseBoolean(file["ceres_options"]["localOptimization"],
+               vioParameters_.optimization.localOptimization);
+  if (file["ceres_options"]["fullOptimizationInterval"].isInt()) {
+    file["ceres_options"]["fullOptimizationInterval"]
+        >> vioParameters_.optimization.fullOptimizationInterval;
+  }
+
+  // project the landmarks out of the problem instead of estimating them
+  parseBoolean(file["ceres_options"]["structurelessBackend"],
+               vioParameters_.optimization.structurelessBackend);
+
   // do we use the direct driver?
   bool success = parseBoolean(file["useDriver"], useDriver);
   OKVIS_ASSERT_TRUE(Exception, success,
@@ -170,6 +229,23 @@ void VioParametersReader::readConfigFile(const std::string &filename) {
                     vioParameters_.optimization.maxNoKeypoints >= 0,
                     "Invalid parameter value.");
 
+  // spatial bucketing of the detections
+  if (file["detection_options"]["gridColumns"].isInt()
+      && file["detection_options"]["gridRows"].isInt()) {
+    file["detection_options"]["gridColumns"] >> vioParameters_.optimization.detectionGridColumns;
+    file["detection_options"]["gridRows"] >> vioParameters_.optimization.detectionGridRows;
+    OKVIS_ASSERT_TRUE(Exception,
+                      vioParameters_.optimization.detectionGridColumns >= 0
+                      && vioParameters_.optimization.detectionGridRows >= 0,
+                      "Invalid parameter value.");
+  }
+  if (file["detection_options"]["cellQuota"].isInt()) {
+    file["detection_options"]["cellQuota"] >> vioParameters_.optimization.detectionCellQuota;
+    OKVIS_ASSERT_TRUE(Exception,
+                      vioParameters_.optimization.detectionCellQuota >= 0,
+                      "Invalid parameter value.");
+  }
+
   // image delay
   success = file["imageDelay"].isReal();
   OKVIS_ASSERT_TRUE(Exception, success,
@@ -207,6 +283,64 @@ void VioParametersReader::readConfigFile(const std::string &filename) {
         << vioParameters_.sensors_information.frameTimestampTolerance;
   }
 
+  // multiframe synchronization
+  cv::FileNode frameSynchronization = file["camera_params"]["frame_synchronization"];
+  if (frameSynchronization.isMap()) {
+    FrameSynchronizationParameters &parameters = vioParameters_.frameSynchronization;
+    parseBoolean(frameSynchronization["asynchronous"], parameters.asynchronous);
+    if (frameSynchronization["min_cameras"].isInt()) {
+      parameters.minCameras = (int) frameSynchronization["min_cameras"];
+    }
+    if (frameSynchronization["required_cameras"].isSeq()) {
+      parameters.requiredCameras.clear();
+      for (size_t i = 0; i < frameSynchronization["required_cameras"].size(); ++i) {
+        parameters.requiredCameras.push_back(
+            (int) frameSynchronization["required_cameras"][i]);
+      }
+    }
+    if (frameSynchronization["deadline"].isReal()) {
+      frameSynchronization["deadline"] >> parameters.deadline;
+    }
+    if (frameSynchronization["late_frames"].isString()) {
+      std::string policy = (std::string) frameSynchronization["late_frames"];
+      // cut out first word. str currently contains everything including comments
+      policy = policy.substr(0, policy.find(" "));
+      if (policy.compare("append") == 0)
+        parameters.lateFrames = LateFramePolicy::Append;
+      else if (policy.compare("discard") == 0)
+        parameters.lateFrames = LateFramePolicy::Discard;
+      else
+        LOG(WARNING) << policy << " unknown late frame policy, discarding late frames";
+    }
+    if (parameters.asynchronous) {
+      LOG(INFO) << "Asynchronous multiframes: dispatch after " << parameters.minCameras
+                << " camera(s) or " << parameters.deadline << " s";
+    }
+  }
+
+  // load shedding
+  cv::FileNode loadShedding = file["load_shedding"];
+  if (loadShedding.isMap()) {
+    LoadSheddingParameters &parameters = vioParameters_.loadShedding;
+    parseBoolean(loadShedding["enabled"], parameters.enabled);
+    if (loadShedding["max_latency"].isReal()) {
+      loadShedding["max_latency"] >> parameters.maxLatency;
+    }
+    if (loadShedding["max_consecutive_skips"].isInt()) {
+      parameters.maxConsecutiveSkips = (int) loadShedding["max_consecutive_skips"];
+    }
+    if (loadShedding["keyframe_translation"].isReal()) {
+      loadShedding["keyframe_translation"] >> parameters.keyframeTranslation;
+    }
+    if (loadShedding["keyframe_rotation"].isReal()) {
+      loadShedding["keyframe_rotation"] >> parameters.keyframeRotation;
+    }
+    if (parameters.enabled) {
+      LOG(INFO) << "Load shedding: skipping non-keyframe candidates above "
+                << parameters.maxLatency << " camera periods of latency";
+    }
+  }
+
   // camera params
   if (file["camera_params"]["sigma_absolute_translation"].isReal()) {
     file["camera_params"]["sigma_absolute_translation"]
@@ -245,6 +379,41 @@ void VioParametersReader::readConfigFile(const std::string &filename) {
         << "camera_params: sigma_c_relative_orientation parameter not provided. Setting to default 0.0";
   }
 
+  // freezing of converged extrinsics
+  cv::FileNode extrinsicsFreeze = file["camera_params"]["extrinsics_freeze"];
+  if (extrinsicsFreeze.isMap()) {
+    ExtrinsicsFreezeParameters &parameters = vioParameters_.extrinsicsFreeze;
+    parseBoolean(extrinsicsFreeze["enabled"], parameters.enabled);
+    if (extrinsicsFreeze["translation_threshold"].isReal()) {
+      extrinsicsFreeze["translation_threshold"] >> parameters.translationThreshold;
+    }
+    if (extrinsicsFreeze["rotation_threshold"].isReal()) {
+      extrinsicsFreeze["rotation_threshold"] >> parameters.rotationThreshold;
+    }
+    if (extrinsicsFreeze["stable_optimizations"].isInt()) {
+      parameters.numStableOptimizations = (int) extrinsicsFreeze["stable_optimizations"];
+    }
+  }
+
+  // removal of persistent outliers
+  cv::FileNode outlierCulling = file["outlier_culling"];
+  if (outlierCulling.isMap()) {
+    OutlierCullingParameters &parameters = vioParameters_.outlierCulling;
+    parseBoolean(outlierCulling["enabled"], parameters.enabled);
+    if (outlierCulling["chi2_threshold"].isReal()) {
+      outlierCulling["chi2_threshold"] >> parameters.chi2Threshold;
+    }
+    if (outlierCulling["consecutive_optimizations"].isInt()) {
+      parameters.numConsecutive = (int) outlierCulling["consecutive_optimizations"];
+    }
+    if (outlierCulling["min_observations"].isInt()) {
+      parameters.minObservations = (int) outlierCulling["min_observations"];
+    }
+    if (outlierCulling["time_limit"].isReal()) {
+      outlierCulling["time_limit"] >> parameters.timeLimit;
+    }
+  }
+
   if (file["publishing_options"]["publish_rate"].isInt()) {
     file["publishing_options"]["publish_rate"]
         >> vioParameters_.publishing.publishRate;
@@ -271,6 +440,11 @@ void VioParametersReader::readConfigFile(const std::string &filename) {
   parseBoolean(file["publishing_options"]["publishLandmarks"],
                vioParameters_.publishing.publishLandmarks);
 
+  if (file["publishing_options"]["covarianceTimeLimit"].isReal()) {
+    file["publishing_options"]["covarianceTimeLimit"]
+        >> vioParameters_.publishing.covarianceTimeLimit;
+  }
+
   cv::FileNode T_Wc_W_ = file["publishing_options"]["T_Wc_W"];
   if (T_Wc_W_.isSeq()) {
     Eigen::Matrix4d T_Wc_W_e;
@@ -315,6 +489,20 @@ void VioParametersReader::readConfigFile(const std::string &filename) {
     }
   }
 
+  parseCallbackDispatch(file["publishing_options"]["stateCallbackDispatch"],
+                        vioParameters_.publishing.stateCallbackDispatch);
+  parseCallbackDispatch(file["publishing_options"]["fullStateCallbackDispatch"],
+                        vioParameters_.publishing.fullStateCallbackDispatch);
+  parseCallbackDispatch(
+      file["publishing_options"]["fullStateWithExtrinsicsCallbackDispatch"],
+      vioParameters_.publishing.fullStateWithExtrinsicsCallbackDispatch);
+  parseCallbackDispatch(file["publishing_options"]["landmarksCallbackDispatch"],
+                        vioParameters_.publishing.landmarksCallbackDispatch);
+  parseCallbackDispatch(file["publishing_options"]["stateCovarianceCallbackDispatch"],
+                        vioParameters_.publishing.stateCovarianceCallbackDispatch);
+  parseCallbackDispatch(file["publishing_options"]["smoothedStateCallbackDispatch"],
+                        vioParameters_.publishing.smoothedStateCallbackDispatch);
+
   // camera calibration
   std::vector<CameraCalibration, Eigen::aligned_allocator<CameraCalibration>> calibrations;
   if (!getCameraCalibration(calibrations, file))
@@ -327,24 +515,24 @@ void VioParametersReader::readConfigFile(const std::string &filename) {
         new okvis::kinematics::Transformation(calibrations[i].T_SC.r(),
                                               calibrations[i].T_SC.q().normalized()));
 
+    std::shared_ptr<okvis::cameras::CameraBase> cameraGeometry;
+    okvis::cameras::NCameraSystem::DistortionType distortionType;
     if (strcmp(calibrations[i].distortionType.c_str(), "equidistant") == 0) {
-      vioParameters_.nCameraSystem.addCamera(
-          T_SC_okvis_ptr,
-          std::shared_ptr<const okvis::cameras::CameraBase>(
-              new okvis::cameras::PinholeCamera<
-                  okvis::cameras::EquidistantDistortion>(
-                  calibrations[i].imageDimension[0],
-                  calibrations[i].imageDimension[1],
-                  calibrations[i].focalLength[0],
-                  calibrations[i].focalLength[1],
-                  calibrations[i].principalPoint[0],
-                  calibrations[i].principalPoint[1],
-                  okvis::cameras::EquidistantDistortion(
-                      calibrations[i].distortionCoefficients[0],
-                      calibrations[i].distortionCoefficients[1],
-                      calibrations[i].distortionCoefficients[2],
-                      calibrations[i].distortionCoefficients[3])/*, id ?*/)),
-          okvis::cameras::NCameraSystem::Equidistant/*, computeOverlaps ?*/);
+      cameraGeometry.reset(
+          new okvis::cameras::PinholeCamera<
+              okvis::cameras::EquidistantDistortion>(
+              calibrations[i].imageDimension[0],
+              calibrations[i].imageDimension[1],
+              calibrations[i].focalLength[0],
+              calibrations[i].focalLength[1],
+              calibrations[i].principalPoint[0],
+              calibrations[i].principalPoint[1],
+              okvis::cameras::EquidistantDistortion(
+                  calibrations[i].distortionCoefficients[0],
+                  calibrations[i].distortionCoefficients[1],
+                  calibrations[i].distortionCoefficients[2],
+                  calibrations[i].distortionCoefficients[3])/*, id ?*/);
+      distortionType = okvis::cameras::NCameraSystem::Equidistant;
       std::stringstream s;
       s << calibrations[i].T_SC.T();
       LOG(INFO) << "Equidistant pinhole camera " << camIdx
@@ -352,23 +540,21 @@ void VioParametersReader::readConfigFile(const std::string &filename) {
     }
     else if (strcmp(calibrations[i].distortionType.c_str(), "radialtangential") == 0
              || strcmp(calibrations[i].distortionType.c_str(), "plumb_bob") == 0) {
-      vioParameters_.nCameraSystem.addCamera(
-          T_SC_okvis_ptr,
-          std::shared_ptr<const okvis::cameras::CameraBase>(
-              new okvis::cameras::PinholeCamera<
-                  okvis::cameras::RadialTangentialDistortion>(
-                  calibrations[i].imageDimension[0],
-                  calibrations[i].imageDimension[1],
-                  calibrations[i].focalLength[0],
-                  calibrations[i].focalLength[1],
-                  calibrations[i].principalPoint[0],
-                  calibrations[i].principalPoint[1],
-                  okvis::cameras::RadialTangentialDistortion(
-                      calibrations[i].distortionCoefficients[0],
-                      calibrations[i].distortionCoefficients[1],
-                      calibrations[i].distortionCoefficients[2],
-                      calibrations[i].distortionCoefficients[3])/*, id ?*/)),
-          okvis::cameras::NCameraSystem::RadialTangential/*, computeOverlaps ?*/);
+      cameraGeometry.reset(
+          new okvis::cameras::PinholeCamera<
+              okvis::cameras::RadialTangentialDistortion>(
+              calibrations[i].imageDimension[0],
+              calibrations[i].imageDimension[1],
+              calibrations[i].focalLength[0],
+              calibrations[i].focalLength[1],
+              calibrations[i].principalPoint[0],
+              calibrations[i].principalPoint[1],
+              okvis::cameras::RadialTangentialDistortion(
+                  calibrations[i].distortionCoefficients[0],
+                  calibrations[i].distortionCoefficients[1],
+                  calibrations[i].distortionCoefficients[2],
+                  calibrations[i].distortionCoefficients[3])/*, id ?*/);
+      distortionType = okvis::cameras::NCameraSystem::RadialTangential;
       std::stringstream s;
       s << calibrations[i].T_SC.T();
       LOG(INFO) << "Radial tangential pinhole camera " << camIdx
@@ -376,27 +562,25 @@ void VioParametersReader::readConfigFile(const std::string &filename) {
     }
     else if (strcmp(calibrations[i].distortionType.c_str(), "radialtangential8") == 0
              || strcmp(calibrations[i].distortionType.c_str(), "plumb_bob8") == 0) {
-      vioParameters_.nCameraSystem.addCamera(
-          T_SC_okvis_ptr,
-          std::shared_ptr<const okvis::cameras::CameraBase>(
-              new okvis::cameras::PinholeCamera<
-                  okvis::cameras::RadialTangentialDistortion8>(
-                  calibrations[i].imageDimension[0],
-                  calibrations[i].imageDimension[1],
-                  calibrations[i].focalLength[0],
-                  calibrations[i].focalLength[1],
-                  calibrations[i].principalPoint[0],
-                  calibrations[i].principalPoint[1],
-                  okvis::cameras::RadialTangentialDistortion8(
-                      calibrations[i].distortionCoefficients[0],
-                      calibrations[i].distortionCoefficients[1],
-                      calibrations[i].distortionCoefficients[2],
-                      calibrations[i].distortionCoefficients[3],
-                      calibrations[i].distortionCoefficients[4],
-                      calibrations[i].distortionCoefficients[5],
-                      calibrations[i].distortionCoefficients[6],
-                      calibrations[i].distortionCoefficients[7])/*, id ?*/)),
-          okvis::cameras::NCameraSystem::RadialTangential8/*, computeOverlaps ?*/);
+      cameraGeometry.reset(
+          new okvis::cameras::PinholeCamera<
+              okvis::cameras::RadialTangentialDistortion8>(
+              calibrations[i].imageDimension[0],
+              calibrations[i].imageDimension[1],
+              calibrations[i].focalLength[0],
+              calibrations[i].focalLength[1],
+              calibrations[i].principalPoint[0],
+              calibrations[i].principalPoint[1],
+              okvis::cameras::RadialTangentialDistortion8(
+                  calibrations[i].distortionCoefficients[0],
+                  calibrations[i].distortionCoefficients[1],
+                  calibrations[i].distortionCoefficients[2],
+                  calibrations[i].distortionCoefficients[3],
+                  calibrations[i].distortionCoefficients[4],
+                  calibrations[i].distortionCoefficients[5],
+                  calibrations[i].distortionCoefficients[6],
+                  calibrations[i].distortionCoefficients[7])/*, id ?*/);
+      distortionType = okvis::cameras::NCameraSystem::RadialTangential8;
       std::stringstream s;
       s << calibrations[i].T_SC.T();
       LOG(INFO) << "Radial tangential 8 pinhole camera " << camIdx
@@ -404,7 +588,29 @@ void VioParametersReader::readConfigFile(const std::string &filename) {
     }
     else {
       LOG(ERROR) << "unrecognized distortion type " << calibrations[i].distortionType;
+      ++camIdx;
+      continue;
+    }
+
+    // static detection mask, relative paths are relative to the configuration file
+    if (!calibrations[i].maskFile.empty()) {
+      std::string maskFile = calibrations[i].maskFile;
+      if (maskFile[0] != '/' && filename.find_last_of('/') != std::string::npos) {
+        maskFile = filename.substr(0, filename.find_last_of('/') + 1) + maskFile;
+      }
+      cv::Mat mask = cv::imread(maskFile, 0);
+      OKVIS_ASSERT_TRUE(Exception, mask.data != nullptr,
+                        "Could not read the mask " << maskFile << " of camera " << camIdx);
+      const bool maskSet = cameraGeometry->setMask(mask);
+      OKVIS_ASSERT_TRUE(Exception, maskSet,
+                        "The mask " << maskFile << " does not match the image size of camera "
+                        << camIdx);
+      LOG(INFO) << "Camera " << camIdx << " masked with " << maskFile << ", "
+                << cv::countNonZero(mask) * 100 / int(mask.total()) << "% of the image valid";
     }
+
+    vioParameters_.nCameraSystem.addCamera(T_SC_okvis_ptr, cameraGeometry,
+                                           distortionType/*, computeOverlaps ?*/);
     ++camIdx;
   }
 
@@ -515,6 +721,37 @@ bool VioParametersReader::parseBoolean(cv::FileNode node, bool &val) const {
   return false;
 }
 
+// Parses the dispatch settings of a user callback.
+void VioParametersReader::parseCallbackDispatch(
+    cv::FileNode node, okvis::CallbackDispatchParameters &parameters) const {
+  if (!node.isMap()) {
+    return;
+  }
+  if (node["policy"].isString()) {
+    std::string policy = (std::string) node["policy"];
+    // cut out first word. str currently contains everything including comments
+    policy = policy.substr(0, policy.find(" "));
+    std::transform(policy.begin(), policy.end(), policy.begin(), ::tolower);
+    if (policy.compare("synchronous") == 0)
+      parameters.policy = CallbackDispatchPolicy::Synchronous;
+    else if (policy.compare("latest") == 0)
+      parameters.policy = CallbackDispatchPolicy::LatestOnly;
+    else if (policy.compare("bounded") == 0)
+      parameters.policy = CallbackDispatchPolicy::Bounded;
+    else if (policy.compare("blocking") == 0)
+      parameters.policy = CallbackDispatchPolicy::Blocking;
+    else
+      LOG(WARNING) << policy << " unknown callback dispatch policy, keeping the default";
+  }
+  if (node["queueSize"].isInt()) {
+    const int queueSize = (int) node["queueSize"];
+    if (queueSize > 0)
+      parameters.queueSize = queueSize;
+    else
+      LOG(WARNING) << "callback queueSize must be positive, keeping the default";
+  }
+}
+
 bool VioParametersReader::getCameraCalibration(
     std::vector<CameraCalibration, Eigen::aligned_allocator<CameraCalibration>> &calibrations,
     cv::FileStorage &configurationFile) {
@@ -605,6 +842,9 @@ bool VioParametersReader::getCalibrationViaConfig(
       calib.focalLength << focalLengthNode[0], focalLengthNode[1];
       calib.principalPoint << principalPointNode[0], principalPointNode[1];
       calib.distortionType = (std::string) ((*it)["distortion_type"]);
+      if ((*it)["mask"].isString()) {
+        calib.maskFile = (std::string) ((*it)["mask"]);
+      }
 
       calibrations.push_back(calib);
     }
@@ -127,6 +127,7 @@ public:
 
   /// \brief Detect keypoints. This uses virtual function calls.
   ///        That's a negligibly small overhead for many detections.
+  ///        Keypoints in regions masked by the camera geometry are discarded.
   /// \return The number of detected points.
   inline int detect();
 
@@ -169,6 +170,10 @@ public:
   /// \return The descriptor data pointer; NULL if out of bounds.
   inline const unsigned char *keypointDescriptor(size_t keypointIdx);
 
+  /// \brief Access all descriptors, one row per keypoint.
+  /// \return The descriptors.
+  inline const cv::Mat &descriptors() const;
+
   /// \brief Set the landmark ID
   /// @param[in] keypointIdx The requested keypoint's index.
   /// @param[in] landmarkId The landmark Id.
@@ -207,6 +207,11 @@ public:
   inline const unsigned char *keypointDescriptor(size_t cameraIdx,
                                                  size_t keypointIdx);
 
+  /// \brief Access all descriptors of a frame, one row per keypoint.
+  /// @param[in] cameraIdx The camera index.
+  /// \return The descriptors.
+  inline const cv::Mat &descriptors(size_t cameraIdx) const;
+
   /// \brief Set the landmark ID
   /// @param[in] cameraIdx The camera index.
   /// @param[in] keypointIdx The requested keypoint's index.
@@ -108,7 +108,13 @@ int Frame::detect() {
   // run the detector
   OKVIS_ASSERT_TRUE_DBG(Exception, detector_ != NULL,
                         "Detector not initialised!");
-  detector_->detect(image_, keypoints_);
+  if (cameraGeometry_ && cameraGeometry_->hasMask()) {
+    // not all detectors honour the mask, so filter explicitly
+    detector_->detect(image_, keypoints_, cameraGeometry_->mask());
+    cv::KeyPointsFilter::runByPixelsMask(keypoints_, cameraGeometry_->mask());
+  } else {
+    detector_->detect(image_, keypoints_);
+  }
   return keypoints_.size();
 }
 
@@ -243,6 +249,11 @@ const unsigned char *Frame::keypointDescriptor(size_t keypointIdx) {
 #endif
 }
 
+// Access all descriptors.
+const cv::Mat &Frame::descriptors() const {
+  return descriptors_;
+}
+
 // Set the landmark ID
 bool Frame::setLandmarkId(size_t keypointIdx, uint64_t landmarkId) {
 #ifndef NDEBUG
@@ -203,6 +203,12 @@ const unsigned char *MultiFrame::keypointDescriptor(size_t cameraIdx,
   return frames_[cameraIdx].keypointDescriptor(keypointIdx);
 }
 
+// Access all descriptors of a frame.
+const cv::Mat &MultiFrame::descriptors(size_t cameraIdx) const {
+  OKVIS_ASSERT_TRUE_DBG(Exception, cameraIdx < frames_.size(), "Out of range");
+  return frames_[cameraIdx].descriptors();
+}
+
 // Set the landmark ID
 bool MultiFrame::setLandmarkId(size_t cameraIdx, size_t keypointIdx,
                                uint64_t landmarkId) {
@@ -86,3 +86,51 @@ TEST(Frame, functions) {
   }
 }
 
+
+TEST(Frame, mask) {
+
+  std::shared_ptr<okvis::cameras::CameraBase> camera =
+      okvis::cameras::PinholeCamera<okvis::cameras::RadialTangentialDistortion>::createTestObject();
+  const int width = camera->imageWidth();
+  const int height = camera->imageHeight();
+
+  // mask the left half of the image
+  cv::Mat mask(height, width, CV_8UC1, cv::Scalar(255));
+  mask.colRange(0, width / 2).setTo(cv::Scalar(0));
+  ASSERT_TRUE(camera->setMask(mask));
+
+  // projections into the masked half are flagged
+  Eigen::Vector3d ray;
+  ASSERT_TRUE(camera->backProject(Eigen::Vector2d(width / 4, height / 2), &ray));
+  Eigen::Vector2d imagePoint;
+  EXPECT_EQ(okvis::cameras::CameraBase::ProjectionStatus::Masked,
+            camera->project(ray, &imagePoint));
+  ASSERT_TRUE(camera->backProject(Eigen::Vector2d(3 * width / 4, height / 2), &ray));
+  EXPECT_EQ(okvis::cameras::CameraBase::ProjectionStatus::Successful,
+            camera->project(ray, &imagePoint));
+
+#ifdef __ARM_NEON__
+  std::shared_ptr<cv::FeatureDetector> detector(
+       new brisk::BriskFeatureDetector(34, 2));
+#else
+  std::shared_ptr<cv::FeatureDetector> detector(
+      new brisk::ScaleSpaceFeatureDetector<brisk::HarrisScoreCalculator>(
+          34, 2, 800, 450));
+#endif
+  std::shared_ptr<cv::DescriptorExtractor> extractor(
+      new cv::BriskDescriptorExtractor(true, false));
+
+  // create a stupid random image
+  Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> eigenImage(width, height);
+  eigenImage.setRandom();
+  cv::Mat image(height, width, CV_8UC1, eigenImage.data());
+  okvis::Frame frame(image, camera, detector, extractor);
+
+  // no keypoints are detected in the masked half
+  ASSERT_GT(frame.detect(), 0);
+  for (size_t k = 0; k < frame.numKeypoints(); ++k) {
+    Eigen::Vector2d keypoint;
+    frame.getKeypoint(k, keypoint);
+    EXPECT_NE(0, mask.at<uchar>(int(keypoint[1]), int(keypoint[0])));
+  }
+}
@@ -0,0 +1,173 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file BenchmarkMatching.cpp
+ * @brief Benchmark of Frontend::dataAssociationAndInitialization() on simulated data,
+ *        matching keyframe by keyframe versus matching against all landmarks at once.
+ */
+
+#include <chrono>
+
+#include <benchmark/benchmark.h>
+#include <okvis/Estimator.hpp>
+#include <okvis/Frontend.hpp>
+#include <okvis/SensorSimulator.hpp>
+#include "benchmarkDataGenerators.hpp"
+
+namespace {
+
+const int kMeasuredFrames = 30;  ///< Frames matched per benchmark run after warm-up.
+const int kWarmUpFrames = 20;  ///< Frames processed before measuring, to fill the window.
+const int kMaxIterations = 10;  ///< Optimizer iterations per frame (as in the default config).
+const size_t kNumKeyframes = 5;  ///< As in the default config.
+const size_t kNumImuFrames = 3;  ///< As in the default config.
+const double kCameraRate = 20.0;  ///< [Hz]
+
+// IMU readings spanning the gap between the newest state and time t.
+okvis::ImuMeasurementDeque imuMeasurementsUntil(const okvis::SensorSimulator &simulator,
+                                                const okvis::Estimator &estimator,
+                                                const okvis::Time &t, double imuRate) {
+  const okvis::Duration margin(2.0 / imuRate);
+  const okvis::Time start = estimator.timestamp(estimator.currentFrameId()) - margin;
+  okvis::ImuMeasurementDeque imuMeasurements;
+  for (okvis::ImuMeasurementDeque::const_iterator it = simulator.imuMeasurements().begin();
+      it != simulator.imuMeasurements().end() && it->timeStamp <= t + margin; ++it) {
+    if (it->timeStamp >= start) {
+      imuMeasurements.push_back(*it);
+    }
+  }
+  return imuMeasurements;
+}
+
+}  // namespace
+
+// Arguments: mapToFrameMatching, numCameras, numLandmarks.
+static void BM_FrontendMatching(benchmark::State &state) {
+  const size_t numCameras = size_t(state.range(1));
+  const okvis::ImuParameters imuParameters = okvis::BenchmarkDataGenerator::getImuParameters();
+  okvis::SimulationParameters simulationParameters;
+  simulationParameters.numLandmarks = size_t(state.range(2));
+  simulationParameters.cameraRate = kCameraRate;
+  simulationParameters.duration = double(kWarmUpFrames + kMeasuredFrames + 3) / kCameraRate;
+  okvis::SensorSimulator simulator(okvis::BenchmarkDataGenerator::getCameraSystem(numCameras),
+                                   imuParameters,
+                                   simulationParameters);
+
+  okvis::VioParameters parameters;
+  parameters.nCameraSystem = simulator.nCameraSystem();
+  parameters.optimization.mapToFrameMatching = state.range(0) != 0;
+
+  std::shared_ptr<okvis::ceres::Map> mapPtr(new okvis::ceres::Map);
+  okvis::Estimator estimator(mapPtr);
+  for (size_t i = 0; i < numCameras; ++i) {
+    estimator.addCamera(okvis::ExtrinsicsEstimationParameters());
+  }
+  estimator.addImu(imuParameters);
+  okvis::Frontend frontend(numCameras);
+  std::shared_ptr<okvis::MapPointVector> map(new okvis::MapPointVector);
+
+  // the first frame with known associations, as the gravity alignment is not simulated
+  simulator.addToEstimator(estimator, 0, true);
+
+  // all further frames go through the frontend as in ThreadedKFVio::matchingLoop()
+  size_t k = 1;
+  double matchingTime = 0.0;
+  size_t numDescriptorComparisons = 0;
+  size_t numMatches = 0;
+  auto processFrame = [&](bool measure) {
+    okvis::MultiFramePtr multiFrame = simulator.simulateMultiFrame(k);
+    for (size_t i = 0; i < multiFrame->numFrames(); ++i) {
+      for (size_t j = 0; j < multiFrame->numKeypoints(i); ++j) {
+        multiFrame->setLandmarkId(i, j, 0);
+      }
+    }
+    bool asKeyframe = false;
+    estimator.addStates(multiFrame,
+                        imuMeasurementsUntil(simulator, estimator, simulator.frameTimestamp(k),
+                                             imuParameters.rate),
+                        asKeyframe);
+    okvis::kinematics::Transformation T_WS;
+    estimator.get_T_WS(multiFrame->id(), T_WS);
+
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+    frontend.dataAssociationAndInitialization(estimator, T_WS, parameters, map, multiFrame,
+                                              &asKeyframe);
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+    if (asKeyframe) {
+      estimator.setKeyframe(multiFrame->id(), asKeyframe);
+    }
+    if (measure) {
+      matchingTime += std::chrono::duration<double>(t1 - t0).count();
+      numDescriptorComparisons += frontend.numDescriptorComparisons();
+      for (size_t i = 0; i < multiFrame->numFrames(); ++i) {
+        for (size_t j = 0; j < multiFrame->numKeypoints(i); ++j) {
+          numMatches += multiFrame->landmarkId(i, j) != 0 ? 1 : 0;
+        }
+      }
+    }
+
+    estimator.optimize(kMaxIterations, 1, false);
+    okvis::MapPointVector removedLandmarks;
+    estimator.applyMarginalizationStrategy(kNumKeyframes, kNumImuFrames, removedLandmarks);
+    ++k;
+  };
+
+  while (k < size_t(kWarmUpFrames)) {
+    processFrame(false);
+  }
+  for (auto _ : state) {
+    processFrame(true);
+  }
+
+  state.counters["matching_ms"] = benchmark::Counter(
+      1.0e3 * matchingTime, benchmark::Counter::kAvgIterations);
+  state.counters["descriptor_comparisons"] = benchmark::Counter(
+      double(numDescriptorComparisons), benchmark::Counter::kAvgIterations);
+  state.counters["matched_keypoints"] = benchmark::Counter(
+      double(numMatches), benchmark::Counter::kAvgIterations);
+  state.counters["landmarks"] = double(estimator.numLandmarks());
+}
+
+// Both matching modes for the default rig and varying landmark density.
+static void FrontendMatchingArguments(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ArgNames({"mapToFrameMatching", "numCameras", "numLandmarks"});
+  for (int numLandmarks : {500, 1000, 2000}) {
+    for (int mapToFrameMatching : {0, 1}) {
+      benchmark->Args({mapToFrameMatching, 2, numLandmarks});
+    }
+  }
+}
+
+BENCHMARK(BM_FrontendMatching)
+    ->Apply(FrontendMatchingArguments)
+    ->Iterations(kMeasuredFrames)
+    ->Unit(benchmark::kMillisecond);
@@ -47,6 +47,7 @@
 #include <okvis/VioFrontendInterface.hpp>
 #include <okvis/timing/Timer.hpp>
 #include <okvis/DenseMatcher.hpp>
+#include <okvis/MapToFrameMatcher.hpp>
 
 /// \brief okvis Main namespace of this package.
 namespace okvis {
@@ -86,6 +87,8 @@ public:
    * @param[in] keypoints If the keypoints are already available from a different source, provide them here
    *                      in order to skip detection.
    * @warning Using keypoints from a different source is not yet implemented.
+   * @remark  If the camera geometry has a mask, no keypoints are kept in masked regions and
+   *          the maximum number of keypoints applies to the unmasked region.
    * @return True if successful.
    */
   virtual bool detectAndDescribe(size_t cameraIndex,
@@ -158,6 +161,16 @@ public:
     return briskDetectionMaximumKeypoints_;
   }
 
+  /// @brief Get the number of columns of the keypoint bucketing grid (0 if disabled).
+  size_t getDetectionGridColumns() const {
+    return detectionGridColumns_;
+  }
+
+  /// @brief Get the number of rows of the keypoint bucketing grid (0 if disabled).
+  size_t getDetectionGridRows() const {
+    return detectionGridRows_;
+  }
+
   ///@}
   /// @name Getters related to the BRISK descriptor
   /// @{
@@ -224,6 +237,20 @@ public:
     initialiseBriskFeatureDetectors();
   }
 
+  /**
+   * @brief Spread the keypoints over a grid: the strongest ones of every cell are retained
+   *        first, the remaining budget is filled with the strongest of the rest.
+   * @param columns   Number of grid columns. 0 disables bucketing.
+   * @param rows      Number of grid rows. 0 disables bucketing.
+   * @param cellQuota Keypoints first retained per cell. 0 means maximum keypoints / number of cells.
+   */
+  void setDetectionGrid(size_t columns, size_t rows, size_t cellQuota = 0) {
+    detectionGridColumns_ = columns;
+    detectionGridRows_ = rows;
+    detectionCellQuota_ = cellQuota;
+    initialiseBriskFeatureDetectors();
+  }
+
   /// @}
   /// @name Setters related to the BRISK descriptor
   /// @{
@@ -261,6 +288,11 @@ public:
 
   /// @}
 
+  /// @brief Get the number of descriptor comparisons of the last dataAssociationAndInitialization().
+  size_t numDescriptorComparisons() const {
+    return numDescriptorComparisons_;
+  }
+
 private:
 
   /**
@@ -277,6 +309,11 @@ private:
   std::vector<std::shared_ptr<cv::DescriptorExtractor> > descriptorExtractors_;
   /// Mutexes for feature detectors and descriptors.
   std::vector<std::unique_ptr<std::mutex> > featureDetectorMutexes_;
+  /**
+   * @brief   The camera masks the feature detectors were created for (empty if unmasked).
+   * @warning Lock with featureDetectorMutexes_[cameraIndex] when using the mask.
+   */
+  std::vector<cv::Mat> detectionMasks_;
 
   bool isInitialized_;        ///< Is the pose initialised?
   const size_t numCameras_;   ///< Number of cameras in the configuration.
@@ -288,6 +325,9 @@ private:
   double briskDetectionThreshold_;          ///< The set BRISK detection threshold.
   double briskDetectionAbsoluteThreshold_;  ///< The set BRISK absolute detection threshold.
   size_t briskDetectionMaximumKeypoints_;   ///< The set maximum number of keypoints.
+  size_t detectionGridColumns_;             ///< Columns of the keypoint bucketing grid. 0 disables bucketing.
+  size_t detectionGridRows_;                ///< Rows of the keypoint bucketing grid. 0 disables bucketing.
+  size_t detectionCellQuota_;               ///< Keypoints first retained per grid cell. 0: automatic.
 
   /// @}
   /// @name BRISK descriptor extractor parameters
@@ -305,6 +345,7 @@ private:
   ///@}
 
   std::unique_ptr<okvis::DenseMatcher> matcher_; ///< Matcher object.
+  okvis::MapToFrameMatcher mapToFrameMatcher_; ///< Matches all landmarks at once, see matchToMap().
 
   /**
    * @brief If the hull-area around all matched keypoints of the current frame (with existing landmarks)
@@ -321,6 +362,8 @@ private:
    */
   float keyframeInsertionMatchingRatioThreshold_;  //0.2
 
+  size_t numDescriptorComparisons_; ///< Descriptor comparisons of the last dataAssociationAndInitialization().
+
   /**
    * @brief Decision whether a new frame should be keyframe or not.
    * @param estimator     const reference to the estimator.
@@ -330,6 +373,25 @@ private:
   bool doWeNeedANewKeyframe(const okvis::Estimator &estimator,
                             std::shared_ptr<okvis::MultiFrame> currentFrame);  // based on some overlap area heuristics
 
+  /**
+   * @brief Select the keyframes to match a new multiframe to.
+   *
+   * Keyframes are ranked by the number of their landmarks that project into the new
+   * multiframe at the propagated pose. Ties, e.g. before landmarks are triangulated, are
+   * broken by the landmarks shared with the last frame in the covisibility graph.
+   * @warning As this function uses the estimator it is not threadsafe.
+   * @param[in]  estimator       Estimator.
+   * @param[in]  params          Parameter struct.
+   * @param[in]  currentFrameId  ID of the current frame.
+   * @param[in]  T_WS_propagated Propagated pose of the current frame.
+   * @param[out] keyframeIds     All keyframes in the window by decreasing predicted overlap.
+   */
+  void selectKeyframesToMatch(const okvis::Estimator &estimator,
+                              const okvis::VioParameters &params,
+                              const uint64_t currentFrameId,
+                              const okvis::kinematics::Transformation &T_WS_propagated,
+                              std::vector<uint64_t> &keyframeIds) const;
+
   /**
    * @brief Match a new multiframe to existing keyframes
    * @tparam MATCHING_ALGORITHM Algorithm to match new keypoints to existing landmarks
@@ -337,6 +399,8 @@ private:
    * @param      estimator              Estimator.
    * @param[in]  params                 Parameter struct.
    * @param[in]  currentFrameId         ID of the current frame that should be matched against keyframes.
+   * @param[in]  T_WS_propagated        Propagated pose of the current frame, used to select
+   *                                    the keyframes, see selectKeyframesToMatch().
    * @param[out] rotationOnly           Was the rotation only RANSAC motion model good enough to
    *                                    explain the motion between the new frame and the keyframes?
    * @param[in]  usePoseUncertainty     Use the pose uncertainty for the matching.
@@ -347,11 +411,26 @@ private:
   template<class MATCHING_ALGORITHM>
   int matchToKeyframes(okvis::Estimator &estimator,
                        const okvis::VioParameters &params,
-                       const uint64_t currentFrameId, bool &rotationOnly,
+                       const uint64_t currentFrameId,
+                       const okvis::kinematics::Transformation &T_WS_propagated,
+                       bool &rotationOnly,
                        bool usePoseUncertainty = true,
                        double *uncertainMatchFraction = 0,
                        bool removeOutliers = true);  // for wide-baseline matches (good initial guess)
 
+  /**
+   * @brief Match all initialised landmarks to a new multiframe in one pass.
+   * @tparam MATCHING_ALGORITHM Matching algorithm, defines the camera geometry.
+   * @warning As this function uses the estimator it is not threadsafe.
+   * @param estimator       Estimator.
+   * @param currentFrameId  ID of the current frame.
+   * @param T_WS_propagated Propagated pose of the current frame.
+   * @return The number of matches.
+   */
+  template<class MATCHING_ALGORITHM>
+  int matchToMap(okvis::Estimator &estimator, const uint64_t currentFrameId,
+                 const okvis::kinematics::Transformation &T_WS_propagated);
+
   /**
    * @brief Match a new multiframe to the last frame.
    * @tparam MATCHING_ALGORITHM Algorithm to match new keypoints to existing landmarks
@@ -412,6 +491,25 @@ private:
                     uint64_t olderFrameId, bool initializePose,
                     bool removeOutliers, bool &rotationOnly);
 
+  /**
+   * @brief Instantiates the feature detector of a camera with the current settings.
+   *        If the camera is masked, the maximum number of keypoints is scaled by the
+   *        inverse of the unmasked image fraction.
+   * @param cameraIndex The camera index.
+   * @return The feature detector.
+   */
+  std::shared_ptr<cv::FeatureDetector> createFeatureDetector(size_t cameraIndex) const;
+
+  /**
+   * @brief Reduce detected keypoints to the maximum number of keypoints, spread over the
+   *        bucketing grid if enabled, otherwise the strongest ones.
+   * @param[in,out] keypoints The keypoints.
+   * @param imageWidth  Image width. [pixels]
+   * @param imageHeight Image height. [pixels]
+   */
+  void selectKeypoints(std::vector<cv::KeyPoint> &keypoints, int imageWidth,
+                       int imageHeight) const;
+
   /// (re)instantiates feature detectors and descriptor extractors. Used after settings changed or at startup.
   void initialiseBriskFeatureDetectors();
 
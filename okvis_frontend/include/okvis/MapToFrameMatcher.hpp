@@ -0,0 +1,128 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file MapToFrameMatcher.hpp
+ * @brief Header file for the MapToFrameMatcher class.
+ */
+
+#ifndef INCLUDE_OKVIS_MAPTOFRAMEMATCHER_HPP_
+#define INCLUDE_OKVIS_MAPTOFRAMEMATCHER_HPP_
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <okvis/assert_macros.hpp>
+#include <okvis/Estimator.hpp>
+#include <okvis/FrameTypedefs.hpp>
+#include <okvis/MultiFrame.hpp>
+#include <okvis/kinematics/Transformation.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/**
+ * @brief Matches all initialised landmarks of the estimator to a new multiframe in one pass.
+ *
+ * Every landmark is projected once into each camera of the multiframe at the given pose
+ * (CameraBase::projectHomogeneousBatch()) and compared against the keypoints in a grid cell
+ * neighbourhood of the projection, using a single representative descriptor per landmark:
+ * the observed descriptor with the smallest median distance to the other observations.
+ * This replaces matching the landmarks keyframe by keyframe, where a landmark seen in several
+ * keyframes is projected and compared several times.
+ */
+class MapToFrameMatcher
+{
+public:
+  OKVIS_DEFINE_EXCEPTION(Exception, std::runtime_error)
+
+  /// \brief A match: keypoint in the multiframe and landmark ID.
+  typedef std::pair<okvis::KeypointIdentifier, uint64_t> Match;
+
+  /**
+   * @brief Constructor.
+   * @param searchRadius Keypoints are searched within this distance of the projection. [pixels]
+   */
+  MapToFrameMatcher(double searchRadius = 15.0);
+
+  /**
+   * @brief Match the initialised landmarks to the keypoints of a multiframe without landmark.
+   * @warning As this function uses the estimator it is not threadsafe.
+   * @param[in]  estimator         Estimator holding the landmarks and their observations.
+   * @param[in]  multiFrame        The multiframe. Its landmark IDs are not changed.
+   * @param[in]  T_WS              Pose of the multiframe.
+   * @param[in]  T_SC              Extrinsics of the cameras.
+   * @param[in]  distanceThreshold Maximum descriptor distance of a match.
+   * @param[out] matches           The matches, at most one per keypoint and per landmark
+   *                               and camera.
+   * @return The number of matches.
+   */
+  size_t match(const okvis::Estimator &estimator, okvis::MultiFramePtr multiFrame,
+               const okvis::kinematics::Transformation &T_WS,
+               const std::vector<okvis::kinematics::Transformation,
+                   Eigen::aligned_allocator<okvis::kinematics::Transformation> > &T_SC,
+               float distanceThreshold, std::vector<Match> &matches);
+
+  /// \brief Descriptor comparisons in the last call of match(), including the update
+  ///        of representative descriptors.
+  size_t numDescriptorComparisons() const {
+    return numDescriptorComparisons_;
+  }
+
+  /// \brief Successful landmark projections in the last call of match().
+  size_t numProjections() const {
+    return numProjections_;
+  }
+
+private:
+  /// \brief Cached representative descriptor of a landmark.
+  struct RepresentativeDescriptor
+  {
+    size_t numObservations = 0; ///< Observations the descriptor was selected from.
+    okvis::KeypointIdentifier newestObservation; ///< Newest of these observations.
+    std::vector<unsigned char> descriptor; ///< The descriptor.
+  };
+
+  /// \brief Get the representative descriptor of a landmark, reselecting it if the
+  ///        observations changed.
+  const std::vector<unsigned char> &representativeDescriptor(const okvis::Estimator &estimator,
+                                                             const okvis::MapPoint &landmark);
+
+  double searchRadius_; ///< Search radius around the projections. [pixels]
+  std::map<uint64_t, RepresentativeDescriptor> descriptors_; ///< Representative descriptor per landmark ID.
+  size_t numDescriptorComparisons_; ///< Descriptor comparisons in the last call of match().
+  size_t numProjections_; ///< Successful projections in the last call of match().
+};
+
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_MAPTOFRAMEMATCHER_HPP_ */
@@ -41,6 +41,7 @@
 #ifndef INCLUDE_OKVIS_VIOKEYFRAMEWINDOWMATCHINGALGORITHM_HPP_
 #define INCLUDE_OKVIS_VIOKEYFRAMEWINDOWMATCHINGALGORITHM_HPP_
 
+#include <atomic>
 #include <memory>
 
 #include <okvis/DenseMatcher.hpp>
@@ -137,6 +138,7 @@ public:
   virtual float distance(size_t indexA, size_t indexB) const {
     OKVIS_ASSERT_LT_DBG(MatchingAlgorithm::Exception, indexA, sizeA(), "index A out of bounds");
     OKVIS_ASSERT_LT_DBG(MatchingAlgorithm::Exception, indexB, sizeB(), "index B out of bounds");
+    numDescriptorComparisons_.fetch_add(1, std::memory_order_relaxed);
     const float dist = static_cast<float>(specificDescriptorDistance(
         frameA_->keypointDescriptor(camIdA_, indexA),
         frameB_->keypointDescriptor(camIdB_, indexB)));
@@ -163,6 +165,10 @@ public:
   size_t numMatches();
   /// \brief Get the number of uncertain matches.
   size_t numUncertainMatches();
+  /// \brief Get the number of descriptor comparisons.
+  size_t numDescriptorComparisons() const {
+    return numDescriptorComparisons_;
+  }
 
   /// \brief access the matching result.
   const okvis::Matches &getMatches() const;
@@ -211,6 +217,8 @@ private:
   size_t numMatches_ = 0;
   /// The number of uncertain matches.
   size_t numUncertainMatches_ = 0;
+  /// The number of descriptor comparisons, distance() is called from several threads.
+  mutable std::atomic<size_t> numDescriptorComparisons_{0};
 
   /// Focal length of camera used in frame A.
   double fA_ = 0;
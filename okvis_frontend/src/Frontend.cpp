@@ -40,6 +40,9 @@
 
 #include <okvis/Frontend.hpp>
 
+#include <algorithm>
+#include <set>
+
 #include <brisk/brisk.h>
 
 #include <opencv2/imgproc/imgproc.hpp>
@@ -65,6 +68,16 @@
 /// \brief okvis Main namespace of this package.
 namespace okvis {
 
+namespace {
+// Partial multiframes (asynchronous frame synchronization) may lack cameras:
+// only match if both frames of the camera have keypoints.
+bool bothDetected(const okvis::Estimator &estimator, uint64_t frameIdA,
+                  uint64_t frameIdB, size_t cameraIndex) {
+  return estimator.multiFrame(frameIdA)->numKeypoints(cameraIndex) > 0
+      && estimator.multiFrame(frameIdB)->numKeypoints(cameraIndex) > 0;
+}
+}  // namespace
+
 // Constructor.
 Frontend::Frontend(size_t numCameras)
     : isInitialized_(false),
@@ -73,18 +86,23 @@ Frontend::Frontend(size_t numCameras)
       briskDetectionThreshold_(50.0),
       briskDetectionAbsoluteThreshold_(800.0),
       briskDetectionMaximumKeypoints_(450),
+      detectionGridColumns_(0),
+      detectionGridRows_(0),
+      detectionCellQuota_(0),
       briskDescriptionRotationInvariance_(true),
       briskDescriptionScaleInvariance_(false),
       briskMatchingThreshold_(60.0),
       matcher_(
           std::unique_ptr<okvis::DenseMatcher>(new okvis::DenseMatcher(4))),
       keyframeInsertionOverlapThreshold_(0.6),
-      keyframeInsertionMatchingRatioThreshold_(0.2) {
+      keyframeInsertionMatchingRatioThreshold_(0.2),
+      numDescriptorComparisons_(0) {
   // create mutexes for feature detectors and descriptor extractors
   for (size_t i = 0; i < numCameras_; ++i) {
     featureDetectorMutexes_.push_back(
         std::unique_ptr<std::mutex>(new std::mutex()));
   }
+  detectionMasks_.resize(numCameras_);
   initialiseBriskFeatureDetectors();
 }
 
@@ -99,11 +117,30 @@ bool Frontend::detectAndDescribe(size_t cameraIndex,
   // check there are no keypoints here
   OKVIS_ASSERT_TRUE(Exception, keypoints == nullptr, "external keypoints currently not supported")
 
+  // the detector has to spend its keypoint budget on the unmasked image region only
+  const cv::Mat &mask = frameOut->geometry(cameraIndex)->mask();
+  if (mask.data != detectionMasks_[cameraIndex].data) {
+    detectionMasks_[cameraIndex] = mask;
+    featureDetectors_[cameraIndex] = createFeatureDetector(cameraIndex);
+  }
+
   frameOut->setDetector(cameraIndex, featureDetectors_[cameraIndex]);
   frameOut->setExtractor(cameraIndex, descriptorExtractors_[cameraIndex]);
 
   frameOut->detect(cameraIndex);
 
+  // the detector budget is enlarged for masking and bucketing: select before description
+  const size_t numKeypoints = frameOut->numKeypoints(cameraIndex);
+  if (numKeypoints > briskDetectionMaximumKeypoints_) {
+    std::vector<cv::KeyPoint> keypoints(numKeypoints);
+    for (size_t k = 0; k < numKeypoints; ++k) {
+      frameOut->getCvKeypoint(cameraIndex, k, keypoints[k]);
+    }
+    selectKeypoints(keypoints, frameOut->geometry(cameraIndex)->imageWidth(),
+                    frameOut->geometry(cameraIndex)->imageHeight());
+    frameOut->resetKeypoints(cameraIndex, keypoints);
+  }
+
   // ExtractionDirection == gravity direction in camera frame
   Eigen::Vector3d g_in_W(0, 0, -1);
   Eigen::Vector3d extractionDirection = T_WC.inverse().C() * g_in_W;
@@ -116,7 +153,7 @@ bool Frontend::detectAndDescribe(size_t cameraIndex,
 // Matching as well as initialization of landmarks and state.
 bool Frontend::dataAssociationAndInitialization(
     okvis::Estimator &estimator,
-    okvis::kinematics::Transformation & /*T_WS_propagated*/, // TODO sleutenegger: why is this not used here?
+    okvis::kinematics::Transformation &T_WS_propagated,
     const okvis::VioParameters &params,
     const std::shared_ptr<okvis::MapPointVector> /*map*/, // TODO sleutenegger: why is this not used here?
     std::shared_ptr<okvis::MultiFrame> framesInOut,
@@ -137,6 +174,7 @@ bool Frontend::dataAssociationAndInitialization(
                       "mixed frame types are not supported yet");
   }
   int num3dMatches = 0;
+  numDescriptorComparisons_ = 0;
 
   // first frame? (did do addStates before, so 1 frame minimum in estimator)
   if (estimator.numFrames() > 1) {
@@ -146,34 +184,68 @@ bool Frontend::dataAssociationAndInitialization(
     double uncertainMatchFraction = 0;
     bool rotationOnly = false;
 
+    // match all landmarks at once
+    if (params.optimization.mapToFrameMatching) {
+      TimerSwitchable matchMapTimer("2.4.0 matchToMap");
+      switch (distortionType) {
+        case okvis::cameras::NCameraSystem::RadialTangential: {
+          num3dMatches = matchToMap<
+              VioKeyframeWindowMatchingAlgorithm<
+                  okvis::cameras::PinholeCamera<
+                      okvis::cameras::RadialTangentialDistortion> > >(
+              estimator, framesInOut->id(), T_WS_propagated);
+          break;
+        }
+        case okvis::cameras::NCameraSystem::Equidistant: {
+          num3dMatches = matchToMap<
+              VioKeyframeWindowMatchingAlgorithm<
+                  okvis::cameras::PinholeCamera<
+                      okvis::cameras::EquidistantDistortion> > >(
+              estimator, framesInOut->id(), T_WS_propagated);
+          break;
+        }
+        case okvis::cameras::NCameraSystem::RadialTangential8: {
+          num3dMatches = matchToMap<
+              VioKeyframeWindowMatchingAlgorithm<
+                  okvis::cameras::PinholeCamera<
+                      okvis::cameras::RadialTangentialDistortion8> > >(
+              estimator, framesInOut->id(), T_WS_propagated);
+          break;
+        }
+        default: OKVIS_THROW(Exception, "Unsupported distortion type.")
+          break;
+      }
+      matchMapTimer.stop();
+    }
+
     // match to last keyframe
     TimerSwitchable matchKeyframesTimer("2.4.1 matchToKeyframes");
     switch (distortionType) {
       case okvis::cameras::NCameraSystem::RadialTangential: {
-        num3dMatches = matchToKeyframes<
+        num3dMatches += matchToKeyframes<
             VioKeyframeWindowMatchingAlgorithm<
                 okvis::cameras::PinholeCamera<
                     okvis::cameras::RadialTangentialDistortion> > >(
-            estimator, params, framesInOut->id(), rotationOnly, false,
-            &uncertainMatchFraction);
+            estimator, params, framesInOut->id(), T_WS_propagated, rotationOnly,
+            false, &uncertainMatchFraction);
         break;
       }
       case okvis::cameras::NCameraSystem::Equidistant: {
-        num3dMatches = matchToKeyframes<
+        num3dMatches += matchToKeyframes<
             VioKeyframeWindowMatchingAlgorithm<
                 okvis::cameras::PinholeCamera<
                     okvis::cameras::EquidistantDistortion> > >(
-            estimator, params, framesInOut->id(), rotationOnly, false,
-            &uncertainMatchFraction);
+            estimator, params, framesInOut->id(), T_WS_propagated, rotationOnly,
+            false, &uncertainMatchFraction);
         break;
       }
       case okvis::cameras::NCameraSystem::RadialTangential8: {
-        num3dMatches = matchToKeyframes<
+        num3dMatches += matchToKeyframes<
             VioKeyframeWindowMatchingAlgorithm<
                 okvis::cameras::PinholeCamera<
                     okvis::cameras::RadialTangentialDistortion8> > >(
-            estimator, params, framesInOut->id(), rotationOnly, false,
-            &uncertainMatchFraction);
+            estimator, params, framesInOut->id(), T_WS_propagated, rotationOnly,
+            false, &uncertainMatchFraction);
         break;
       }
       default: OKVIS_THROW(Exception, "Unsupported distortion type.")
@@ -366,11 +438,93 @@ bool Frontend::doWeNeedANewKeyframe(
     return true;
 }
 
+// Select the keyframes to match a new multiframe to.
+void Frontend::selectKeyframesToMatch(
+    const okvis::Estimator &estimator, const okvis::VioParameters &params,
+    const uint64_t currentFrameId,
+    const okvis::kinematics::Transformation &T_WS_propagated,
+    std::vector<uint64_t> &keyframeIds) const {
+  keyframeIds.clear();
+  const uint64_t lastFrameId = estimator.frameIdByAge(1);
+  okvis::MultiFramePtr currentFrame = estimator.multiFrame(currentFrameId);
+
+  // current camera poses
+  std::vector<okvis::kinematics::Transformation,
+      Eigen::aligned_allocator<okvis::kinematics::Transformation> > T_CW;
+  for (size_t im = 0; im < params.nCameraSystem.numCameras(); ++im) {
+    okvis::kinematics::Transformation T_SC;
+    estimator.getCameraSensorStates(currentFrameId, im, T_SC);
+    T_CW.push_back((T_WS_propagated * T_SC).inverse());
+  }
+
+  // landmarks of all keyframes, so that their positions are looked up in one go
+  std::vector<uint64_t> candidateKeyframeIds;
+  std::vector<size_t> firstLandmark;
+  std::vector<uint64_t> landmarkIds;
+  for (size_t age = 1; age < estimator.numFrames(); ++age) {
+    const uint64_t keyframeId = estimator.frameIdByAge(age);
+    if (!estimator.isKeyframe(keyframeId))
+      continue;
+    okvis::MultiFramePtr keyframe = estimator.multiFrame(keyframeId);
+    std::set<uint64_t> keyframeLandmarks;
+    for (size_t imA = 0; imA < keyframe->numFrames(); ++imA) {
+      for (size_t k = 0; k < keyframe->numKeypoints(imA); ++k) {
+        const uint64_t landmarkId = keyframe->landmarkId(imA, k);
+        if (landmarkId != 0)
+          keyframeLandmarks.insert(landmarkId);
+      }
+    }
+    candidateKeyframeIds.push_back(keyframeId);
+    firstLandmark.push_back(landmarkIds.size());
+    landmarkIds.insert(landmarkIds.end(), keyframeLandmarks.begin(), keyframeLandmarks.end());
+  }
+  firstLandmark.push_back(landmarkIds.size());
+  std::vector<Eigen::Vector4d, Eigen::aligned_allocator<Eigen::Vector4d> > landmarkPoints;
+  estimator.getLandmarkPositions(landmarkIds, landmarkPoints);
+
+  // score: landmarks of the keyframe visible at the propagated pose, then the landmarks
+  // shared with the last frame in the covisibility graph
+  std::vector<std::pair<std::pair<size_t, size_t>, uint64_t> > scores;
+  for (size_t i = 0; i < candidateKeyframeIds.size(); ++i) {
+    size_t numVisible = 0;
+    for (size_t l = firstLandmark[i]; l < firstLandmark[i + 1]; ++l) {
+      if (landmarkPoints[l].isZero())
+        continue;  // not in the estimator (any more)
+      for (size_t im = 0; im < currentFrame->numFrames(); ++im) {
+        Eigen::Vector2d keypoint;
+        if (currentFrame->numKeypoints(im) > 0
+            && currentFrame->geometry(im)->projectHomogeneous(T_CW[im] * landmarkPoints[l],
+                                                               &keypoint)
+                == okvis::cameras::CameraBase::ProjectionStatus::Successful) {
+          ++numVisible;
+          break;
+        }
+      }
+    }
+    const size_t covisibility =
+        estimator.numCovisibleLandmarks(candidateKeyframeIds[i], lastFrameId);
+    scores.push_back(std::make_pair(std::make_pair(numVisible, covisibility),
+                                    candidateKeyframeIds[i]));
+  }
+
+  // keyframes by decreasing score; ties go to the most recent one
+  std::stable_sort(
+      scores.begin(), scores.end(),
+      [](const std::pair<std::pair<size_t, size_t>, uint64_t> &a,
+         const std::pair<std::pair<size_t, size_t>, uint64_t> &b) {
+        return a.first > b.first;
+      });
+  for (size_t i = 0; i < scores.size(); ++i) {
+    keyframeIds.push_back(scores[i].second);
+  }
+}
+
 // Match a new multiframe to existing keyframes
 template<class MATCHING_ALGORITHM>
 int Frontend::matchToKeyframes(okvis::Estimator &estimator,
                                const okvis::VioParameters &params,
                                const uint64_t currentFrameId,
+                               const okvis::kinematics::Transformation &T_WS_propagated,
                                bool &rotationOnly,
                                bool usePoseUncertainty,
                                double *uncertainMatchFraction,
@@ -384,13 +538,19 @@ int Frontend::matchToKeyframes(okvis::Estimator &estimator,
   int retCtr = 0;
   int numUncertainMatches = 0;
 
+  // keyframes by predicted overlap
+  std::vector<uint64_t> keyframeIds;
+  selectKeyframesToMatch(estimator, params, currentFrameId, T_WS_propagated, keyframeIds);
+
   // go through all the frames and try to match the initialized keypoints
-  size_t kfcounter = 0;
-  for (size_t age = 1; age < estimator.numFrames(); ++age) {
-    uint64_t olderFrameId = estimator.frameIdByAge(age);
-    if (!estimator.isKeyframe(olderFrameId))
-      continue;
+  // (already done in one pass with matchToMap())
+  const size_t numKeyframes3d2d = params.optimization.mapToFrameMatching ?
+      0 : size_t(params.optimization.numMatchingKeyframes3d2d);
+  for (size_t i = 0; i < keyframeIds.size() && i < numKeyframes3d2d; ++i) {
+    uint64_t olderFrameId = keyframeIds[i];
     for (size_t im = 0; im < params.nCameraSystem.numCameras(); ++im) {
+      if (!bothDetected(estimator, olderFrameId, currentFrameId, im))
+        continue;
       MATCHING_ALGORITHM matchingAlgorithm(estimator,
                                            MATCHING_ALGORITHM::Match3D2D,
                                            briskMatchingThreshold_,
@@ -401,20 +561,18 @@ int Frontend::matchToKeyframes(okvis::Estimator &estimator,
       matcher_->match<MATCHING_ALGORITHM>(matchingAlgorithm);
       retCtr += matchingAlgorithm.numMatches();
       numUncertainMatches += matchingAlgorithm.numUncertainMatches();
+      numDescriptorComparisons_ += matchingAlgorithm.numDescriptorComparisons();
 
     }
-    kfcounter++;
-    if (kfcounter > 2)
-      break;
   }
 
-  kfcounter = 0;
   bool firstFrame = true;
-  for (size_t age = 1; age < estimator.numFrames(); ++age) {
-    uint64_t olderFrameId = estimator.frameIdByAge(age);
-    if (!estimator.isKeyframe(olderFrameId))
-      continue;
+  for (size_t i = 0; i < keyframeIds.size()
+      && i < size_t(params.optimization.numMatchingKeyframes2d2d); ++i) {
+    uint64_t olderFrameId = keyframeIds[i];
     for (size_t im = 0; im < params.nCameraSystem.numCameras(); ++im) {
+      if (!bothDetected(estimator, olderFrameId, currentFrameId, im))
+        continue;
       MATCHING_ALGORITHM matchingAlgorithm(estimator,
                                            MATCHING_ALGORITHM::Match2D2D,
                                            briskMatchingThreshold_,
@@ -425,11 +583,12 @@ int Frontend::matchToKeyframes(okvis::Estimator &estimator,
       matcher_->match<MATCHING_ALGORITHM>(matchingAlgorithm);
       retCtr += matchingAlgorithm.numMatches();
       numUncertainMatches += matchingAlgorithm.numUncertainMatches();
+      numDescriptorComparisons_ += matchingAlgorithm.numDescriptorComparisons();
     }
 
     // remove outliers
-    // only do RANSAC 3D2D with most recent KF
-    if (kfcounter == 0 && isInitialized_)
+    // only do RANSAC 3D2D with the best overlapping KF
+    if (i == 0 && isInitialized_)
       runRansac3d2d(estimator, params.nCameraSystem,
                     estimator.multiFrame(currentFrameId), removeOutliers);
 
@@ -443,10 +602,6 @@ int Frontend::matchToKeyframes(okvis::Estimator &estimator,
       rotationOnly = rotationOnly_tmp;
       firstFrame = false;
     }
-
-    kfcounter++;
-    if (kfcounter > 1)
-      break;
   }
 
   // calculate fraction of safe matches
@@ -457,6 +612,30 @@ int Frontend::matchToKeyframes(okvis::Estimator &estimator,
   return retCtr;
 }
 
+// Match all initialised landmarks to a new multiframe in one pass.
+template<class MATCHING_ALGORITHM>
+int Frontend::matchToMap(okvis::Estimator &estimator, const uint64_t currentFrameId,
+                         const okvis::kinematics::Transformation &T_WS_propagated) {
+  okvis::MultiFramePtr multiFrame = estimator.multiFrame(currentFrameId);
+  std::vector<okvis::kinematics::Transformation,
+      Eigen::aligned_allocator<okvis::kinematics::Transformation> > T_SC(multiFrame->numFrames());
+  for (size_t im = 0; im < multiFrame->numFrames(); ++im) {
+    estimator.getCameraSensorStates(currentFrameId, im, T_SC[im]);
+  }
+  std::vector<MapToFrameMatcher::Match> matches;
+  mapToFrameMatcher_.match(estimator, multiFrame, T_WS_propagated, T_SC,
+                           float(briskMatchingThreshold_), matches);
+  numDescriptorComparisons_ += mapToFrameMatcher_.numDescriptorComparisons();
+
+  for (size_t i = 0; i < matches.size(); ++i) {
+    const okvis::KeypointIdentifier &kid = matches[i].first;
+    multiFrame->setLandmarkId(kid.cameraIndex, kid.keypointIndex, matches[i].second);
+    estimator.addObservation<typename MATCHING_ALGORITHM::camera_geometry_t>(
+        matches[i].second, currentFrameId, kid.cameraIndex, kid.keypointIndex);
+  }
+  return int(matches.size());
+}
+
 // Match a new multiframe to the last frame.
 template<class MATCHING_ALGORITHM>
 int Frontend::matchToLastFrame(okvis::Estimator &estimator,
@@ -480,6 +659,10 @@ int Frontend::matchToLastFrame(okvis::Estimator &estimator,
   int retCtr = 0;
 
   for (size_t im = 0; im < params.nCameraSystem.numCameras(); ++im) {
+    if (params.optimization.mapToFrameMatching)
+      break;  // already done in one pass with matchToMap()
+    if (!bothDetected(estimator, lastFrameId, currentFrameId, im))
+      continue;
     MATCHING_ALGORITHM matchingAlgorithm(estimator,
                                          MATCHING_ALGORITHM::Match3D2D,
                                          briskMatchingThreshold_,
@@ -489,12 +672,15 @@ int Frontend::matchToLastFrame(okvis::Estimator &estimator,
     // match 3D-2D
     matcher_->match<MATCHING_ALGORITHM>(matchingAlgorithm);
     retCtr += matchingAlgorithm.numMatches();
+    numDescriptorComparisons_ += matchingAlgorithm.numDescriptorComparisons();
   }
 
   runRansac3d2d(estimator, params.nCameraSystem,
                 estimator.multiFrame(currentFrameId), removeOutliers);
 
   for (size_t im = 0; im < params.nCameraSystem.numCameras(); ++im) {
+    if (!bothDetected(estimator, lastFrameId, currentFrameId, im))
+      continue;
     MATCHING_ALGORITHM matchingAlgorithm(estimator,
                                          MATCHING_ALGORITHM::Match2D2D,
                                          briskMatchingThreshold_,
@@ -504,6 +690,7 @@ int Frontend::matchToLastFrame(okvis::Estimator &estimator,
     // match 2D-2D for initialization of new (mono-)correspondences
     matcher_->match<MATCHING_ALGORITHM>(matchingAlgorithm);
     retCtr += matchingAlgorithm.numMatches();
+    numDescriptorComparisons_ += matchingAlgorithm.numDescriptorComparisons();
   }
 
   // remove outliers
@@ -532,6 +719,10 @@ void Frontend::matchStereo(okvis::Estimator &estimator,
       if (!multiFrame->hasOverlap(im0, im1)) {
         continue;
       }
+      // one of the cameras may be missing in a partial multiframe
+      if (multiFrame->numKeypoints(im0) == 0 || multiFrame->numKeypoints(im1) == 0) {
+        continue;
+      }
 
       MATCHING_ALGORITHM matchingAlgorithm(estimator,
                                            MATCHING_ALGORITHM::Match2D2D,
@@ -545,10 +736,12 @@ void Frontend::matchStereo(okvis::Estimator &estimator,
       // match 3D-2D
       matchingAlgorithm.setMatchingType(MATCHING_ALGORITHM::Match3D2D);
       matcher_->match<MATCHING_ALGORITHM>(matchingAlgorithm);
+      numDescriptorComparisons_ += matchingAlgorithm.numDescriptorComparisons();
 
       // match 2D-3D
       matchingAlgorithm.setFrames(mfId, mfId, im1, im0);  // newest frame
       matcher_->match<MATCHING_ALGORITHM>(matchingAlgorithm);
+      numDescriptorComparisons_ += matchingAlgorithm.numDescriptorComparisons();
     }
   }
 
@@ -809,6 +1002,91 @@ int Frontend::runRansac2d2d(okvis::Estimator &estimator,
   return 0;
 }
 
+// Instantiates the feature detector of camera cameraIndex with the current settings.
+std::shared_ptr<cv::FeatureDetector> Frontend::createFeatureDetector(
+    size_t cameraIndex) const {
+  // scale the keypoint budget by the inverse of the unmasked image fraction
+  size_t maximumKeypoints = briskDetectionMaximumKeypoints_;
+  const cv::Mat &mask = detectionMasks_[cameraIndex];
+  if (mask.data) {
+    const double validFraction = std::max(
+        0.05, double(cv::countNonZero(mask)) / double(mask.total()));
+    maximumKeypoints = size_t(double(maximumKeypoints) / validFraction);
+  }
+  const bool bucketing = detectionGridColumns_ > 0 && detectionGridRows_ > 0;
+#ifdef __ARM_NEON__
+  // the grid adapted detector buckets by itself
+  return std::shared_ptr<cv::FeatureDetector>(
+      new cv::GridAdaptedFeatureDetector(
+      new cv::FastFeatureDetector(briskDetectionThreshold_),
+          maximumKeypoints, bucketing ? detectionGridRows_ : 7,
+          bucketing ? detectionGridColumns_ : 4)); // from config file, except the default 7x4...
+#else
+  // leave candidates in sparsely textured cells for the bucketing
+  if (bucketing) {
+    maximumKeypoints *= 2;
+  }
+  return std::shared_ptr<cv::FeatureDetector>(
+      new brisk::ScaleSpaceFeatureDetector<brisk::HarrisScoreCalculator>(
+          briskDetectionThreshold_, briskDetectionOctaves_,
+          briskDetectionAbsoluteThreshold_,
+          maximumKeypoints));
+#endif
+}
+
+// Reduce detected keypoints to the maximum number of keypoints.
+void Frontend::selectKeypoints(std::vector<cv::KeyPoint> &keypoints,
+                               int imageWidth, int imageHeight) const {
+  const size_t maximumKeypoints = briskDetectionMaximumKeypoints_;
+  if (detectionGridColumns_ == 0 || detectionGridRows_ == 0) {
+    cv::KeyPointsFilter::retainBest(keypoints, maximumKeypoints);
+    if (keypoints.size() > maximumKeypoints) {
+      keypoints.resize(maximumKeypoints);  // retainBest keeps ties
+    }
+    return;
+  }
+
+  // strongest first
+  std::stable_sort(keypoints.begin(), keypoints.end(),
+                   [](const cv::KeyPoint &a, const cv::KeyPoint &b) {
+                     return a.response > b.response;});
+
+  // fill every cell up to its quota
+  const size_t numCells = detectionGridColumns_ * detectionGridRows_;
+  const size_t cellQuota =
+      detectionCellQuota_ > 0 ?
+          detectionCellQuota_ : std::max(size_t(1), maximumKeypoints / numCells);
+  std::vector<size_t> cellCounts(numCells, 0);
+  std::vector<cv::KeyPoint> selected;
+  std::vector<cv::KeyPoint> remaining;
+  selected.reserve(maximumKeypoints);
+  for (size_t k = 0; k < keypoints.size(); ++k) {
+    const size_t column = std::min(
+        detectionGridColumns_ - 1,
+        size_t(std::max(0.0f, keypoints[k].pt.x) * detectionGridColumns_ / imageWidth));
+    const size_t row = std::min(
+        detectionGridRows_ - 1,
+        size_t(std::max(0.0f, keypoints[k].pt.y) * detectionGridRows_ / imageHeight));
+    size_t &cellCount = cellCounts[row * detectionGridColumns_ + column];
+    if (cellCount < cellQuota) {
+      ++cellCount;
+      selected.push_back(keypoints[k]);
+    } else {
+      remaining.push_back(keypoints[k]);
+    }
+  }
+
+  // quotas of sparsely textured cells go to the strongest of the rest
+  for (size_t k = 0; k < remaining.size() && selected.size() < maximumKeypoints; ++k) {
+    selected.push_back(remaining[k]);
+  }
+  // large quotas may exceed the budget: the weakest are dropped
+  if (selected.size() > maximumKeypoints) {
+    selected.resize(maximumKeypoints);
+  }
+  keypoints.swap(selected);
+}
+
 // (re)instantiates feature detectors and descriptor extractors. Used after settings changed or at startup.
 void Frontend::initialiseBriskFeatureDetectors() {
   for (auto it = featureDetectorMutexes_.begin();
@@ -818,18 +1096,7 @@ void Frontend::initialiseBriskFeatureDetectors() {
   featureDetectors_.clear();
   descriptorExtractors_.clear();
   for (size_t i = 0; i < numCameras_; ++i) {
-    featureDetectors_.push_back(
-        std::shared_ptr<cv::FeatureDetector>(
-#ifdef __ARM_NEON__
-            new cv::GridAdaptedFeatureDetector( 
-            new cv::FastFeatureDetector(briskDetectionThreshold_),
-                briskDetectionMaximumKeypoints_, 7, 4 ))); // from config file, except the 7x4...
-#else
-            new brisk::ScaleSpaceFeatureDetector<brisk::HarrisScoreCalculator>(
-                briskDetectionThreshold_, briskDetectionOctaves_,
-                briskDetectionAbsoluteThreshold_,
-                briskDetectionMaximumKeypoints_)));
-#endif
+    featureDetectors_.push_back(createFeatureDetector(i));
     descriptorExtractors_.push_back(
         std::shared_ptr<cv::DescriptorExtractor>(
             new brisk::BriskDescriptorExtractor(
@@ -0,0 +1,251 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file MapToFrameMatcher.cpp
+ * @brief Source file for the MapToFrameMatcher class.
+ */
+
+#include <okvis/MapToFrameMatcher.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <brisk/internal/hamming.h>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+namespace {
+// Descriptor distance, BRISK descriptors of 48 bytes.
+uint32_t descriptorDistance(const unsigned char *descriptorA, const unsigned char *descriptorB) {
+  return brisk::Hamming::PopcntofXORed(descriptorA, descriptorB, 3/*48 / 16*/);
+}
+
+// Representative descriptors are selected among the most recent observations only.
+const size_t maxRepresentativeObservations = 8;
+}  // namespace
+
+// Constructor.
+MapToFrameMatcher::MapToFrameMatcher(double searchRadius)
+    : searchRadius_(searchRadius),
+      numDescriptorComparisons_(0),
+      numProjections_(0) {
+}
+
+// Match the initialised landmarks to the keypoints of a multiframe.
+size_t MapToFrameMatcher::match(
+    const okvis::Estimator &estimator, okvis::MultiFramePtr multiFrame,
+    const okvis::kinematics::Transformation &T_WS,
+    const std::vector<okvis::kinematics::Transformation,
+        Eigen::aligned_allocator<okvis::kinematics::Transformation> > &T_SC,
+    float distanceThreshold, std::vector<Match> &matches) {
+  OKVIS_ASSERT_TRUE(Exception, T_SC.size() == multiFrame->numFrames(),
+                    "need extrinsics for every camera");
+  matches.clear();
+  numDescriptorComparisons_ = 0;
+  numProjections_ = 0;
+
+  // initialised landmarks and their representative descriptors
+  okvis::PointMap landmarkMap;
+  estimator.getLandmarks(landmarkMap);
+  std::vector<uint64_t> landmarkIds;
+  std::vector<const std::vector<unsigned char> *> landmarkDescriptors;
+  Eigen::Matrix4Xd hp_W(4, landmarkMap.size());
+  for (okvis::PointMap::const_iterator it = landmarkMap.begin(); it != landmarkMap.end(); ++it) {
+    if (it->second.observations.empty() || !estimator.isLandmarkInitialized(it->first)) {
+      continue;
+    }
+    const std::vector<unsigned char> &descriptor = representativeDescriptor(estimator, it->second);
+    if (descriptor.empty()) {
+      continue;
+    }
+    hp_W.col(landmarkIds.size()) = it->second.point;
+    landmarkIds.push_back(it->first);
+    landmarkDescriptors.push_back(&descriptor);
+  }
+  hp_W.conservativeResize(4, landmarkIds.size());
+
+  // forget landmarks that were removed
+  for (std::map<uint64_t, RepresentativeDescriptor>::iterator it = descriptors_.begin();
+       it != descriptors_.end();) {
+    if (landmarkMap.find(it->first) == landmarkMap.end()) {
+      it = descriptors_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  if (landmarkIds.empty()) {
+    return 0;
+  }
+
+  for (size_t im = 0; im < multiFrame->numFrames(); ++im) {
+    const size_t numKeypoints = multiFrame->numKeypoints(im);
+    if (numKeypoints == 0) {
+      continue;
+    }
+    std::shared_ptr<const okvis::cameras::CameraBase> geometry = multiFrame->geometry(im);
+
+    // grid index of the keypoints without landmark, cells as large as the search radius
+    const double cellSize = std::max(1.0, searchRadius_);
+    const int cols = int(std::ceil(geometry->imageWidth() / cellSize));
+    const int rows = int(std::ceil(geometry->imageHeight() / cellSize));
+    std::vector<std::vector<size_t> > grid(cols * rows);
+    std::vector<Eigen::Vector2d, Eigen::aligned_allocator<Eigen::Vector2d> > keypoints(
+        numKeypoints);
+    for (size_t k = 0; k < numKeypoints; ++k) {
+      multiFrame->getKeypoint(im, k, keypoints[k]);
+      if (multiFrame->landmarkId(im, k) != 0) {
+        continue;
+      }
+      const int col = std::min(cols - 1, std::max(0, int(keypoints[k][0] / cellSize)));
+      const int row = std::min(rows - 1, std::max(0, int(keypoints[k][1] / cellSize)));
+      grid[row * cols + col].push_back(k);
+    }
+
+    // project all landmarks at once
+    const okvis::kinematics::Transformation T_CW = (T_WS * T_SC[im]).inverse();
+    const Eigen::Matrix4Xd hp_C = T_CW.T() * hp_W;
+    Eigen::Matrix2Xd projections(2, hp_C.cols());
+    std::vector<okvis::cameras::CameraBase::ProjectionStatus> stati;
+    geometry->projectHomogeneousBatch(hp_C, &projections, &stati);
+
+    // best keypoint per landmark, then best landmark per keypoint
+    std::vector<uint32_t> keypointDistances(numKeypoints,
+                                            std::numeric_limits<uint32_t>::max());
+    std::vector<size_t> keypointLandmarks(numKeypoints, landmarkIds.size());
+    const double radiusSquared = searchRadius_ * searchRadius_;
+    for (size_t l = 0; l < landmarkIds.size(); ++l) {
+      if (stati[l] != okvis::cameras::CameraBase::ProjectionStatus::Successful) {
+        continue;
+      }
+      ++numProjections_;
+      const Eigen::Vector2d projection = projections.col(l);
+      const int colMin = std::max(0, int((projection[0] - searchRadius_) / cellSize));
+      const int colMax = std::min(cols - 1, int((projection[0] + searchRadius_) / cellSize));
+      const int rowMin = std::max(0, int((projection[1] - searchRadius_) / cellSize));
+      const int rowMax = std::min(rows - 1, int((projection[1] + searchRadius_) / cellSize));
+      uint32_t bestDistance = uint32_t(distanceThreshold);
+      size_t bestKeypoint = numKeypoints;
+      for (int row = rowMin; row <= rowMax; ++row) {
+        for (int col = colMin; col <= colMax; ++col) {
+          const std::vector<size_t> &cell = grid[row * cols + col];
+          for (size_t i = 0; i < cell.size(); ++i) {
+            const size_t k = cell[i];
+            if ((keypoints[k] - projection).squaredNorm() > radiusSquared) {
+              continue;
+            }
+            ++numDescriptorComparisons_;
+            const uint32_t distance = descriptorDistance(landmarkDescriptors[l]->data(),
+                                                         multiFrame->keypointDescriptor(im, k));
+            if (distance < bestDistance) {
+              bestDistance = distance;
+              bestKeypoint = k;
+            }
+          }
+        }
+      }
+      if (bestKeypoint < numKeypoints && bestDistance < keypointDistances[bestKeypoint]) {
+        keypointDistances[bestKeypoint] = bestDistance;
+        keypointLandmarks[bestKeypoint] = l;
+      }
+    }
+
+    for (size_t k = 0; k < numKeypoints; ++k) {
+      if (keypointLandmarks[k] < landmarkIds.size()) {
+        matches.push_back(Match(okvis::KeypointIdentifier(multiFrame->id(), im, k),
+                                landmarkIds[keypointLandmarks[k]]));
+      }
+    }
+  }
+  return matches.size();
+}
+
+// Get the representative descriptor of a landmark.
+const std::vector<unsigned char> &MapToFrameMatcher::representativeDescriptor(
+    const okvis::Estimator &estimator, const okvis::MapPoint &landmark) {
+  RepresentativeDescriptor &representative = descriptors_[landmark.id];
+  // the observations are ordered by frame ID, so a new observation replacing a removed
+  // one changes the newest observation even if their number stays the same
+  const okvis::KeypointIdentifier newestObservation =
+      landmark.observations.empty() ? okvis::KeypointIdentifier()
+                                    : landmark.observations.rbegin()->first;
+  if (representative.numObservations == landmark.observations.size()
+      && representative.newestObservation == newestObservation) {
+    return representative.descriptor;
+  }
+  representative.numObservations = landmark.observations.size();
+  representative.newestObservation = newestObservation;
+
+  // the most recent observations (sorted by frame ID)
+  std::vector<const unsigned char *> candidates;
+  for (std::map<okvis::KeypointIdentifier, uint64_t>::const_reverse_iterator it =
+      landmark.observations.rbegin();
+      it != landmark.observations.rend() && candidates.size() < maxRepresentativeObservations;
+      ++it) {
+    const unsigned char *descriptor = estimator.multiFrame(it->first.frameId)->keypointDescriptor(
+        it->first.cameraIndex, it->first.keypointIndex);
+    if (descriptor) {
+      candidates.push_back(descriptor);
+    }
+  }
+  if (candidates.empty()) {
+    representative.descriptor.clear();
+    return representative.descriptor;
+  }
+
+  // smallest median distance to the others
+  size_t best = 0;
+  if (candidates.size() > 2) {
+    Eigen::MatrixXi distances = Eigen::MatrixXi::Zero(candidates.size(), candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      for (size_t j = i + 1; j < candidates.size(); ++j) {
+        distances(i, j) = distances(j, i) = int(descriptorDistance(candidates[i], candidates[j]));
+        ++numDescriptorComparisons_;
+      }
+    }
+    int bestMedian = std::numeric_limits<int>::max();
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      std::vector<int> row(distances.data() + i * candidates.size(),
+                           distances.data() + (i + 1) * candidates.size());
+      std::nth_element(row.begin(), row.begin() + row.size() / 2, row.end());
+      if (row[row.size() / 2] < bestMedian) {
+        bestMedian = row[row.size() / 2];
+        best = i;
+      }
+    }
+  }
+  representative.descriptor.assign(candidates[best], candidates[best] + 48);
+  return representative.descriptor;
+}
+
+}  // namespace okvis
@@ -150,6 +150,7 @@ void VioKeyframeWindowMatchingAlgorithm<CAMERA_GEOMETRY_T>::doSetup() {
   // reset the match counter
   numMatches_ = 0;
   numUncertainMatches_ = 0;
+  numDescriptorComparisons_ = 0;
 
   const size_t numA = frameA_->numKeypoints(camIdA_);
   skipA_.clear();
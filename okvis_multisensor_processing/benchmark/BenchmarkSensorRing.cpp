@@ -0,0 +1,165 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file BenchmarkSensorRing.cpp
+ * @brief Latency of the shared memory sensor ring from the producer call until the
+ *        VioInterface receives the data.
+ *
+ * Images are timed in two modes (argument "mode"): 0: copied in with addImage(),
+ * 1: written in place into an acquired slot, i.e. only publishing is timed.
+ */
+
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <okvis/SharedMemorySensorRing.hpp>
+
+namespace {
+
+// Sink that records the arrival time of the last delivery and releases images right away.
+class TimingVio : public okvis::VioInterface {
+ public:
+  bool addImage(const okvis::Time &, size_t, const cv::Mat &,
+                const std::vector<cv::KeyPoint> *, bool *) {
+    return false;
+  }
+  bool addKeypoints(const okvis::Time &, size_t,
+                    const std::vector<cv::KeyPoint> &,
+                    const std::vector<uint64_t> &, const cv::Mat &, bool *) {
+    return false;
+  }
+  bool addImuMeasurement(const okvis::Time &, const Eigen::Vector3d &,
+                         const Eigen::Vector3d &) {
+    arrived();
+    return true;
+  }
+  bool addImageBuffer(const okvis::Time &, size_t, const cv::Mat &,
+                      const ImageReleaseCallback &releaseCallback) {
+    releaseCallback();
+    arrived();
+    return true;
+  }
+
+  // Wait for the next delivery and return its arrival time.
+  std::chrono::steady_clock::time_point waitForArrival() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this]() {return numArrived_ > 0;});
+    --numArrived_;
+    return arrival_;
+  }
+
+ private:
+  void arrived() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    arrival_ = std::chrono::steady_clock::now();
+    ++numArrived_;
+    condition_.notify_one();
+  }
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::chrono::steady_clock::time_point arrival_;
+  int numArrived_ = 0;
+};
+
+std::string ringName() {
+  return "/okvis_benchmark_ring_" + std::to_string(getpid());
+}
+
+}  // namespace
+
+// Image latency. Arguments: mode, rows, cols.
+static void BM_SensorRingImage(benchmark::State &state) {
+  const bool inPlace = state.range(0) == 1;
+  const int rows = state.range(1);
+  const int cols = state.range(2);
+  okvis::SensorRingParameters parameters;
+  parameters.numImageSlots = 4;
+  parameters.maxImageBytes = rows * cols;
+  TimingVio vio;
+  okvis::SensorRingProducer producer(ringName(), parameters);
+  okvis::SensorRingConsumer consumer(ringName(), vio);
+  cv::Mat image(rows, cols, CV_8UC1, cv::Scalar(128));
+  okvis::Time stamp(1, 0);
+
+  for (auto _ : state) {
+    okvis::SensorRingProducer::ImageSlot slot;
+    if (inPlace) {
+      // the driver writes the image into the slot, not part of the transport latency
+      producer.acquireImageSlot(rows, cols, CV_8UC1, slot, 1.0);
+      image.copyTo(slot.image);
+    }
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    if (inPlace) {
+      producer.publishImage(slot, stamp, 0);
+    } else {
+      producer.addImage(stamp, 0, image, 1.0);
+    }
+    const std::chrono::steady_clock::time_point arrival = vio.waitForArrival();
+    state.SetIterationTime(
+        std::chrono::duration<double>(arrival - start).count());
+    stamp += okvis::Duration(0.05);
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * rows * cols);
+}
+BENCHMARK(BM_SensorRingImage)
+    ->ArgNames({"mode", "rows", "cols"})
+    ->Args({0, 480, 752})->Args({1, 480, 752})
+    ->Args({0, 1024, 1280})->Args({1, 1024, 1280})
+    ->UseManualTime()->Unit(benchmark::kMicrosecond);
+
+// IMU reading latency.
+static void BM_SensorRingImu(benchmark::State &state) {
+  TimingVio vio;
+  okvis::SensorRingProducer producer(ringName(), okvis::SensorRingParameters());
+  okvis::SensorRingConsumer consumer(ringName(), vio);
+  const Eigen::Vector3d alpha(0.0, 0.0, 9.81);
+  const Eigen::Vector3d omega = Eigen::Vector3d::Zero();
+  okvis::Time stamp(1, 0);
+
+  for (auto _ : state) {
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    producer.addImuMeasurement(stamp, alpha, omega);
+    const std::chrono::steady_clock::time_point arrival = vio.waitForArrival();
+    state.SetIterationTime(
+        std::chrono::duration<double>(arrival - start).count());
+    stamp += okvis::Duration(0.005);
+  }
+}
+BENCHMARK(BM_SensorRingImu)->UseManualTime()->Unit(benchmark::kMicrosecond);
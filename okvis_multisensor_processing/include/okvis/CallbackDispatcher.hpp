@@ -0,0 +1,105 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file okvis/CallbackDispatcher.hpp
+ * @brief Header file for the CallbackDispatcher class.
+ */
+
+#ifndef INCLUDE_OKVIS_CALLBACKDISPATCHER_HPP_
+#define INCLUDE_OKVIS_CALLBACKDISPATCHER_HPP_
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include <okvis/Parameters.hpp>
+#include <okvis/threadsafe/ThreadsafeQueue.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/**
+ * @brief Invokes user callbacks on an own executor thread according to a
+ *        CallbackDispatchPolicy, such that a slow consumer cannot stall the caller.
+ */
+class CallbackDispatcher
+{
+public:
+  /// \brief A callback invocation with all its arguments bound.
+  typedef std::function<void()> Job;
+
+  /**
+   * @brief Constructor. Starts the executor thread unless the policy is Synchronous.
+   * @param parameters Policy and queue size.
+   */
+  explicit CallbackDispatcher(const okvis::CallbackDispatchParameters &parameters);
+
+  /// \brief Destructor. Calls shutdown().
+  ~CallbackDispatcher();
+
+  /// \brief The dispatch settings.
+  const okvis::CallbackDispatchParameters &parameters() const {
+    return parameters_;
+  }
+
+  /**
+   * @brief Dispatch a callback invocation according to the policy.
+   *
+   * Synchronous: runs the job right away. LatestOnly and Bounded: never blocks,
+   * drops the oldest pending job if full. Blocking: waits while full.
+   * @param job The invocation.
+   */
+  void dispatch(const Job &job);
+
+  /// \brief Run all pending jobs and stop the executor thread. Jobs dispatched
+  ///        afterwards are dropped.
+  void shutdown();
+
+  /// \brief Number of jobs dropped so far.
+  uint64_t numDropped() const {
+    return numDropped_;
+  }
+
+private:
+  /// \brief Loop running the jobs.
+  void executorLoop();
+
+  okvis::CallbackDispatchParameters parameters_; ///< Policy and queue size.
+  okvis::threadsafe::ThreadSafeQueue<Job> jobs_; ///< Pending jobs.
+  std::atomic_bool shutdown_; ///< Set by shutdown().
+  std::atomic<uint64_t> numDropped_; ///< Number of dropped jobs.
+  std::thread executorThread_; ///< Thread running executorLoop().
+};
+
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_CALLBACKDISPATCHER_HPP_ */
@@ -44,6 +44,7 @@
 #define INCLUDE_OKVIS_FRAMESYNCHRONIZER_HPP_
 
 #include <memory>
+#include <vector>
 #include <okvis/Measurements.hpp>
 #include <okvis/MultiFrame.hpp>
 #include <okvis/VioInterface.hpp>
@@ -62,6 +63,24 @@ class FrameSynchronizer
 public:
   OKVIS_DEFINE_EXCEPTION(Exception, std::runtime_error)
 
+  /// @brief What to do with the keypoints of a frame after detection (asynchronous mode).
+  enum class DetectionResult
+  {
+    Merge,   ///< The multiframe is still pending: copy the keypoints into it.
+    Append,  ///< The multiframe was dispatched already: append the keypoints for later matching.
+    Discard  ///< The multiframe was dispatched already or dropped: discard the keypoints.
+  };
+
+  /// @brief Counters on the multiframes that went through the synchronizer (asynchronous mode).
+  struct Statistics
+  {
+    size_t numDispatched = 0;      ///< Multiframes handed to the matching.
+    size_t numPartial = 0;         ///< Dispatched multiframes in which not all cameras had completed detection.
+    size_t numDropped = 0;         ///< Multiframes dropped because required cameras were missing.
+    size_t numLateAppended = 0;    ///< Late frames appended to a dispatched multiframe.
+    size_t numLateDiscarded = 0;   ///< Late frames discarded.
+  };
+
 
   /**
    * @brief Constructor. Calls init().
@@ -80,8 +99,12 @@ public:
 
   /**
    * @brief Adds a new frame to the internal buffer and returns the Multiframe containing the frame.
+   *
+   * In asynchronous mode the image is not set, since the multiframe may be dispatched before
+   * detection completes for this frame.
    * @param frame New frame.
-   * @return Multiframe with the added frame in it.
+   * @return Multiframe with the added frame in it. In asynchronous mode nullptr if the frame is
+   *         too old or is to be discarded as late frame.
    */
   std::shared_ptr<okvis::MultiFrame> addNewFrame(
       std::shared_ptr<okvis::CameraMeasurement> &frame);
@@ -109,8 +132,78 @@ public:
    */
   bool detectionCompletedForAllCameras(uint64_t multiFrameId);
 
+  /**
+   * @brief Whether multiframes are dispatched before all cameras completed detection.
+   *        See okvis::FrameSynchronizationParameters.
+   */
+  bool isAsynchronous() const {
+    return parameters_.frameSynchronization.asynchronous;
+  }
+
+  /**
+   * @brief Inform the synchronizer that camera cameraIndex completed keypoint detection and description
+   *        for a multiframe (asynchronous mode).
+   * @param multiFrameId ID of the multiframe returned by addNewFrame().
+   * @param cameraIndex The camera index.
+   * @param now Current (wall clock) time, used for the dispatch deadline.
+   * @return Merge if the multiframe still awaits dispatch. Otherwise the late frame policy.
+   */
+  DetectionResult detectionEndedForFrame(uint64_t multiFrameId, size_t cameraIndex,
+                                         const okvis::Time &now);
+
+  /**
+   * @brief Get the multiframes that are ready for matching in temporal order (asynchronous mode).
+   *
+   * A multiframe is ready once all cameras, or at least okvis::FrameSynchronizationParameters::minCameras
+   * including the required ones, completed detection, or once the deadline after the first completed
+   * detection expired. Older pending multiframes are dispatched alongside, or dropped if required cameras are
+   * missing, such that the returned multiframes are always newer than the ones returned before.
+   * @param[in]  now Current (wall clock) time.
+   * @param[out] multiFrames The multiframes to process, oldest first.
+   * @return True if multiFrames is not empty.
+   */
+  bool popDispatchableMultiFrames(const okvis::Time &now,
+                                  std::vector<std::shared_ptr<okvis::MultiFrame> > &multiFrames);
+
+  /**
+   * @brief Mark a multiframe as deliberately skipped (load shedding): it is neither completed, dispatched
+   *        nor reported as dropped, and frames arriving for it later are discarded in asynchronous mode.
+   * @param multiFrameId ID of the multiframe.
+   */
+  void skipMultiFrame(uint64_t multiFrameId);
+
+  /// @brief Get the counters on dispatched, partial, dropped and late frames.
+  const Statistics &statistics() const {
+    return statistics_;
+  }
+
 private:
 
+  /// @brief State of a multiframe in the buffer.
+  enum class EntryState
+  {
+    Pending,     ///< Awaiting detections.
+    Dispatched,  ///< Handed to the matching.
+    Dropped,     ///< Discarded without matching.
+    Skipped      ///< Skipped before detection, see skipMultiFrame().
+  };
+
+  /// @brief A multiframe in the buffer together with its detection progress.
+  struct BufferEntry
+  {
+    std::shared_ptr<okvis::MultiFrame> multiFrame;  ///< The multiframe.
+    size_t numDetected = 0;  ///< How many times detection has completed.
+    std::vector<bool> detected;  ///< Which cameras completed detection (asynchronous mode).
+    okvis::Time firstDetection;  ///< Wall clock time of the first completed detection (asynchronous mode).
+    EntryState state = EntryState::Pending;  ///< Dispatch state (asynchronous mode).
+  };
+
+  /// @brief Ready for dispatch? See popDispatchableMultiFrames().
+  bool isReady(const BufferEntry &entry, const okvis::Time &now) const;
+
+  /// @brief Have all required cameras completed detection?
+  bool hasRequiredCameras(const BufferEntry &entry) const;
+
   /**
    * @brief Find a multiframe in the buffer that has a timestamp within the tolerances of the given one. The tolerance
    *        is given as a parameter in okvis::VioParameters::sensors_information::frameTimestampTolerance
@@ -137,8 +230,8 @@ private:
   size_t numCameras_;
   /// Timestamp tolerance to classify multiple frames as being part of the same multiframe.
   double timeTol_;
-  /// Circular buffer containing a multiframe pointer and a counter for how many times detection has completed.
-  std::vector<std::pair<std::shared_ptr<okvis::MultiFrame>, size_t> > frameBuffer_;
+  /// Circular buffer containing the multiframes and their detection progress.
+  std::vector<BufferEntry> frameBuffer_;
   /// Position of the newest multiframe in the buffer.
   int bufferPosition_;
 
@@ -147,6 +240,9 @@ private:
   /// ID of the last multiframe that returned true in detectionCompletedForAllCameras().
   uint64_t lastCompletedFrameId_;
 
+  /// Counters on dispatched, partial, dropped and late frames.
+  Statistics statistics_;
+
 };
 
 } /* namespace okvis */
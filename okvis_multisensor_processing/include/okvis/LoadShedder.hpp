@@ -0,0 +1,138 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file okvis/LoadShedder.hpp
+ * @brief Header file for the LoadShedder class.
+ */
+
+#ifndef INCLUDE_OKVIS_LOADSHEDDER_HPP_
+#define INCLUDE_OKVIS_LOADSHEDDER_HPP_
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <okvis/Parameters.hpp>
+#include <okvis/Time.hpp>
+#include <okvis/kinematics/Transformation.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/**
+ * @brief Decides which multiframes to skip before detection when the pipeline falls behind.
+ *
+ * The latency from receiving a frame to adding its state is tracked against the camera period.
+ * While it exceeds LoadSheddingParameters::maxLatency, multiframes that are not keyframe
+ * candidates are skipped, at most LoadSheddingParameters::maxConsecutiveSkips in a row.
+ * The IMU measurements of skipped frames end up in the preintegration towards the next state.
+ * This class is threadsafe.
+ */
+class LoadShedder
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  /// \brief Telemetry on the skip decisions and the latency.
+  struct Statistics
+  {
+    size_t numFrames = 0;  ///< Multiframes decided on.
+    size_t numSkipped = 0;  ///< Multiframes skipped.
+    size_t numKeyframeCandidatesKept = 0;  ///< Multiframes kept while overloaded since they were keyframe candidates.
+    double latency = 0.0;  ///< Smoothed latency from receiving a frame to adding its state. [s]
+    double maxLatency = 0.0;  ///< Largest latency measured. [s]
+  };
+
+  /**
+   * @brief Constructor.
+   * @param parameters Thresholds.
+   * @param cameraRate Camera rate. [Hz]
+   */
+  LoadShedder(const okvis::LoadSheddingParameters &parameters, double cameraRate);
+
+  /// \brief The settings.
+  const okvis::LoadSheddingParameters &parameters() const {
+    return parameters_;
+  }
+
+  /**
+   * @brief Record the reception of a frame.
+   * @param stamp Timestamp of the frame.
+   * @param now Current (wall clock) time.
+   */
+  void frameReceived(const okvis::Time &stamp, const okvis::Time &now);
+
+  /**
+   * @brief Record that the state of a multiframe was added, which updates the latency.
+   * @param stamp Timestamp of the multiframe.
+   * @param now Current (wall clock) time.
+   */
+  void stateAdded(const okvis::Time &stamp, const okvis::Time &now);
+
+  /// \brief Record the pose of a new keyframe.
+  void keyframeAdded(const okvis::kinematics::Transformation &T_WS);
+
+  /// \brief Has the motion since the last keyframe exceeded the keyframe candidate thresholds?
+  bool isKeyframeCandidate(const okvis::kinematics::Transformation &T_WS) const;
+
+  /**
+   * @brief Decide whether to skip a multiframe. The first call for a multiframe decides,
+   *        subsequent calls (i.e. from the other cameras) return the same decision.
+   * @param multiFrameId ID of the multiframe.
+   * @param keyframeCandidate Whether the multiframe is a keyframe candidate. Those are never skipped.
+   * @return True if the multiframe should be skipped.
+   */
+  bool skip(uint64_t multiFrameId, bool keyframeCandidate);
+
+  /// \brief Is the smoothed latency above LoadSheddingParameters::maxLatency?
+  bool overloaded() const;
+
+  /// \brief Get the telemetry.
+  Statistics statistics() const;
+
+private:
+  okvis::LoadSheddingParameters parameters_; ///< Thresholds.
+  double cameraPeriod_; ///< Inverse camera rate. [s]
+  mutable std::mutex mutex_; ///< Lock for everything below.
+  std::map<okvis::Time, okvis::Time> receptionTimes_; ///< Wall clock reception time per frame timestamp.
+  bool haveLatency_; ///< Whether the latency has been measured.
+  std::deque<std::pair<uint64_t, bool> > decisions_; ///< Recent decisions per multiframe ID.
+  size_t consecutiveSkips_; ///< Multiframes skipped in a row.
+  bool haveKeyframe_; ///< Whether T_WK_ is set.
+  okvis::kinematics::Transformation T_WK_; ///< Pose of the last keyframe.
+  Statistics statistics_; ///< Telemetry.
+};
+
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_LOADSHEDDER_HPP_ */
@@ -0,0 +1,218 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file okvis/SharedMemorySensorRing.hpp
+ * @brief Header file for the SensorRingProducer and SensorRingConsumer classes.
+ */
+
+#ifndef INCLUDE_OKVIS_SHAREDMEMORYSENSORRING_HPP_
+#define INCLUDE_OKVIS_SHAREDMEMORYSENSORRING_HPP_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <Eigen/Core>
+#include <opencv2/core/core.hpp>
+
+#include <okvis/assert_macros.hpp>
+#include <okvis/Time.hpp>
+#include <okvis/VioInterface.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/// \brief Dimensions of a shared memory sensor ring. Chosen by the producer.
+struct SensorRingParameters
+{
+  size_t numImageSlots = 8; ///< Number of image slots. A slot is blocked until the consumer released it.
+  size_t maxImageBytes = 1280 * 1024; ///< Capacity of one image slot. [bytes]
+  size_t imuCapacity = 4096; ///< Number of IMU readings buffered. Unread readings are overwritten when full.
+};
+
+class SharedMemorySegment;
+
+/**
+ * @brief Producer side of a shared memory sensor ring.
+ *
+ * Creates a named POSIX shared memory segment that holds a ring of IMU readings and a
+ * fixed number of image slots. Meant to be used by sensor drivers running in a separate
+ * process. Images can either be written directly into a slot (acquireImageSlot(), then
+ * publishImage()) or copied in with addImage(). A SensorRingConsumer in the estimator
+ * process hands the slots to the VioInterface without copying.
+ * The producer is not thread-safe: use one producer thread, or protect it externally.
+ */
+class SensorRingProducer
+{
+public:
+  OKVIS_DEFINE_EXCEPTION(Exception, std::runtime_error)
+
+  /// \brief A writable image slot.
+  struct ImageSlot
+  {
+    size_t index = 0; ///< Index of the slot in the ring.
+    cv::Mat image; ///< Image header pointing to the shared memory. Write the image here.
+  };
+
+  /**
+   * @brief Constructor. Creates the shared memory segment.
+   * @param name Name of the segment, e.g. "/okvis_sensors". Replaces an existing one.
+   * @param parameters Dimensions of the ring.
+   */
+  SensorRingProducer(const std::string &name,
+                     const okvis::SensorRingParameters &parameters =
+                         okvis::SensorRingParameters());
+
+  /// \brief Destructor. Signals shutdown to the consumer and removes the segment name.
+  ~SensorRingProducer();
+
+  /// \brief The dimensions of the ring.
+  const okvis::SensorRingParameters &parameters() const {
+    return parameters_;
+  }
+
+  /// \brief          Add an IMU measurement.
+  /// \param stamp    The measurement timestamp.
+  /// \param alpha    The acceleration measured at this time.
+  /// \param omega    The angular velocity measured at this time.
+  void addImuMeasurement(const okvis::Time &stamp, const Eigen::Vector3d &alpha,
+                         const Eigen::Vector3d &omega);
+
+  /**
+   * @brief Get a free image slot to write an image into.
+   * @param[in]  rows Image rows.
+   * @param[in]  cols Image columns.
+   * @param[in]  type OpenCV image type, e.g. CV_8UC1.
+   * @param[out] slot The slot. Must be passed to publishImage() afterwards.
+   * @param[in]  timeout Time to wait for the consumer to release a slot. [s]
+   * @return False if no slot became free within the timeout.
+   */
+  bool acquireImageSlot(int rows, int cols, int type, ImageSlot &slot,
+                        double timeout = 0.0);
+
+  /**
+   * @brief Make an image written to an acquired slot available to the consumer.
+   * @param slot The slot returned by acquireImageSlot().
+   * @param stamp The image timestamp.
+   * @param cameraIndex The index of the camera that the image originates from.
+   */
+  void publishImage(ImageSlot &slot, const okvis::Time &stamp, size_t cameraIndex);
+
+  /**
+   * @brief Copy an image into a free slot and publish it.
+   * @param stamp The image timestamp.
+   * @param cameraIndex The index of the camera that the image originates from.
+   * @param image The image.
+   * @param timeout Time to wait for the consumer to release a slot. [s]
+   * @return False if no slot became free within the timeout.
+   */
+  bool addImage(const okvis::Time &stamp, size_t cameraIndex,
+                const cv::Mat &image, double timeout = 0.0);
+
+  /// \brief Number of images that could not be published since no slot was free.
+  uint64_t numDroppedImages() const {
+    return numDroppedImages_;
+  }
+
+private:
+  okvis::SensorRingParameters parameters_; ///< Dimensions of the ring.
+  std::shared_ptr<SharedMemorySegment> segment_; ///< The mapped segment.
+  uint64_t numDroppedImages_ = 0; ///< Images not published for lack of a free slot.
+};
+
+/**
+ * @brief Consumer side of a shared memory sensor ring.
+ *
+ * Opens the segment created by a SensorRingProducer and feeds its content to a
+ * VioInterface (e.g. ThreadedKFVio) from an internal thread. IMU readings are delivered
+ * before images with the same or a later timestamp. Images are passed with VioInterface::addImageBuffer() pointing into
+ * the mapped memory, and the slot is handed back to the producer once released. The
+ * mapping is kept alive until all slots have been released, even after destruction.
+ */
+class SensorRingConsumer
+{
+public:
+  OKVIS_DEFINE_EXCEPTION(Exception, std::runtime_error)
+
+  /**
+   * @brief Constructor. Opens the segment and starts the consumer thread.
+   * @param name Name of the segment as passed to the SensorRingProducer.
+   * @param vio The estimator interface to feed. Must outlive the consumer.
+   */
+  SensorRingConsumer(const std::string &name, okvis::VioInterface &vio);
+
+  /// \brief Destructor. Stops the consumer thread.
+  ~SensorRingConsumer();
+
+  /// \brief Stop the consumer thread. Images in flight are still released.
+  void shutdown();
+
+  /// \brief True once the producer has been destroyed and everything has been consumed.
+  bool producerFinished() const {
+    return producerFinished_;
+  }
+
+  /// \brief Number of IMU readings overwritten by the producer before they were consumed.
+  uint64_t numDroppedImuMeasurements() const {
+    return numDroppedImuMeasurements_;
+  }
+
+  /// \brief Number of images that a blocking VioInterface did not accept.
+  uint64_t numRejectedImages() const {
+    return numRejectedImages_;
+  }
+
+  /// \brief Number of images that a non-blocking VioInterface could not queue without
+  ///        dropping frames.
+  uint64_t numDroppedImages() const {
+    return numDroppedImages_;
+  }
+
+private:
+  /// \brief Loop that waits for new data and feeds the VioInterface.
+  void consumerLoop();
+
+  okvis::VioInterface &vio_; ///< The estimator interface.
+  std::shared_ptr<SharedMemorySegment> segment_; ///< The mapped segment.
+  uint64_t imuReadCount_ = 0; ///< Number of IMU readings consumed (or dropped) so far.
+  std::atomic_bool shutdown_; ///< Tells the consumer thread to stop.
+  std::atomic_bool producerFinished_; ///< Producer gone and all data consumed.
+  std::atomic<uint64_t> numDroppedImuMeasurements_; ///< Overwritten IMU readings.
+  std::atomic<uint64_t> numRejectedImages_; ///< Images not accepted by a blocking VioInterface.
+  std::atomic<uint64_t> numDroppedImages_; ///< Images dropped by a non-blocking VioInterface.
+  std::thread consumerThread_; ///< The consumer thread.
+};
+
+}  // namespace okvis
+
+#endif /* INCLUDE_OKVIS_SHAREDMEMORYSENSORRING_HPP_ */
@@ -41,6 +41,7 @@
 #ifndef INCLUDE_OKVIS_THREADEDKFVIO_HPP_
 #define INCLUDE_OKVIS_THREADEDKFVIO_HPP_
 
+#include <memory>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
@@ -53,8 +54,10 @@
 #include <okvis/Parameters.hpp>
 #include <okvis/assert_macros.hpp>
 
+#include <okvis/CallbackDispatcher.hpp>
 #include <okvis/ImuFrameSynchronizer.hpp>
 #include <okvis/FrameSynchronizer.hpp>
+#include <okvis/LoadShedder.hpp>
 #include <okvis/VioVisualizer.hpp>
 #include <okvis/timing/Timer.hpp>
 #include <okvis/threadsafe/ThreadsafeQueue.hpp>
@@ -65,6 +68,7 @@
 #else
 
 #include <okvis/Estimator.hpp>
+#include <okvis/StructurelessEstimator.hpp>
 #include <okvis/VioFrontendInterface.hpp>
 
 #endif
@@ -138,6 +142,19 @@ public:
                         const std::vector<cv::KeyPoint> *keypoints = 0,
                         bool *asKeyframe = 0);
 
+  /**
+   * \brief                 Add a new image in a caller-owned buffer without copying it.
+   * \param stamp           The image timestamp.
+   * \param cameraIndex     The index of the camera that the image originates from.
+   * \param image           The image, pointing to the caller-owned buffer.
+   * \param releaseCallback Called from the frame consumer thread once detection is done,
+   *                        or whenever the image is dropped.
+   * \return                Returns true normally. False, if the previous one has not been processed yet.
+   */
+  virtual bool addImageBuffer(const okvis::Time &stamp, size_t cameraIndex,
+                              const cv::Mat &image,
+                              const ImageReleaseCallback &releaseCallback);
+
   /**
    * \brief             Add an abstracted image observation.
    * \warning Not implemented.
@@ -236,6 +253,33 @@ public:
    */
   virtual void setBlocking(bool blocking);
 
+  /// \}
+  /// \name Getters
+  /// \{
+
+  /// \brief Number of user callback invocations dropped so far due to the dispatch policies.
+  struct CallbackDropCounts
+  {
+    uint64_t state = 0;                   ///< StateCallback.
+    uint64_t fullState = 0;               ///< FullStateCallback.
+    uint64_t fullStateWithExtrinsics = 0; ///< FullStateCallbackWithExtrinsics.
+    uint64_t landmarks = 0;               ///< LandmarksCallback.
+    uint64_t stateCovariance = 0;         ///< StateCovarianceCallback.
+    uint64_t smoothedState = 0;           ///< SmoothedStateCallback.
+  };
+
+  /// \brief Number of user callback invocations dropped so far due to the dispatch policies,
+  ///        see PublishingParameters.
+  CallbackDropCounts callbackDropCounts() const;
+
+  /// \brief Counters on dispatched, partial (not all cameras detected), dropped and late
+  ///        multiframes. Only populated with asynchronous multiframes, see FrameSynchronizationParameters.
+  okvis::FrameSynchronizer::Statistics frameSynchronizationStatistics();
+
+  /// \brief Skip decisions and the latency from receiving a frame to adding its state,
+  ///        see LoadSheddingParameters.
+  okvis::LoadShedder::Statistics loadSheddingStatistics() const;
+
   /// \}
 
   /// \brief Trigger display (needed because OSX won't allow threaded display).
@@ -251,8 +295,32 @@ private:
 
   /// \brief Loop to process frames from camera with index cameraIndex
   void frameConsumerLoop(size_t cameraIndex);
+  /**
+   * \brief Hand the keypoints detected for camera cameraIndex to the multiframe (asynchronous multiframes).
+   * @param cameraIndex The camera index.
+   * @param multiFrame The multiframe returned by the frame synchronizer.
+   * @param detectionFrame The multiframe the detection was run on.
+   * @return False if termination was requested.
+   */
+  bool mergeDetection(size_t cameraIndex,
+                      const std::shared_ptr<okvis::MultiFrame> &multiFrame,
+                      const std::shared_ptr<okvis::MultiFrame> &detectionFrame);
+  /**
+   * \brief Push the multiframes that are ready to the matching (asynchronous multiframes).
+   * @param frameSynchronizerLock Lock on frameSynchronizer_mutex_. Released before pushing.
+   * @return False if termination was requested.
+   */
+  bool dispatchMultiFrames(std::unique_lock<std::mutex> &frameSynchronizerLock);
   /// \brief Loop that matches frames with existing frames.
   void matchingLoop();
+  /**
+   * \brief Publish the state refined right after matching, see Estimator::refineState().
+   *        Lock estimator_mutex_ before calling.
+   * @param frame The multiframe of the state.
+   * @param imuData The IMU measurements used to add the state.
+   */
+  void publishRefinedState(const std::shared_ptr<okvis::MultiFrame> &frame,
+                           const okvis::ImuMeasurementDeque &imuData);
   /// \brief Loop to process IMU measurements.
   void imuConsumerLoop();
   /// \brief Loop to process position measurements.
@@ -272,7 +340,7 @@ private:
   void visualizationLoop();
   /// \brief Loop that performs the optimization and marginalisation.
   void optimizationLoop();
-  /// \brief Loop that publishes the newest state and landmarks.
+  /// \brief Loop that publishes the newest state and landmarks as well as marginalized states.
   void publisherLoop();
 
   /**
@@ -285,6 +353,29 @@ private:
   okvis::ImuMeasurementDeque getImuMeasurments(okvis::Time &start,
                                                okvis::Time &end);
 
+  /**
+   * @brief Add a camera measurement to the input queue of its frame consumer thread.
+   * @param stamp The image timestamp.
+   * @param cameraIndex The index of the camera that the image originates from.
+   * @param image The image.
+   * @param imageLease Keeps a caller-owned image buffer borrowed, or empty.
+   * @param keypoints Optionally already pass keypoints.
+   * @return True normally. False, if the previous one has not been processed yet.
+   */
+  bool addCameraMeasurement(const okvis::Time &stamp, size_t cameraIndex,
+                            const cv::Mat &image,
+                            const std::shared_ptr<void> &imageLease,
+                            const std::vector<cv::KeyPoint> *keypoints);
+
+  /**
+   * @brief Stop accessing a caller-owned image buffer after detection.
+   *        The multiframe keeps a copy only if images are visualized.
+   * @param frame The camera measurement. It is reset.
+   * @param multiFrame The multiframe the image has been added to.
+   */
+  void releaseImageBuffer(std::shared_ptr<okvis::CameraMeasurement> &frame,
+                          const std::shared_ptr<okvis::MultiFrame> &multiFrame);
+
   /**
    * @brief Remove IMU measurements from the internal buffer.
    * @param eraseUntil Remove all measurements that are strictly older than this time.
@@ -310,6 +401,10 @@ private:
     okvis::MapPointVector landmarksVector;      ///< Vector containing the current landmarks.
     okvis::MapPointVector transferredLandmarks; ///< Vector of the landmarks that have been marginalized out.
     bool onlyPublishLandmarks;                  ///< Boolean to signalise the publisherLoop() that only the landmarks should be published
+    bool covarianceAvailable = false;           ///< Whether covariance (of the optimized frame) has been computed.
+    uint64_t frameId = 0;                       ///< ID of the optimized frame. Set together with covariance.
+    okvis::Time frameStamp;                     ///< Timestamp of the optimized frame. Set together with covariance.
+    Eigen::Matrix<double, 15, 15> covariance;   ///< Marginal covariance of pose and speeds/biases of the optimized frame.
   };
 
   /// @name State variables
@@ -375,6 +470,9 @@ private:
   okvis::PositionMeasurementDeque positionMeasurements_;
   /// The queue containing the results of the optimization or IMU propagation ready for publishing.
   okvis::threadsafe::ThreadSafeQueue<OptimizationResults> optimizationResults_;
+  /// \brief The final estimates of marginalized frames ready for publishing.
+  /// \note Separate from optimizationResults_, since IMU propagated states may drop entries there.
+  okvis::threadsafe::ThreadSafeQueue<okvis::FrameState> smoothedStates_;
   /// The queue containing visualization data that is ready to be displayed.
   okvis::threadsafe::ThreadSafeQueue<VioVisualizer::VisualizationData::Ptr> visualizationData_;
   /// The queue containing the actual display images
@@ -387,6 +485,7 @@ private:
   std::mutex imuMeasurements_mutex_;      ///< Lock when accessing imuMeasurements_
   std::mutex positionMeasurements_mutex_;      ///< Lock when accessing imuMeasurements_
   std::mutex frameSynchronizer_mutex_;    ///< Lock when accessing the frameSynchronizer_.
+  std::mutex multiFrameDispatch_mutex_;   ///< Keeps the order when pushing asynchronous multiframes to the matching.
   std::mutex estimator_mutex_;            ///< Lock when accessing the estimator_.
   ///< Condition variable to signalise that optimization is done.
   std::condition_variable optimizationNotification_;
@@ -416,6 +515,17 @@ private:
   std::thread optimizationThread_;  ///< Thread running optimizationLoop().
   std::thread publisherThread_;     ///< Thread running publisherLoop().
 
+  /// @}
+  /// @name Callback dispatchers. Invoke the user callbacks for publisherLoop().
+  /// @{
+
+  std::unique_ptr<CallbackDispatcher> stateCallbackDispatcher_;                   ///< For stateCallback_.
+  std::unique_ptr<CallbackDispatcher> fullStateCallbackDispatcher_;               ///< For fullStateCallback_.
+  std::unique_ptr<CallbackDispatcher> fullStateWithExtrinsicsCallbackDispatcher_; ///< For fullStateCallbackWithExtrinsics_.
+  std::unique_ptr<CallbackDispatcher> landmarksCallbackDispatcher_;               ///< For landmarksCallback_.
+  std::unique_ptr<CallbackDispatcher> stateCovarianceCallbackDispatcher_;         ///< For stateCovarianceCallback_.
+  std::unique_ptr<CallbackDispatcher> smoothedStateCallbackDispatcher_;           ///< For smoothedStateCallback_.
+
   /// @}
   /// @name Algorithm objects.
   /// @{
@@ -424,9 +534,11 @@ private:
   okvis::MockVioBackendInterface& estimator_;
   okvis::MockVioFrontendInterface& frontend_;
 #else
-  okvis::Estimator estimator_;    ///< The backend estimator.
+  std::unique_ptr<okvis::Estimator> estimatorPtr_; ///< Owns the backend estimator.
+  okvis::Estimator &estimator_;   ///< The backend estimator, see Optimization::structurelessBackend.
   okvis::Frontend frontend_;      ///< The frontend.
 #endif
+  std::unique_ptr<okvis::LoadShedder> loadShedder_; ///< Skips frames when the pipeline falls behind.
 
   /// @}
 
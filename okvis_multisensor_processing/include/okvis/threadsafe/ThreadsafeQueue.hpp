@@ -112,6 +112,11 @@ public:
     NotifyAll();
   }
 
+  /// \brief Return true if a shutdown was requested.
+  bool IsShutdown() const {
+    return shutdown_;
+  }
+
   /// \brief Tell the queue to resume after a shutdown request.
   virtual void Resume() final {
     shutdown_ = false;
@@ -257,8 +262,9 @@ public:
       struct timeval tv;
       struct timespec ts;
       gettimeofday(&tv, NULL);
-      ts.tv_sec = tv.tv_sec;
-      ts.tv_nsec = tv.tv_usec * 1e3 + timeout_nanoseconds;
+      const int64_t nsec = int64_t(tv.tv_usec) * 1000 + timeout_nanoseconds;
+      ts.tv_sec = tv.tv_sec + nsec / 1000000000;
+      ts.tv_nsec = nsec % 1000000000;
       pthread_cond_timedwait(&condition_empty_, &mutex_, &ts);
     }
     if (queue_.empty()) {
@@ -0,0 +1,109 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file CallbackDispatcher.cpp
+ * @brief Source file for the CallbackDispatcher class.
+ */
+
+#include <glog/logging.h>
+
+#include <okvis/CallbackDispatcher.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+// Constructor. Starts the executor thread unless the policy is Synchronous.
+CallbackDispatcher::CallbackDispatcher(
+    const okvis::CallbackDispatchParameters &parameters)
+    : parameters_(parameters),
+      shutdown_(false),
+      numDropped_(0) {
+  if (parameters_.policy == CallbackDispatchPolicy::LatestOnly) {
+    parameters_.queueSize = 1;
+  }
+  CHECK_GT(parameters_.queueSize, 0u) << "callback queue size must be positive";
+  if (parameters_.policy != CallbackDispatchPolicy::Synchronous) {
+    executorThread_ = std::thread(&CallbackDispatcher::executorLoop, this);
+  }
+}
+
+// Destructor.
+CallbackDispatcher::~CallbackDispatcher() {
+  shutdown();
+}
+
+// Dispatch a callback invocation according to the policy.
+void CallbackDispatcher::dispatch(const Job &job) {
+  if (shutdown_) {
+    ++numDropped_;
+    return;
+  }
+  switch (parameters_.policy) {
+    case CallbackDispatchPolicy::Synchronous:
+      job();
+      break;
+    case CallbackDispatchPolicy::LatestOnly:
+    case CallbackDispatchPolicy::Bounded:
+      if (jobs_.PushNonBlockingDroppingIfFull(job, parameters_.queueSize)) {
+        ++numDropped_;
+      }
+      break;
+    case CallbackDispatchPolicy::Blocking:
+      if (!jobs_.PushBlockingIfFull(job, parameters_.queueSize)) {
+        ++numDropped_;
+      }
+      break;
+  }
+}
+
+// Run all pending jobs and stop the executor thread.
+void CallbackDispatcher::shutdown() {
+  shutdown_ = true;
+  jobs_.Shutdown();
+  if (executorThread_.joinable()) {
+    executorThread_.join();
+  }
+}
+
+// Loop running the jobs.
+void CallbackDispatcher::executorLoop() {
+  Job job;
+  while (jobs_.PopBlocking(&job)) {
+    job();
+  }
+  // shut down: run what is left
+  while (jobs_.PopNonBlocking(&job)) {
+    job();
+  }
+}
+
+}  // namespace okvis
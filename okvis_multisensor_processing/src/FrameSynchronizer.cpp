@@ -40,6 +40,8 @@
  * @author Andreas Forster
  */
 
+#include <algorithm>
+
 #include <glog/logging.h>
 
 #include <okvis/FrameSynchronizer.hpp>
@@ -59,8 +61,7 @@ FrameSynchronizer::FrameSynchronizer(okvis::VioParameters &parameters)
   if (parameters.nCameraSystem.numCameras() > 0) {
     init(parameters);
   }
-  frameBuffer_.resize(max_frame_sync_buffer_size,
-                      std::pair<std::shared_ptr<okvis::MultiFrame>, size_t>(nullptr, 0));
+  frameBuffer_.resize(max_frame_sync_buffer_size);
   bufferPosition_ = 0;
 }
 
@@ -83,7 +84,23 @@ std::shared_ptr<okvis::MultiFrame> FrameSynchronizer::addNewFrame(std::shared_pt
   std::shared_ptr<okvis::MultiFrame> multiFrame;
   int position;
   if (findFrameByTime(frame_stamp, position)) {
-    multiFrame = frameBuffer_[position].first;
+    multiFrame = frameBuffer_[position].multiFrame;
+    if (frameBuffer_[position].state == EntryState::Skipped) {
+      // the other cameras of a skipped multiframe are skipped as well
+      if (isAsynchronous()) {
+        return nullptr;
+      }
+      return multiFrame;
+    }
+    if (isAsynchronous() && frameBuffer_[position].state != EntryState::Pending) {
+      // late frame: the multiframe has been dispatched or dropped already
+      if (frameBuffer_[position].state == EntryState::Dispatched
+          && parameters_.frameSynchronization.lateFrames == LateFramePolicy::Append) {
+        return multiFrame;
+      }
+      ++statistics_.numLateDiscarded;
+      return nullptr;
+    }
     OKVIS_ASSERT_TRUE_DBG(Exception, multiFrame->image(frame->sensorId).empty(),
                           "Frame for this camera has already been added to multiframe!");
     if (frame_stamp != multiFrame->timestamp()) {
@@ -91,19 +108,38 @@ std::shared_ptr<okvis::MultiFrame> FrameSynchronizer::addNewFrame(std::shared_pt
       frame_stamp += (multiFrame->timestamp() - frame_stamp) * 0.5;
       multiFrame->setTimestamp(frame_stamp);
     }
-    multiFrame->setImage(frame->sensorId, frame->measurement.image);
+    if (!isAsynchronous()) {
+      multiFrame->setImage(frame->sensorId, frame->measurement.image);
+    }
+  }
+  else if (isAsynchronous() && lastCompletedFrameId_ != 0
+           && frame_stamp <= lastCompletedFrameTimestamp_) {
+    // too old: newer multiframes have been dispatched already
+    ++statistics_.numLateDiscarded;
+    return nullptr;
   }
   else {
     multiFrame = std::shared_ptr<okvis::MultiFrame>(new okvis::MultiFrame(parameters_.nCameraSystem, frame_stamp,
                                                                           okvis::IdProvider::instance().newId()));
-    multiFrame->setImage(frame->sensorId, frame->measurement.image);
+    if (!isAsynchronous()) {
+      multiFrame->setImage(frame->sensorId, frame->measurement.image);
+    }
     bufferPosition_ = (bufferPosition_ + 1) % max_frame_sync_buffer_size;
-    if (frameBuffer_[bufferPosition_].first != nullptr
-        && frameBuffer_[bufferPosition_].second != numCameras_) {
-      LOG(ERROR) << "Dropping frame with id " << frameBuffer_[bufferPosition_].first->id();
+    BufferEntry &entry = frameBuffer_[bufferPosition_];
+    if (isAsynchronous()) {
+      if (entry.multiFrame != nullptr && entry.state == EntryState::Pending) {
+        LOG(ERROR) << "Dropping frame with id " << entry.multiFrame->id();
+        ++statistics_.numDropped;
+      }
+    } else if (entry.multiFrame != nullptr && entry.numDetected != numCameras_
+               && entry.state != EntryState::Skipped) {
+      LOG(ERROR) << "Dropping frame with id " << entry.multiFrame->id();
     }
-    frameBuffer_[bufferPosition_].first = multiFrame;
-    frameBuffer_[bufferPosition_].second = 0;
+    entry.multiFrame = multiFrame;
+    entry.numDetected = 0;
+    entry.detected.assign(numCameras_, false);
+    entry.firstDetection = okvis::Time();
+    entry.state = EntryState::Pending;
   }
   return multiFrame;
 }
@@ -113,8 +149,8 @@ bool FrameSynchronizer::detectionEndedForMultiFrame(uint64_t multiFrameId) {
   int position;
   bool found = findFrameById(multiFrameId, position);
   if (found) {
-    ++frameBuffer_[position].second;
-    OKVIS_ASSERT_TRUE_DBG(Exception, frameBuffer_[position].second <= numCameras_,
+    ++frameBuffer_[position].numDetected;
+    OKVIS_ASSERT_TRUE_DBG(Exception, frameBuffer_[position].numDetected <= numCameras_,
                           "Completion counter is larger than the amount of cameras in the system!");
   }
   return found;
@@ -125,15 +161,15 @@ bool FrameSynchronizer::detectionEndedForMultiFrame(uint64_t multiFrameId) {
 bool FrameSynchronizer::detectionCompletedForAllCameras(uint64_t multiFrameId) {
   int position;
   if (findFrameById(multiFrameId, position)) {
-    if (frameBuffer_[position].second == numCameras_) {
-      OKVIS_ASSERT_TRUE(Exception, frameBuffer_[position].first->timestamp() > lastCompletedFrameTimestamp_
-                                   && (lastCompletedFrameId_ == 0 || frameBuffer_[position].first->id() > lastCompletedFrameId_),
+    if (frameBuffer_[position].numDetected == numCameras_) {
+      OKVIS_ASSERT_TRUE(Exception, frameBuffer_[position].multiFrame->timestamp() > lastCompletedFrameTimestamp_
+                                   && (lastCompletedFrameId_ == 0 || frameBuffer_[position].multiFrame->id() > lastCompletedFrameId_),
                         "wrong order!\ntimestamp last: " << lastCompletedFrameTimestamp_
-                                                         << "\ntimestamp new:  " << frameBuffer_[position].first->timestamp()
+                                                         << "\ntimestamp new:  " << frameBuffer_[position].multiFrame->timestamp()
                                                          << "\nid last: " << lastCompletedFrameId_
-                                                         << "\nid new:  " << frameBuffer_[position].first->id());
-      lastCompletedFrameId_ = frameBuffer_[position].first->id();
-      lastCompletedFrameTimestamp_ = frameBuffer_[position].first->timestamp();
+                                                         << "\nid new:  " << frameBuffer_[position].multiFrame->id());
+      lastCompletedFrameId_ = frameBuffer_[position].multiFrame->id();
+      lastCompletedFrameTimestamp_ = frameBuffer_[position].multiFrame->timestamp();
       return true;
     }
     else
@@ -143,15 +179,121 @@ bool FrameSynchronizer::detectionCompletedForAllCameras(uint64_t multiFrameId) {
     return false;
 }
 
+// Inform the synchronizer that camera cameraIndex completed keypoint detection and description
+// for a multiframe (asynchronous mode).
+FrameSynchronizer::DetectionResult FrameSynchronizer::detectionEndedForFrame(
+    uint64_t multiFrameId, size_t cameraIndex, const okvis::Time &now) {
+  int position;
+  if (!findFrameById(multiFrameId, position)) {
+    // fell out of the buffer
+    ++statistics_.numLateDiscarded;
+    return DetectionResult::Discard;
+  }
+  BufferEntry &entry = frameBuffer_[position];
+  if (entry.state == EntryState::Pending) {
+    OKVIS_ASSERT_TRUE_DBG(Exception, !entry.detected.at(cameraIndex),
+                          "Detection for this camera has already ended!");
+    if (entry.numDetected == 0) {
+      entry.firstDetection = now;
+    }
+    entry.detected.at(cameraIndex) = true;
+    ++entry.numDetected;
+    return DetectionResult::Merge;
+  }
+  if (entry.state == EntryState::Dispatched
+      && parameters_.frameSynchronization.lateFrames == LateFramePolicy::Append) {
+    ++statistics_.numLateAppended;
+    return DetectionResult::Append;
+  }
+  ++statistics_.numLateDiscarded;
+  return DetectionResult::Discard;
+}
+
+// Mark a multiframe as deliberately skipped.
+void FrameSynchronizer::skipMultiFrame(uint64_t multiFrameId) {
+  int position;
+  if (findFrameById(multiFrameId, position)
+      && frameBuffer_[position].state == EntryState::Pending) {
+    frameBuffer_[position].state = EntryState::Skipped;
+  }
+}
+
+// Get the multiframes that are ready for matching in temporal order (asynchronous mode).
+bool FrameSynchronizer::popDispatchableMultiFrames(
+    const okvis::Time &now, std::vector<std::shared_ptr<okvis::MultiFrame> > &multiFrames) {
+  multiFrames.clear();
+  std::vector<BufferEntry*> pending;
+  for (size_t i = 0; i < frameBuffer_.size(); ++i) {
+    if (frameBuffer_[i].multiFrame != nullptr && frameBuffer_[i].state == EntryState::Pending) {
+      pending.push_back(&frameBuffer_[i]);
+    }
+  }
+  std::sort(pending.begin(), pending.end(), [](const BufferEntry* a, const BufferEntry* b) {
+    return a->multiFrame->timestamp() < b->multiFrame->timestamp();
+  });
+
+  // everything up to the newest ready multiframe leaves the buffer, to keep the temporal order
+  int newestReady = -1;
+  for (size_t i = 0; i < pending.size(); ++i) {
+    if (isReady(*pending[i], now)) {
+      newestReady = static_cast<int>(i);
+    }
+  }
+  for (int i = 0; i <= newestReady; ++i) {
+    BufferEntry &entry = *pending[i];
+    if (entry.numDetected == 0 || !hasRequiredCameras(entry)
+        || (lastCompletedFrameId_ != 0
+            && entry.multiFrame->timestamp() <= lastCompletedFrameTimestamp_)) {
+      LOG(WARNING) << "Dropping frame with id " << entry.multiFrame->id() << ": "
+                   << entry.numDetected << " of " << numCameras_ << " cameras detected";
+      entry.state = EntryState::Dropped;
+      ++statistics_.numDropped;
+      continue;
+    }
+    entry.state = EntryState::Dispatched;
+    ++statistics_.numDispatched;
+    if (entry.numDetected < numCameras_) {
+      ++statistics_.numPartial;
+    }
+    lastCompletedFrameId_ = entry.multiFrame->id();
+    lastCompletedFrameTimestamp_ = entry.multiFrame->timestamp();
+    multiFrames.push_back(entry.multiFrame);
+  }
+  return !multiFrames.empty();
+}
+
+// Ready for dispatch?
+bool FrameSynchronizer::isReady(const BufferEntry &entry, const okvis::Time &now) const {
+  if (entry.state != EntryState::Pending || entry.numDetected == 0) {
+    return false;
+  }
+  if (entry.numDetected == numCameras_
+      || (now - entry.firstDetection).toSec() >= parameters_.frameSynchronization.deadline) {
+    return true;
+  }
+  return entry.numDetected >= parameters_.frameSynchronization.minCameras
+      && hasRequiredCameras(entry);
+}
+
+// Have all required cameras completed detection?
+bool FrameSynchronizer::hasRequiredCameras(const BufferEntry &entry) const {
+  for (size_t cameraIndex : parameters_.frameSynchronization.requiredCameras) {
+    if (cameraIndex < entry.detected.size() && !entry.detected[cameraIndex]) {
+      return false;
+    }
+  }
+  return true;
+}
+
 // Find a multiframe in the buffer that has a timestamp within the tolerances of the given one. The tolerance
 // is given as a parameter in okvis::VioParameters::sensors_information::frameTimestampTolerance
 bool FrameSynchronizer::findFrameByTime(const okvis::Time &timestamp, int &position) const {
   bool found = false;
   for (int i = 0; i < max_frame_sync_buffer_size; ++i) {
     position = (bufferPosition_ + i) % max_frame_sync_buffer_size;
-    if (frameBuffer_[position].first != nullptr &&
-        (frameBuffer_[position].first->timestamp() == timestamp ||
-         fabs((frameBuffer_[position].first->timestamp() - timestamp).toSec()) < timeTol_)) {
+    if (frameBuffer_[position].multiFrame != nullptr &&
+        (frameBuffer_[position].multiFrame->timestamp() == timestamp ||
+         fabs((frameBuffer_[position].multiFrame->timestamp() - timestamp).toSec()) < timeTol_)) {
       found = true;
       break;
     }
@@ -164,8 +306,8 @@ bool FrameSynchronizer::findFrameById(uint64_t mfId, int &position) const {
   bool found = false;
   for (int i = 0; i < max_frame_sync_buffer_size; ++i) {
     position = (bufferPosition_ + i) % max_frame_sync_buffer_size;
-    if (frameBuffer_[position].first != nullptr &&
-        frameBuffer_[position].first->id() == mfId) {
+    if (frameBuffer_[position].multiFrame != nullptr &&
+        frameBuffer_[position].multiFrame->id() == mfId) {
       found = true;
       break;
     }
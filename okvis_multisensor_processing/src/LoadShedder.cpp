@@ -0,0 +1,161 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file LoadShedder.cpp
+ * @brief Source file for the LoadShedder class.
+ */
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include <okvis/LoadShedder.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+static const double latency_smoothing = 0.3;  // weight of a new latency measurement
+static const size_t max_reception_times = 100;  // bound in case states stop being added
+static const size_t max_decisions = 16;  // more than the multiframes in flight
+
+// Constructor.
+LoadShedder::LoadShedder(const okvis::LoadSheddingParameters &parameters,
+                         double cameraRate)
+    : parameters_(parameters),
+      cameraPeriod_(cameraRate > 0.0 ? 1.0 / cameraRate : 0.0),
+      haveLatency_(false),
+      consecutiveSkips_(0),
+      haveKeyframe_(false) {
+  if (parameters_.enabled && cameraPeriod_ == 0.0) {
+    LOG(WARNING) << "Load shedding requires a camera rate, disabling it.";
+    parameters_.enabled = false;
+  }
+}
+
+// Record the reception of a frame.
+void LoadShedder::frameReceived(const okvis::Time &stamp, const okvis::Time &now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // with multiple cameras the first reception counts
+  receptionTimes_.insert(std::make_pair(stamp, now));
+  while (receptionTimes_.size() > max_reception_times) {
+    receptionTimes_.erase(receptionTimes_.begin());
+  }
+}
+
+// Record that the state of a multiframe was added, which updates the latency.
+void LoadShedder::stateAdded(const okvis::Time &stamp, const okvis::Time &now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // the multiframe timestamp may be in between the frame timestamps
+  const okvis::Duration tolerance(0.5 * cameraPeriod_);
+  const okvis::Time begin = stamp.toSec() > tolerance.toSec() ? stamp - tolerance : okvis::Time();
+  std::map<okvis::Time, okvis::Time>::iterator it = receptionTimes_.lower_bound(begin);
+  const std::map<okvis::Time, okvis::Time>::iterator end = receptionTimes_.upper_bound(stamp + tolerance);
+  if (it == end) {
+    return;
+  }
+  okvis::Time received = it->second;
+  for (; it != end; ++it) {
+    received = std::min(received, it->second);
+  }
+  // older frames were skipped or dropped
+  receptionTimes_.erase(receptionTimes_.begin(), end);
+
+  const double latency = (now - received).toSec();
+  statistics_.latency = haveLatency_ ?
+      (1.0 - latency_smoothing) * statistics_.latency + latency_smoothing * latency : latency;
+  haveLatency_ = true;
+  statistics_.maxLatency = std::max(statistics_.maxLatency, latency);
+}
+
+// Record the pose of a new keyframe.
+void LoadShedder::keyframeAdded(const okvis::kinematics::Transformation &T_WS) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  T_WK_ = T_WS;
+  haveKeyframe_ = true;
+}
+
+// Has the motion since the last keyframe exceeded the keyframe candidate thresholds?
+bool LoadShedder::isKeyframeCandidate(const okvis::kinematics::Transformation &T_WS) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!haveKeyframe_) {
+    return true;
+  }
+  const okvis::kinematics::Transformation T_KS = T_WK_.inverse() * T_WS;
+  return T_KS.r().norm() > parameters_.keyframeTranslation
+      || Eigen::AngleAxisd(T_KS.q()).angle() > parameters_.keyframeRotation;
+}
+
+// Decide whether to skip a multiframe.
+bool LoadShedder::skip(uint64_t multiFrameId, bool keyframeCandidate) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < decisions_.size(); ++i) {
+    if (decisions_[i].first == multiFrameId) {
+      return decisions_[i].second;
+    }
+  }
+
+  ++statistics_.numFrames;
+  bool skip = false;
+  if (parameters_.enabled && statistics_.latency > parameters_.maxLatency * cameraPeriod_) {
+    if (keyframeCandidate) {
+      ++statistics_.numKeyframeCandidatesKept;
+    } else if (consecutiveSkips_ < parameters_.maxConsecutiveSkips) {
+      skip = true;
+    }
+  }
+  if (skip) {
+    ++consecutiveSkips_;
+    ++statistics_.numSkipped;
+  } else {
+    consecutiveSkips_ = 0;
+  }
+
+  decisions_.push_back(std::make_pair(multiFrameId, skip));
+  if (decisions_.size() > max_decisions) {
+    decisions_.pop_front();
+  }
+  return skip;
+}
+
+// Is the smoothed latency above LoadSheddingParameters::maxLatency?
+bool LoadShedder::overloaded() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_.latency > parameters_.maxLatency * cameraPeriod_;
+}
+
+// Get the telemetry.
+LoadShedder::Statistics LoadShedder::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return statistics_;
+}
+
+}  // namespace okvis
@@ -0,0 +1,574 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file SharedMemorySensorRing.cpp
+ * @brief Source file for the SensorRingProducer and SensorRingConsumer classes.
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <okvis/SharedMemorySensorRing.hpp>
+
+/// \brief okvis Main namespace of this package.
+namespace okvis {
+
+/**
+ * @brief A mapped shared memory segment holding the sensor ring.
+ *
+ * Layout: RingHeader | ImageSlotHeader[numImageSlots] | ImuRecord[imuCapacity] |
+ * image data[numImageSlots]. All sections start cache-line aligned. All fields are
+ * protected by the process-shared mutex in the header, except for the image data,
+ * which is owned by whoever put the slot into the Writing or InUse state.
+ */
+class SharedMemorySegment
+{
+public:
+  /// \brief The state of an image slot.
+  enum SlotState : uint32_t
+  {
+    Free = 0, ///< Can be acquired by the producer.
+    Writing = 1, ///< Acquired by the producer, being written.
+    Ready = 2, ///< Published, waiting for the consumer.
+    InUse = 3 ///< Handed to the VioInterface, waiting to be released.
+  };
+
+  /// \brief The segment header.
+  struct RingHeader
+  {
+    uint32_t magic; ///< Set to ringMagic once initialised.
+    uint32_t version; ///< Layout version.
+    uint64_t numImageSlots; ///< Number of image slots.
+    uint64_t maxImageBytes; ///< Capacity of one image slot.
+    uint64_t imuCapacity; ///< Number of IMU records.
+    pthread_mutex_t mutex; ///< Process-shared mutex protecting the ring.
+    pthread_cond_t dataAvailable; ///< Signalled on new data and on producer shutdown.
+    pthread_cond_t slotReleased; ///< Signalled when the consumer released an image slot.
+    uint64_t imuWriteCount; ///< Total number of IMU records written.
+    uint64_t imageSequence; ///< Total number of images published.
+    uint32_t producerFinished; ///< Set when the producer is destroyed.
+  };
+
+  /// \brief The header of an image slot.
+  struct ImageSlotHeader
+  {
+    uint32_t state; ///< SlotState.
+    uint32_t cameraIndex; ///< Camera index.
+    uint64_t sequence; ///< Publishing order.
+    uint32_t sec; ///< Timestamp seconds.
+    uint32_t nsec; ///< Timestamp nanoseconds.
+    int32_t rows; ///< Image rows.
+    int32_t cols; ///< Image columns.
+    int32_t type; ///< OpenCV image type.
+    uint64_t step; ///< Bytes per image row.
+  };
+
+  /// \brief An IMU reading.
+  struct ImuRecord
+  {
+    uint32_t sec; ///< Timestamp seconds.
+    uint32_t nsec; ///< Timestamp nanoseconds.
+    double alpha[3]; ///< Acceleration.
+    double omega[3]; ///< Angular velocity.
+  };
+
+  static const uint32_t ringMagic = 0x4f4b5652;  ///< "OKVR".
+  static const uint32_t ringVersion = 1; ///< Increment on layout changes.
+
+  /**
+   * @brief Create (parameters given) or open (parameters NULL) the named segment.
+   * @param name The segment name.
+   * @param parameters Dimensions of the ring to be created, or NULL to open an existing one.
+   */
+  SharedMemorySegment(const std::string &name,
+                      const okvis::SensorRingParameters *parameters);
+
+  /// \brief Unmap. Also removes the name if this segment was created here.
+  ~SharedMemorySegment();
+
+  /// \brief The header.
+  RingHeader &header() const {
+    return *reinterpret_cast<RingHeader*>(data_);
+  }
+  /// \brief Header of image slot i.
+  ImageSlotHeader &slot(size_t i) const {
+    return reinterpret_cast<ImageSlotHeader*>(data_ + slotsOffset_)[i];
+  }
+  /// \brief IMU record i (i < imuCapacity).
+  ImuRecord &imu(size_t i) const {
+    return reinterpret_cast<ImuRecord*>(data_ + imuOffset_)[i];
+  }
+  /// \brief Pixel data of image slot i.
+  unsigned char *imageData(size_t i) const {
+    return data_ + imagesOffset_ + i * imageStride_;
+  }
+
+  /// \brief Lock the shared mutex. Recovers it if its owner died.
+  void lock();
+  /// \brief Unlock the shared mutex.
+  void unlock();
+  /// \brief Wait on cond with the mutex locked.
+  /// \return False if the deadline passed.
+  bool waitUntil(pthread_cond_t &cond, const timespec &deadline);
+  /// \brief Hand image slot i back to the producer.
+  void releaseSlot(size_t i);
+
+  /// \brief Absolute deadline timeout seconds from now.
+  static timespec deadline(double timeout);
+
+private:
+  /// \brief Compute the section offsets from the header dimensions.
+  void computeLayout(const okvis::SensorRingParameters &parameters);
+
+  std::string name_; ///< The segment name.
+  bool owner_ = false; ///< True if created here.
+  unsigned char *data_ = nullptr; ///< Start of the mapping.
+  size_t size_ = 0; ///< Size of the mapping.
+  size_t slotsOffset_ = 0; ///< Offset of the slot headers.
+  size_t imuOffset_ = 0; ///< Offset of the IMU records.
+  size_t imagesOffset_ = 0; ///< Offset of the image data.
+  size_t imageStride_ = 0; ///< Distance between the image data of consecutive slots.
+};
+
+namespace {
+// Round up to full cache lines.
+size_t alignToCacheLine(size_t bytes) {
+  return (bytes + 63) & ~size_t(63);
+}
+// Segment names must start with a single slash.
+std::string segmentName(const std::string &name) {
+  return (!name.empty() && name[0] == '/') ? name : "/" + name;
+}
+}
+
+void SharedMemorySegment::computeLayout(
+    const okvis::SensorRingParameters &parameters) {
+  slotsOffset_ = alignToCacheLine(sizeof(RingHeader));
+  imuOffset_ = slotsOffset_
+      + alignToCacheLine(parameters.numImageSlots * sizeof(ImageSlotHeader));
+  imagesOffset_ = imuOffset_
+      + alignToCacheLine(parameters.imuCapacity * sizeof(ImuRecord));
+  imageStride_ = alignToCacheLine(parameters.maxImageBytes);
+  size_ = imagesOffset_ + parameters.numImageSlots * imageStride_;
+}
+
+SharedMemorySegment::SharedMemorySegment(
+    const std::string &name, const okvis::SensorRingParameters *parameters)
+    : name_(segmentName(name)),
+      owner_(parameters != NULL) {
+  if (owner_) {
+    OKVIS_ASSERT_TRUE(SensorRingProducer::Exception,
+                      parameters->numImageSlots > 0 && parameters->imuCapacity > 0,
+                      "the sensor ring needs image slots and IMU capacity");
+    computeLayout(*parameters);
+    shm_unlink(name_.c_str());  // replace stale segments
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    OKVIS_ASSERT_TRUE(SensorRingProducer::Exception, fd >= 0,
+                      "cannot create shared memory " << name_ << ": " << strerror(errno));
+    if (ftruncate(fd, size_) != 0) {
+      int error = errno;
+      close(fd);
+      shm_unlink(name_.c_str());
+      OKVIS_THROW(SensorRingProducer::Exception,
+                  "cannot resize shared memory " << name_ << ": " << strerror(error));
+    }
+    void *data = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      int error = errno;
+      shm_unlink(name_.c_str());
+      OKVIS_THROW(SensorRingProducer::Exception,
+                  "cannot map shared memory " << name_ << ": " << strerror(error));
+    }
+    data_ = static_cast<unsigned char*>(data);
+
+    // the segment is zero-filled, i.e. all slots are free
+    RingHeader &ringHeader = header();
+    ringHeader.version = ringVersion;
+    ringHeader.numImageSlots = parameters->numImageSlots;
+    ringHeader.maxImageBytes = parameters->maxImageBytes;
+    ringHeader.imuCapacity = parameters->imuCapacity;
+    pthread_mutexattr_t mutexAttributes;
+    pthread_mutexattr_init(&mutexAttributes);
+    pthread_mutexattr_setpshared(&mutexAttributes, PTHREAD_PROCESS_SHARED);
+#ifndef __APPLE__
+    pthread_mutexattr_setrobust(&mutexAttributes, PTHREAD_MUTEX_ROBUST);
+#endif
+    pthread_mutex_init(&ringHeader.mutex, &mutexAttributes);
+    pthread_mutexattr_destroy(&mutexAttributes);
+    pthread_condattr_t condAttributes;
+    pthread_condattr_init(&condAttributes);
+    pthread_condattr_setpshared(&condAttributes, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&ringHeader.dataAvailable, &condAttributes);
+    pthread_cond_init(&ringHeader.slotReleased, &condAttributes);
+    pthread_condattr_destroy(&condAttributes);
+    // publish the initialised segment
+    __atomic_store_n(&ringHeader.magic, ringMagic, __ATOMIC_RELEASE);
+    return;
+  }
+
+  int fd = shm_open(name_.c_str(), O_RDWR, 0600);
+  OKVIS_ASSERT_TRUE(SensorRingConsumer::Exception, fd >= 0,
+                    "cannot open shared memory " << name_ << ": " << strerror(errno));
+  struct stat status;
+  if (fstat(fd, &status) != 0
+      || size_t(status.st_size) < alignToCacheLine(sizeof(RingHeader))) {
+    close(fd);
+    OKVIS_THROW(SensorRingConsumer::Exception,
+                "shared memory " << name_ << " is not a sensor ring (yet)");
+  }
+  size_ = status.st_size;
+  void *data = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  OKVIS_ASSERT_TRUE(SensorRingConsumer::Exception, data != MAP_FAILED,
+                    "cannot map shared memory " << name_ << ": " << strerror(errno));
+  data_ = static_cast<unsigned char*>(data);
+  const RingHeader &ringHeader = header();
+  if (__atomic_load_n(&ringHeader.magic, __ATOMIC_ACQUIRE) != ringMagic
+      || ringHeader.version != ringVersion) {
+    munmap(data_, size_);
+    data_ = nullptr;
+    OKVIS_THROW(SensorRingConsumer::Exception,
+                "shared memory " << name_ << " is not an initialised sensor ring"
+                " of version " << ringVersion);
+  }
+  okvis::SensorRingParameters dimensions;
+  dimensions.numImageSlots = ringHeader.numImageSlots;
+  dimensions.maxImageBytes = ringHeader.maxImageBytes;
+  dimensions.imuCapacity = ringHeader.imuCapacity;
+  const size_t mappedSize = size_;
+  computeLayout(dimensions);
+  if (size_ > mappedSize) {
+    munmap(data_, mappedSize);
+    data_ = nullptr;
+    OKVIS_THROW(SensorRingConsumer::Exception,
+                "shared memory " << name_ << " is smaller than its ring dimensions");
+  }
+  size_ = mappedSize;
+}
+
+SharedMemorySegment::~SharedMemorySegment() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+  if (owner_) {
+    shm_unlink(name_.c_str());
+  }
+}
+
+void SharedMemorySegment::lock() {
+  int result = pthread_mutex_lock(&header().mutex);
+#ifndef __APPLE__
+  if (result == EOWNERDEAD) {
+    // the other process died while holding the lock. All updates are single
+    // field writes, so the ring is still consistent.
+    LOG(WARNING) << "Recovering sensor ring mutex of " << name_;
+    pthread_mutex_consistent(&header().mutex);
+    result = 0;
+  }
+#endif
+  CHECK_EQ(result, 0) << "cannot lock sensor ring mutex";
+}
+
+void SharedMemorySegment::unlock() {
+  pthread_mutex_unlock(&header().mutex);
+}
+
+bool SharedMemorySegment::waitUntil(pthread_cond_t &cond,
+                                    const timespec &deadline) {
+  int result = pthread_cond_timedwait(&cond, &header().mutex, &deadline);
+#ifndef __APPLE__
+  if (result == EOWNERDEAD) {
+    pthread_mutex_consistent(&header().mutex);
+    result = 0;
+  }
+#endif
+  return result != ETIMEDOUT;
+}
+
+void SharedMemorySegment::releaseSlot(size_t i) {
+  std::lock_guard<SharedMemorySegment> lock(*this);
+  slot(i).state = Free;
+  pthread_cond_broadcast(&header().slotReleased);
+}
+
+timespec SharedMemorySegment::deadline(double timeout) {
+  timespec time;
+  clock_gettime(CLOCK_REALTIME, &time);
+  const int64_t nanoseconds = int64_t(time.tv_nsec)
+      + int64_t(std::max(timeout, 0.0) * 1.0e9);
+  time.tv_sec += nanoseconds / 1000000000;
+  time.tv_nsec = nanoseconds % 1000000000;
+  return time;
+}
+
+// Constructor. Creates the shared memory segment.
+SensorRingProducer::SensorRingProducer(
+    const std::string &name, const okvis::SensorRingParameters &parameters)
+    : parameters_(parameters),
+      segment_(new SharedMemorySegment(name, &parameters)) {
+}
+
+// Destructor. Signals shutdown to the consumer and removes the segment name.
+SensorRingProducer::~SensorRingProducer() {
+  std::lock_guard<SharedMemorySegment> lock(*segment_);
+  segment_->header().producerFinished = 1;
+  pthread_cond_broadcast(&segment_->header().dataAvailable);
+}
+
+// Add an IMU measurement.
+void SensorRingProducer::addImuMeasurement(const okvis::Time &stamp,
+                                           const Eigen::Vector3d &alpha,
+                                           const Eigen::Vector3d &omega) {
+  std::lock_guard<SharedMemorySegment> lock(*segment_);
+  SharedMemorySegment::RingHeader &header = segment_->header();
+  SharedMemorySegment::ImuRecord &record = segment_->imu(
+      header.imuWriteCount % parameters_.imuCapacity);
+  record.sec = stamp.sec;
+  record.nsec = stamp.nsec;
+  Eigen::Map<Eigen::Vector3d>(record.alpha) = alpha;
+  Eigen::Map<Eigen::Vector3d>(record.omega) = omega;
+  ++header.imuWriteCount;
+  pthread_cond_broadcast(&header.dataAvailable);
+}
+
+// Get a free image slot to write an image into.
+bool SensorRingProducer::acquireImageSlot(int rows, int cols, int type,
+                                          ImageSlot &slot, double timeout) {
+  const size_t step = size_t(cols) * CV_ELEM_SIZE(type);
+  OKVIS_ASSERT_LE(Exception, step * rows, parameters_.maxImageBytes,
+                  "image does not fit into a sensor ring slot");
+  const timespec deadline = SharedMemorySegment::deadline(timeout);
+  std::unique_lock<SharedMemorySegment> lock(*segment_);
+  while (true) {
+    for (size_t i = 0; i < parameters_.numImageSlots; ++i) {
+      SharedMemorySegment::ImageSlotHeader &slotHeader = segment_->slot(i);
+      if (slotHeader.state == SharedMemorySegment::Free) {
+        slotHeader.state = SharedMemorySegment::Writing;
+        lock.unlock();
+        slot.index = i;
+        slot.image = cv::Mat(rows, cols, type, segment_->imageData(i), step);
+        return true;
+      }
+    }
+    if (timeout <= 0.0
+        || !segment_->waitUntil(segment_->header().slotReleased, deadline)) {
+      ++numDroppedImages_;
+      return false;
+    }
+  }
+}
+
+// Make an image written to an acquired slot available to the consumer.
+void SensorRingProducer::publishImage(ImageSlot &slot, const okvis::Time &stamp,
+                                      size_t cameraIndex) {
+  OKVIS_ASSERT_LT(Exception, slot.index, parameters_.numImageSlots,
+                  "invalid image slot");
+  OKVIS_ASSERT_TRUE(Exception,
+                    slot.image.data == segment_->imageData(slot.index),
+                    "the image slot was not acquired or is already published");
+  std::lock_guard<SharedMemorySegment> lock(*segment_);
+  SharedMemorySegment::RingHeader &header = segment_->header();
+  SharedMemorySegment::ImageSlotHeader &slotHeader = segment_->slot(slot.index);
+  OKVIS_ASSERT_TRUE(Exception, slotHeader.state == SharedMemorySegment::Writing,
+                    "the image slot was not acquired");
+  slotHeader.cameraIndex = cameraIndex;
+  slotHeader.sequence = header.imageSequence++;
+  slotHeader.sec = stamp.sec;
+  slotHeader.nsec = stamp.nsec;
+  slotHeader.rows = slot.image.rows;
+  slotHeader.cols = slot.image.cols;
+  slotHeader.type = slot.image.type();
+  slotHeader.step = slot.image.step[0];
+  slotHeader.state = SharedMemorySegment::Ready;
+  slot.image = cv::Mat();
+  pthread_cond_broadcast(&header.dataAvailable);
+}
+
+// Copy an image into a free slot and publish it.
+bool SensorRingProducer::addImage(const okvis::Time &stamp, size_t cameraIndex,
+                                  const cv::Mat &image, double timeout) {
+  ImageSlot slot;
+  if (!acquireImageSlot(image.rows, image.cols, image.type(), slot, timeout)) {
+    return false;
+  }
+  image.copyTo(slot.image);  // same size and type: copies into the slot
+  publishImage(slot, stamp, cameraIndex);
+  return true;
+}
+
+// Constructor. Opens the segment and starts the consumer thread.
+SensorRingConsumer::SensorRingConsumer(const std::string &name,
+                                       okvis::VioInterface &vio)
+    : vio_(vio),
+      segment_(new SharedMemorySegment(name, NULL)),
+      shutdown_(false),
+      producerFinished_(false),
+      numDroppedImuMeasurements_(0),
+      numRejectedImages_(0),
+      numDroppedImages_(0) {
+  consumerThread_ = std::thread(&SensorRingConsumer::consumerLoop, this);
+}
+
+// Destructor. Stops the consumer thread.
+SensorRingConsumer::~SensorRingConsumer() {
+  shutdown();
+}
+
+// Stop the consumer thread.
+void SensorRingConsumer::shutdown() {
+  shutdown_ = true;
+  {
+    std::lock_guard<SharedMemorySegment> lock(*segment_);
+    pthread_cond_broadcast(&segment_->header().dataAvailable);
+  }
+  if (consumerThread_.joinable()) {
+    consumerThread_.join();
+  }
+}
+
+// Loop that waits for new data and feeds the VioInterface.
+void SensorRingConsumer::consumerLoop() {
+  const SharedMemorySegment::RingHeader &header = segment_->header();
+  const size_t numImageSlots = header.numImageSlots;
+  const uint64_t imuCapacity = header.imuCapacity;
+  std::vector<SharedMemorySegment::ImuRecord> imuRecords;
+  std::vector<std::pair<uint64_t, size_t>> readySlots;  // sequence, index
+  std::vector<SharedMemorySegment::ImageSlotHeader> slotHeaders(numImageSlots);
+
+  while (!shutdown_) {
+    imuRecords.clear();
+    readySlots.clear();
+    bool finished = false;
+    {
+      std::unique_lock<SharedMemorySegment> lock(*segment_);
+      const timespec deadline = SharedMemorySegment::deadline(0.1);
+      while (!shutdown_) {
+        for (size_t i = 0; i < numImageSlots; ++i) {
+          if (segment_->slot(i).state == SharedMemorySegment::Ready) {
+            readySlots.push_back(std::make_pair(segment_->slot(i).sequence, i));
+          }
+        }
+        if (!readySlots.empty() || header.imuWriteCount != imuReadCount_
+            || header.producerFinished) {
+          break;
+        }
+        if (!segment_->waitUntil(segment_->header().dataAvailable, deadline)) {
+          break;  // check for shutdown
+        }
+      }
+      if (shutdown_) {
+        break;
+      }
+
+      // copy out the IMU readings; the oldest ones may have been overwritten
+      const uint64_t imuWriteCount = header.imuWriteCount;
+      if (imuWriteCount - imuReadCount_ > imuCapacity) {
+        const uint64_t numDropped = imuWriteCount - imuReadCount_ - imuCapacity;
+        LOG(WARNING) << "Sensor ring overflow: dropped " << numDropped
+                     << " IMU measurements";
+        numDroppedImuMeasurements_ += numDropped;
+        imuReadCount_ = imuWriteCount - imuCapacity;
+      }
+      for (; imuReadCount_ < imuWriteCount; ++imuReadCount_) {
+        imuRecords.push_back(segment_->imu(imuReadCount_ % imuCapacity));
+      }
+
+      // take over the published images
+      for (size_t r = 0; r < readySlots.size(); ++r) {
+        SharedMemorySegment::ImageSlotHeader &slotHeader =
+            segment_->slot(readySlots[r].second);
+        slotHeader.state = SharedMemorySegment::InUse;
+        slotHeaders[readySlots[r].second] = slotHeader;
+      }
+      finished = header.producerFinished && imuRecords.empty()
+          && readySlots.empty();
+    }
+
+    // merge by time: IMU readings up to (and including) a frame's stamp are delivered
+    // before the frame, such that the frame finds its IMU measurements
+    std::sort(readySlots.begin(), readySlots.end());
+    size_t imuIndex = 0;
+    for (size_t r = 0; r <= readySlots.size(); ++r) {
+      const bool isLast = r == readySlots.size();
+      const size_t index = isLast ? 0 : readySlots[r].second;
+      const SharedMemorySegment::ImageSlotHeader &slotHeader = slotHeaders[index];
+      const okvis::Time frameStamp(slotHeader.sec, slotHeader.nsec);
+      for (; imuIndex < imuRecords.size(); ++imuIndex) {
+        const SharedMemorySegment::ImuRecord &record = imuRecords[imuIndex];
+        const okvis::Time imuStamp(record.sec, record.nsec);
+        if (!isLast && imuStamp > frameStamp) {
+          break;
+        }
+        vio_.addImuMeasurement(imuStamp,
+                               Eigen::Map<const Eigen::Vector3d>(record.alpha),
+                               Eigen::Map<const Eigen::Vector3d>(record.omega));
+      }
+      if (isLast) {
+        break;
+      }
+      cv::Mat image(slotHeader.rows, slotHeader.cols, slotHeader.type,
+                    segment_->imageData(index), slotHeader.step);
+      // the callback keeps the mapping alive until the slot is released
+      std::shared_ptr<SharedMemorySegment> segment = segment_;
+      if (!vio_.addImageBuffer(frameStamp, slotHeader.cameraIndex, image,
+                               [segment, index]() {segment->releaseSlot(index);})) {
+        // without blocking, false means that the input queue was full and frames were dropped
+        if (vio_.blocking()) {
+          ++numRejectedImages_;
+        }
+        else {
+          ++numDroppedImages_;
+        }
+      }
+    }
+
+    if (finished) {
+      producerFinished_ = true;
+      break;
+    }
+  }
+}
+
+}  // namespace okvis
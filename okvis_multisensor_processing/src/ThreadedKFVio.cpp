@@ -38,6 +38,7 @@
  * @author Andreas Forster
  */
 
+#include <algorithm>
 #include <map>
 
 #include <glog/logging.h>
@@ -52,6 +53,19 @@ namespace okvis {
 static const int max_camera_input_queue_size = 10;
 static const okvis::Duration temporal_imu_data_overlap(0.02);  // overlap of imu data before and after two consecutive frames [seconds]
 
+namespace {
+// Copy the keypoints and descriptors of one camera between multiframes.
+void copyKeypoints(size_t cameraIndex, const okvis::MultiFrame &source,
+                   okvis::MultiFrame &target) {
+  std::vector<cv::KeyPoint> keypoints(source.numKeypoints(cameraIndex));
+  for (size_t k = 0; k < keypoints.size(); ++k) {
+    source.getCvKeypoint(cameraIndex, k, keypoints[k]);
+  }
+  target.resetKeypoints(cameraIndex, keypoints);
+  target.resetDescriptors(cameraIndex, source.descriptors(cameraIndex));
+}
+}  // namespace
+
 #ifdef USE_MOCK
 // Constructor for gmock.
 ThreadedKFVio::ThreadedKFVio(okvis::VioParameters& parameters, okvis::MockVioBackendInterface& estimator,
@@ -78,7 +92,9 @@ ThreadedKFVio::ThreadedKFVio(okvis::VioParameters &parameters)
       frameSynchronizer_(okvis::FrameSynchronizer(parameters)),
       lastAddedImageTimestamp_(okvis::Time(0, 0)),
       optimizationDone_(true),
-      estimator_(),
+      estimatorPtr_(parameters.optimization.structurelessBackend ?
+          new okvis::StructurelessEstimator() : new okvis::Estimator()),
+      estimator_(*estimatorPtr_),
       frontend_(parameters.nCameraSystem.numCameras()),
       parameters_(parameters),
       maxImuInputQueueSize_(
@@ -99,11 +115,30 @@ void ThreadedKFVio::init() {
   frontend_.setBriskDetectionOctaves(parameters_.optimization.detectionOctaves);
   frontend_.setBriskDetectionThreshold(parameters_.optimization.detectionThreshold);
   frontend_.setBriskDetectionMaximumKeypoints(parameters_.optimization.maxNoKeypoints);
+  frontend_.setDetectionGrid(parameters_.optimization.detectionGridColumns,
+                             parameters_.optimization.detectionGridRows,
+                             parameters_.optimization.detectionCellQuota);
 
   lastOptimizedStateTimestamp_ =
       okvis::Time(0.0) + temporal_imu_data_overlap;  // s.t. last_timestamp_ - overlap >= 0 (since okvis::time(-0.02) returns big number)
   lastAddedStateTimestamp_ = okvis::Time(0.0) + temporal_imu_data_overlap;  // s.t. last_timestamp_ - overlap >= 0 (since okvis::time(-0.02) returns big number)
 
+  estimator_.setExtrinsicsAutoFreeze(parameters_.extrinsicsFreeze.enabled,
+                                     parameters_.extrinsicsFreeze.translationThreshold,
+                                     parameters_.extrinsicsFreeze.rotationThreshold,
+                                     parameters_.extrinsicsFreeze.numStableOptimizations);
+  estimator_.setLandmarkMarginalizationPolicy(
+      size_t(parameters_.optimization.marginalizationMinObservations),
+      parameters_.optimization.marginalizationMinQuality);
+  estimator_.setPriorSparsification(parameters_.optimization.priorSparsification,
+                                    parameters_.optimization.priorSparsificationMaxKld);
+  estimator_.setAnchoredLandmarks(parameters_.optimization.anchoredLandmarks);
+  estimator_.setTrustRegionWarmStart(parameters_.optimization.warmStartTrustRegion);
+  estimator_.setOutlierCulling(parameters_.outlierCulling.chi2Threshold,
+                               parameters_.outlierCulling.numConsecutive,
+                               parameters_.outlierCulling.minObservations);
+  estimator_.setMaxLandmarks(size_t(parameters_.optimization.maxLandmarks));
+
   estimator_.addImu(parameters_.imu);
   for (size_t i = 0; i < numCameras_; ++i) {
     // parameters_.camera_extrinsics is never set (default 0's)...
@@ -114,6 +149,23 @@ void ThreadedKFVio::init() {
             (new threadsafe::ThreadSafeQueue<std::shared_ptr<okvis::CameraMeasurement> >()));
   }
 
+  // one executor per user callback, such that slow ones cannot delay the others
+  const PublishingParameters &publishing = parameters_.publishing;
+  stateCallbackDispatcher_.reset(new CallbackDispatcher(publishing.stateCallbackDispatch));
+  fullStateCallbackDispatcher_.reset(
+      new CallbackDispatcher(publishing.fullStateCallbackDispatch));
+  fullStateWithExtrinsicsCallbackDispatcher_.reset(
+      new CallbackDispatcher(publishing.fullStateWithExtrinsicsCallbackDispatch));
+  landmarksCallbackDispatcher_.reset(
+      new CallbackDispatcher(publishing.landmarksCallbackDispatch));
+  stateCovarianceCallbackDispatcher_.reset(
+      new CallbackDispatcher(publishing.stateCovarianceCallbackDispatch));
+  smoothedStateCallbackDispatcher_.reset(
+      new CallbackDispatcher(publishing.smoothedStateCallbackDispatch));
+
+  loadShedder_.reset(new LoadShedder(parameters_.loadShedding,
+                                     parameters_.sensors_information.cameraRate));
+
   // set up windows so things don't crash on Mac OS
   if (parameters_.visualization.displayImages) {
     for (size_t im = 0; im < parameters_.nCameraSystem.numCameras(); im++) {
@@ -160,6 +212,7 @@ ThreadedKFVio::~ThreadedKFVio() {
   matchedFrames_.Shutdown();
   imuMeasurementsReceived_.Shutdown();
   optimizationResults_.Shutdown();
+  smoothedStates_.Shutdown();
   visualizationData_.Shutdown();
   imuFrameSynchronizer_.shutdown();
   positionMeasurementsReceived_.Shutdown();
@@ -180,6 +233,14 @@ ThreadedKFVio::~ThreadedKFVio() {
   optimizationThread_.join();
   publisherThread_.join();
 
+  // deliver what has been dispatched to the user callbacks
+  stateCallbackDispatcher_->shutdown();
+  fullStateCallbackDispatcher_->shutdown();
+  fullStateWithExtrinsicsCallbackDispatcher_->shutdown();
+  landmarksCallbackDispatcher_->shutdown();
+  stateCovarianceCallbackDispatcher_->shutdown();
+  smoothedStateCallbackDispatcher_->shutdown();
+
   /*okvis::kinematics::Transformation endPosition;
   estimator_.get_T_WS(estimator_.currentFrameId(), endPosition);
   std::stringstream s;
@@ -196,6 +257,38 @@ bool ThreadedKFVio::addImage(const okvis::Time &stamp, size_t cameraIndex,
                              const cv::Mat &image,
                              const std::vector<cv::KeyPoint> *keypoints,
                              bool * /*asKeyframe*/) {
+  return addCameraMeasurement(stamp, cameraIndex, image, std::shared_ptr<void>(),
+                              keypoints);
+}
+
+// Add a new image in a caller-owned buffer without copying it.
+bool ThreadedKFVio::addImageBuffer(const okvis::Time &stamp, size_t cameraIndex,
+                                   const cv::Mat &image,
+                                   const ImageReleaseCallback &releaseCallback) {
+  if (image.empty()) {
+    LOG(ERROR) << "Received an empty image buffer. Dropping it.";
+    if (releaseCallback) {
+      releaseCallback();
+    }
+    return false;
+  }
+  std::shared_ptr<void> imageLease;
+  if (releaseCallback) {
+    // calls releaseCallback once the last reference to the image is gone. It points to the
+    // buffer, such that it tests true while the buffer is borrowed.
+    imageLease = std::shared_ptr<void>(static_cast<void *>(image.data),
+                                       [releaseCallback](void *) {
+      releaseCallback();
+    });
+  }
+  return addCameraMeasurement(stamp, cameraIndex, image, imageLease, nullptr);
+}
+
+// Add a camera measurement to the input queue of its frame consumer thread.
+bool ThreadedKFVio::addCameraMeasurement(const okvis::Time &stamp, size_t cameraIndex,
+                                         const cv::Mat &image,
+                                         const std::shared_ptr<void> &imageLease,
+                                         const std::vector<cv::KeyPoint> *keypoints) {
   assert(cameraIndex < numCameras_);
 
   if (lastAddedImageTimestamp_ > stamp
@@ -206,10 +299,12 @@ bool ThreadedKFVio::addImage(const okvis::Time &stamp, size_t cameraIndex,
     return false;
   }
   lastAddedImageTimestamp_ = stamp;
+  loadShedder_->frameReceived(stamp, okvis::Time::now());
 
   std::shared_ptr<okvis::CameraMeasurement> frame = std::make_shared<
       okvis::CameraMeasurement>();
   frame->measurement.image = image;
+  frame->measurement.imageLease = imageLease;
   frame->timeStamp = stamp;
   frame->sensorId = cameraIndex;
 
@@ -340,9 +435,25 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
   TimerSwitchable waitForMatchingThreadTimer("1.4 waitForMatchingThread" + std::to_string(cameraIndex), true);
 
 
+  const bool asynchronous = parameters_.frameSynchronization.asynchronous;
+  // poll for expired dispatch deadlines while waiting for frames
+  const int64_t dispatchPollingInterval = int64_t(
+      0.5e9 * std::max(parameters_.frameSynchronization.deadline, 1.0e-3));
+
   for (;;) {
     // get data and check for termination request
-    if (cameraMeasurementsReceived_[cameraIndex]->PopBlocking(&frame) == false) {
+    if (asynchronous) {
+      if (cameraMeasurementsReceived_[cameraIndex]->PopTimeout(&frame, dispatchPollingInterval) == false) {
+        if (cameraMeasurementsReceived_[cameraIndex]->IsShutdown()) {
+          return;
+        }
+        std::unique_lock<std::mutex> lock(frameSynchronizer_mutex_);
+        if (dispatchMultiFrames(lock) == false) {
+          return;
+        }
+        continue;
+      }
+    } else if (cameraMeasurementsReceived_[cameraIndex]->PopBlocking(&frame) == false) {
       return;
     }
     beforeDetectTimer.start();
@@ -355,6 +466,20 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
       multiFrame = frameSynchronizer_.addNewFrame(frame);
       addNewFrameToSynchronizerTimer.stop();
     }  // unlock frameSynchronizer only now as we can be sure that not two states are added for the same timestamp
+    if (!multiFrame) {
+      // late frame to be discarded, hand back a caller-owned buffer right away
+      frame.reset();
+      beforeDetectTimer.stop();
+      continue;
+    }
+    // with asynchronous multiframes, detect on a separate multiframe, since the synchronizer
+    // may dispatch the multiframe to the matching before we are done
+    std::shared_ptr<okvis::MultiFrame> detectionFrame = multiFrame;
+    if (asynchronous) {
+      detectionFrame.reset(new okvis::MultiFrame(parameters_.nCameraSystem, multiFrame->timestamp(),
+                                                 multiFrame->id()));
+      detectionFrame->setImage(frame->sensorId, frame->measurement.image);
+    }
     okvis::kinematics::Transformation T_WS;
     okvis::Time lastTimestamp;
     okvis::SpeedAndBias speedAndBiases;
@@ -369,7 +494,7 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
     }
 
     // -- get relevant imu messages for new state
-    okvis::Time imuDataEndTime = multiFrame->timestamp()
+    okvis::Time imuDataEndTime = detectionFrame->timestamp()
                                  + temporal_imu_data_overlap;
     okvis::Time imuDataBeginTime = lastTimestamp - temporal_imu_data_overlap;
 
@@ -390,12 +515,14 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
     // if imu_data is empty, either end_time > begin_time or
     // no measurements in timeframe, should not happen, as we waited for measurements
     if (imuData.size() == 0) {
+      releaseImageBuffer(frame, detectionFrame);
       beforeDetectTimer.stop();
       continue;
     }
 
     if (imuData.front().timeStamp > frame->timeStamp) {
       LOG(WARNING) << "Frame is newer than oldest IMU measurement. Dropping it.";
+      releaseImageBuffer(frame, detectionFrame);
       beforeDetectTimer.stop();
       continue;
     }
@@ -409,11 +536,12 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
         lastOptimized_T_WS_ = T_WS;
         lastOptimizedSpeedAndBiases_.setZero();
         lastOptimizedSpeedAndBiases_.segment<3>(6) = imu_params_.a0;
-        lastOptimizedStateTimestamp_ = multiFrame->timestamp();
+        lastOptimizedStateTimestamp_ = detectionFrame->timestamp();
       }
       OKVIS_ASSERT_TRUE_DBG(Exception, success,
                             "pose could not be initialized from imu measurements.");
       if (!success) {
+        releaseImageBuffer(frame, detectionFrame);
         beforeDetectTimer.stop();
         continue;
       }
@@ -423,17 +551,39 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
       propagationTimer.start();
       okvis::ceres::ImuError::propagation(imuData, parameters_.imu, T_WS,
                                           speedAndBiases, lastTimestamp,
-                                          multiFrame->timestamp());
+                                          detectionFrame->timestamp());
       propagationTimer.stop();
     }
+    // skip before detection if the pipeline falls behind, the IMU bridges the gap to the next state
+    if (loadShedder_->parameters().enabled
+        && loadShedder_->skip(multiFrame->id(), loadShedder_->isKeyframeCandidate(T_WS))) {
+      releaseImageBuffer(frame, detectionFrame);
+      {
+        std::lock_guard<std::mutex> lock(frameSynchronizer_mutex_);
+        frameSynchronizer_.skipMultiFrame(multiFrame->id());
+      }
+      beforeDetectTimer.stop();
+      continue;
+    }
     okvis::kinematics::Transformation T_WC = T_WS
                                              * (*parameters_.nCameraSystem.T_SC(frame->sensorId));
     beforeDetectTimer.stop();
     detectTimer.start();
-    frontend_.detectAndDescribe(frame->sensorId, multiFrame, T_WC, nullptr);
+    frontend_.detectAndDescribe(frame->sensorId, detectionFrame, T_WC, nullptr);
     detectTimer.stop();
     afterDetectTimer.start();
 
+    // the image is not needed for matching anymore: hand back a caller-owned buffer
+    releaseImageBuffer(frame, detectionFrame);
+
+    if (asynchronous) {
+      afterDetectTimer.stop();
+      if (mergeDetection(cameraIndex, multiFrame, detectionFrame) == false) {
+        return;
+      }
+      continue;
+    }
+
     bool push = false;
     {  // we now tell frame synchronizer that detectAndDescribe is done for MF with our timestamp
       waitForFrameSynchronizerMutexTimer2.start();
@@ -460,12 +610,77 @@ void ThreadedKFVio::frameConsumerLoop(size_t cameraIndex) {
   }
 }
 
+// Hand the keypoints detected for camera cameraIndex to the multiframe (asynchronous multiframes).
+bool ThreadedKFVio::mergeDetection(
+    size_t cameraIndex, const std::shared_ptr<okvis::MultiFrame> &multiFrame,
+    const std::shared_ptr<okvis::MultiFrame> &detectionFrame) {
+  std::unique_lock<std::mutex> lock(frameSynchronizer_mutex_);
+  switch (frameSynchronizer_.detectionEndedForFrame(multiFrame->id(), cameraIndex,
+                                                    okvis::Time::now())) {
+    case okvis::FrameSynchronizer::DetectionResult::Merge:
+      // not dispatched yet, so nobody else is reading the multiframe
+      copyKeypoints(cameraIndex, *detectionFrame, *multiFrame);
+      multiFrame->setImage(cameraIndex, detectionFrame->image(cameraIndex));
+      return dispatchMultiFrames(lock);
+    case okvis::FrameSynchronizer::DetectionResult::Append: {
+      // already in the estimator: the keypoints are available for matching against later frames.
+      // Everybody else reads this multiframe under estimator_mutex_ or from a copy taken under it.
+      lock.unlock();
+      std::lock_guard<std::mutex> estimatorLock(estimator_mutex_);
+      copyKeypoints(cameraIndex, *detectionFrame, *multiFrame);
+      return true;
+    }
+    case okvis::FrameSynchronizer::DetectionResult::Discard:
+      break;
+  }
+  return true;
+}
+
+// Push the multiframes that are ready to the matching (asynchronous multiframes).
+bool ThreadedKFVio::dispatchMultiFrames(std::unique_lock<std::mutex> &frameSynchronizerLock) {
+  std::vector<std::shared_ptr<okvis::MultiFrame> > multiFrames;
+  if (!frameSynchronizer_.popDispatchableMultiFrames(okvis::Time::now(), multiFrames)) {
+    return true;
+  }
+  // take the dispatch lock before releasing the synchronizer, such that
+  // the multiframes of concurrent calls arrive in order
+  std::lock_guard<std::mutex> dispatchLock(multiFrameDispatch_mutex_);
+  frameSynchronizerLock.unlock();
+  for (size_t i = 0; i < multiFrames.size(); ++i) {
+    // use queue size 1 to propagate a congestion to the _cameraMeasurementsReceived queue
+    // and check for termination request
+    if (keypointMeasurements_.PushBlockingIfFull(multiFrames[i], 1) == false) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Stop accessing a caller-owned image buffer after detection.
+void ThreadedKFVio::releaseImageBuffer(
+    std::shared_ptr<okvis::CameraMeasurement> &frame,
+    const std::shared_ptr<okvis::MultiFrame> &multiFrame) {
+  if (!frame->measurement.imageLease) {
+    return;
+  }
+  if (parameters_.visualization.displayImages) {
+    multiFrame->setImage(frame->sensorId, frame->measurement.image.clone());
+  } else {
+    multiFrame->setImage(frame->sensorId, cv::Mat());
+  }
+  // no reference to the buffer may survive the release
+  frame->measurement.image = cv::Mat();
+  frame->measurement.imageLease.reset();
+  frame.reset();
+}
+
 // Loop that matches frames with existing frames.
 void ThreadedKFVio::matchingLoop() {
   TimerSwitchable prepareToAddStateTimer("2.1 prepareToAddState", true);
   TimerSwitchable waitForOptimizationTimer("2.2 waitForOptimization", true);
   TimerSwitchable addStateTimer("2.3 addState", true);
   TimerSwitchable matchingTimer("2.4 matching", true);
+  TimerSwitchable poseRefinementTimer("2.5 poseRefinement", true);
 
   for (;;) {
     // get new frame
@@ -532,8 +747,20 @@ void ThreadedKFVio::matchingLoop() {
       frontend_.dataAssociationAndInitialization(estimator_, T_WS, parameters_,
                                                  map_, frame, &asKeyframe);
       matchingTimer.stop();
-      if (asKeyframe)
+      if (asKeyframe) {
         estimator_.setKeyframe(frame->id(), asKeyframe);
+        loadShedder_->keyframeAdded(T_WS);
+      }
+
+      // fast path: refine the new state alone and publish it ahead of the full optimization
+      if (parameters_.optimization.poseRefinementIterations > 0) {
+        poseRefinementTimer.start();
+        if (estimator_.refineState(frame->id(),
+                                   parameters_.optimization.poseRefinementIterations)) {
+          publishRefinedState(frame, imuData);
+        }
+        poseRefinementTimer.stop();
+      }
       if (!blocking_) {
         double timeLimit = parameters_.optimization.timeLimitForMatchingAndOptimization
                            - (okvis::Time::now() - t0Matching).toSec();
@@ -542,6 +769,7 @@ void ThreadedKFVio::matchingLoop() {
       }
       optimizationDone_ = false;
     }  // unlock estimator_mutex_
+    loadShedder_->stateAdded(frame->timestamp(), okvis::Time::now());
 
     // use queue size 1 to propagate a congestion to the _matchedFrames queue
     if (matchedFrames_.PushBlockingIfFull(frame, 1) == false)
@@ -549,6 +777,34 @@ void ThreadedKFVio::matchingLoop() {
   }
 }
 
+// Publish the state refined right after matching.
+void ThreadedKFVio::publishRefinedState(const std::shared_ptr<okvis::MultiFrame> &frame,
+                                        const okvis::ImuMeasurementDeque &imuData) {
+  OptimizationResults result;
+  {
+    // the IMU propagation and the next frame continue from the refined state
+    std::lock_guard<std::mutex> lock(lastState_mutex_);
+    estimator_.get_T_WS(frame->id(), lastOptimized_T_WS_);
+    estimator_.getSpeedAndBias(frame->id(), 0, lastOptimizedSpeedAndBiases_);
+    lastOptimizedStateTimestamp_ = frame->timestamp();
+    repropagationNeeded_ = true;
+    result.T_WS = lastOptimized_T_WS_;
+    result.speedAndBiases = lastOptimizedSpeedAndBiases_;
+    result.stamp = lastOptimizedStateTimestamp_;
+  }
+  // with IMU propagated states, the refined state is published by the next IMU measurement
+  if (parameters_.publishing.publishImuPropagatedState) {
+    return;
+  }
+  result.omega_S = imuData.back().measurement.gyroscopes - result.speedAndBiases.segment<3>(3);
+  result.onlyPublishLandmarks = false;
+  for (size_t i = 0; i < parameters_.nCameraSystem.numCameras(); ++i) {
+    result.vector_of_T_SCi.push_back(
+        okvis::kinematics::Transformation(*parameters_.nCameraSystem.T_SC(i)));
+  }
+  optimizationResults_.Push(result);
+}
+
 // Loop to process IMU measurements.
 void ThreadedKFVio::imuConsumerLoop() {
   okvis::ImuMeasurement data;
@@ -734,6 +990,7 @@ void ThreadedKFVio::optimizationLoop() {
   TimerSwitchable optimizationTimer("3.1 optimization", true);
   TimerSwitchable marginalizationTimer("3.2 marginalization", true);
   TimerSwitchable afterOptimizationTimer("3.3 afterOptimization", true);
+  int numLocalOptimizations = 0;  // since the last full optimization
 
   for (;;) {
     std::shared_ptr<okvis::MultiFrame> frame_pairs;
@@ -742,12 +999,36 @@ void ThreadedKFVio::optimizationLoop() {
     if (matchedFrames_.PopBlocking(&frame_pairs) == false)
       return;
     OptimizationResults result;
+    okvis::FrameStateVector marginalizedStates;
     {
       std::lock_guard<std::mutex> l(estimator_mutex_);
       optimizationTimer.start();
+      if (parameters_.optimization.maxLandmarks > 0) {
+        // the pruned landmarks are fine, hand them over like the marginalized ones
+        estimator_.pruneLandmarks(result.transferredLandmarks);
+      }
       //if(frontend_.isInitialized()){
-      estimator_.optimize(parameters_.optimization.max_iterations, 2, false);
+      // the old states hardly change on non-keyframes: optimize the newest ones only
+      const int fullOptimizationInterval = parameters_.optimization.fullOptimizationInterval;
+      if (parameters_.optimization.localOptimization
+          && !estimator_.isKeyframe(frame_pairs->id())
+          && (fullOptimizationInterval <= 0
+              || numLocalOptimizations + 1 < fullOptimizationInterval)) {
+        estimator_.optimizeLocal(parameters_.optimization.numImuFrames,
+                                 parameters_.optimization.max_iterations, 2, false);
+        ++numLocalOptimizations;
+      }
+      else {
+        estimator_.optimize(parameters_.optimization.max_iterations, 2, false);
+        numLocalOptimizations = 0;
+      }
       //}
+      if (parameters_.outlierCulling.enabled) {
+        // only the outlier observations are dropped: like the pruned and the marginalized
+        // landmarks, those left with too few observations are handed over
+        estimator_.cullOutliers(result.transferredLandmarks, 2,
+                                parameters_.outlierCulling.timeLimit);
+      }
       /*if (estimator_.numFrames() > 0 && !frontend_.isInitialized()){
         // undo translation
         for(size_t n=0; n<estimator_.numFrames(); ++n){
@@ -777,7 +1058,8 @@ void ThreadedKFVio::optimizationLoop() {
       marginalizationTimer.start();
       estimator_.applyMarginalizationStrategy(
           parameters_.optimization.numKeyframes,
-          parameters_.optimization.numImuFrames, result.transferredLandmarks);
+          parameters_.optimization.numImuFrames, result.transferredLandmarks,
+          smoothedStateCallback_ ? &marginalizedStates : NULL);
       marginalizationTimer.stop();
       afterOptimizationTimer.start();
 
@@ -806,6 +1088,15 @@ void ThreadedKFVio::optimizationLoop() {
         repropagationNeeded_ = true;
       }
 
+      // marginal covariance of the newest state, within the time budget
+      if (stateCovarianceCallback_) {
+        result.covarianceAvailable = estimator_.computeCovariance(
+            frame_pairs->id(), result.covariance,
+            parameters_.publishing.covarianceTimeLimit);
+        result.frameId = frame_pairs->id();
+        result.frameStamp = frame_pairs->timestamp();
+      }
+
       if (parameters_.visualization.displayImages) {
         // fill in information that requires access to estimator.
         visualizationDataPtr = VioVisualizer::VisualizationData::Ptr(
@@ -838,8 +1129,11 @@ void ThreadedKFVio::optimizationLoop() {
             ++it;
           }
         }
-        visualizationDataPtr->keyFrames = estimator_.multiFrame(
-            estimator_.currentKeyframeId());
+        // snapshots: late keypoints are appended to these multiframes under estimator_mutex_
+        visualizationDataPtr->currentFrames = std::shared_ptr<okvis::MultiFrame>(
+            new okvis::MultiFrame(*frame_pairs));
+        visualizationDataPtr->keyFrames = std::shared_ptr<okvis::MultiFrame>(
+            new okvis::MultiFrame(*estimator_.multiFrame(estimator_.currentKeyframeId())));
         estimator_.get_T_WS(estimator_.currentKeyframeId(),
                             visualizationDataPtr->T_WS_keyFrame);
       }
@@ -856,39 +1150,102 @@ void ThreadedKFVio::optimizationLoop() {
                 *parameters_.nCameraSystem.T_SC(i)));
       }
     }
+    for (size_t i = 0; i < marginalizedStates.size(); ++i) {
+      smoothedStates_.Push(marginalizedStates[i]);
+    }
     optimizationResults_.Push(result);
 
     // adding further elements to visualization data that do not access estimator
     if (parameters_.visualization.displayImages) {
-      visualizationDataPtr->currentFrames = frame_pairs;
       visualizationData_.PushNonBlockingDroppingIfFull(visualizationDataPtr, 1);
     }
     afterOptimizationTimer.stop();
   }
 }
 
-// Loop that publishes the newest state and landmarks.
+// Loop that publishes the newest state and landmarks as well as marginalized states.
 void ThreadedKFVio::publisherLoop() {
   for (;;) {
     // get the result data
-    OptimizationResults result;
-    if (optimizationResults_.PopBlocking(&result) == false)
+    OptimizationResults poppedResult;
+    if (optimizationResults_.PopBlocking(&poppedResult) == false)
       return;
-
-    // call all user callbacks
-    if (stateCallback_ && !result.onlyPublishLandmarks)
-      stateCallback_(result.stamp, result.T_WS);
-    if (fullStateCallback_ && !result.onlyPublishLandmarks)
-      fullStateCallback_(result.stamp, result.T_WS, result.speedAndBiases,
-                         result.omega_S);
-    if (fullStateCallbackWithExtrinsics_ && !result.onlyPublishLandmarks)
-      fullStateCallbackWithExtrinsics_(result.stamp, result.T_WS,
-                                       result.speedAndBiases, result.omega_S,
-                                       result.vector_of_T_SCi);
-    if (landmarksCallback_ && !result.landmarksVector.empty())
-      landmarksCallback_(result.stamp, result.landmarksVector,
-                         result.transferredLandmarks);  //TODO(gohlp): why two maps?
+    // shared by all dispatched callbacks, so the landmarks are not copied
+    std::shared_ptr<const OptimizationResults> result(
+        new OptimizationResults(std::move(poppedResult)));
+
+    // dispatch all user callbacks
+    if (stateCallback_ && !result->onlyPublishLandmarks) {
+      const StateCallback callback = stateCallback_;
+      stateCallbackDispatcher_->dispatch([callback, result]() {
+        callback(result->stamp, result->T_WS);
+      });
+    }
+    if (fullStateCallback_ && !result->onlyPublishLandmarks) {
+      const FullStateCallback callback = fullStateCallback_;
+      fullStateCallbackDispatcher_->dispatch([callback, result]() {
+        callback(result->stamp, result->T_WS, result->speedAndBiases,
+                 result->omega_S);
+      });
+    }
+    if (fullStateCallbackWithExtrinsics_ && !result->onlyPublishLandmarks) {
+      const FullStateCallbackWithExtrinsics callback =
+          fullStateCallbackWithExtrinsics_;
+      fullStateWithExtrinsicsCallbackDispatcher_->dispatch([callback, result]() {
+        callback(result->stamp, result->T_WS, result->speedAndBiases,
+                 result->omega_S, result->vector_of_T_SCi);
+      });
+    }
+    if (landmarksCallback_ && !result->landmarksVector.empty()) {
+      const LandmarksCallback callback = landmarksCallback_;
+      landmarksCallbackDispatcher_->dispatch([callback, result]() {
+        callback(result->stamp, result->landmarksVector,
+                 result->transferredLandmarks);  //TODO(gohlp): why two maps?
+      });
+    }
+    if (stateCovarianceCallback_ && result->covarianceAvailable) {
+      const StateCovarianceCallback callback = stateCovarianceCallback_;
+      stateCovarianceCallbackDispatcher_->dispatch([callback, result]() {
+        callback(result->frameStamp, result->frameId, result->covariance);
+      });
+    }
+    // the smoothed states were queued before the optimization result, so they are all here
+    okvis::FrameState smoothedState;
+    while (smoothedStates_.PopNonBlocking(&smoothedState)) {
+      if (smoothedStateCallback_) {
+        const SmoothedStateCallback callback = smoothedStateCallback_;
+        std::shared_ptr<const okvis::FrameState> state(
+            new okvis::FrameState(smoothedState));
+        smoothedStateCallbackDispatcher_->dispatch([callback, state]() {
+          callback(state->timestamp, state->frameId, state->T_WS);
+        });
+      }
+    }
   }
 }
 
+// Counters on dispatched, partial, dropped and late multiframes.
+okvis::FrameSynchronizer::Statistics ThreadedKFVio::frameSynchronizationStatistics() {
+  std::lock_guard<std::mutex> lock(frameSynchronizer_mutex_);
+  return frameSynchronizer_.statistics();
+}
+
+// Skip decisions and the latency from receiving a frame to adding its state.
+okvis::LoadShedder::Statistics ThreadedKFVio::loadSheddingStatistics() const {
+  return loadShedder_->statistics();
+}
+
+// Number of user callback invocations dropped so far due to the dispatch policies.
+ThreadedKFVio::CallbackDropCounts ThreadedKFVio::callbackDropCounts() const {
+  CallbackDropCounts counts;
+  counts.state = stateCallbackDispatcher_->numDropped();
+  counts.fullState = fullStateCallbackDispatcher_->numDropped();
+  counts.fullStateWithExtrinsics =
+      fullStateWithExtrinsicsCallbackDispatcher_->numDropped();
+  counts.landmarks = landmarksCallbackDispatcher_->numDropped();
+  counts.stateCovariance = stateCovarianceCallbackDispatcher_->numDropped();
+  counts.smoothedState = smoothedStateCallbackDispatcher_->numDropped();
+  return counts;
+}
+
 }  // namespace okvis
@@ -57,6 +57,18 @@
 /// \brief okvis Main namespace of this package.
 namespace okvis {
 
+namespace {
+// The image of a camera, or a black one if the camera missed the multiframe
+// (asynchronous multiframes).
+cv::Mat imageOrBlank(const okvis::MultiFrame &multiFrame, size_t cameraIndex) {
+  if (!multiFrame.image(cameraIndex).empty()) {
+    return multiFrame.image(cameraIndex);
+  }
+  return cv::Mat::zeros(multiFrame.geometry(cameraIndex)->imageHeight(),
+                        multiFrame.geometry(cameraIndex)->imageWidth(), CV_8UC1);
+}
+}  // namespace
+
 VioVisualizer::VioVisualizer(okvis::VioParameters &parameters)
     : parameters_(parameters) {
   if (parameters.nCameraSystem.numCameras() > 0) {
@@ -77,12 +89,13 @@ cv::Mat VioVisualizer::drawMatches(VisualizationData::Ptr &data,
   std::shared_ptr<okvis::MultiFrame> keyframe = data->keyFrames;
   std::shared_ptr<okvis::MultiFrame> frame = data->currentFrames;
 
+  const cv::Mat currentImage = imageOrBlank(*frame, image_number);
   if (keyframe == nullptr)
-    return frame->image(image_number);
+    return currentImage;
 
   // allocate an image
-  const unsigned int im_cols = frame->image(image_number).cols;
-  const unsigned int im_rows = frame->image(image_number).rows;
+  const unsigned int im_cols = currentImage.cols;
+  const unsigned int im_rows = currentImage.rows;
   const unsigned int rowJump = im_rows;
 
   cv::Mat outimg(2 * im_rows, im_cols, CV_8UC3);
@@ -90,8 +103,8 @@ cv::Mat VioVisualizer::drawMatches(VisualizationData::Ptr &data,
   cv::Mat current = outimg(cv::Rect(0, rowJump, im_cols, im_rows));
   cv::Mat actKeyframe = outimg(cv::Rect(0, 0, im_cols, im_rows));
 
-  cv::cvtColor(frame->image(image_number), current, CV_GRAY2BGR);
-  cv::cvtColor(keyframe->image(image_number), actKeyframe, CV_GRAY2BGR);
+  cv::cvtColor(currentImage, current, CV_GRAY2BGR);
+  cv::cvtColor(imageOrBlank(*keyframe, image_number), actKeyframe, CV_GRAY2BGR);
 
   // the keyframe trafo
   Eigen::Vector2d keypoint;
@@ -206,7 +219,7 @@ cv::Mat VioVisualizer::drawKeypoints(VisualizationData::Ptr &data,
                                      size_t cameraIndex) {
 
   std::shared_ptr<okvis::MultiFrame> currentFrames = data->currentFrames;
-  const cv::Mat currentImage = currentFrames->image(cameraIndex);
+  const cv::Mat currentImage = imageOrBlank(*currentFrames, cameraIndex);
 
   cv::Mat outimg;
   cv::cvtColor(currentImage, outimg, CV_GRAY2BGR);
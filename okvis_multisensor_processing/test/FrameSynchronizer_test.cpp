@@ -238,3 +238,120 @@ TEST_F(FrameSynchronizerTest, OneOutOfOrder) {
   frame_syncer.addNewFrame(test_frames.at(6).at(1));
 }
 
+
+
+TEST_F(FrameSynchronizerTest, AsynchronousMinCameras) {
+  parameters.frameSynchronization.asynchronous = true;
+  parameters.frameSynchronization.minCameras = 1;
+  parameters.frameSynchronization.deadline = 1.0;
+  frame_syncer.init(parameters);
+  okvis::Time now(100.0);
+  std::vector<okvis::MultiFramePtr> dispatched;
+  for (size_t i = 0; i < num_test_frames; ++i) {
+    okvis::MultiFramePtr multiFrame = frame_syncer.addNewFrame(test_frames.at(i).at(0));
+    ASSERT_TRUE(multiFrame != nullptr);
+    EXPECT_TRUE(multiFrame->image(0).empty());  // set only when merging the detection
+    EXPECT_FALSE(frame_syncer.popDispatchableMultiFrames(now, dispatched));
+    EXPECT_TRUE(frame_syncer.detectionEndedForFrame(multiFrame->id(), 0, now)
+                == FrameSynchronizer::DetectionResult::Merge);
+    ASSERT_TRUE(frame_syncer.popDispatchableMultiFrames(now, dispatched));
+    ASSERT_EQ(1u, dispatched.size());
+    EXPECT_EQ(multiFrame->id(), dispatched[0]->id());
+    // the second camera is late
+    EXPECT_TRUE(frame_syncer.addNewFrame(test_frames.at(i).at(1)) == nullptr);
+  }
+  EXPECT_EQ(num_test_frames, frame_syncer.statistics().numDispatched);
+  EXPECT_EQ(num_test_frames, frame_syncer.statistics().numPartial);
+  EXPECT_EQ(num_test_frames, frame_syncer.statistics().numLateDiscarded);
+  EXPECT_EQ(0u, frame_syncer.statistics().numDropped);
+}
+
+
+TEST_F(FrameSynchronizerTest, AsynchronousDeadline) {
+  parameters.frameSynchronization.asynchronous = true;
+  parameters.frameSynchronization.minCameras = num_cameras;
+  parameters.frameSynchronization.deadline = 0.02;
+  frame_syncer.init(parameters);
+  okvis::Time now(100.0);
+  std::vector<okvis::MultiFramePtr> dispatched;
+
+  // all cameras: dispatch immediately
+  okvis::MultiFramePtr multiFrame = frame_syncer.addNewFrame(test_frames.at(0).at(0));
+  frame_syncer.addNewFrame(test_frames.at(0).at(1));
+  frame_syncer.detectionEndedForFrame(multiFrame->id(), 0, now);
+  EXPECT_FALSE(frame_syncer.popDispatchableMultiFrames(now, dispatched));
+  frame_syncer.detectionEndedForFrame(multiFrame->id(), 1, now);
+  EXPECT_TRUE(frame_syncer.popDispatchableMultiFrames(now, dispatched));
+
+  // one camera: wait for the deadline
+  multiFrame = frame_syncer.addNewFrame(test_frames.at(1).at(0));
+  frame_syncer.detectionEndedForFrame(multiFrame->id(), 0, now);
+  EXPECT_FALSE(frame_syncer.popDispatchableMultiFrames(now + okvis::Duration(0.01), dispatched));
+  ASSERT_TRUE(frame_syncer.popDispatchableMultiFrames(now + okvis::Duration(0.03), dispatched));
+  ASSERT_EQ(1u, dispatched.size());
+  EXPECT_EQ(multiFrame->id(), dispatched[0]->id());
+  EXPECT_EQ(2u, frame_syncer.statistics().numDispatched);
+  EXPECT_EQ(1u, frame_syncer.statistics().numPartial);
+}
+
+
+TEST_F(FrameSynchronizerTest, AsynchronousLateAppend) {
+  parameters.frameSynchronization.asynchronous = true;
+  parameters.frameSynchronization.minCameras = 1;
+  parameters.frameSynchronization.lateFrames = LateFramePolicy::Append;
+  frame_syncer.init(parameters);
+  okvis::Time now(100.0);
+  std::vector<okvis::MultiFramePtr> dispatched;
+
+  okvis::MultiFramePtr multiFrame = frame_syncer.addNewFrame(test_frames.at(0).at(0));
+  okvis::MultiFramePtr lateMultiFrame = frame_syncer.addNewFrame(test_frames.at(0).at(1));
+  EXPECT_EQ(multiFrame, lateMultiFrame);
+  frame_syncer.detectionEndedForFrame(multiFrame->id(), 0, now);
+  EXPECT_TRUE(frame_syncer.popDispatchableMultiFrames(now, dispatched));
+  EXPECT_TRUE(frame_syncer.detectionEndedForFrame(multiFrame->id(), 1, now)
+              == FrameSynchronizer::DetectionResult::Append);
+
+  // arrives after dispatch
+  multiFrame = frame_syncer.addNewFrame(test_frames.at(1).at(0));
+  frame_syncer.detectionEndedForFrame(multiFrame->id(), 0, now);
+  EXPECT_TRUE(frame_syncer.popDispatchableMultiFrames(now, dispatched));
+  lateMultiFrame = frame_syncer.addNewFrame(test_frames.at(1).at(1));
+  EXPECT_EQ(multiFrame, lateMultiFrame);
+  EXPECT_TRUE(frame_syncer.detectionEndedForFrame(multiFrame->id(), 1, now)
+              == FrameSynchronizer::DetectionResult::Append);
+  EXPECT_EQ(2u, frame_syncer.statistics().numLateAppended);
+  EXPECT_EQ(0u, frame_syncer.statistics().numLateDiscarded);
+}
+
+
+TEST_F(FrameSynchronizerTest, AsynchronousRequiredCamera) {
+  parameters.frameSynchronization.asynchronous = true;
+  parameters.frameSynchronization.minCameras = 1;
+  parameters.frameSynchronization.requiredCameras = std::vector<size_t>(1, 1);
+  parameters.frameSynchronization.deadline = 0.02;
+  frame_syncer.init(parameters);
+  okvis::Time now(100.0);
+  std::vector<okvis::MultiFramePtr> dispatched;
+
+  // required camera missing until the deadline: dropped
+  okvis::MultiFramePtr multiFrame0 = frame_syncer.addNewFrame(test_frames.at(0).at(0));
+  frame_syncer.detectionEndedForFrame(multiFrame0->id(), 0, now);
+  EXPECT_FALSE(frame_syncer.popDispatchableMultiFrames(now, dispatched));
+  EXPECT_FALSE(frame_syncer.popDispatchableMultiFrames(now + okvis::Duration(0.03), dispatched));
+  EXPECT_EQ(1u, frame_syncer.statistics().numDropped);
+
+  // an older pending multiframe lacking the required camera is dropped
+  // when a newer one gets dispatched
+  okvis::MultiFramePtr multiFrame1 = frame_syncer.addNewFrame(test_frames.at(1).at(0));
+  okvis::MultiFramePtr multiFrame2 = frame_syncer.addNewFrame(test_frames.at(2).at(1));
+  frame_syncer.detectionEndedForFrame(multiFrame1->id(), 0, now);
+  frame_syncer.detectionEndedForFrame(multiFrame2->id(), 1, now);
+  ASSERT_TRUE(frame_syncer.popDispatchableMultiFrames(now, dispatched));
+  ASSERT_EQ(1u, dispatched.size());
+  EXPECT_EQ(multiFrame2->id(), dispatched[0]->id());
+  EXPECT_EQ(2u, frame_syncer.statistics().numDropped);
+
+  // the detection for the dropped one is discarded
+  EXPECT_TRUE(frame_syncer.addNewFrame(test_frames.at(1).at(1)) == nullptr);
+  EXPECT_EQ(1u, frame_syncer.statistics().numDispatched);
+}
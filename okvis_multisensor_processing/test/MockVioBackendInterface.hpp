@@ -68,15 +68,31 @@ public:
   MOCK_METHOD4(removeObservation,
                bool(uint64_t landmarkId, uint64_t poseId, size_t camIdx, size_t keypointIdx));
 
-  MOCK_METHOD3(applyMarginalizationStrategy,
-               bool(size_t numKeyframes, size_t numImuFrames, okvis::MapPointVector & removedLandmarks));
+  MOCK_METHOD4(applyMarginalizationStrategy,
+               bool(size_t numKeyframes, size_t numImuFrames, okvis::MapPointVector & removedLandmarks,
+                    okvis::FrameStateVector * marginalizedStates));
 
   MOCK_METHOD3(optimize,
                void(size_t, size_t, bool));
 
+  MOCK_METHOD4(optimizeLocal,
+               void(size_t, size_t, size_t, bool));
+
+  MOCK_METHOD3(cullOutliers,
+               size_t(okvis::MapPointVector & removedLandmarks, size_t numThreads, double timeLimit));
+
+  MOCK_METHOD1(pruneLandmarks,
+               size_t(okvis::MapPointVector & removedLandmarks));
+
   MOCK_METHOD2(setOptimizationTimeLimit,
                bool(double timeLimit, int minIterations));
 
+  MOCK_METHOD2(refineState,
+               bool(uint64_t poseId, size_t maxIterations));
+
+  MOCK_CONST_METHOD3(computeCovariance,
+                     bool(uint64_t poseId, Eigen::Matrix<double, 15, 15> & covariance, double timeLimit));
+
   MOCK_CONST_METHOD1(isLandmarkAdded,
                      bool(uint64_t landmarkId));
 
@@ -0,0 +1,173 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file testCallbackDispatcher.cpp
+ * @brief Tests of the callback dispatch policies.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include <okvis/CallbackDispatcher.hpp>
+
+namespace {
+
+// Occupies the executor of a dispatcher until release() is called.
+class BlockingJob {
+ public:
+  BlockingJob() : started_(false), released_(false) {}
+  okvis::CallbackDispatcher::Job job() {
+    return [this]() {
+      started_ = true;
+      while (!released_) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    };
+  }
+  void waitUntilStarted() {
+    while (!started_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  void release() {
+    released_ = true;
+  }
+ private:
+  std::atomic_bool started_;
+  std::atomic_bool released_;
+};
+
+// Records the order in which the jobs ran.
+class Recorder {
+ public:
+  okvis::CallbackDispatcher::Job job(int value) {
+    return [this, value]() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      values_.push_back(value);
+    };
+  }
+  std::vector<int> values() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return values_;
+  }
+ private:
+  std::mutex mutex_;
+  std::vector<int> values_;
+};
+
+}  // namespace
+
+TEST(CallbackDispatcher, synchronous) {
+  okvis::CallbackDispatcher dispatcher(okvis::CallbackDispatchParameters(
+      okvis::CallbackDispatchPolicy::Synchronous));
+  std::thread::id caller;
+  dispatcher.dispatch([&caller]() {caller = std::this_thread::get_id();});
+  EXPECT_EQ(std::this_thread::get_id(), caller);
+}
+
+TEST(CallbackDispatcher, latestOnly) {
+  BlockingJob blocker;
+  Recorder recorder;
+  okvis::CallbackDispatcher dispatcher(okvis::CallbackDispatchParameters(
+      okvis::CallbackDispatchPolicy::LatestOnly, 10));
+  dispatcher.dispatch(blocker.job());
+  blocker.waitUntilStarted();
+  for (int i = 0; i < 5; ++i) {
+    dispatcher.dispatch(recorder.job(i));  // never blocks
+  }
+  blocker.release();
+  dispatcher.shutdown();
+  ASSERT_EQ(1u, recorder.values().size());
+  EXPECT_EQ(4, recorder.values().front());
+  EXPECT_EQ(4u, dispatcher.numDropped());
+}
+
+TEST(CallbackDispatcher, bounded) {
+  BlockingJob blocker;
+  Recorder recorder;
+  okvis::CallbackDispatcher dispatcher(okvis::CallbackDispatchParameters(
+      okvis::CallbackDispatchPolicy::Bounded, 3));
+  dispatcher.dispatch(blocker.job());
+  blocker.waitUntilStarted();
+  for (int i = 0; i < 10; ++i) {
+    dispatcher.dispatch(recorder.job(i));  // never blocks
+  }
+  EXPECT_EQ(7u, dispatcher.numDropped());
+  blocker.release();
+  dispatcher.shutdown();
+  EXPECT_EQ(std::vector<int>({7, 8, 9}), recorder.values());
+}
+
+TEST(CallbackDispatcher, blocking) {
+  BlockingJob blocker;
+  Recorder recorder;
+  okvis::CallbackDispatcher dispatcher(okvis::CallbackDispatchParameters(
+      okvis::CallbackDispatchPolicy::Blocking, 2));
+  dispatcher.dispatch(blocker.job());
+  blocker.waitUntilStarted();
+  std::atomic<int> numDispatched(0);
+  std::thread publisher([&]() {
+    for (int i = 0; i < 5; ++i) {
+      dispatcher.dispatch(recorder.job(i));
+      ++numDispatched;
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(2, numDispatched.load());  // waits for the executor
+  blocker.release();
+  publisher.join();
+  dispatcher.shutdown();
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4}), recorder.values());
+  EXPECT_EQ(0u, dispatcher.numDropped());
+}
+
+TEST(CallbackDispatcher, slowConsumerDoesNotDelayOthers) {
+  BlockingJob blocker;
+  Recorder recorder;
+  okvis::CallbackDispatcher slow(okvis::CallbackDispatchParameters(
+      okvis::CallbackDispatchPolicy::LatestOnly));
+  okvis::CallbackDispatcher fast(okvis::CallbackDispatchParameters(
+      okvis::CallbackDispatchPolicy::Bounded, 100));
+  slow.dispatch(blocker.job());
+  blocker.waitUntilStarted();
+  for (int i = 0; i < 10; ++i) {
+    slow.dispatch(recorder.job(-1));
+    fast.dispatch(recorder.job(i));
+  }
+  fast.shutdown();  // runs everything pending
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), recorder.values());
+  blocker.release();
+}
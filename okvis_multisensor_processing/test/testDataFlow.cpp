@@ -3,9 +3,14 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wnon-virtual-dtor"
 
+#include <opencv2/core/version.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
 #pragma GCC diagnostic pop
@@ -24,6 +29,19 @@ using ::testing::Between;
 using ::testing::Return;
 using ::testing::_;
 
+namespace {
+
+// Number of cv::Mat headers sharing the (reference counted) data of image.
+int numReferences(const cv::Mat &image) {
+#if CV_MAJOR_VERSION < 3
+  return image.refcount ? *image.refcount : 0;
+#else
+  return image.u ? image.u->refcount : 0;
+#endif
+}
+
+}  // namespace
+
 
 TEST(OkvisVioInterfaces, testDataFlow) {
   using namespace okvis;
@@ -48,7 +66,7 @@ TEST(OkvisVioInterfaces, testDataFlow) {
       .Times(1);
   EXPECT_CALL(dummy, addStates(_, _, _))
       .Times(Between(5, 10));
-  EXPECT_CALL(dummy, applyMarginalizationStrategy(_, _, _))
+  EXPECT_CALL(dummy, applyMarginalizationStrategy(_, _, _, _))
       .Times(Between(5, 10));
   EXPECT_CALL(dummy, setOptimizationTimeLimit(_, _))
       .Times(1);
@@ -115,3 +133,71 @@ TEST(OkvisVioInterfaces, testDataFlow) {
     }
   }
 }
+
+TEST(OkvisVioInterfaces, testImageBufferRelease) {
+  using namespace okvis;
+
+  okvis::VioParameters parameters;
+  parameters.nCameraSystem = TestDataGenerator::getTestCameraSystem(2);
+  parameters.visualization.displayImages = false;
+  parameters.imu.a_max = 1;
+  parameters.imu.g_max = 1;
+  parameters.optimization.numImuFrames = 2;
+  parameters.publishing.publishImuPropagatedState = true;
+
+  cv::Mat image_cam = cv::imread("testImage.jpg", 0);
+  ASSERT_TRUE(image_cam.data != NULL);
+
+  std::mutex mutex;
+  std::condition_variable releasedCondition;
+  int released = 0;
+  int stillReferenced = 0;
+  int added = 0;
+  {
+    ThreadedKFVio vio(parameters);
+    vio.setBlocking(true);
+
+    double now = okvis::Time::now().toSec();
+    okvis::ImuMeasurement imu_data;
+    imu_data.measurement.accelerometers.setZero();
+    imu_data.measurement.gyroscopes.setZero();
+
+    // the caller-owned buffers are handed in without copying
+    std::vector<cv::Mat> buffers(2);
+    for (int i = 0; i < 10; ++i) {
+      for (int j = 0; j < 5; ++j) {
+        vio.addImuMeasurement(okvis::Time(now), imu_data.measurement.accelerometers, imu_data.measurement.gyroscopes);
+        now += 0.01;
+      }
+      for (size_t c = 0; c < buffers.size(); ++c) {
+        buffers[c] = image_cam.clone();
+        vio.addImageBuffer(okvis::Time(now), c, buffers[c], [&, c]() {
+          std::lock_guard<std::mutex> lock(mutex);
+          // no other cv::Mat, e.g. the image of the multiframe, shares the buffer anymore
+          if (numReferences(buffers[c]) != 1) {
+            ++stillReferenced;
+          }
+          ++released;
+          releasedCondition.notify_all();
+        });
+        ++added;
+      }
+      for (int j = 0; j < 5; ++j) {
+        vio.addImuMeasurement(okvis::Time(now), imu_data.measurement.accelerometers, imu_data.measurement.gyroscopes);
+        now += 0.01;
+      }
+
+      // both buffers come back after detection, before the next frame is added
+      std::unique_lock<std::mutex> lock(mutex);
+      EXPECT_TRUE(releasedCondition.wait_for(lock, std::chrono::seconds(10),
+                                             [&]() {return released == added;}))
+          << "frame " << i << ": " << added - released << " buffers not released";
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(added, released);
+  }
+
+  // every buffer is released exactly once
+  EXPECT_EQ(added, released);
+  EXPECT_EQ(0, stillReferenced);
+}
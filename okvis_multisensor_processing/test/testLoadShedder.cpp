@@ -0,0 +1,126 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file testLoadShedder.cpp
+ * @brief Tests of the load shedding decisions.
+ */
+
+#include "gtest/gtest.h"
+#include <okvis/LoadShedder.hpp>
+
+namespace {
+
+const double camera_rate = 20.0;  // [Hz]
+
+// Receive and add frames at the camera rate with a constant latency.
+void simulate(okvis::LoadShedder &loadShedder, double latency, size_t numFrames) {
+  for (size_t i = 0; i < numFrames; ++i) {
+    const okvis::Time stamp(1.0 + i / camera_rate);
+    loadShedder.frameReceived(stamp, stamp);
+    loadShedder.stateAdded(stamp, stamp + okvis::Duration(latency));
+  }
+}
+
+okvis::LoadSheddingParameters enabledParameters() {
+  okvis::LoadSheddingParameters parameters;
+  parameters.enabled = true;
+  parameters.maxLatency = 2.0;
+  parameters.maxConsecutiveSkips = 2;
+  return parameters;
+}
+
+}  // namespace
+
+TEST(LoadShedder, Latency) {
+  okvis::LoadShedder loadShedder(okvis::LoadSheddingParameters(), camera_rate);
+  simulate(loadShedder, 0.02, 50);
+  EXPECT_NEAR(0.02, loadShedder.statistics().latency, 1e-9);
+  EXPECT_NEAR(0.02, loadShedder.statistics().maxLatency, 1e-9);
+
+  // both cameras of a multiframe: the first reception counts
+  const okvis::Time stamp(10.0);
+  loadShedder.frameReceived(stamp, okvis::Time(10.0));
+  loadShedder.frameReceived(stamp + okvis::Duration(0.001), okvis::Time(10.01));
+  loadShedder.stateAdded(stamp, okvis::Time(10.5));
+  EXPECT_NEAR(0.5, loadShedder.statistics().maxLatency, 1e-9);
+}
+
+TEST(LoadShedder, NoSkipWhenDisabledOrIdle) {
+  okvis::LoadShedder disabled(okvis::LoadSheddingParameters(), camera_rate);
+  simulate(disabled, 1.0, 10);
+  EXPECT_FALSE(disabled.skip(1, false));
+
+  okvis::LoadShedder idle(enabledParameters(), camera_rate);
+  simulate(idle, 0.05, 10);  // one camera period
+  EXPECT_FALSE(idle.overloaded());
+  EXPECT_FALSE(idle.skip(1, false));
+  EXPECT_EQ(0u, idle.statistics().numSkipped);
+}
+
+TEST(LoadShedder, SkipsNonKeyframeCandidates) {
+  okvis::LoadShedder loadShedder(enabledParameters(), camera_rate);
+  simulate(loadShedder, 0.2, 10);  // four camera periods
+  EXPECT_TRUE(loadShedder.overloaded());
+
+  EXPECT_TRUE(loadShedder.skip(1, false));
+  EXPECT_TRUE(loadShedder.skip(1, false));  // same decision for the other cameras
+  EXPECT_FALSE(loadShedder.skip(2, true));  // keyframe candidate
+  EXPECT_TRUE(loadShedder.skip(3, false));
+  EXPECT_TRUE(loadShedder.skip(4, false));
+  EXPECT_FALSE(loadShedder.skip(5, false));  // at most two in a row
+  EXPECT_TRUE(loadShedder.skip(6, false));
+
+  const okvis::LoadShedder::Statistics statistics = loadShedder.statistics();
+  EXPECT_EQ(6u, statistics.numFrames);
+  EXPECT_EQ(4u, statistics.numSkipped);
+  EXPECT_EQ(1u, statistics.numKeyframeCandidatesKept);
+}
+
+TEST(LoadShedder, KeyframeCandidates) {
+  okvis::LoadShedder loadShedder(enabledParameters(), camera_rate);
+  okvis::kinematics::Transformation T_WS;
+  T_WS.setIdentity();
+  EXPECT_TRUE(loadShedder.isKeyframeCandidate(T_WS));  // no keyframe yet
+
+  loadShedder.keyframeAdded(T_WS);
+  EXPECT_FALSE(loadShedder.isKeyframeCandidate(T_WS));
+  EXPECT_TRUE(loadShedder.isKeyframeCandidate(
+      okvis::kinematics::Transformation(Eigen::Vector3d(0.2, 0.0, 0.0),
+                                        Eigen::Quaterniond::Identity())));
+  EXPECT_TRUE(loadShedder.isKeyframeCandidate(
+      okvis::kinematics::Transformation(
+          Eigen::Vector3d::Zero(),
+          Eigen::Quaterniond(Eigen::AngleAxisd(0.2, Eigen::Vector3d::UnitZ())))));
+  EXPECT_FALSE(loadShedder.isKeyframeCandidate(
+      okvis::kinematics::Transformation(Eigen::Vector3d(0.05, 0.0, 0.0),
+                                        Eigen::Quaterniond::Identity())));
+}
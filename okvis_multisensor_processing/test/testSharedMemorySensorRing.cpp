@@ -0,0 +1,335 @@
+/*********************************************************************************
+ *  OKVIS - Open Keyframe-based Visual-Inertial SLAM
+ *  Copyright (c) 2015, Autonomous Systems Lab / ETH Zurich
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright notice,
+ *     this list of conditions and the following disclaimer in the documentation
+ *     and/or other materials provided with the distribution.
+ *   * Neither the name of Autonomous Systems Lab / ETH Zurich nor the names of
+ *     its contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Created on: Oct 18, 2026
+ *********************************************************************************/
+
+/**
+ * @file testSharedMemorySensorRing.cpp
+ * @brief Loopback tests of the shared memory sensor ring.
+ */
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnon-virtual-dtor"
+#include <opencv2/highgui/highgui.hpp>
+#pragma GCC diagnostic pop
+
+#include <okvis/SharedMemorySensorRing.hpp>
+#include <okvis/ThreadedKFVio.hpp>
+
+#include "testDataGenerators.hpp"
+
+namespace {
+
+// Records what the consumer delivers. Releases images right away or keeps them.
+class RecordingVio : public okvis::VioInterface {
+ public:
+  struct Event {
+    bool isImage;
+    okvis::Time stamp;
+    size_t cameraIndex;
+    int value;  // first pixel, or acceleration x
+  };
+
+  explicit RecordingVio(bool holdImages) : holdImages_(holdImages), acceptImages_(true) {}
+
+  bool addImage(const okvis::Time &, size_t, const cv::Mat &,
+                const std::vector<cv::KeyPoint> *, bool *) {
+    return false;
+  }
+  bool addKeypoints(const okvis::Time &, size_t,
+                    const std::vector<cv::KeyPoint> &,
+                    const std::vector<uint64_t> &, const cv::Mat &, bool *) {
+    return false;
+  }
+  bool addImuMeasurement(const okvis::Time &stamp, const Eigen::Vector3d &alpha,
+                         const Eigen::Vector3d &) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.push_back(Event{false, stamp, 0, int(alpha[0])});
+    return true;
+  }
+  bool addImageBuffer(const okvis::Time &stamp, size_t cameraIndex,
+                      const cv::Mat &image,
+                      const ImageReleaseCallback &releaseCallback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // every pixel carries the same value
+    int value = image.at<unsigned char>(0, 0);
+    if (cv::countNonZero(image != value) != 0) {
+      value = -1;
+    }
+    events_.push_back(Event{true, stamp, cameraIndex, value});
+    if (holdImages_) {
+      held_.push_back(releaseCallback);
+    } else {
+      releaseCallback();
+    }
+    return acceptImages_;
+  }
+
+  std::vector<Event> events() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_;
+  }
+  size_t numImages() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t n = 0;
+    for (size_t i = 0; i < events_.size(); ++i) {
+      n += events_[i].isImage ? 1 : 0;
+    }
+    return n;
+  }
+  void setAcceptImages(bool acceptImages) {
+    acceptImages_ = acceptImages;
+  }
+  void releaseOne() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ASSERT_FALSE(held_.empty());
+    held_.front()();
+    held_.erase(held_.begin());
+  }
+
+ private:
+  bool holdImages_;
+  std::atomic_bool acceptImages_;
+  std::mutex mutex_;
+  std::vector<Event> events_;
+  std::vector<ImageReleaseCallback> held_;
+};
+
+std::string ringName(const std::string &test) {
+  return "/okvis_test_ring_" + std::to_string(getpid()) + "_" + test;
+}
+
+bool waitFor(const std::function<bool()> &condition) {
+  for (int i = 0; i < 500 && !condition(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return condition();
+}
+
+}  // namespace
+
+TEST(SharedMemorySensorRing, loopback) {
+  okvis::SensorRingParameters parameters;
+  parameters.numImageSlots = 3;
+  parameters.maxImageBytes = 64 * 48;
+  parameters.imuCapacity = 64;
+  const size_t numFrames = 20;
+
+  RecordingVio vio(false);
+  std::unique_ptr<okvis::SensorRingProducer> producer(
+      new okvis::SensorRingProducer(ringName("loopback"), parameters));
+  okvis::SensorRingConsumer consumer(ringName("loopback"), vio);
+
+  // more frames than slots: the slots need to be recycled
+  okvis::Time t(100, 0);
+  for (size_t k = 0; k < numFrames; ++k) {
+    for (int j = 0; j < 5; ++j) {
+      producer->addImuMeasurement(t, Eigen::Vector3d(k, 0, 0), Eigen::Vector3d::Zero());
+      t += okvis::Duration(0.002);
+    }
+    for (size_t c = 0; c < 2; ++c) {
+      okvis::SensorRingProducer::ImageSlot slot;
+      ASSERT_TRUE(producer->acquireImageSlot(48, 64, CV_8UC1, slot, 1.0));
+      slot.image.setTo(cv::Scalar(k % 256));
+      producer->publishImage(slot, t, c);
+    }
+  }
+  producer.reset();
+  ASSERT_TRUE(waitFor([&consumer]() {return consumer.producerFinished();}));
+
+  const std::vector<RecordingVio::Event> events = vio.events();
+  ASSERT_EQ(numFrames * 7, events.size());
+  EXPECT_EQ(0u, consumer.numDroppedImuMeasurements());
+  EXPECT_EQ(0u, consumer.numRejectedImages());
+  EXPECT_EQ(0u, consumer.numDroppedImages());
+  size_t numImu = 0;
+  size_t numImages = 0;
+  okvis::Time lastStamp(0, 0);
+  for (size_t i = 0; i < events.size(); ++i) {
+    const RecordingVio::Event &event = events[i];
+    EXPECT_GE(event.stamp, lastStamp) << "data out of order";
+    lastStamp = event.stamp;
+    if (event.isImage) {
+      // all IMU readings up to the frame were delivered before it
+      EXPECT_EQ(5 * (numImages / 2 + 1), numImu);
+      EXPECT_EQ(numImages % 2, event.cameraIndex);
+      EXPECT_EQ(int(numImages / 2), event.value) << "image corrupted";
+      ++numImages;
+    } else {
+      EXPECT_EQ(int(numImu / 5), event.value);
+      ++numImu;
+    }
+  }
+}
+
+TEST(SharedMemorySensorRing, slotsReferencedUntilReleased) {
+  okvis::SensorRingParameters parameters;
+  parameters.numImageSlots = 2;
+  parameters.maxImageBytes = 64 * 48;
+
+  RecordingVio vio(true);
+  okvis::SensorRingProducer producer(ringName("release"), parameters);
+  std::unique_ptr<okvis::SensorRingConsumer> consumer(
+      new okvis::SensorRingConsumer(ringName("release"), vio));
+
+  cv::Mat image(48, 64, CV_8UC1, cv::Scalar(7));
+  EXPECT_TRUE(producer.addImage(okvis::Time(1, 0), 0, image));
+  EXPECT_TRUE(producer.addImage(okvis::Time(2, 0), 0, image));
+  ASSERT_TRUE(waitFor([&vio]() {return vio.numImages() == 2;}));
+
+  // both slots are referenced by the sink
+  EXPECT_FALSE(producer.addImage(okvis::Time(3, 0), 0, image));
+  EXPECT_EQ(1u, producer.numDroppedImages());
+
+  // the mapping outlives the consumer while images are referenced
+  consumer.reset();
+  vio.releaseOne();
+  EXPECT_TRUE(producer.addImage(okvis::Time(3, 0), 0, image, 1.0));
+  EXPECT_FALSE(producer.addImage(okvis::Time(4, 0), 0, image));
+  vio.releaseOne();
+  EXPECT_TRUE(producer.addImage(okvis::Time(4, 0), 0, image, 1.0));
+
+  // too large for a slot
+  cv::Mat largeImage(480, 640, CV_8UC1, cv::Scalar(0));
+  EXPECT_THROW(producer.addImage(okvis::Time(5, 0), 0, largeImage),
+               okvis::SensorRingProducer::Exception);
+}
+
+TEST(SharedMemorySensorRing, loopbackToThreadedKFVio) {
+  okvis::VioParameters parameters;
+  parameters.nCameraSystem = TestDataGenerator::getTestCameraSystem(2);
+  parameters.visualization.displayImages = false;
+  parameters.imu.a_max = 1;
+  parameters.imu.g_max = 1;
+  parameters.optimization.numImuFrames = 2;
+
+  cv::Mat image = cv::imread("testImage.jpg", 0);
+  ASSERT_TRUE(image.data != NULL);
+
+  // one slot per camera: the next frame can only be written once ThreadedKFVio has
+  // stopped accessing the slots of the previous one
+  okvis::SensorRingParameters ringParameters;
+  ringParameters.numImageSlots = 2;
+  ringParameters.maxImageBytes = image.total() * image.elemSize();
+  ringParameters.imuCapacity = 64;
+
+  okvis::ThreadedKFVio vio(parameters);
+  vio.setBlocking(true);
+  okvis::SensorRingProducer producer(ringName("threadedKFVio"), ringParameters);
+  okvis::SensorRingConsumer consumer(ringName("threadedKFVio"), vio);
+
+  const Eigen::Vector3d gravity(0.0, 0.0, 9.81);
+  okvis::Time t = okvis::Time::now();
+  for (int k = 0; k < 10; ++k) {
+    for (int j = 0; j < 5; ++j) {
+      producer.addImuMeasurement(t, gravity, Eigen::Vector3d::Zero());
+      t += okvis::Duration(0.01);
+    }
+    for (size_t c = 0; c < 2; ++c) {
+      ASSERT_TRUE(producer.addImage(t, c, image, 10.0))
+          << "slot of camera " << c << " not released after frame " << k - 1;
+    }
+    // the IMU readings after the frame let its detection start
+    for (int j = 0; j < 5; ++j) {
+      producer.addImuMeasurement(t, gravity, Eigen::Vector3d::Zero());
+      t += okvis::Duration(0.01);
+    }
+  }
+  EXPECT_EQ(0u, producer.numDroppedImages());
+  EXPECT_EQ(0u, consumer.numRejectedImages());
+}
+
+TEST(SharedMemorySensorRing, imuOverflow) {
+  okvis::SensorRingParameters parameters;
+  parameters.numImageSlots = 1;
+  parameters.maxImageBytes = 64;
+  parameters.imuCapacity = 8;
+
+  RecordingVio vio(false);
+  std::unique_ptr<okvis::SensorRingProducer> producer(
+      new okvis::SensorRingProducer(ringName("overflow"), parameters));
+  for (int i = 0; i < 20; ++i) {
+    producer->addImuMeasurement(okvis::Time(1, i), Eigen::Vector3d(i, 0, 0),
+                                Eigen::Vector3d::Zero());
+  }
+  okvis::SensorRingConsumer consumer(ringName("overflow"), vio);
+  producer.reset();
+  ASSERT_TRUE(waitFor([&consumer]() {return consumer.producerFinished();}));
+
+  // the oldest readings were overwritten
+  const std::vector<RecordingVio::Event> events = vio.events();
+  EXPECT_EQ(12u, consumer.numDroppedImuMeasurements());
+  ASSERT_EQ(8u, events.size());
+  for (size_t i = 0; i < events.size(); ++i) {
+    EXPECT_EQ(int(12 + i), events[i].value);
+  }
+}
+
+TEST(SharedMemorySensorRing, rejectedAndDroppedImages) {
+  okvis::SensorRingParameters parameters;
+  parameters.numImageSlots = 2;
+  parameters.maxImageBytes = 64 * 48;
+
+  RecordingVio vio(false);
+  vio.setAcceptImages(false);
+  okvis::SensorRingProducer producer(ringName("rejected"), parameters);
+  okvis::SensorRingConsumer consumer(ringName("rejected"), vio);
+  cv::Mat image(48, 64, CV_8UC1, cv::Scalar(7));
+
+  // a non-blocking sink that does not accept an image has dropped frames
+  vio.setBlocking(false);
+  EXPECT_TRUE(producer.addImage(okvis::Time(1, 0), 0, image, 1.0));
+  ASSERT_TRUE(waitFor([&consumer]() {return consumer.numDroppedImages() == 1;}));
+  EXPECT_EQ(0u, consumer.numRejectedImages());
+
+  // a blocking one has rejected the image
+  vio.setBlocking(true);
+  EXPECT_TRUE(producer.addImage(okvis::Time(2, 0), 0, image, 1.0));
+  ASSERT_TRUE(waitFor([&consumer]() {return consumer.numRejectedImages() == 1;}));
+  EXPECT_EQ(1u, consumer.numDroppedImages());
+}
+
+TEST(SharedMemorySensorRing, missingSegment) {
+  RecordingVio vio(false);
+  EXPECT_THROW(okvis::SensorRingConsumer consumer(ringName("missing"), vio),
+               okvis::SensorRingConsumer::Exception);
+}